@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Detection box overlap and non-maximum suppression.
+ *
+ * Split out of fpga_lpr_display.c so det_nms_test can check the NMS engine
+ * against a plain pairwise greedy pass without the RKNN/GStreamer stack.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "det_nms.h"
+
+struct point2f {
+    float x;
+    float y;
+};
+
+float box_iou(const struct det_box *a, const struct det_box *b)
+{
+    int x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    int y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    int x2 = a->x2 < b->x2 ? a->x2 : b->x2;
+    int y2 = a->y2 < b->y2 ? a->y2 : b->y2;
+    int iw = x2 - x1 + 1;
+    int ih = y2 - y1 + 1;
+    int ia;
+    int ua;
+    if (iw <= 0 || ih <= 0)
+        return 0.0f;
+    ia = iw * ih;
+    ua = (a->x2 - a->x1 + 1) * (a->y2 - a->y1 + 1) +
+         (b->x2 - b->x1 + 1) * (b->y2 - b->y1 + 1) - ia;
+    if (ua <= 0)
+        return 0.0f;
+    return (float)ia / (float)ua;
+}
+static float polygon_area_signed(const struct point2f *pts, int n)
+{
+    float acc = 0.0f;
+    int i;
+    for (i = 0; i < n; i++) {
+        const struct point2f *a = &pts[i];
+        const struct point2f *b = &pts[(i + 1) % n];
+        acc += a->x * b->y - b->x * a->y;
+    }
+    return 0.5f * acc;
+}
+
+static float polygon_area_abs(const struct point2f *pts, int n)
+{
+    float a = polygon_area_signed(pts, n);
+    return (a >= 0.0f) ? a : -a;
+}
+
+static bool clip_inside(const struct point2f *p, const struct point2f *a,
+                        const struct point2f *b, float orient_sign)
+{
+    float cross = (b->x - a->x) * (p->y - a->y) - (b->y - a->y) * (p->x - a->x);
+    if (orient_sign >= 0.0f)
+        return cross >= -1e-6f;
+    return cross <= 1e-6f;
+}
+
+static struct point2f line_intersection(const struct point2f *s, const struct point2f *e,
+                                        const struct point2f *a, const struct point2f *b)
+{
+    struct point2f out = *e;
+    float x1 = s->x, y1 = s->y;
+    float x2 = e->x, y2 = e->y;
+    float x3 = a->x, y3 = a->y;
+    float x4 = b->x, y4 = b->y;
+    float den = (x1 - x2) * (y3 - y4) - (y1 - y2) * (x3 - x4);
+    if (fabsf(den) < 1e-8f)
+        return out;
+    out.x = ((x1 * y2 - y1 * x2) * (x3 - x4) - (x1 - x2) * (x3 * y4 - y3 * x4)) / den;
+    out.y = ((x1 * y2 - y1 * x2) * (y3 - y4) - (y1 - y2) * (x3 * y4 - y3 * x4)) / den;
+    return out;
+}
+
+static int convex_clip_polygon(const struct point2f *subject, int subject_n,
+                               const struct point2f *clip, int clip_n,
+                               struct point2f *out, int out_cap)
+{
+    struct point2f in_buf[16];
+    struct point2f out_buf[16];
+    int in_n = subject_n;
+    int i;
+    if (subject_n <= 0 || clip_n <= 0 || out_cap <= 0)
+        return 0;
+    if (subject_n > 16 || clip_n > 16)
+        return 0;
+    memcpy(in_buf, subject, (size_t)subject_n * sizeof(subject[0]));
+    for (i = 0; i < clip_n; i++) {
+        struct point2f a = clip[i];
+        struct point2f b = clip[(i + 1) % clip_n];
+        float orient = polygon_area_signed(clip, clip_n);
+        int j;
+        int out_n = 0;
+        if (in_n <= 0)
+            return 0;
+        for (j = 0; j < in_n; j++) {
+            struct point2f cur = in_buf[j];
+            struct point2f prev = in_buf[(j + in_n - 1) % in_n];
+            bool cur_in = clip_inside(&cur, &a, &b, orient);
+            bool prev_in = clip_inside(&prev, &a, &b, orient);
+            if (cur_in) {
+                if (!prev_in && out_n < 16)
+                    out_buf[out_n++] = line_intersection(&prev, &cur, &a, &b);
+                if (out_n < 16)
+                    out_buf[out_n++] = cur;
+            } else if (prev_in) {
+                if (out_n < 16)
+                    out_buf[out_n++] = line_intersection(&prev, &cur, &a, &b);
+            }
+        }
+        memcpy(in_buf, out_buf, (size_t)out_n * sizeof(out_buf[0]));
+        in_n = out_n;
+    }
+    if (in_n > out_cap)
+        in_n = out_cap;
+    memcpy(out, in_buf, (size_t)in_n * sizeof(out[0]));
+    return in_n;
+}
+
+static void det_to_quad_points(const struct det_box *d, struct point2f q[4])
+{
+    if (d->has_obb) {
+        int i;
+        for (i = 0; i < 4; i++) {
+            q[i].x = d->quad[i * 2 + 0];
+            q[i].y = d->quad[i * 2 + 1];
+        }
+        return;
+    }
+    q[0].x = (float)d->x1; q[0].y = (float)d->y1;
+    q[1].x = (float)d->x2; q[1].y = (float)d->y1;
+    q[2].x = (float)d->x2; q[2].y = (float)d->y2;
+    q[3].x = (float)d->x1; q[3].y = (float)d->y2;
+}
+
+float rotated_iou(const struct det_box *a, const struct det_box *b)
+{
+    struct point2f qa[4];
+    struct point2f qb[4];
+    struct point2f inter[16];
+    float area_a;
+    float area_b;
+    float inter_area;
+    float denom;
+    int inter_n;
+    if (box_iou(a, b) <= 0.0f)
+        return 0.0f;
+    det_to_quad_points(a, qa);
+    det_to_quad_points(b, qb);
+    area_a = polygon_area_abs(qa, 4);
+    area_b = polygon_area_abs(qb, 4);
+    if (area_a <= 1e-6f || area_b <= 1e-6f)
+        return 0.0f;
+    inter_n = convex_clip_polygon(qa, 4, qb, 4, inter, 16);
+    if (inter_n <= 2)
+        return 0.0f;
+    inter_area = polygon_area_abs(inter, inter_n);
+    if (inter_area <= 1e-6f)
+        return 0.0f;
+    denom = area_a + area_b - inter_area;
+    if (denom <= 1e-6f)
+        return 0.0f;
+    return inter_area / denom;
+}
+
+/*
+ * Shared NMS engine behind nms_inplace and rotated_nms_inplace. The
+ * candidates are copied to SoA arrays. They are then popped from a
+ * max-heap by confidence, so only as many as can still be kept get
+ * ordered. Each is checked against the boxes already kept in its class
+ * bucket, which gives the same result as greedy suppression. Every pair
+ * goes through an AABB overlap test first; rotated pairs use the hull of
+ * their quads, not the clamped corners. Rotated pairs also go through
+ * an AABB bound on their polygon IoU, so only pairs that could exceed
+ * the threshold reach convex_clip_polygon. From NMS_GRID_MIN candidates
+ * on, kept boxes are indexed in a uniform grid and a candidate only visits
+ * the cells it touches.
+ */
+#define NMS_MAX_CAND (MAX_DETS * 4)
+#define NMS_BUCKETS 16
+#define NMS_GRID 8
+#define NMS_GRID_MIN 64
+#define NMS_CELL_ENTRIES (MAX_DETS * 16)
+
+struct nms_scratch {
+    int x1[NMS_MAX_CAND];
+    int y1[NMS_MAX_CAND];
+    int x2[NMS_MAX_CAND];
+    int y2[NMS_MAX_CAND];
+    float conf[NMS_MAX_CAND];
+    int cls[NMS_MAX_CAND];
+    float area[NMS_MAX_CAND];       /* polygon area, rotated mode only */
+    int heap[NMS_MAX_CAND];
+    /* Kept boxes, by keep slot: class bucket chains and grid cell chains */
+    int keep[MAX_DETS];
+    int stamp[MAX_DETS];
+    int bucket_head[NMS_BUCKETS];
+    int bucket_next[MAX_DETS];
+    int cell_head[NMS_GRID * NMS_GRID];
+    int cell_slot[NMS_CELL_ENTRIES];
+    int cell_next[NMS_CELL_ENTRIES];
+    struct det_box out[MAX_DETS];
+};
+
+static __thread struct nms_scratch g_nms;
+
+static void nms_heap_sift(const float *conf, int *heap, int n, int i)
+{
+    for (;;) {
+        int l = 2 * i + 1;
+        int r = l + 1;
+        int m = i;
+        int t;
+        if (l < n && conf[heap[l]] > conf[heap[m]]) m = l;
+        if (r < n && conf[heap[r]] > conf[heap[m]]) m = r;
+        if (m == i)
+            return;
+        t = heap[i];
+        heap[i] = heap[m];
+        heap[m] = t;
+        i = m;
+    }
+}
+
+/* Does kept candidate @k suppress candidate @c? Cheapest rejections first. */
+static bool nms_suppresses(const struct nms_scratch *s, const struct det_box *dets,
+                           int k, int c, float iou_thr, bool rotated)
+{
+    if (s->cls[k] != s->cls[c])
+        return false;
+    if (s->x2[k] < s->x1[c] || s->x2[c] < s->x1[k] ||
+        s->y2[k] < s->y1[c] || s->y2[c] < s->y1[k])
+        return false;
+    if (!rotated)
+        return box_iou(&dets[k], &dets[c]) > iou_thr;
+    {
+        /* The quads lie inside their hulls (see nms_run), so this bounds their IoU from above. */
+        float iw = (float)((s->x2[k] < s->x2[c] ? s->x2[k] : s->x2[c]) -
+                           (s->x1[k] > s->x1[c] ? s->x1[k] : s->x1[c]));
+        float ih = (float)((s->y2[k] < s->y2[c] ? s->y2[k] : s->y2[c]) -
+                           (s->y1[k] > s->y1[c] ? s->y1[k] : s->y1[c]));
+        float ub = fminf(iw * ih, fminf(s->area[k], s->area[c]));
+        float den = s->area[k] + s->area[c] - ub;
+        if (ub <= 0.0f || den <= 1e-6f || ub / den <= iou_thr)
+            return false;
+    }
+    return rotated_iou(&dets[k], &dets[c]) > iou_thr;
+}
+
+/* Greedy NMS over dets[0..n), keeping at most @max_keep; returns the kept count. */
+static int nms_run(struct det_box *dets, int n, float iou_thr, int max_keep, bool rotated)
+{
+    struct nms_scratch *s = &g_nms;
+    int min_x = 1 << 30, min_y = 1 << 30;
+    int max_x = -(1 << 30), max_y = -(1 << 30);
+    int cell_w = 1, cell_h = 1;
+    int cell_used = 0;
+    bool use_grid;
+    int heap_n;
+    int kept = 0;
+    int i;
+
+    if (n > NMS_MAX_CAND)
+        n = NMS_MAX_CAND;
+    if (max_keep <= 0 || max_keep > MAX_DETS)
+        max_keep = MAX_DETS;
+    if (n <= 0)
+        return 0;
+
+    for (i = 0; i < n; i++) {
+        const struct det_box *d = &dets[i];
+        s->x1[i] = d->x1;
+        s->y1[i] = d->y1;
+        s->x2[i] = d->x2;
+        s->y2[i] = d->y2;
+        s->conf[i] = d->conf;
+        s->cls[i] = d->cls;
+        if (rotated) {
+            /*
+             * Decoders clamp x1..y2 to the image, but a quad may hang over
+             * the edge. Rebuild the hull from the quad so the AABB tests and
+             * the IoU bound in nms_suppresses() cover the whole polygon.
+             */
+            struct point2f q[4];
+            float qx1, qy1, qx2, qy2;
+            int j;
+            det_to_quad_points(d, q);
+            s->area[i] = polygon_area_abs(q, 4);
+            qx1 = qx2 = q[0].x;
+            qy1 = qy2 = q[0].y;
+            for (j = 1; j < 4; j++) {
+                qx1 = fminf(qx1, q[j].x);
+                qy1 = fminf(qy1, q[j].y);
+                qx2 = fmaxf(qx2, q[j].x);
+                qy2 = fmaxf(qy2, q[j].y);
+            }
+            s->x1[i] = (int)floorf(qx1);
+            s->y1[i] = (int)floorf(qy1);
+            s->x2[i] = (int)ceilf(qx2);
+            s->y2[i] = (int)ceilf(qy2);
+        }
+        if (s->x1[i] < min_x) min_x = s->x1[i];
+        if (s->y1[i] < min_y) min_y = s->y1[i];
+        if (s->x2[i] > max_x) max_x = s->x2[i];
+        if (s->y2[i] > max_y) max_y = s->y2[i];
+        s->heap[i] = i;
+    }
+    use_grid = n >= NMS_GRID_MIN;
+    if (use_grid) {
+        cell_w = (max_x - min_x) / NMS_GRID + 1;
+        cell_h = (max_y - min_y) / NMS_GRID + 1;
+        for (i = 0; i < NMS_GRID * NMS_GRID; i++)
+            s->cell_head[i] = -1;
+    }
+    for (i = 0; i < NMS_BUCKETS; i++)
+        s->bucket_head[i] = -1;
+
+    heap_n = n;
+    for (i = n / 2 - 1; i >= 0; i--)
+        nms_heap_sift(s->conf, s->heap, heap_n, i);
+
+    while (heap_n > 0 && kept < max_keep) {
+        int c = s->heap[0];
+        int bucket = (int)((unsigned int)s->cls[c] % NMS_BUCKETS);
+        bool suppressed = false;
+        int gx1 = 0, gy1 = 0, gx2 = 0, gy2 = 0;
+        int gx, gy;
+        int k;
+
+        s->heap[0] = s->heap[--heap_n];
+        nms_heap_sift(s->conf, s->heap, heap_n, 0);
+
+        if (use_grid) {
+            gx1 = (s->x1[c] - min_x) / cell_w;
+            gy1 = (s->y1[c] - min_y) / cell_h;
+            gx2 = (s->x2[c] - min_x) / cell_w;
+            gy2 = (s->y2[c] - min_y) / cell_h;
+            for (gy = gy1; gy <= gy2 && !suppressed; gy++) {
+                for (gx = gx1; gx <= gx2 && !suppressed; gx++) {
+                    int e;
+                    for (e = s->cell_head[gy * NMS_GRID + gx]; e >= 0; e = s->cell_next[e]) {
+                        k = s->cell_slot[e];
+                        if (s->stamp[k] == c)
+                            continue;
+                        s->stamp[k] = c;
+                        if (nms_suppresses(s, dets, s->keep[k], c, iou_thr, rotated)) {
+                            suppressed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        } else {
+            for (k = s->bucket_head[bucket]; k >= 0; k = s->bucket_next[k]) {
+                if (nms_suppresses(s, dets, s->keep[k], c, iou_thr, rotated)) {
+                    suppressed = true;
+                    break;
+                }
+            }
+        }
+        if (suppressed)
+            continue;
+
+        s->keep[kept] = c;
+        s->stamp[kept] = -1;
+        s->bucket_next[kept] = s->bucket_head[bucket];
+        s->bucket_head[bucket] = kept;
+        if (use_grid) {
+            if (cell_used + (gy2 - gy1 + 1) * (gx2 - gx1 + 1) > NMS_CELL_ENTRIES) {
+                /* Out of cell entries: the bucket chains still hold every kept box. */
+                use_grid = false;
+            } else {
+                for (gy = gy1; gy <= gy2; gy++) {
+                    for (gx = gx1; gx <= gx2; gx++) {
+                        s->cell_slot[cell_used] = kept;
+                        s->cell_next[cell_used] = s->cell_head[gy * NMS_GRID + gx];
+                        s->cell_head[gy * NMS_GRID + gx] = cell_used++;
+                    }
+                }
+            }
+        }
+        kept++;
+    }
+
+    for (i = 0; i < kept; i++)
+        s->out[i] = dets[s->keep[i]];
+    memcpy(dets, s->out, (size_t)kept * sizeof(dets[0]));
+    return kept;
+}
+
+void nms_inplace(struct det_box *dets, int *count, float iou_thr)
+{
+    *count = nms_run(dets, *count, iou_thr, MAX_DETS, false);
+}
+
+void rotated_nms_inplace(struct det_box *dets, int *count, float iou_thr, int max_det)
+{
+    *count = nms_run(dets, *count, iou_thr, max_det, true);
+}
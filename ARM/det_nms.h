@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Detection boxes and non-maximum suppression for fpga_lpr_display.
+ *
+ * Axis-aligned boxes use inclusive integer corners. Oriented (OBB) boxes
+ * also carry their four corners in quad[]; the integer corners are only a
+ * bound and may have been clamped to the image, so rotated overlap is
+ * always measured on the quad.
+ */
+
+#ifndef _DET_NMS_H
+#define _DET_NMS_H
+
+#define MAX_DETS 128
+
+struct det_box {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+    float conf;
+    int cls;
+    int has_obb;
+    float cx;
+    float cy;
+    float w;
+    float h;
+    float angle;
+    float quad[8];
+};
+
+/* IoU of the inclusive integer rectangles */
+float box_iou(const struct det_box *a, const struct det_box *b);
+/* IoU of the quads (the rectangle for boxes without has_obb) */
+float rotated_iou(const struct det_box *a, const struct det_box *b);
+
+/*
+ * Greedy per-class NMS by descending confidence, in place. Suppresses a
+ * box when its IoU with a kept box of the same class exceeds @iou_thr.
+ */
+void nms_inplace(struct det_box *dets, int *count, float iou_thr);
+/* Same, on rotated_iou(), keeping at most @max_det boxes */
+void rotated_nms_inplace(struct det_box *dets, int *count, float iou_thr, int max_det);
+
+#endif /* _DET_NMS_H */
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * NMS self-test
+ *
+ * Checks nms_inplace and rotated_nms_inplace against a plain pairwise
+ * greedy pass. Boxes are built the way the decoders leave them: oriented
+ * quads whose integer corners are clamped to a 640x640 canvas, so plates
+ * hanging over the edge keep a quad larger than their rectangle.
+ *
+ * Usage: det_nms_test
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "det_nms.h"
+
+#define CANVAS_SIZE 640    /* ALGO_STREAM_SIZE in fpga_lpr_display */
+#define NMS_TRIALS  400
+
+static uint32_t g_seed = 0x1234567u;
+
+static float frand(float lo, float hi)
+{
+    g_seed = g_seed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(g_seed >> 8) / (float)(1u << 24);
+}
+
+/* det_quad_from_obb() followed by clamp_box(), as in decode_yolov8_obb_outputs */
+static void make_obb(struct det_box *d, float cx, float cy, float w, float h,
+                     float angle, float conf, int cls)
+{
+    static const float local[4][2] = { {-1, -1}, {1, -1}, {1, 1}, {-1, 1} };
+    float c = cosf(angle), s = sinf(angle);
+    float min_x = 1e30f, min_y = 1e30f, max_x = -1e30f, max_y = -1e30f;
+    int i;
+
+    memset(d, 0, sizeof(*d));
+    d->cx = cx; d->cy = cy; d->w = w; d->h = h; d->angle = angle;
+    d->conf = conf;
+    d->cls = cls;
+    for (i = 0; i < 4; i++) {
+        float lx = local[i][0] * w * 0.5f;
+        float ly = local[i][1] * h * 0.5f;
+        float x = cx + lx * c - ly * s;
+        float y = cy + lx * s + ly * c;
+        d->quad[i * 2 + 0] = x;
+        d->quad[i * 2 + 1] = y;
+        min_x = fminf(min_x, x); max_x = fmaxf(max_x, x);
+        min_y = fminf(min_y, y); max_y = fmaxf(max_y, y);
+    }
+    d->x1 = (int)floorf(min_x);
+    d->y1 = (int)floorf(min_y);
+    d->x2 = (int)ceilf(max_x);
+    d->y2 = (int)ceilf(max_y);
+    d->has_obb = 1;
+    if (d->x1 < 0) d->x1 = 0;
+    if (d->y1 < 0) d->y1 = 0;
+    if (d->x2 >= CANVAS_SIZE) d->x2 = CANVAS_SIZE - 1;
+    if (d->y2 >= CANVAS_SIZE) d->y2 = CANVAS_SIZE - 1;
+    if (d->x2 < d->x1) d->x2 = d->x1;
+    if (d->y2 < d->y1) d->y2 = d->y1;
+}
+
+/* Sort by confidence, keep a box unless a kept box of its class overlaps it. */
+static int reference_nms(struct det_box *dets, int n, float iou_thr, int max_keep, bool rotated)
+{
+    struct det_box tmp[MAX_DETS * 4];
+    int kept = 0;
+    int i, j;
+
+    memcpy(tmp, dets, (size_t)n * sizeof(dets[0]));
+    for (i = 1; i < n; i++) {
+        struct det_box t = tmp[i];
+        for (j = i; j > 0 && tmp[j - 1].conf < t.conf; j--)
+            tmp[j] = tmp[j - 1];
+        tmp[j] = t;
+    }
+    for (i = 0; i < n && kept < max_keep; i++) {
+        bool suppressed = false;
+        for (j = 0; j < kept && !suppressed; j++) {
+            float iou;
+            if (dets[j].cls != tmp[i].cls)
+                continue;
+            iou = rotated ? rotated_iou(&dets[j], &tmp[i]) : box_iou(&dets[j], &tmp[i]);
+            suppressed = iou > iou_thr;
+        }
+        if (!suppressed)
+            dets[kept++] = tmp[i];
+    }
+    return kept;
+}
+
+static int compare_nms(const char *what, const struct det_box *in, int n,
+                       float iou_thr, int max_keep, bool rotated)
+{
+    struct det_box got[MAX_DETS * 4];
+    struct det_box want[MAX_DETS * 4];
+    int got_n = n;
+    int want_n;
+    int i;
+
+    memcpy(got, in, (size_t)n * sizeof(in[0]));
+    memcpy(want, in, (size_t)n * sizeof(in[0]));
+    if (rotated)
+        rotated_nms_inplace(got, &got_n, iou_thr, max_keep);
+    else
+        nms_inplace(got, &got_n, iou_thr);
+    want_n = reference_nms(want, n, iou_thr, rotated ? max_keep : MAX_DETS, rotated);
+    if (got_n != want_n) {
+        printf("%s: kept %d boxes, greedy pass keeps %d\n", what, got_n, want_n);
+        return 1;
+    }
+    for (i = 0; i < got_n; i++) {
+        if (memcmp(&got[i], &want[i], sizeof(got[i])) != 0) {
+            printf("%s: kept box %d differs from the greedy pass\n", what, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Two near-identical plates mostly off the left edge: their clamped
+ * rectangles are slivers, but the quads overlap almost entirely.
+ */
+static int edge_overlap_test(void)
+{
+    struct det_box d[2];
+    int n = 2;
+    int fails = 0;
+
+    make_obb(&d[0], -30.0f, 300.0f, 90.0f, 30.0f, 0.15f, 0.9f, 0);
+    make_obb(&d[1], -28.0f, 301.0f, 90.0f, 30.0f, 0.12f, 0.8f, 0);
+    fails += compare_nms("edge overlap", d, 2, 0.45f, MAX_DETS, true);
+    rotated_nms_inplace(d, &n, 0.45f, MAX_DETS);
+    if (n != 1 || d[0].conf != 0.9f) {
+        printf("edge overlap: expected only the 0.9 plate, kept %d\n", n);
+        fails++;
+    }
+
+    make_obb(&d[0], 630.0f, 645.0f, 80.0f, 26.0f, -0.3f, 0.7f, 0);
+    make_obb(&d[1], 632.0f, 644.0f, 80.0f, 26.0f, -0.28f, 0.75f, 0);
+    fails += compare_nms("corner overlap", d, 2, 0.45f, MAX_DETS, true);
+    return fails;
+}
+
+/* Random clusters, below and above the grid threshold, some across the edges */
+static int random_test(void)
+{
+    static struct det_box d[MAX_DETS * 4];
+    int trial;
+    int fails = 0;
+
+    for (trial = 0; trial < NMS_TRIALS && !fails; trial++) {
+        int n = trial % 2 ? 8 + trial % 40 : 64 + trial % (MAX_DETS * 4 - 64);
+        int clusters = 1 + trial % 7;
+        int i;
+
+        for (i = 0; i < n; i++) {
+            float cx = (float)((i % clusters) * CANVAS_SIZE / clusters) + frand(-40.0f, 40.0f);
+            float cy = (float)((i % clusters) * 97 % CANVAS_SIZE) + frand(-40.0f, 40.0f);
+            /* Distinct confidences keep the greedy order well defined. */
+            make_obb(&d[i], cx, cy, frand(20.0f, 140.0f), frand(8.0f, 50.0f),
+                     frand(-0.8f, 0.8f), 0.05f + 0.9f * (float)i / (float)n + frand(0.0f, 1e-4f),
+                     (int)(frand(0.0f, 3.0f)));
+        }
+        fails += compare_nms("random rotated", d, n, 0.3f + 0.1f * (float)(trial % 4),
+                             trial % 3 ? MAX_DETS : 10, true);
+        for (i = 0; i < n; i++)
+            d[i].has_obb = 0;
+        fails += compare_nms("random axis", d, n, 0.45f, MAX_DETS, false);
+    }
+    return fails;
+}
+
+int main(void)
+{
+    int fails = edge_overlap_test() + random_test();
+
+    if (fails) {
+        printf("FAIL: %d NMS cases\n", fails);
+        return 1;
+    }
+    printf("PASS: NMS matches the pairwise greedy pass.\n");
+    return 0;
+}
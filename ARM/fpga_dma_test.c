@@ -3,9 +3,12 @@
  * FPGA DMA Test Application
  *
  * Userspace test program for the FPGA DMA driver
- * Tests: device info query, DMA frame transfer, data validation
+ * Tests: device info query, DMA frame transfer, data validation,
+ *        throughput/latency benchmark (--bench), raw recording (--record)
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,8 +21,10 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include "pcie_fpga_dma.h"
+#include "frame_record.h"
 
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
@@ -132,6 +137,15 @@ static void print_usage(const char *progname)
     printf("  --save-ppm <filename>  Save frame as PPM image\n");
     printf("  --ppm-mode <mode>      PPM decode mode (default: bgr565): rgb565|bgr565|rgb565-swap|bgr565-swap\n");
     printf("  --mmap                 Test mmap buffer access\n");
+    printf("  --dmabuf               Test dma-buf export of ring buffer 0\n");
+    printf("  --roi <x,y,w,h[,d]>    Read one window of the frame, decimated by d (1|2|4, default: 1)\n");
+    printf("  --bench <modes>        Benchmark modes, comma list or 'all':\n");
+    printf("                         copy|mmap|userptr|queue|cpu-malloc|cpu-ring|cpu-dmabuf\n");
+    printf("                         (--count sets frames per mode, default: 300)\n");
+    printf("  --bench-csv <file>     Append benchmark rows to CSV file\n");
+    printf("  --bench-label <text>   Tag benchmark rows (e.g. bitstream or driver version)\n");
+    printf("  --sweep <p=v1,v2,..>   Rerun the benchmark for each value of a runtime driver parameter\n");
+    printf("  --record <file>        Stream frames into a FRAW recording (--count, default: until Ctrl+C)\n");
     printf("  --help                 Show this help message\n");
     printf("\nExamples:\n");
     printf("  %s --info\n", progname);
@@ -139,6 +153,10 @@ static void print_usage(const char *progname)
     printf("  %s --read frame.raw --verify --dump 64\n", progname);
     printf("  %s --read frame.raw --save-ppm frame.ppm\n", progname);
     printf("  %s --continuous --count 100\n", progname);
+    printf("  %s --roi 0,0,1280,720,2 --verify\n", progname);
+    printf("  %s --bench all --count 300 --bench-csv dma_bench.csv --bench-label v5_1\n", progname);
+    printf("  %s --bench copy,mmap --sweep dma_max_len_dwords=256,512,1023\n", progname);
+    printf("  %s --record traffic.fraw --count 3600\n", progname);
 }
 
 /**
@@ -147,6 +165,7 @@ static void print_usage(const char *progname)
 static int print_fpga_info(int fd)
 {
     struct fpga_info info;
+    struct fpga_tensor_info tinfo;
     int ret;
 
     ret = ioctl(fd, FPGA_DMA_GET_INFO, &info);
@@ -170,6 +189,18 @@ static int print_fpga_info(int fd)
     printf("  Frame Size:            %u bytes (%.2f MB)\n",
            info.frame_stride * info.frame_height,
            (float)(info.frame_stride * info.frame_height) / (1024 * 1024));
+    memset(&tinfo, 0, sizeof(tinfo));
+    if (ioctl(fd, FPGA_DMA_GET_TENSOR_INFO, &tinfo) < 0) {
+        printf("  Tensor Slots:          0 (driver has no tensor channel: %s)\n", strerror(errno));
+    } else if (tinfo.count) {
+        printf("  Tensor Slots:          %u\n", tinfo.count);
+        printf("  Tensor Layout:         %ux%u format=%u stride=%u bytes\n",
+               tinfo.width, tinfo.height, tinfo.format, tinfo.stride);
+        printf("  Tensor Letterbox:      scale=%.4f pad=%u,%u\n",
+               (double)tinfo.scale_q16 / 65536.0, tinfo.pad_x, tinfo.pad_y);
+    } else {
+        printf("  Tensor Slots:          0 (dma_tensor=0 or no MSI)\n");
+    }
     print_color(COLOR_BLUE, "===============================");
 
     return 0;
@@ -374,6 +405,1073 @@ static int test_mmap(int fd)
     return 0;
 }
 
+/**
+ * test_dmabuf - Export ring buffer 0 as dma-buf and compare with the ring mmap
+ */
+static int test_dmabuf(int fd)
+{
+    struct dma_buffer_export exp;
+    struct buffer_map map;
+    void *ring_map;
+    void *buf_map;
+    int ret;
+
+    print_color(COLOR_BLUE, "Testing dma-buf export...");
+
+    memset(&map, 0, sizeof(map));
+    map.index = 0;
+    if (ioctl(fd, FPGA_DMA_MAP_BUFFER, &map) < 0) {
+        print_color(COLOR_RED, "Failed to get buffer info: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&exp, 0, sizeof(exp));
+    exp.index = 0;
+    exp.flags = O_CLOEXEC;
+    if (ioctl(fd, FPGA_DMA_EXPORT_DMABUF, &exp) < 0) {
+        print_color(COLOR_RED, "dma-buf export failed: %s", strerror(errno));
+        return -1;
+    }
+    printf("dma-buf fd: %d, size: %u bytes\n", exp.fd, exp.size);
+
+    ring_map = mmap(NULL, map.size, PROT_READ, MAP_SHARED, fd, (off_t)map.offset);
+    if (ring_map == MAP_FAILED) {
+        print_color(COLOR_RED, "ring mmap failed: %s", strerror(errno));
+        close(exp.fd);
+        return -1;
+    }
+    buf_map = mmap(NULL, exp.size, PROT_READ, MAP_SHARED, exp.fd, 0);
+    if (buf_map == MAP_FAILED) {
+        print_color(COLOR_RED, "dma-buf mmap failed: %s", strerror(errno));
+        munmap(ring_map, map.size);
+        close(exp.fd);
+        return -1;
+    }
+
+    ret = read_frame(fd, NULL, FPGA_FRAME_SIZE);
+    if (ret == 0) {
+        if (memcmp(ring_map, buf_map, exp.size < map.size ? exp.size : map.size) == 0) {
+            print_color(COLOR_GREEN, "dma-buf contents match ring buffer 0");
+        } else {
+            print_color(COLOR_RED, "dma-buf contents differ from ring buffer 0");
+            ret = -1;
+        }
+    }
+
+    munmap(buf_map, exp.size);
+    munmap(ring_map, map.size);
+    close(exp.fd);
+    return ret;
+}
+
+/**
+ * test_roi - Read one window of the frame and report the landed layout
+ */
+static int test_roi(int fd, struct dma_roi_transfer *roi, int do_verify, int dump_bytes)
+{
+    struct timespec start, end;
+    size_t max_size = (size_t)roi->width * roi->height * FPGA_FRAME_BPP_BGRX8888;
+    uint8_t *buffer;
+    double elapsed;
+
+    buffer = malloc(max_size);
+    if (!buffer) {
+        print_color(COLOR_RED, "Failed to allocate buffer");
+        return -1;
+    }
+
+    print_color(COLOR_BLUE, "Reading ROI %ux%u+%u+%u decim=%u...",
+                roi->width, roi->height, roi->x, roi->y, roi->decim);
+
+    roi->xfer.user_buf = (uint64_t)(unsigned long)buffer;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (ioctl(fd, FPGA_DMA_READ_ROI, roi) < 0) {
+        print_color(COLOR_RED, "ROI read failed: %s", strerror(errno));
+        free(buffer);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    print_color(COLOR_GREEN, "ROI read %u bytes (%ux%u, stride %u) in %.3f seconds (%.2f MB/s)",
+                roi->xfer.size, roi->stride / FPGA_FRAME_BPP_BGRX8888,
+                roi->stride ? roi->xfer.size / roi->stride : 0, roi->stride,
+                elapsed, roi->xfer.size / (elapsed * 1024 * 1024));
+
+    if (do_verify) {
+        verify_frame(buffer, roi->xfer.size);
+    }
+    if (dump_bytes > 0) {
+        dump_data(buffer, (size_t)dump_bytes < roi->xfer.size ? (size_t)dump_bytes : roi->xfer.size);
+    }
+
+    free(buffer);
+    return 0;
+}
+
+/*
+ * Benchmark mode (--bench)
+ *
+ * Every mode runs @frames timed iterations after a short warm-up and emits one
+ * CSV row.  DMA modes time the ioctl that lands a frame; the cpu-* modes time
+ * a full read of an already-landed frame, which is where coherent (uncached on
+ * arm64) and cacheable ring memory differ.  Each row carries the driver
+ * parameters in effect so runs under different insmod settings line up.
+ */
+#define BENCH_PARAM_DIR   "/sys/module/pcie_fpga_dma/parameters"
+#define BENCH_STATS_DIR   "/sys/class/fpga_dma/" FPGA_DMA_DEV_NAME
+#define BENCH_WARMUP      5
+#define BENCH_MAX_VALUES  16
+
+enum bench_mode {
+    BENCH_COPY = 0,     /* READ_FRAME, kernel copies the ring slot to user memory */
+    BENCH_MMAP,         /* READ_FRAME into ring slot 0, no copy */
+    BENCH_USERPTR,      /* READ_FRAME with FPGA_DMA_XFER_FLAG_USERPTR */
+    BENCH_QUEUE,        /* QBUF/DQBUF over every ring slot */
+    BENCH_CPU_MALLOC,   /* CPU read of a malloc'd frame */
+    BENCH_CPU_RING,     /* CPU read of ring slot 0 through the device mmap */
+    BENCH_CPU_DMABUF,   /* CPU read of ring slot 0 through an exported dma-buf */
+    BENCH_MODE_COUNT,
+};
+
+static const char *const bench_mode_names[BENCH_MODE_COUNT] = {
+    "copy", "mmap", "userptr", "queue", "cpu-malloc", "cpu-ring", "cpu-dmabuf",
+};
+
+/* Parameters stamped on every CSV row */
+static const char *const bench_row_params[] = {
+    "dma_max_len_dwords", "dma_poll_sleep_us", "dma_poll_sleep_max_us",
+    "dma_ring_buffers", "dma_ring_cached", "dma_allow_poll_fallback",
+    "dma_poll_frame_mode",
+};
+
+/* Read by the driver at probe only; a change needs rmmod/insmod */
+static const char *const bench_probe_params[] = {
+    "dma_ring_buffers", "dma_ring_cached", "dma_allow_poll_fallback", "dma_pixel_format",
+    "dma_tensor",
+};
+
+struct bench_ctx {
+    int fd;
+    int frames;
+    unsigned int modes;          /* bitmask of enum bench_mode */
+    const char *label;
+    FILE *csv;
+    struct fpga_info info;
+    size_t frame_size;
+    uint32_t ring_count;
+    uint32_t ring_size;          /* per-slot mmap size */
+    uint8_t *ring[FPGA_DMA_MAX_RING_BUFFERS];
+    uint8_t *copy_buf;
+    uint8_t *user_buf;           /* page aligned for USERPTR */
+    int dmabuf_fd;
+    uint8_t *dmabuf_map;
+    uint32_t dmabuf_size;
+    double *lat_us;
+    const char *sweep_param;
+    const char *sweep_value;
+};
+
+static volatile uint64_t g_bench_sink;
+
+static double bench_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+/**
+ * sysfs_read_long - Read one integer (or Y/N bool) sysfs value, -1 if absent
+ */
+static long sysfs_read_long(const char *path)
+{
+    char buf[32];
+    FILE *fp;
+    long val = -1;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    if (fgets(buf, sizeof(buf), fp)) {
+        if (buf[0] == 'Y')
+            val = 1;
+        else if (buf[0] == 'N')
+            val = 0;
+        else
+            val = strtol(buf, NULL, 0);
+    }
+    fclose(fp);
+    return val;
+}
+
+static int sysfs_write_str(const char *path, const char *value)
+{
+    FILE *fp;
+    int ret = 0;
+
+    fp = fopen(path, "w");
+    if (!fp)
+        return -1;
+    if (fputs(value, fp) < 0)
+        ret = -1;
+    if (fclose(fp) != 0)
+        ret = -1;
+    return ret;
+}
+
+static long bench_param(const char *name)
+{
+    char path[160];
+
+    snprintf(path, sizeof(path), BENCH_PARAM_DIR "/%s", name);
+    return sysfs_read_long(path);
+}
+
+static long bench_stat(const char *name)
+{
+    char path[160];
+
+    snprintf(path, sizeof(path), BENCH_STATS_DIR "/%s", name);
+    return sysfs_read_long(path);
+}
+
+static int bench_is_probe_param(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(bench_probe_params) / sizeof(bench_probe_params[0]); i++) {
+        if (strcmp(name, bench_probe_params[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * parse_bench_modes - "all" or a comma list of bench_mode_names into a bitmask
+ */
+static int parse_bench_modes(const char *arg, unsigned int *mask)
+{
+    char buf[128];
+    char *tok;
+    char *save = NULL;
+    int m;
+
+    if (strcmp(arg, "all") == 0) {
+        *mask = (1U << BENCH_MODE_COUNT) - 1;
+        return 0;
+    }
+    snprintf(buf, sizeof(buf), "%s", arg);
+    *mask = 0;
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        for (m = 0; m < BENCH_MODE_COUNT; m++) {
+            if (strcmp(tok, bench_mode_names[m]) == 0)
+                break;
+        }
+        if (m == BENCH_MODE_COUNT)
+            return -1;
+        *mask |= 1U << m;
+    }
+    return *mask ? 0 : -1;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of an ascending array */
+static double percentile(const double *sorted, int n, double pct)
+{
+    int rank;
+
+    if (n <= 0)
+        return 0.0;
+    rank = (int)(pct / 100.0 * n + 0.999999);
+    if (rank < 1)
+        rank = 1;
+    if (rank > n)
+        rank = n;
+    return sorted[rank - 1];
+}
+
+/* Touch every 64-bit word so the read cannot be elided */
+static void cpu_read_frame(const uint8_t *buf, size_t size)
+{
+    const uint64_t *p = (const uint64_t *)buf;
+    size_t words = size / sizeof(uint64_t);
+    uint64_t acc = 0;
+    size_t i;
+
+    for (i = 0; i < words; i++)
+        acc += p[i];
+    g_bench_sink += acc;
+}
+
+static int bench_sync(int fd, uint32_t index, uint32_t flags)
+{
+    struct dma_buffer_sync sync;
+
+    memset(&sync, 0, sizeof(sync));
+    sync.index = index;
+    sync.flags = flags;
+    return ioctl(fd, FPGA_DMA_SYNC_BUFFER, &sync);
+}
+
+static int bench_read_userptr(int fd, void *buffer, size_t size)
+{
+    struct dma_transfer transfer;
+
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.size = size;
+    transfer.flags = FPGA_DMA_XFER_FLAG_USERPTR;
+    transfer.result = -1;
+    transfer.user_buf = (uint64_t)(unsigned long)buffer;
+    if (ioctl(fd, FPGA_DMA_READ_FRAME, &transfer) < 0 || transfer.result != 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * bench_one - One timed iteration of a non-queue mode, returns 0 or -1
+ */
+static int bench_one(struct bench_ctx *b, enum bench_mode mode)
+{
+    switch (mode) {
+    case BENCH_COPY:
+        return read_frame(b->fd, b->copy_buf, b->frame_size);
+    case BENCH_MMAP:
+        return read_frame(b->fd, NULL, b->frame_size);
+    case BENCH_USERPTR:
+        return bench_read_userptr(b->fd, b->user_buf, b->frame_size);
+    case BENCH_CPU_MALLOC:
+        cpu_read_frame(b->copy_buf, b->frame_size);
+        return 0;
+    case BENCH_CPU_RING:
+        /* No-ops on a coherent ring, cache maintenance on a cacheable one */
+        if (bench_sync(b->fd, 0, FPGA_DMA_SYNC_START) < 0)
+            return -1;
+        cpu_read_frame(b->ring[0], b->frame_size);
+        return bench_sync(b->fd, 0, FPGA_DMA_SYNC_END);
+    case BENCH_CPU_DMABUF:
+        cpu_read_frame(b->dmabuf_map, b->frame_size);
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * bench_run_queue - Keep every ring slot queued; latency is the DQBUF interval
+ */
+static int bench_run_queue(struct bench_ctx *b, int *errors, double *elapsed_us)
+{
+    struct dma_buffer_req req;
+    uint32_t queued = 0;
+    double prev;
+    double now;
+    int n = 0;
+    int i;
+
+    for (i = 0; i < (int)b->ring_count; i++) {
+        memset(&req, 0, sizeof(req));
+        req.index = i;
+        if (ioctl(b->fd, FPGA_DMA_QBUF, &req) < 0) {
+            print_color(COLOR_RED, "QBUF %d failed: %s", i, strerror(errno));
+            break;
+        }
+        queued++;
+    }
+
+    prev = bench_now_us();
+    for (i = 0; queued > 0 && i < BENCH_WARMUP + b->frames && g_running; i++) {
+        memset(&req, 0, sizeof(req));
+        if (ioctl(b->fd, FPGA_DMA_DQBUF, &req) < 0) {
+            print_color(COLOR_RED, "DQBUF failed: %s", strerror(errno));
+            (*errors)++;
+            queued = 0;
+            break;
+        }
+        now = bench_now_us();
+        queued--;
+        if (req.result != 0)
+            (*errors)++;
+        else if (i >= BENCH_WARMUP) {
+            b->lat_us[n++] = now - prev;
+            *elapsed_us += now - prev;
+        }
+        prev = now;
+
+        if (ioctl(b->fd, FPGA_DMA_QBUF, &req) == 0)
+            queued++;
+    }
+
+    /* Leave every slot idle for the next mode */
+    while (queued > 0) {
+        memset(&req, 0, sizeof(req));
+        if (ioctl(b->fd, FPGA_DMA_DQBUF, &req) < 0)
+            break;
+        queued--;
+    }
+    return n;
+}
+
+/**
+ * bench_report - Print one mode's summary and append its CSV row
+ */
+static void bench_report(struct bench_ctx *b, enum bench_mode mode, int n, int errors,
+                         double elapsed_us, long irq_delta, long fallback_delta)
+{
+    uint64_t bytes = (uint64_t)n * b->frame_size;
+    double mb_s = elapsed_us > 0 ? (double)bytes / elapsed_us : 0.0;
+    double fps = elapsed_us > 0 ? n * 1e6 / elapsed_us : 0.0;
+    double p50, p90, p99, lat_max;
+    const char *path;
+    time_t now;
+    char ts[32];
+    size_t i;
+
+    qsort(b->lat_us, n, sizeof(double), cmp_double);
+    p50 = percentile(b->lat_us, n, 50.0);
+    p90 = percentile(b->lat_us, n, 90.0);
+    p99 = percentile(b->lat_us, n, 99.0);
+    lat_max = n > 0 ? b->lat_us[n - 1] : 0.0;
+
+    if (mode >= BENCH_CPU_MALLOC)
+        path = "cpu";
+    else if (irq_delta > 0)
+        path = fallback_delta > 0 ? "irq+poll" : "irq";
+    else if (irq_delta == 0)
+        path = "poll";
+    else
+        path = "unknown";
+
+    print_color(errors ? COLOR_YELLOW : COLOR_GREEN,
+                "%-10s %5d frames %8.2f MB/s %7.2f fps  p50 %8.1f p90 %8.1f p99 %8.1f max %8.1f us  err=%d path=%s",
+                bench_mode_names[mode], n, mb_s, fps, p50, p90, p99, lat_max, errors, path);
+
+    if (!b->csv)
+        return;
+
+    now = time(NULL);
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    fprintf(b->csv, "%s,%s,%s,%s,%s,%zu,%d,%llu,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f,%d,%s,%u,%u",
+            ts, b->label ? b->label : "", bench_mode_names[mode],
+            b->sweep_param ? b->sweep_param : "", b->sweep_value ? b->sweep_value : "",
+            b->frame_size, n, (unsigned long long)bytes, mb_s, fps,
+            p50, p90, p99, lat_max, errors, path,
+            b->info.link_width, b->info.link_speed);
+    for (i = 0; i < sizeof(bench_row_params) / sizeof(bench_row_params[0]); i++)
+        fprintf(b->csv, ",%ld", bench_param(bench_row_params[i]));
+    fprintf(b->csv, "\n");
+    fflush(b->csv);
+}
+
+/**
+ * bench_run_mode - Warm up, time @b->frames iterations and report one mode
+ */
+static void bench_run_mode(struct bench_ctx *b, enum bench_mode mode)
+{
+    long irq0 = bench_stat("irq_count");
+    long fb0 = bench_stat("poll_fallbacks");
+    long irq_delta = -1;
+    long fb_delta = 0;
+    double elapsed = 0.0;
+    double start, t0, t1;
+    int errors = 0;
+    int n = 0;
+    int i;
+
+    if ((mode == BENCH_CPU_DMABUF && !b->dmabuf_map) ||
+        ((mode == BENCH_MMAP || mode == BENCH_CPU_RING || mode == BENCH_QUEUE) && !b->ring[0])) {
+        print_color(COLOR_YELLOW, "%-10s skipped (buffer not mapped)", bench_mode_names[mode]);
+        return;
+    }
+
+    /* cpu-* modes read a frame that is already in place */
+    if (mode == BENCH_CPU_MALLOC && read_frame(b->fd, b->copy_buf, b->frame_size) < 0)
+        return;
+    if ((mode == BENCH_CPU_RING || mode == BENCH_CPU_DMABUF) &&
+        read_frame(b->fd, NULL, b->frame_size) < 0)
+        return;
+
+    if (mode == BENCH_QUEUE) {
+        n = bench_run_queue(b, &errors, &elapsed);
+    } else {
+        start = bench_now_us();
+        for (i = 0; i < BENCH_WARMUP + b->frames && g_running; i++) {
+            if (i == BENCH_WARMUP)
+                start = bench_now_us();
+            t0 = bench_now_us();
+            if (bench_one(b, mode) < 0) {
+                errors++;
+                continue;
+            }
+            t1 = bench_now_us();
+            if (i >= BENCH_WARMUP)
+                b->lat_us[n++] = t1 - t0;
+        }
+        elapsed = bench_now_us() - start;
+    }
+
+    if (irq0 >= 0) {
+        irq_delta = bench_stat("irq_count") - irq0;
+        fb_delta = bench_stat("poll_fallbacks") - fb0;
+    }
+    bench_report(b, mode, n, errors, elapsed, irq_delta, fb_delta);
+}
+
+static void bench_run_all(struct bench_ctx *b)
+{
+    int m;
+
+    for (m = 0; m < BENCH_MODE_COUNT && g_running; m++) {
+        if (b->modes & (1U << m))
+            bench_run_mode(b, (enum bench_mode)m);
+    }
+}
+
+/**
+ * bench_setup - Query geometry and map the ring, a dma-buf and user buffers
+ */
+static int bench_setup(struct bench_ctx *b)
+{
+    struct dma_buffer_export exp;
+    struct buffer_map map;
+    uint32_t i;
+
+    if (ioctl(b->fd, FPGA_DMA_GET_INFO, &b->info) < 0) {
+        print_color(COLOR_RED, "Failed to get FPGA info: %s", strerror(errno));
+        return -1;
+    }
+    b->frame_size = (size_t)b->info.frame_stride * b->info.frame_height;
+    if (!b->frame_size)
+        b->frame_size = FPGA_FRAME_SIZE;
+
+    for (i = 0; i < FPGA_DMA_MAX_RING_BUFFERS; i++) {
+        void *p;
+
+        memset(&map, 0, sizeof(map));
+        map.index = i;
+        if (ioctl(b->fd, FPGA_DMA_MAP_BUFFER, &map) < 0)
+            break;
+        p = mmap(NULL, map.size, PROT_READ, MAP_SHARED, b->fd, (off_t)map.offset);
+        if (p == MAP_FAILED) {
+            print_color(COLOR_YELLOW, "ring %u mmap failed: %s", i, strerror(errno));
+            break;
+        }
+        b->ring[i] = p;
+        b->ring_size = map.size;
+        b->ring_count = i + 1;
+    }
+
+    b->dmabuf_fd = -1;
+    memset(&exp, 0, sizeof(exp));
+    exp.index = 0;
+    exp.flags = O_CLOEXEC;
+    if (ioctl(b->fd, FPGA_DMA_EXPORT_DMABUF, &exp) == 0) {
+        void *p = mmap(NULL, exp.size, PROT_READ, MAP_SHARED, exp.fd, 0);
+
+        b->dmabuf_fd = exp.fd;
+        if (p != MAP_FAILED) {
+            b->dmabuf_map = p;
+            b->dmabuf_size = exp.size;
+        }
+    }
+
+    b->copy_buf = malloc(b->frame_size);
+    b->lat_us = calloc(b->frames + BENCH_WARMUP, sizeof(double));
+    if (posix_memalign((void **)&b->user_buf, 4096, b->frame_size) != 0)
+        b->user_buf = NULL;
+    if (!b->copy_buf || !b->lat_us || !b->user_buf) {
+        print_color(COLOR_RED, "Failed to allocate benchmark buffers");
+        return -1;
+    }
+    memset(b->copy_buf, 0, b->frame_size);
+    memset(b->user_buf, 0, b->frame_size);
+
+    print_color(COLOR_BLUE, "Benchmark: %d frames/mode, frame %zu bytes, ring %u x %u bytes (%s), link x%u Gen%u",
+                b->frames, b->frame_size, b->ring_count, b->ring_size,
+                bench_param("dma_ring_cached") > 0 ? "cacheable" : "coherent",
+                b->info.link_width, b->info.link_speed);
+    return 0;
+}
+
+static void bench_teardown(struct bench_ctx *b)
+{
+    uint32_t i;
+
+    for (i = 0; i < b->ring_count; i++)
+        munmap(b->ring[i], b->ring_size);
+    if (b->dmabuf_map)
+        munmap(b->dmabuf_map, b->dmabuf_size);
+    if (b->dmabuf_fd >= 0)
+        close(b->dmabuf_fd);
+    free(b->copy_buf);
+    free(b->user_buf);
+    free(b->lat_us);
+}
+
+/**
+ * run_benchmark - Run the selected modes, once or per --sweep value
+ * @sweep: "param=v1,v2,..." or NULL
+ */
+static int run_benchmark(int fd, int frames, unsigned int modes, const char *sweep,
+                         const char *csv_file, const char *label)
+{
+    struct bench_ctx b;
+    char values[256];
+    char *list[BENCH_MAX_VALUES];
+    char param_path[160];
+    char saved[32];
+    char *save = NULL;
+    char *tok;
+    char *eq;
+    int nvalues = 0;
+    long orig;
+    size_t i;
+    int v;
+
+    memset(&b, 0, sizeof(b));
+    b.fd = fd;
+    b.frames = frames > 0 ? frames : 300;
+    b.modes = modes;
+    b.label = label;
+
+    if (sweep) {
+        snprintf(values, sizeof(values), "%s", sweep);
+        eq = strchr(values, '=');
+        if (!eq || eq == values || !eq[1]) {
+            print_color(COLOR_RED, "Invalid --sweep '%s' (want param=v1,v2,...)", sweep);
+            return -1;
+        }
+        *eq = '\0';
+        b.sweep_param = values;
+        if (bench_is_probe_param(b.sweep_param)) {
+            print_color(COLOR_RED, "%s is read at probe time; sweep it with run_dma_bench.sh", b.sweep_param);
+            return -1;
+        }
+        for (tok = strtok_r(eq + 1, ",", &save); tok && nvalues < BENCH_MAX_VALUES;
+             tok = strtok_r(NULL, ",", &save))
+            list[nvalues++] = tok;
+        snprintf(param_path, sizeof(param_path), BENCH_PARAM_DIR "/%s", b.sweep_param);
+        orig = sysfs_read_long(param_path);
+        if (orig < 0) {
+            print_color(COLOR_RED, "Unknown driver parameter '%s'", b.sweep_param);
+            return -1;
+        }
+        snprintf(saved, sizeof(saved), "%ld", orig);
+    }
+
+    if (bench_setup(&b) < 0) {
+        bench_teardown(&b);
+        return -1;
+    }
+
+    if (csv_file) {
+        b.csv = fopen(csv_file, "a");
+        if (!b.csv) {
+            print_color(COLOR_RED, "Failed to open CSV '%s': %s", csv_file, strerror(errno));
+            bench_teardown(&b);
+            return -1;
+        }
+        /* Appending lets repeated runs (other bitstreams, insmod settings) share a table */
+        if (ftell(b.csv) == 0) {
+            fprintf(b.csv, "timestamp,label,mode,sweep_param,sweep_value,frame_bytes,frames,bytes,"
+                           "mb_s,fps,lat_p50_us,lat_p90_us,lat_p99_us,lat_max_us,errors,path,"
+                           "link_width,link_speed");
+            for (i = 0; i < sizeof(bench_row_params) / sizeof(bench_row_params[0]); i++)
+                fprintf(b.csv, ",%s", bench_row_params[i]);
+            fprintf(b.csv, "\n");
+        }
+    }
+
+    if (!sweep) {
+        bench_run_all(&b);
+    } else {
+        for (v = 0; v < nvalues && g_running; v++) {
+            if (sysfs_write_str(param_path, list[v]) < 0) {
+                print_color(COLOR_RED, "Failed to set %s=%s: %s", b.sweep_param, list[v], strerror(errno));
+                continue;
+            }
+            b.sweep_value = list[v];
+            print_color(COLOR_BLUE, "--- %s=%s ---", b.sweep_param, list[v]);
+            bench_run_all(&b);
+        }
+        if (sysfs_write_str(param_path, saved) < 0)
+            print_color(COLOR_YELLOW, "Failed to restore %s=%s", b.sweep_param, saved);
+    }
+
+    if (b.csv) {
+        fclose(b.csv);
+        print_color(COLOR_GREEN, "Benchmark results appended to '%s'", csv_file);
+    }
+    bench_teardown(&b);
+    return 0;
+}
+
+#define RECORD_QUEUE_DEPTH      12
+#define RECORD_PREALLOC_FRAMES  600   /* file grows ~10 s of 60 fps at a time */
+
+/*
+ * Write-behind queue: the capture loop fills bufs[prod % depth] while the
+ * writer thread drains bufs[cons % depth]. A full queue drops the frame
+ * instead of holding a ring slot, so slow storage never stalls the DMA.
+ */
+struct record_ctx {
+    int fd;                          /* output file */
+    int direct;                      /* opened with O_DIRECT */
+    struct frame_record_header hdr;
+    uint64_t alloc_slots;            /* slots covered by fallocate */
+    uint8_t *bufs[RECORD_QUEUE_DEPTH];
+    uint64_t prod;
+    uint64_t cons;
+    uint64_t max_depth;
+    int done;
+    int write_error;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/**
+ * record_reserve - Preallocate @ahead more slots once the writer reaches @slot
+ */
+static void record_reserve(struct record_ctx *r, uint64_t slot, uint64_t ahead)
+{
+    uint64_t want;
+
+    if (slot < r->alloc_slots)
+        return;
+    want = slot + ahead;
+    if (fallocate(r->fd, 0, (off_t)r->hdr.data_offset,
+                  (off_t)(want * r->hdr.slot_bytes)) < 0) {
+        print_color(COLOR_YELLOW, "fallocate failed (%s), writing without preallocation",
+                    strerror(errno));
+        want = UINT64_MAX;
+    }
+    r->alloc_slots = want;
+}
+
+/**
+ * record_write_all - pwrite() a whole aligned block, retrying short writes
+ */
+static int record_write_all(int fd, const uint8_t *buf, size_t len, off_t off)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = pwrite(fd, buf, len, off);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        off += n;
+    }
+    return 0;
+}
+
+static void *record_writer_main(void *arg)
+{
+    struct record_ctx *r = arg;
+    uint64_t slot;
+    uint8_t *buf;
+
+    for (;;) {
+        pthread_mutex_lock(&r->lock);
+        while (r->cons == r->prod && !r->done)
+            pthread_cond_wait(&r->cond, &r->lock);
+        if (r->cons == r->prod) {
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+        slot = r->cons;
+        buf = r->bufs[slot % RECORD_QUEUE_DEPTH];
+        pthread_mutex_unlock(&r->lock);
+
+        record_reserve(r, slot, RECORD_PREALLOC_FRAMES);
+        if (record_write_all(r->fd, buf, r->hdr.slot_bytes,
+                             (off_t)(r->hdr.data_offset + slot * r->hdr.slot_bytes)) < 0) {
+            print_color(COLOR_RED, "Recording write failed at frame %llu: %s",
+                        (unsigned long long)slot, strerror(errno));
+            pthread_mutex_lock(&r->lock);
+            r->write_error = 1;
+            pthread_mutex_unlock(&r->lock);
+            break;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        r->cons++;
+        pthread_mutex_unlock(&r->lock);
+    }
+    return NULL;
+}
+
+/**
+ * record_write_header - Write r->hdr as the zero-padded header page
+ */
+static int record_write_header(struct record_ctx *r)
+{
+    uint8_t *page = NULL;
+    int ret;
+
+    if (posix_memalign((void **)&page, FRAME_RECORD_ALIGN, FRAME_RECORD_ALIGN) != 0)
+        return -1;
+    memset(page, 0, FRAME_RECORD_ALIGN);
+    memcpy(page, &r->hdr, sizeof(r->hdr));
+    ret = record_write_all(r->fd, page, FRAME_RECORD_ALIGN, 0);
+    free(page);
+    return ret;
+}
+
+/**
+ * record_finish - Trim the preallocated tail and write the final header
+ */
+static int record_finish(struct record_ctx *r)
+{
+    if (ftruncate(r->fd, (off_t)(r->hdr.data_offset + r->hdr.frame_count * r->hdr.slot_bytes)) < 0 ||
+        record_write_header(r) < 0 || fsync(r->fd) < 0) {
+        print_color(COLOR_RED, "Failed to finalize recording: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * run_record - Stream queued DMA frames into a FRAW container
+ * @frames: Frames to record, 0 until Ctrl+C
+ *
+ * Every ring slot stays queued; each completed frame is copied once into a
+ * page-aligned slot image and handed to the writer thread. The header goes
+ * out first with frame_count 0 and is rewritten at the end, so a file that
+ * still says 0 is an interrupted recording the replay side can recover.
+ */
+static int run_record(int fd, const char *path, int frames)
+{
+    struct record_ctx r;
+    struct fpga_info info;
+    struct buffer_map map;
+    struct dma_buffer_req req;
+    struct frame_record_entry *e;
+    uint8_t *ring[FPGA_DMA_MAX_RING_BUFFERS];
+    uint32_t ring_count = 0;
+    uint32_t ring_size = 0;
+    uint32_t queued = 0;
+    uint32_t prev_seq = 0;
+    uint64_t captured = 0;
+    uint64_t seq_gaps = 0;
+    uint64_t depth;
+    uint32_t driver_dropped = 0;
+    pthread_t writer;
+    struct timespec ts;
+    double t0, elapsed;
+    uint8_t *slot;
+    int errors = 0;
+    int ret = -1;
+    int full;
+    int werr;
+    uint32_t i;
+
+    memset(&r, 0, sizeof(r));
+    memset(ring, 0, sizeof(ring));
+    r.fd = -1;
+    pthread_mutex_init(&r.lock, NULL);
+    pthread_cond_init(&r.cond, NULL);
+
+    if (ioctl(fd, FPGA_DMA_GET_INFO, &info) < 0) {
+        print_color(COLOR_RED, "Failed to get FPGA info: %s", strerror(errno));
+        goto out;
+    }
+    r.hdr.magic = FRAME_RECORD_MAGIC;
+    r.hdr.version = FRAME_RECORD_VERSION;
+    r.hdr.width = info.frame_width;
+    r.hdr.height = info.frame_height;
+    r.hdr.bpp = info.frame_bpp;
+    r.hdr.stride = info.frame_stride;
+    r.hdr.pixel_format = info.pixel_format;
+    r.hdr.frame_bytes = info.frame_stride * info.frame_height;
+    if (!r.hdr.frame_bytes)
+        r.hdr.frame_bytes = FPGA_FRAME_SIZE;
+    r.hdr.slot_bytes = (uint32_t)FRAME_RECORD_SLOT_BYTES(r.hdr.frame_bytes);
+    r.hdr.data_offset = FRAME_RECORD_ALIGN;
+
+    for (i = 0; i < FPGA_DMA_MAX_RING_BUFFERS; i++) {
+        void *p;
+
+        memset(&map, 0, sizeof(map));
+        map.index = i;
+        if (ioctl(fd, FPGA_DMA_MAP_BUFFER, &map) < 0)
+            break;
+        p = mmap(NULL, map.size, PROT_READ, MAP_SHARED, fd, (off_t)map.offset);
+        if (p == MAP_FAILED)
+            break;
+        ring[i] = p;
+        ring_size = map.size;
+        ring_count = i + 1;
+    }
+    if (ring_count == 0 || ring_size < r.hdr.frame_bytes) {
+        print_color(COLOR_RED, "Recording needs the mmap'able DMA ring");
+        goto out;
+    }
+
+    for (i = 0; i < RECORD_QUEUE_DEPTH; i++) {
+        if (posix_memalign((void **)&r.bufs[i], FRAME_RECORD_ALIGN, r.hdr.slot_bytes) != 0) {
+            r.bufs[i] = NULL;
+            print_color(COLOR_RED, "Failed to allocate recording buffers");
+            goto out;
+        }
+        /* Padding stays zero; only the entry and payload change per frame */
+        memset(r.bufs[i], 0, r.hdr.slot_bytes);
+    }
+
+    r.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    r.direct = r.fd >= 0;
+    if (r.fd < 0 && errno == EINVAL) {
+        /* tmpfs and some FUSE mounts refuse O_DIRECT */
+        print_color(COLOR_YELLOW, "O_DIRECT not supported on '%s', using buffered writes", path);
+        r.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (r.fd < 0) {
+        print_color(COLOR_RED, "Failed to open '%s': %s", path, strerror(errno));
+        goto out;
+    }
+    /* Provisional header; record_finish() rewrites it with frame_count and drops */
+    record_reserve(&r, 0, frames > 0 ? (uint64_t)frames : RECORD_PREALLOC_FRAMES);
+    if (record_write_header(&r) < 0) {
+        print_color(COLOR_RED, "Failed to write recording header: %s", strerror(errno));
+        goto out;
+    }
+
+    if (pthread_create(&writer, NULL, record_writer_main, &r) != 0) {
+        print_color(COLOR_RED, "Failed to start writer thread");
+        goto out;
+    }
+
+    for (i = 0; i < ring_count; i++) {
+        memset(&req, 0, sizeof(req));
+        req.index = i;
+        if (ioctl(fd, FPGA_DMA_QBUF, &req) < 0) {
+            print_color(COLOR_RED, "QBUF %u failed: %s", i, strerror(errno));
+            break;
+        }
+        queued++;
+    }
+
+    print_color(COLOR_BLUE, "Recording %s to '%s': %ux%u fmt %u, %u bytes/frame, %u-slot ring, %s",
+                frames > 0 ? "frames" : "until Ctrl+C", path, r.hdr.width, r.hdr.height,
+                r.hdr.pixel_format, r.hdr.frame_bytes, ring_count,
+                r.direct ? "O_DIRECT" : "buffered");
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    r.hdr.start_ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    t0 = bench_now_us();
+    while (queued > 0 && g_running && (frames <= 0 || captured < (uint64_t)frames)) {
+        memset(&req, 0, sizeof(req));
+        if (ioctl(fd, FPGA_DMA_DQBUF, &req) < 0) {
+            if (errno == EINTR)
+                continue;
+            print_color(COLOR_RED, "DQBUF failed: %s", strerror(errno));
+            errors++;
+            break;
+        }
+        queued--;
+
+        if (req.result != 0 || req.index >= ring_count) {
+            errors++;
+        } else {
+            if (captured > 0 && req.sequence != prev_seq + 1)
+                seq_gaps += req.sequence - prev_seq - 1;
+            prev_seq = req.sequence;
+            driver_dropped = req.dropped;
+
+            pthread_mutex_lock(&r.lock);
+            full = r.prod - r.cons >= RECORD_QUEUE_DEPTH;
+            werr = r.write_error;
+            slot = r.bufs[r.prod % RECORD_QUEUE_DEPTH];
+            pthread_mutex_unlock(&r.lock);
+
+            if (werr) {
+                ioctl(fd, FPGA_DMA_QBUF, &req);
+                queued++;
+                break;
+            }
+            if (full) {
+                r.hdr.dropped++;
+            } else {
+                e = (struct frame_record_entry *)slot;
+                e->timestamp_ns = req.timestamp_ns;
+                e->sequence = req.sequence;
+                e->driver_dropped = req.dropped;
+                e->index = (uint32_t)r.prod;
+                e->size = req.size ? req.size : r.hdr.frame_bytes;
+                if (e->size > r.hdr.frame_bytes)
+                    e->size = r.hdr.frame_bytes;
+                bench_sync(fd, req.index, FPGA_DMA_SYNC_START);
+                memcpy(slot + FRAME_RECORD_ENTRY_BYTES, ring[req.index], e->size);
+                bench_sync(fd, req.index, FPGA_DMA_SYNC_END);
+
+                pthread_mutex_lock(&r.lock);
+                r.prod++;
+                depth = r.prod - r.cons;
+                if (depth > r.max_depth)
+                    r.max_depth = depth;
+                pthread_cond_signal(&r.cond);
+                pthread_mutex_unlock(&r.lock);
+            }
+            captured++;
+        }
+
+        if (ioctl(fd, FPGA_DMA_QBUF, &req) == 0)
+            queued++;
+    }
+
+    pthread_mutex_lock(&r.lock);
+    r.done = 1;
+    pthread_cond_signal(&r.cond);
+    pthread_mutex_unlock(&r.lock);
+    pthread_join(writer, NULL);
+    elapsed = bench_now_us() - t0;
+
+    while (queued > 0) {
+        memset(&req, 0, sizeof(req));
+        if (ioctl(fd, FPGA_DMA_DQBUF, &req) < 0)
+            break;
+        queued--;
+    }
+
+    /* Only slots the writer completed are part of the file */
+    r.hdr.frame_count = r.cons;
+    if (record_finish(&r) < 0)
+        goto out;
+
+    print_color(r.hdr.dropped || seq_gaps || errors || r.write_error ? COLOR_YELLOW : COLOR_GREEN,
+                "Recorded %llu/%llu frames in %.2f s (%.2f fps, %.2f MB/s to disk), "
+                "queue full %llu, sequence gaps %llu, driver dropped %u, max queue %llu/%d, err=%d",
+                (unsigned long long)r.hdr.frame_count, (unsigned long long)captured,
+                elapsed / 1e6, elapsed > 0 ? r.hdr.frame_count * 1e6 / elapsed : 0.0,
+                elapsed > 0 ? (double)r.hdr.frame_count * r.hdr.slot_bytes / elapsed : 0.0,
+                (unsigned long long)r.hdr.dropped, (unsigned long long)seq_gaps, driver_dropped,
+                (unsigned long long)r.max_depth, RECORD_QUEUE_DEPTH, errors);
+    ret = r.write_error ? -1 : 0;
+
+out:
+    if (r.fd >= 0)
+        close(r.fd);
+    for (i = 0; i < RECORD_QUEUE_DEPTH; i++)
+        free(r.bufs[i]);
+    for (i = 0; i < ring_count; i++)
+        munmap(ring[i], ring_size);
+    pthread_cond_destroy(&r.cond);
+    pthread_mutex_destroy(&r.lock);
+    return ret;
+}
+
 /**
  * main - Main entry point
  */
@@ -388,8 +1486,18 @@ int main(int argc, char *argv[])
     int do_continuous = 0;
     int do_verify = 0;
     int do_mmap = 0;
+    int do_dmabuf = 0;
+    int do_roi = 0;
+    int do_bench = 0;
+    unsigned int bench_modes = 0;
+    const char *bench_csv = NULL;
+    const char *bench_label = NULL;
+    const char *sweep = NULL;
+    const char *record_file = NULL;
+    struct dma_roi_transfer roi;
     int dump_bytes = 0;
     int frame_count = 1;
+    int count_set = 0;
     int ret = 0;
     int i;
 
@@ -417,6 +1525,7 @@ int main(int argc, char *argv[])
         } else if (strcmp(argv[i], "--count") == 0) {
             if (i + 1 < argc) {
                 frame_count = atoi(argv[++i]);
+                count_set = 1;
             } else {
                 fprintf(stderr, "Error: --count requires number argument\n");
                 return 1;
@@ -458,6 +1567,62 @@ int main(int argc, char *argv[])
             }
         } else if (strcmp(argv[i], "--mmap") == 0) {
             do_mmap = 1;
+        } else if (strcmp(argv[i], "--dmabuf") == 0) {
+            do_dmabuf = 1;
+        } else if (strcmp(argv[i], "--roi") == 0) {
+            int fields;
+
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --roi requires x,y,w,h[,decim] argument\n");
+                return 1;
+            }
+            memset(&roi, 0, sizeof(roi));
+            roi.decim = 1;
+            fields = sscanf(argv[++i], "%u,%u,%u,%u,%u",
+                            &roi.x, &roi.y, &roi.width, &roi.height, &roi.decim);
+            if (fields < 4) {
+                fprintf(stderr, "Error: invalid --roi '%s'\n", argv[i]);
+                return 1;
+            }
+            do_roi = 1;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --bench requires mode list argument\n");
+                return 1;
+            }
+            if (parse_bench_modes(argv[++i], &bench_modes) < 0) {
+                fprintf(stderr, "Error: invalid --bench '%s'\n", argv[i]);
+                return 1;
+            }
+            do_bench = 1;
+        } else if (strcmp(argv[i], "--bench-csv") == 0) {
+            if (i + 1 < argc) {
+                bench_csv = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --bench-csv requires filename argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench-label") == 0) {
+            if (i + 1 < argc) {
+                bench_label = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --bench-label requires text argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            if (i + 1 < argc) {
+                sweep = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --sweep requires param=v1,v2,... argument\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 < argc) {
+                record_file = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --record requires filename argument\n");
+                return 1;
+            }
         } else {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
             print_usage(argv[0]);
@@ -497,6 +1662,43 @@ int main(int argc, char *argv[])
         }
     }
 
+    /* Test dma-buf export */
+    if (do_dmabuf) {
+        ret = test_dmabuf(g_device_fd);
+        if (ret < 0) {
+            close(g_device_fd);
+            return 1;
+        }
+    }
+
+    /* Read one window */
+    if (do_roi) {
+        ret = test_roi(g_device_fd, &roi, do_verify, dump_bytes);
+        if (ret < 0) {
+            close(g_device_fd);
+            return 1;
+        }
+    }
+
+    /* Throughput/latency benchmark */
+    if (do_bench) {
+        ret = run_benchmark(g_device_fd, count_set ? frame_count : 0, bench_modes,
+                            sweep, bench_csv, bench_label);
+        if (ret < 0) {
+            close(g_device_fd);
+            return 1;
+        }
+    }
+
+    /* Raw recording */
+    if (record_file) {
+        ret = run_record(g_device_fd, record_file, count_set ? frame_count : 0);
+        if (ret < 0) {
+            close(g_device_fd);
+            return 1;
+        }
+    }
+
     /* Read frame(s) */
     if (do_read) {
         uint8_t *buffer = NULL;
@@ -3,7 +3,8 @@
  * FPGA HDMI KMS Display Application
  *
  * Capture frames from /dev/fpga_dma0 and render to HDMI via
- * GStreamer appsrc -> queue -> kmssink.
+ * GStreamer appsrc -> queue -> kmssink, or with --output kms straight to
+ * the primary plane through atomic page flips.
  */
 
 #include <dirent.h>
@@ -12,6 +13,7 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <linux/input.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -27,8 +29,12 @@
 
 #include <gst/app/gstappsrc.h>
 #include <gst/gst.h>
+#include <drm_fourcc.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
 
 #include "pcie_fpga_dma.h"
+#include "pixel_convert.h"
 
 #define DEFAULT_DEVICE "/dev/" FPGA_DMA_DEV_NAME
 #define DEFAULT_DRM_CARD "/dev/dri/card0"
@@ -37,8 +43,10 @@
 #define DEFAULT_STATS_INTERVAL 1
 #define DEFAULT_COPY_BUFFERS 3
 #define DEFAULT_QUEUE_DEPTH 2
+#define DEFAULT_DMA_QUEUE 0
 #define MIN_COPY_BUFFERS 2
 #define MAX_COPY_BUFFERS 6
+#define KMS_MAX_BUFS FPGA_DMA_MAX_RING_BUFFERS
 
 enum pixel_order {
     PIXEL_ORDER_BGR565 = 0,
@@ -48,6 +56,7 @@ enum pixel_order {
 enum io_mode {
     IO_MODE_MMAP = 0,
     IO_MODE_COPY,
+    IO_MODE_USERPTR,
 };
 
 enum mmap_mode {
@@ -55,6 +64,11 @@ enum mmap_mode {
     MMAP_MODE_ZERO_COPY,
 };
 
+enum output_mode {
+    OUTPUT_GST = 0,
+    OUTPUT_KMS,
+};
+
 struct options {
     const char *device_path;
     const char *drm_card_path;
@@ -70,6 +84,10 @@ struct options {
     enum mmap_mode mmap_mode;
     bool swap16;
     bool display_sync;
+    int dma_queue;
+    bool dma_stream;
+    enum output_mode output;
+    int frame_drop;
 };
 
 struct frame_slot {
@@ -79,6 +97,62 @@ struct frame_slot {
     uint64_t generation;
 };
 
+struct slot_ticket {
+    int idx;
+    uint64_t generation;
+};
+
+/* One slot registered as a KMS framebuffer */
+struct kms_buf {
+    uint32_t handle;
+    uint32_t fb_id;
+    uint8_t *map;                   /* dumb buffers only */
+    size_t size;
+    bool dumb;
+};
+
+/*
+ * --output kms state. Slots stay in use while they are on screen (front)
+ * or waiting for the next vblank (pending).
+ */
+struct kms_output {
+    bool active;
+    uint32_t conn_id;
+    uint32_t crtc_id;
+    uint32_t plane_id;
+    uint32_t mode_blob;
+    drmModeModeInfo mode;
+    uint32_t dst_x;
+    uint32_t dst_y;
+    uint32_t dst_w;
+    uint32_t dst_h;
+    uint32_t prop_conn_crtc;
+    uint32_t prop_crtc_mode;
+    uint32_t prop_crtc_active;
+    uint32_t prop_fb;
+    uint32_t prop_plane_crtc;
+    uint32_t prop_src_x;
+    uint32_t prop_src_y;
+    uint32_t prop_src_w;
+    uint32_t prop_src_h;
+    uint32_t prop_crtc_x;
+    uint32_t prop_crtc_y;
+    uint32_t prop_crtc_w;
+    uint32_t prop_crtc_h;
+    struct kms_buf bufs[KMS_MAX_BUFS];
+    int buf_count;
+    bool modeset_done;
+    bool flip_pending;
+    bool has_front;
+    struct slot_ticket front;
+    struct slot_ticket pending;
+    int64_t commit_us;
+    unsigned int last_seq;
+    uint64_t flips;
+    uint64_t vblank_repeats;        /* refreshes that showed the same frame again */
+    double total_flip_lat_ms;       /* commit to scanout */
+};
+
 struct app_ctx {
     struct options opt;
 
@@ -100,6 +174,10 @@ struct app_ctx {
     size_t display_frame_size;
     bool source_is_bgrx;
     bool zero_copy_mode;
+    bool async_dma;
+    int dma_queued;
+    uint32_t dma_dropped;
+    uint64_t last_dma_ts_ns;
 
     struct frame_slot *slots;
     int slot_count;
@@ -125,15 +203,16 @@ struct app_ctx {
     uint64_t slot_wait_total_us;
     uint64_t slot_wait_samples;
 
+    double total_capture_lat_ms;
+    uint64_t capture_lat_samples;
+
     int64_t start_us;
     int64_t last_stats_us;
     uint64_t last_stats_captured;
     uint64_t last_stats_released;
-};
 
-struct slot_ticket {
-    int idx;
-    uint64_t generation;
+    uint64_t stale_dropped;
+    struct kms_output kms;
 };
 
 struct frame_cookie {
@@ -169,10 +248,16 @@ static void print_usage(const char *prog)
             "  --stats-interval <sec>  Stats print interval (default: %d)\n"
             "  --copy-buffers <num>    Copy ring size (default: %d, range: %d..%d)\n"
             "  --queue-depth <num>     appsrc max frame queue (default: %d)\n"
-            "  --io-mode <mode>        mmap|copy (default: mmap)\n"
+            "  --io-mode <mode>        mmap|copy|userptr (default: mmap); userptr drops to the\n"
+            "                          slow 4 KB chunk engine unless the buffer maps to one IOVA range\n"
             "  --mmap-mode <mode>      staged|zero-copy (default: staged)\n"
             "  --swap16 <0|1>          Swap bytes in each 16-bit pixel (default: 1)\n"
             "  --display-sync <0|1>    kmssink sync to display clock (default: 1)\n"
+            "  --dma-queue <num>       mmap ring buffers kept in flight via QBUF/DQBUF (0=blocking, default: %d)\n"
+            "  --dma-stream <0|1>      Free-running capture, driver overwrites stale frames (default: 0)\n"
+            "  --pixconv <mode>        Pixel conversion kernels: auto|scalar|neon (default: auto)\n"
+            "  --output <mode>         gst|kms: kmssink, or atomic page flips paced by vblank (default: gst)\n"
+            "  --frame-drop <0|1>      With --dma-queue, show the newest capture and requeue stale ones (default: 1 with kms)\n"
             "  --help                  Show this message\n",
             prog,
             DEFAULT_DEVICE,
@@ -183,7 +268,8 @@ static void print_usage(const char *prog)
             DEFAULT_COPY_BUFFERS,
             MIN_COPY_BUFFERS,
             MAX_COPY_BUFFERS,
-            DEFAULT_QUEUE_DEPTH);
+            DEFAULT_QUEUE_DEPTH,
+            DEFAULT_DMA_QUEUE);
 }
 
 static int parse_options(int argc, char **argv, struct options *opt)
@@ -203,6 +289,11 @@ static int parse_options(int argc, char **argv, struct options *opt)
         {"swap16", required_argument, NULL, 12},
         {"mmap-mode", required_argument, NULL, 13},
         {"display-sync", required_argument, NULL, 14},
+        {"dma-queue", required_argument, NULL, 15},
+        {"dma-stream", required_argument, NULL, 16},
+        {"pixconv", required_argument, NULL, 17},
+        {"output", required_argument, NULL, 18},
+        {"frame-drop", required_argument, NULL, 19},
         {"help", no_argument, NULL, 'h'},
         {0, 0, 0, 0}
     };
@@ -223,6 +314,10 @@ static int parse_options(int argc, char **argv, struct options *opt)
     opt->mmap_mode = MMAP_MODE_STAGED;
     opt->swap16 = true;
     opt->display_sync = true;
+    opt->dma_queue = DEFAULT_DMA_QUEUE;
+    opt->dma_stream = false;
+    opt->output = OUTPUT_GST;
+    opt->frame_drop = -1;
 
     while ((c = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
         switch (c) {
@@ -289,6 +384,8 @@ static int parse_options(int argc, char **argv, struct options *opt)
                 opt->io_mode = IO_MODE_MMAP;
             } else if (strcmp(optarg, "copy") == 0) {
                 opt->io_mode = IO_MODE_COPY;
+            } else if (strcmp(optarg, "userptr") == 0) {
+                opt->io_mode = IO_MODE_USERPTR;
             } else {
                 fprintf(stderr, "Invalid --io-mode: %s\n", optarg);
                 return -1;
@@ -328,6 +425,54 @@ static int parse_options(int argc, char **argv, struct options *opt)
                 return -1;
             }
             break;
+        case 15:
+            opt->dma_queue = atoi(optarg);
+            if (opt->dma_queue < 0 || opt->dma_queue > (int)FPGA_DMA_MAX_RING_BUFFERS) {
+                fprintf(stderr, "Invalid --dma-queue: %s (range 0..%u)\n",
+                        optarg, FPGA_DMA_MAX_RING_BUFFERS);
+                return -1;
+            }
+            break;
+        case 16:
+            if (strcmp(optarg, "1") == 0 || strcasecmp(optarg, "on") == 0 ||
+                strcasecmp(optarg, "true") == 0) {
+                opt->dma_stream = true;
+            } else if (strcmp(optarg, "0") == 0 || strcasecmp(optarg, "off") == 0 ||
+                       strcasecmp(optarg, "false") == 0) {
+                opt->dma_stream = false;
+            } else {
+                fprintf(stderr, "Invalid --dma-stream: %s (use 0|1)\n", optarg);
+                return -1;
+            }
+            break;
+        case 17:
+            if (pixconv_select(optarg) < 0) {
+                fprintf(stderr, "Invalid --pixconv: %s (use auto|scalar|neon)\n", optarg);
+                return -1;
+            }
+            break;
+        case 18:
+            if (strcmp(optarg, "gst") == 0) {
+                opt->output = OUTPUT_GST;
+            } else if (strcmp(optarg, "kms") == 0) {
+                opt->output = OUTPUT_KMS;
+            } else {
+                fprintf(stderr, "Invalid --output: %s (use gst|kms)\n", optarg);
+                return -1;
+            }
+            break;
+        case 19:
+            if (strcmp(optarg, "1") == 0 || strcasecmp(optarg, "on") == 0 ||
+                strcasecmp(optarg, "true") == 0) {
+                opt->frame_drop = 1;
+            } else if (strcmp(optarg, "0") == 0 || strcasecmp(optarg, "off") == 0 ||
+                       strcasecmp(optarg, "false") == 0) {
+                opt->frame_drop = 0;
+            } else {
+                fprintf(stderr, "Invalid --frame-drop: %s (use 0|1)\n", optarg);
+                return -1;
+            }
+            break;
         case 'h':
             print_usage(argv[0]);
             exit(0);
@@ -525,7 +670,7 @@ static int process_events(struct app_ctx *ctx, int wait_ms)
     if (g_stop)
         ctx->running = false;
 
-    if (handle_bus_messages(ctx) < 0)
+    if (ctx->bus && handle_bus_messages(ctx) < 0)
         return -1;
 
     if (ctx->epoll_fd < 0)
@@ -557,6 +702,32 @@ static const char *pixel_format_name(uint32_t pixel_format)
     }
 }
 
+static const char *io_mode_name(enum io_mode mode)
+{
+    switch (mode) {
+    case IO_MODE_MMAP:
+        return "mmap";
+    case IO_MODE_COPY:
+        return "copy";
+    case IO_MODE_USERPTR:
+        return "userptr";
+    default:
+        return "unknown";
+    }
+}
+
+/* USERPTR DMA targets must be cache-line aligned; page alignment covers that. */
+static uint8_t *alloc_dma_target(size_t size)
+{
+    void *p = NULL;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t rounded = (size + page - 1) & ~(page - 1);
+
+    if (posix_memalign(&p, page, rounded) != 0)
+        return NULL;
+    return (uint8_t *)p;
+}
+
 static const char *active_mmap_mode_name(const struct app_ctx *ctx)
 {
     if (ctx->opt.io_mode != IO_MODE_MMAP)
@@ -616,7 +787,8 @@ static int init_fpga_dma(struct app_ctx *ctx)
         ? ctx->frame_size
         : ((size_t)ctx->frame_width * ctx->frame_height * 4U);
     if (ctx->opt.io_mode != IO_MODE_MMAP && ctx->opt.mmap_mode == MMAP_MODE_ZERO_COPY)
-        fprintf(stderr, "Note: --mmap-mode is ignored when --io-mode=copy\n");
+        fprintf(stderr, "Note: --mmap-mode is ignored when --io-mode=%s\n",
+                io_mode_name(ctx->opt.io_mode));
     if (ctx->opt.io_mode == IO_MODE_MMAP &&
         ctx->opt.mmap_mode == MMAP_MODE_ZERO_COPY &&
         !ctx->source_is_bgrx) {
@@ -626,6 +798,7 @@ static int init_fpga_dma(struct app_ctx *ctx)
     ctx->zero_copy_mode = ctx->source_is_bgrx &&
         (ctx->opt.io_mode == IO_MODE_MMAP) &&
         (ctx->opt.mmap_mode == MMAP_MODE_ZERO_COPY);
+    ctx->async_dma = (ctx->opt.io_mode == IO_MODE_MMAP) && (ctx->opt.dma_queue > 0);
 
     if (ctx->opt.io_mode == IO_MODE_MMAP) {
         int requested_maps = 1;
@@ -641,6 +814,8 @@ static int init_fpga_dma(struct app_ctx *ctx)
             }
             if (requested_maps > (int)FPGA_DMA_MAX_RING_BUFFERS)
                 requested_maps = (int)FPGA_DMA_MAX_RING_BUFFERS;
+        } else if (ctx->async_dma) {
+            requested_maps = ctx->opt.dma_queue;
         }
 
         for (i = 0; i < requested_maps; i++) {
@@ -650,7 +825,7 @@ static int init_fpga_dma(struct app_ctx *ctx)
             memset(&map, 0, sizeof(map));
             map.index = (uint32_t)i;
             if (ioctl(ctx->dev_fd, FPGA_DMA_MAP_BUFFER, &map) < 0) {
-                if (ctx->zero_copy_mode && i > 0 && errno == EINVAL)
+                if ((ctx->zero_copy_mode || ctx->async_dma) && i > 0 && errno == EINVAL)
                     break;
                 fprintf(stderr, "FPGA_DMA_MAP_BUFFER failed for index %d: %s\n",
                         i, strerror(errno));
@@ -702,8 +877,14 @@ static int init_fpga_dma(struct app_ctx *ctx)
                 ctx->opt.copy_buffers = ctx->dma_map_count;
             }
         }
+    } else if (ctx->opt.io_mode == IO_MODE_USERPTR && ctx->source_is_bgrx &&
+               ctx->opt.output != OUTPUT_KMS) {
+        /* BGRX frames land directly in the display slots; no staging buffer.
+         * KMS dumb buffers cannot be pinned for USERPTR DMA, so those stage. */
     } else {
-        ctx->dma_copy = malloc(ctx->frame_size);
+        ctx->dma_copy = (ctx->opt.io_mode == IO_MODE_USERPTR)
+            ? alloc_dma_target(ctx->frame_size)
+            : malloc(ctx->frame_size);
         if (!ctx->dma_copy) {
             fprintf(stderr, "Failed to allocate copy IO frame buffer (%zu bytes)\n", ctx->frame_size);
             return -1;
@@ -714,21 +895,371 @@ static int init_fpga_dma(struct app_ctx *ctx)
         fprintf(stderr, "Note: --pixel-order/--swap16 are ignored for BGRX source frames\n");
 
     fprintf(stderr,
-            "FPGA DMA ready: %ux%u fmt=%s bpp=%u stride=%u frame=%zu bytes (io-mode=%s mmap-mode=%s zero-copy=%s)\n",
+            "FPGA DMA ready: %ux%u fmt=%s bpp=%u stride=%u frame=%zu bytes (io-mode=%s mmap-mode=%s zero-copy=%s async=%s)\n",
             ctx->frame_width,
             ctx->frame_height,
             pixel_format_name(ctx->pixel_format),
             ctx->frame_bpp,
             ctx->frame_stride,
             ctx->frame_size,
-            (ctx->opt.io_mode == IO_MODE_MMAP) ? "mmap" : "copy",
+            io_mode_name(ctx->opt.io_mode),
             active_mmap_mode_name(ctx),
-            ctx->zero_copy_mode ? "on" : "off");
+            ctx->zero_copy_mode ? "on" : "off",
+            ctx->async_dma ? "on" : "off");
     if (ctx->opt.io_mode == IO_MODE_MMAP)
         fprintf(stderr, "DMA mmap buffers: %d (size=%zu)\n", ctx->dma_map_count, ctx->dma_map_size);
     return 0;
 }
 
+/*
+ * --output kms: scan the slots out on the primary plane with atomic
+ * commits instead of GStreamer. Every slot is registered as a framebuffer
+ * once: zero-copy slots import their DMA ring buffer as a dma-buf, other
+ * slots are allocated as dumb buffers that the CPU converts into. The main
+ * loop waits for the previous flip's completion event before capturing the
+ * next frame, so capture follows the display vblank instead of usleep().
+ */
+static uint32_t kms_prop(int fd, uint32_t obj_id, uint32_t obj_type, const char *name, uint64_t *value)
+{
+    drmModeObjectProperties *props = drmModeObjectGetProperties(fd, obj_id, obj_type);
+    uint32_t id = 0;
+    uint32_t i;
+
+    if (!props)
+        return 0;
+    for (i = 0; i < props->count_props && !id; i++) {
+        drmModePropertyRes *p = drmModeGetProperty(fd, props->props[i]);
+
+        if (!p)
+            continue;
+        if (strcmp(p->name, name) == 0) {
+            id = p->prop_id;
+            if (value)
+                *value = props->prop_values[i];
+        }
+        drmModeFreeProperty(p);
+    }
+    drmModeFreeObjectProperties(props);
+    return id;
+}
+
+/* CRTC already driving @conn, else the first one one of its encoders can use. */
+static uint32_t kms_pick_crtc(int fd, drmModeRes *res, drmModeConnector *conn, int *crtc_idx)
+{
+    uint32_t crtc_id = 0;
+    int i;
+    int j;
+
+    if (conn->encoder_id) {
+        drmModeEncoder *enc = drmModeGetEncoder(fd, conn->encoder_id);
+
+        if (enc) {
+            crtc_id = enc->crtc_id;
+            drmModeFreeEncoder(enc);
+        }
+    }
+    for (i = 0; i < conn->count_encoders && !crtc_id; i++) {
+        drmModeEncoder *enc = drmModeGetEncoder(fd, conn->encoders[i]);
+
+        if (!enc)
+            continue;
+        for (j = 0; j < res->count_crtcs; j++) {
+            if (enc->possible_crtcs & (1U << j)) {
+                crtc_id = res->crtcs[j];
+                break;
+            }
+        }
+        drmModeFreeEncoder(enc);
+    }
+    for (i = 0; i < res->count_crtcs; i++) {
+        if (crtc_id && res->crtcs[i] == crtc_id) {
+            *crtc_idx = i;
+            return crtc_id;
+        }
+    }
+    return 0;
+}
+
+static uint32_t kms_pick_primary_plane(int fd, int crtc_idx)
+{
+    drmModePlaneRes *pres = drmModeGetPlaneResources(fd);
+    uint32_t plane_id = 0;
+    uint32_t i;
+    uint32_t f;
+
+    if (!pres)
+        return 0;
+    for (i = 0; i < pres->count_planes && !plane_id; i++) {
+        drmModePlane *p = drmModeGetPlane(fd, pres->planes[i]);
+        uint64_t type = 0;
+
+        if (!p)
+            continue;
+        if ((p->possible_crtcs & (1U << crtc_idx)) &&
+            kms_prop(fd, p->plane_id, DRM_MODE_OBJECT_PLANE, "type", &type) &&
+            type == DRM_PLANE_TYPE_PRIMARY) {
+            for (f = 0; f < p->count_formats; f++) {
+                if (p->formats[f] == DRM_FORMAT_XRGB8888) {
+                    plane_id = p->plane_id;
+                    break;
+                }
+            }
+        }
+        drmModeFreePlane(p);
+    }
+    drmModeFreePlaneResources(pres);
+    return plane_id;
+}
+
+/* Fit the frame into the mode, keeping its aspect ratio. */
+static void kms_fit_frame(struct app_ctx *ctx)
+{
+    struct kms_output *k = &ctx->kms;
+    uint32_t mw = k->mode.hdisplay;
+    uint32_t mh = k->mode.vdisplay;
+
+    if ((uint64_t)mw * ctx->frame_height >= (uint64_t)mh * ctx->frame_width) {
+        k->dst_h = mh;
+        k->dst_w = (uint32_t)((uint64_t)ctx->frame_width * mh / ctx->frame_height);
+    } else {
+        k->dst_w = mw;
+        k->dst_h = (uint32_t)((uint64_t)ctx->frame_height * mw / ctx->frame_width);
+    }
+    k->dst_x = (mw - k->dst_w) / 2U;
+    k->dst_y = (mh - k->dst_h) / 2U;
+}
+
+static int kms_init(struct app_ctx *ctx)
+{
+    struct kms_output *k = &ctx->kms;
+    drmModeRes *res = NULL;
+    drmModeConnector *conn = NULL;
+    drmModeCrtc *crtc = NULL;
+    int crtc_idx = -1;
+    int ret = -1;
+    int i;
+
+    memset(k, 0, sizeof(*k));
+    if (drmSetClientCap(ctx->drm_fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0 ||
+        drmSetClientCap(ctx->drm_fd, DRM_CLIENT_CAP_ATOMIC, 1) != 0) {
+        fprintf(stderr, "[kms] atomic modesetting not supported by %s\n", ctx->opt.drm_card_path);
+        return -1;
+    }
+
+    res = drmModeGetResources(ctx->drm_fd);
+    if (!res) {
+        fprintf(stderr, "[kms] drmModeGetResources failed: %s\n", strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < res->count_connectors && !conn; i++) {
+        conn = drmModeGetConnector(ctx->drm_fd, res->connectors[i]);
+        if (!conn)
+            continue;
+        if ((ctx->opt.connector_id >= 0 && conn->connector_id != (uint32_t)ctx->opt.connector_id) ||
+            conn->connection != DRM_MODE_CONNECTED || conn->count_modes <= 0) {
+            drmModeFreeConnector(conn);
+            conn = NULL;
+        }
+    }
+    if (!conn) {
+        fprintf(stderr, "[kms] no connected connector%s\n",
+                ctx->opt.connector_id >= 0 ? " matching --connector-id" : "");
+        goto out;
+    }
+    k->conn_id = conn->connector_id;
+    k->crtc_id = kms_pick_crtc(ctx->drm_fd, res, conn, &crtc_idx);
+    if (!k->crtc_id) {
+        fprintf(stderr, "[kms] no CRTC for connector %u\n", k->conn_id);
+        goto out;
+    }
+
+    /* Keep the running mode to avoid a modeset flicker; else the preferred one. */
+    crtc = drmModeGetCrtc(ctx->drm_fd, k->crtc_id);
+    if (crtc && crtc->mode_valid) {
+        k->mode = crtc->mode;
+    } else {
+        k->mode = conn->modes[0];
+        for (i = 0; i < conn->count_modes; i++) {
+            if (conn->modes[i].type & DRM_MODE_TYPE_PREFERRED) {
+                k->mode = conn->modes[i];
+                break;
+            }
+        }
+    }
+
+    k->plane_id = kms_pick_primary_plane(ctx->drm_fd, crtc_idx);
+    if (!k->plane_id) {
+        fprintf(stderr, "[kms] no XRGB8888 primary plane on CRTC %u\n", k->crtc_id);
+        goto out;
+    }
+
+    k->prop_conn_crtc = kms_prop(ctx->drm_fd, k->conn_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", NULL);
+    k->prop_crtc_mode = kms_prop(ctx->drm_fd, k->crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID", NULL);
+    k->prop_crtc_active = kms_prop(ctx->drm_fd, k->crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE", NULL);
+    k->prop_fb = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID", NULL);
+    k->prop_plane_crtc = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID", NULL);
+    k->prop_src_x = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X", NULL);
+    k->prop_src_y = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y", NULL);
+    k->prop_src_w = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W", NULL);
+    k->prop_src_h = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H", NULL);
+    k->prop_crtc_x = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X", NULL);
+    k->prop_crtc_y = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y", NULL);
+    k->prop_crtc_w = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W", NULL);
+    k->prop_crtc_h = kms_prop(ctx->drm_fd, k->plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H", NULL);
+    if (!k->prop_conn_crtc || !k->prop_crtc_mode || !k->prop_crtc_active || !k->prop_fb ||
+        !k->prop_plane_crtc || !k->prop_src_x || !k->prop_src_y || !k->prop_src_w || !k->prop_src_h ||
+        !k->prop_crtc_x || !k->prop_crtc_y || !k->prop_crtc_w || !k->prop_crtc_h) {
+        fprintf(stderr, "[kms] missing atomic properties\n");
+        goto out;
+    }
+    if (drmModeCreatePropertyBlob(ctx->drm_fd, &k->mode, sizeof(k->mode), &k->mode_blob) != 0) {
+        fprintf(stderr, "[kms] mode blob failed: %s\n", strerror(errno));
+        goto out;
+    }
+    kms_fit_frame(ctx);
+    k->active = true;
+    fprintf(stderr, "[kms] connector=%u crtc=%u plane=%u mode=%ux%u@%u frame=%ux%u -> %ux%u+%u+%u\n",
+            k->conn_id, k->crtc_id, k->plane_id, k->mode.hdisplay, k->mode.vdisplay, k->mode.vrefresh,
+            ctx->frame_width, ctx->frame_height, k->dst_w, k->dst_h, k->dst_x, k->dst_y);
+    ret = 0;
+
+out:
+    if (crtc)
+        drmModeFreeCrtc(crtc);
+    if (conn)
+        drmModeFreeConnector(conn);
+    drmModeFreeResources(res);
+    return ret;
+}
+
+/* Zero-copy slot: the driver's ring buffer, imported through dma-buf. */
+static int kms_import_ring_buffer(struct app_ctx *ctx, int idx, struct kms_buf *b)
+{
+    struct dma_buffer_export exp;
+    uint32_t handles[4] = {0};
+    uint32_t pitches[4] = {0};
+    uint32_t offsets[4] = {0};
+    int ret;
+
+    memset(&exp, 0, sizeof(exp));
+    exp.index = (uint32_t)idx;
+    exp.flags = O_CLOEXEC;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_EXPORT_DMABUF, &exp) < 0) {
+        fprintf(stderr, "[kms] FPGA_DMA_EXPORT_DMABUF[%d] failed: %s\n", idx, strerror(errno));
+        return -1;
+    }
+    ret = drmPrimeFDToHandle(ctx->drm_fd, exp.fd, &b->handle);
+    close(exp.fd);
+    if (ret != 0) {
+        fprintf(stderr, "[kms] dma-buf import of ring buffer %d failed: %s\n", idx, strerror(errno));
+        return -1;
+    }
+    handles[0] = b->handle;
+    pitches[0] = ctx->frame_stride;
+    if (drmModeAddFB2(ctx->drm_fd, ctx->frame_width, ctx->frame_height, DRM_FORMAT_XRGB8888,
+                      handles, pitches, offsets, &b->fb_id, 0) != 0) {
+        fprintf(stderr, "[kms] AddFB2 for ring buffer %d failed: %s\n", idx, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Staged/copy slot: a dumb buffer the CPU fills with packed BGRX rows. */
+static int kms_create_dumb(struct app_ctx *ctx, struct kms_buf *b)
+{
+    struct drm_mode_create_dumb creq;
+    struct drm_mode_map_dumb mreq;
+    uint32_t handles[4] = {0};
+    uint32_t pitches[4] = {0};
+    uint32_t offsets[4] = {0};
+    void *map;
+
+    memset(&creq, 0, sizeof(creq));
+    creq.width = ctx->frame_width;
+    creq.height = ctx->frame_height;
+    creq.bpp = 32;
+    if (drmIoctl(ctx->drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0) {
+        fprintf(stderr, "[kms] CREATE_DUMB failed: %s\n", strerror(errno));
+        return -1;
+    }
+    b->handle = creq.handle;
+    b->dumb = true;
+    if (creq.pitch != ctx->frame_width * 4U || creq.size < ctx->display_frame_size) {
+        fprintf(stderr, "[kms] dumb buffer pitch %u, slots need packed rows of %u\n",
+                creq.pitch, ctx->frame_width * 4U);
+        return -1;
+    }
+    handles[0] = b->handle;
+    pitches[0] = creq.pitch;
+    if (drmModeAddFB2(ctx->drm_fd, ctx->frame_width, ctx->frame_height, DRM_FORMAT_XRGB8888,
+                      handles, pitches, offsets, &b->fb_id, 0) != 0) {
+        fprintf(stderr, "[kms] AddFB2 failed: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.handle = b->handle;
+    if (drmIoctl(ctx->drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0)
+        return -1;
+    map = mmap(NULL, (size_t)creq.size, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->drm_fd, (off_t)mreq.offset);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "[kms] dumb buffer mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+    b->map = (uint8_t *)map;
+    b->size = (size_t)creq.size;
+    return 0;
+}
+
+static int kms_register_slots(struct app_ctx *ctx)
+{
+    struct kms_output *k = &ctx->kms;
+    int i;
+
+    if (ctx->slot_count > (int)KMS_MAX_BUFS)
+        return -1;
+    for (i = 0; i < ctx->slot_count; i++) {
+        int ret = ctx->zero_copy_mode
+            ? kms_import_ring_buffer(ctx, i, &k->bufs[i])
+            : kms_create_dumb(ctx, &k->bufs[i]);
+
+        k->buf_count = i + 1;
+        if (ret < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void kms_release(struct app_ctx *ctx)
+{
+    struct kms_output *k = &ctx->kms;
+    int i;
+
+    for (i = 0; i < k->buf_count; i++) {
+        struct kms_buf *b = &k->bufs[i];
+
+        if (b->fb_id)
+            drmModeRmFB(ctx->drm_fd, b->fb_id);
+        if (b->map)
+            munmap(b->map, b->size);
+        if (b->handle && b->dumb) {
+            struct drm_mode_destroy_dumb dreq;
+
+            memset(&dreq, 0, sizeof(dreq));
+            dreq.handle = b->handle;
+            drmIoctl(ctx->drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+        } else if (b->handle) {
+            struct drm_gem_close creq;
+
+            memset(&creq, 0, sizeof(creq));
+            creq.handle = b->handle;
+            drmIoctl(ctx->drm_fd, DRM_IOCTL_GEM_CLOSE, &creq);
+        }
+    }
+    if (k->mode_blob)
+        drmModeDestroyPropertyBlob(ctx->drm_fd, k->mode_blob);
+    memset(k, 0, sizeof(*k));
+}
+
 static int init_copy_slots(struct app_ctx *ctx)
 {
     int i;
@@ -752,6 +1283,11 @@ static int init_copy_slots(struct app_ctx *ctx)
         return -1;
     }
 
+    if (ctx->kms.active && kms_register_slots(ctx) < 0) {
+        fprintf(stderr, "[kms] cannot register slots as framebuffers, falling back to GStreamer\n");
+        kms_release(ctx);
+    }
+
     if (ctx->zero_copy_mode) {
         for (i = 0; i < ctx->slot_count; i++) {
             ctx->slots[i].data = (uint8_t *)ctx->dma_maps[i];
@@ -761,7 +1297,14 @@ static int init_copy_slots(struct app_ctx *ctx)
     }
 
     for (i = 0; i < ctx->slot_count; i++) {
-        ctx->slots[i].data = malloc(ctx->display_frame_size);
+        if (ctx->kms.active) {
+            ctx->slots[i].data = ctx->kms.bufs[i].map;
+            ctx->slots[i].owns_data = false;
+            continue;
+        }
+        ctx->slots[i].data = (ctx->opt.io_mode == IO_MODE_USERPTR)
+            ? alloc_dma_target(ctx->display_frame_size)
+            : malloc(ctx->display_frame_size);
         if (!ctx->slots[i].data) {
             fprintf(stderr, "Failed to allocate copy slot %d\n", i);
             return -1;
@@ -772,6 +1315,29 @@ static int init_copy_slots(struct app_ctx *ctx)
     return 0;
 }
 
+/* DMA one frame straight into @dst (pinned by the driver, no kernel copy). */
+static int trigger_frame_dma_user(struct app_ctx *ctx, uint8_t *dst)
+{
+    struct dma_transfer transfer;
+
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.size = (uint32_t)ctx->frame_size;
+    transfer.flags = FPGA_DMA_XFER_FLAG_USERPTR;
+    transfer.user_buf = (uint64_t)(uintptr_t)dst;
+
+    if (ioctl(ctx->dev_fd, FPGA_DMA_READ_FRAME, &transfer) < 0) {
+        fprintf(stderr, "FPGA_DMA_READ_FRAME(userptr) failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if (transfer.result != 0) {
+        fprintf(stderr, "FPGA_DMA_READ_FRAME(userptr) result error: %u\n", transfer.result);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int trigger_frame_dma(struct app_ctx *ctx, uint32_t buf_index)
 {
     struct dma_transfer transfer;
@@ -796,49 +1362,120 @@ static int trigger_frame_dma(struct app_ctx *ctx, uint32_t buf_index)
     return 0;
 }
 
-static void convert_frame_to_bgrx(struct app_ctx *ctx, uint8_t *dst, const uint8_t *src)
+static int queue_dma_buffer(struct app_ctx *ctx, uint32_t buf_index)
 {
-    size_t i;
-    size_t pixel_count = (size_t)ctx->frame_width * ctx->frame_height;
-
-    for (i = 0; i < pixel_count; i++) {
-        uint8_t lo = src[(i << 1)];
-        uint8_t hi = src[(i << 1) + 1];
-        uint16_t pix;
-        uint8_t r5;
-        uint8_t g6;
-        uint8_t b5;
-        uint8_t r8;
-        uint8_t g8;
-        uint8_t b8;
-        size_t out = i << 2;
-
-        if (ctx->opt.swap16) {
-            uint8_t tmp = lo;
-            lo = hi;
-            hi = tmp;
-        }
+    struct dma_buffer_req req;
 
-        pix = (uint16_t)lo | ((uint16_t)hi << 8);
-        if (ctx->opt.pixel_order == PIXEL_ORDER_BGR565) {
-            r5 = pix & 0x1F;
-            g6 = (pix >> 5) & 0x3F;
-            b5 = (pix >> 11) & 0x1F;
-        } else {
-            r5 = (pix >> 11) & 0x1F;
-            g6 = (pix >> 5) & 0x3F;
-            b5 = pix & 0x1F;
-        }
+    memset(&req, 0, sizeof(req));
+    req.index = buf_index;
+    req.size = (uint32_t)ctx->frame_size;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_QBUF, &req) < 0) {
+        fprintf(stderr, "FPGA_DMA_QBUF[%u] failed: %s\n", buf_index, strerror(errno));
+        return -1;
+    }
+    ctx->dma_queued++;
+    return 0;
+}
 
-        r8 = (uint8_t)((r5 << 3) | (r5 >> 2));
-        g8 = (uint8_t)((g6 << 2) | (g6 >> 4));
-        b8 = (uint8_t)((b5 << 3) | (b5 >> 2));
+/* Returns 1 with a buffer, 0 if FPGA_DMA_BUF_FLAG_NONBLOCK found none ready, -1 on error. */
+static int dequeue_dma_buffer_flags(struct app_ctx *ctx, uint32_t *buf_index, uint32_t flags)
+{
+    struct dma_buffer_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.flags = flags;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_DQBUF, &req) < 0) {
+        if (errno == EAGAIN && (flags & FPGA_DMA_BUF_FLAG_NONBLOCK))
+            return 0;
+        fprintf(stderr, "FPGA_DMA_DQBUF failed: %s\n", strerror(errno));
+        return -1;
+    }
+    ctx->dma_queued--;
+    *buf_index = req.index;
+    ctx->dma_dropped = req.dropped;
+    ctx->last_dma_ts_ns = req.timestamp_ns;
 
-        dst[out + 0] = b8;
-        dst[out + 1] = g8;
-        dst[out + 2] = r8;
-        dst[out + 3] = 0xFF;
+    if (req.result != 0) {
+        fprintf(stderr, "FPGA_DMA_DQBUF slot %u result error: %d\n", req.index, req.result);
+        return -1;
     }
+    return 1;
+}
+
+static int dequeue_dma_buffer(struct app_ctx *ctx, uint32_t *buf_index)
+{
+    return dequeue_dma_buffer_flags(ctx, buf_index, 0) < 0 ? -1 : 0;
+}
+
+/*
+ * --frame-drop: take the newest completed buffer and hand older ones
+ * straight back to the driver, so a flip never shows a stale frame.
+ */
+static int dequeue_latest_dma_buffer(struct app_ctx *ctx, uint32_t *buf_index)
+{
+    uint32_t newer;
+    int ret;
+
+    if (dequeue_dma_buffer(ctx, buf_index) < 0)
+        return -1;
+    if (!ctx->opt.frame_drop)
+        return 0;
+    while (ctx->dma_queued > 0) {
+        ret = dequeue_dma_buffer_flags(ctx, &newer, FPGA_DMA_BUF_FLAG_NONBLOCK);
+        if (ret <= 0)
+            return ret;
+        if (queue_dma_buffer(ctx, *buf_index) < 0)
+            return -1;
+        ctx->stale_dropped++;
+        *buf_index = newer;
+    }
+    return 0;
+}
+
+static int start_dma_streaming(struct app_ctx *ctx)
+{
+    if (ioctl(ctx->dev_fd, FPGA_DMA_STREAMON) < 0) {
+        fprintf(stderr, "FPGA_DMA_STREAMON failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Capture-to-push latency, measured from the driver's completion timestamp. */
+static void account_capture_latency(struct app_ctx *ctx)
+{
+    int64_t now_ns;
+
+    if (ctx->last_dma_ts_ns == 0)
+        return;
+    now_ns = mono_us() * 1000LL;
+    if (now_ns > (int64_t)ctx->last_dma_ts_ns) {
+        ctx->total_capture_lat_ms += (double)(now_ns - (int64_t)ctx->last_dma_ts_ns) / 1000000.0;
+        ctx->capture_lat_samples++;
+    }
+    ctx->last_dma_ts_ns = 0;
+}
+
+static int queue_staged_dma_buffers(struct app_ctx *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->dma_map_count; i++) {
+        if (queue_dma_buffer(ctx, (uint32_t)i) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void convert_frame_to_bgrx(struct app_ctx *ctx, uint8_t *dst, const uint8_t *src)
+{
+    unsigned int flags = 0;
+
+    if (ctx->opt.swap16)
+        flags |= PIXCONV_565_SWAP16;
+    if (ctx->opt.pixel_order == PIXEL_ORDER_BGR565)
+        flags |= PIXCONV_565_RED_LOW;
+    pixconv_565_to_bgrx(src, dst, (size_t)ctx->frame_width * ctx->frame_height, flags);
 }
 
 static void prepare_display_frame(struct app_ctx *ctx, uint8_t *dst, const uint8_t *src)
@@ -924,6 +1561,64 @@ static int acquire_free_slot(struct app_ctx *ctx, struct slot_ticket *ticket)
     }
 }
 
+/*
+ * Zero-copy slots are the DMA ring buffers themselves: every slot kmssink has
+ * released goes straight back to the driver queue.
+ */
+static int requeue_zero_copy_slots(struct app_ctx *ctx)
+{
+    int free_idx[FPGA_DMA_MAX_RING_BUFFERS];
+    int free_count = 0;
+    int i;
+
+    g_mutex_lock(&ctx->slots_lock);
+    for (i = 0; i < ctx->slot_count && free_count < (int)FPGA_DMA_MAX_RING_BUFFERS; i++) {
+        if (!ctx->slots[i].in_use) {
+            ctx->slots[i].in_use = true;
+            ctx->slots[i].generation++;
+            free_idx[free_count++] = i;
+        }
+    }
+    g_mutex_unlock(&ctx->slots_lock);
+
+    for (i = 0; i < free_count; i++) {
+        if (queue_dma_buffer(ctx, (uint32_t)free_idx[i]) < 0)
+            return -1;
+    }
+
+    if (ctx->dma_queued == 0) {
+        struct slot_ticket ticket;
+
+        /* Every ring buffer is on screen; wait for kmssink to hand one back. */
+        if (acquire_free_slot(ctx, &ticket) < 0)
+            return -1;
+        if (queue_dma_buffer(ctx, (uint32_t)ticket.idx) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int dequeue_zero_copy_slot(struct app_ctx *ctx, struct slot_ticket *ticket)
+{
+    uint32_t buf_index;
+
+    if (requeue_zero_copy_slots(ctx) < 0)
+        return -1;
+    if (dequeue_latest_dma_buffer(ctx, &buf_index) < 0)
+        return -1;
+    if ((int)buf_index >= ctx->slot_count) {
+        fprintf(stderr, "DQBUF returned ring index %u beyond slot count %d\n",
+                buf_index, ctx->slot_count);
+        return -1;
+    }
+
+    g_mutex_lock(&ctx->slots_lock);
+    ticket->idx = (int)buf_index;
+    ticket->generation = ctx->slots[buf_index].generation;
+    g_mutex_unlock(&ctx->slots_lock);
+    return 0;
+}
+
 static GstBuffer *build_frame_buffer(struct app_ctx *ctx, const struct slot_ticket *ticket)
 {
     struct frame_cookie *cookie;
@@ -956,6 +1651,129 @@ static GstBuffer *build_frame_buffer(struct app_ctx *ctx, const struct slot_tick
     return buf;
 }
 
+static void kms_flip_handler(int fd, unsigned int seq, unsigned int sec, unsigned int usec, void *data)
+{
+    struct app_ctx *ctx = (struct app_ctx *)data;
+    struct kms_output *k = &ctx->kms;
+    int64_t vblank_us = (int64_t)sec * 1000000LL + (int64_t)usec;
+
+    (void)fd;
+    if (k->flips > 0 && seq - k->last_seq > 1U)
+        k->vblank_repeats += seq - k->last_seq - 1U;
+    k->last_seq = seq;
+    if (vblank_us > k->commit_us)
+        k->total_flip_lat_ms += (double)(vblank_us - k->commit_us) / 1000.0;
+    k->flips++;
+
+    /* The previous frame just left the screen. */
+    if (k->has_front)
+        release_slot_ticket(ctx, &k->front, true);
+    k->front = k->pending;
+    k->has_front = true;
+    k->flip_pending = false;
+}
+
+/* Block until the committed flip is on screen; the loop's vsync pacing point. */
+static int kms_wait_flip(struct app_ctx *ctx)
+{
+    struct kms_output *k = &ctx->kms;
+    int64_t deadline_us = mono_us() + (int64_t)ctx->opt.timeout_ms * 1000LL;
+    drmEventContext evctx;
+
+    memset(&evctx, 0, sizeof(evctx));
+    evctx.version = DRM_EVENT_CONTEXT_VERSION;
+    evctx.page_flip_handler = kms_flip_handler;
+
+    while (k->flip_pending) {
+        struct pollfd pfd;
+        int n;
+
+        if (process_events(ctx, 0) < 0 || !ctx->running)
+            return -1;
+        pfd.fd = ctx->drm_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        n = poll(&pfd, 1, 20);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "[kms] poll failed: %s\n", strerror(errno));
+            return -1;
+        }
+        if (n > 0 && drmHandleEvent(ctx->drm_fd, &evctx) != 0) {
+            fprintf(stderr, "[kms] drmHandleEvent failed: %s\n", strerror(errno));
+            return -1;
+        }
+        if (k->flip_pending && mono_us() >= deadline_us) {
+            fprintf(stderr, "[kms] page flip timeout (%d ms)\n", ctx->opt.timeout_ms);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int kms_commit(struct app_ctx *ctx, int slot_idx)
+{
+    struct kms_output *k = &ctx->kms;
+    drmModeAtomicReqPtr req = drmModeAtomicAlloc();
+    uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT;
+    int ret;
+
+    if (!req)
+        return -1;
+    if (!k->modeset_done) {
+        drmModeAtomicAddProperty(req, k->conn_id, k->prop_conn_crtc, k->crtc_id);
+        drmModeAtomicAddProperty(req, k->crtc_id, k->prop_crtc_mode, k->mode_blob);
+        drmModeAtomicAddProperty(req, k->crtc_id, k->prop_crtc_active, 1);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_plane_crtc, k->crtc_id);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_src_x, 0);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_src_y, 0);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_src_w, (uint64_t)ctx->frame_width << 16);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_src_h, (uint64_t)ctx->frame_height << 16);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_crtc_x, k->dst_x);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_crtc_y, k->dst_y);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_crtc_w, k->dst_w);
+        drmModeAtomicAddProperty(req, k->plane_id, k->prop_crtc_h, k->dst_h);
+        flags = DRM_MODE_ATOMIC_ALLOW_MODESET | DRM_MODE_PAGE_FLIP_EVENT;
+    }
+    drmModeAtomicAddProperty(req, k->plane_id, k->prop_fb, k->bufs[slot_idx].fb_id);
+    ret = drmModeAtomicCommit(ctx->drm_fd, req, flags, ctx);
+    drmModeAtomicFree(req);
+    return ret;
+}
+
+/* Queue @ticket's slot for the next vblank; it stays in use until replaced. */
+static int kms_present(struct app_ctx *ctx, const struct slot_ticket *ticket)
+{
+    struct kms_output *k = &ctx->kms;
+
+    if (kms_wait_flip(ctx) < 0)
+        return -1;
+    k->pending = *ticket;
+    k->commit_us = mono_us();
+    if (kms_commit(ctx, ticket->idx) != 0) {
+        if (k->modeset_done || (k->dst_w == ctx->frame_width && k->dst_h == ctx->frame_height) ||
+            k->mode.hdisplay < ctx->frame_width || k->mode.vdisplay < ctx->frame_height) {
+            fprintf(stderr, "[kms] atomic commit failed: %s\n", strerror(errno));
+            return -1;
+        }
+        /* No scaler on the primary plane: show the frame 1:1, centred. */
+        k->dst_w = ctx->frame_width;
+        k->dst_h = ctx->frame_height;
+        k->dst_x = (k->mode.hdisplay - k->dst_w) / 2U;
+        k->dst_y = (k->mode.vdisplay - k->dst_h) / 2U;
+        if (kms_commit(ctx, ticket->idx) != 0) {
+            fprintf(stderr, "[kms] atomic modeset failed: %s\n", strerror(errno));
+            return -1;
+        }
+        fprintf(stderr, "[kms] plane cannot scale, showing %ux%u at +%u+%u\n",
+                k->dst_w, k->dst_h, k->dst_x, k->dst_y);
+    }
+    k->modeset_done = true;
+    k->flip_pending = true;
+    return 0;
+}
+
 static void get_slot_counts(struct app_ctx *ctx, int *free_slots, int *used_slots)
 {
     int i;
@@ -983,23 +1801,38 @@ static void print_stats(struct app_ctx *ctx)
     int64_t dt = now - ctx->last_stats_us;
     double avg_ms;
     double avg_slot_wait_ms;
+    double avg_capture_lat_ms;
     int free_slots;
     int used_slots;
+    char extra[160];
+    size_t off = 0;
 
     if (dt < (int64_t)ctx->opt.stats_interval * 1000000LL)
         return;
 
+    extra[0] = '\0';
+    if (ctx->opt.frame_drop > 0)
+        off += (size_t)snprintf(extra + off, sizeof(extra) - off, " stale=%" PRIu64, ctx->stale_dropped);
+    if (ctx->kms.active && off < sizeof(extra))
+        snprintf(extra + off, sizeof(extra) - off, " flips=%" PRIu64 " vbl_repeat=%" PRIu64 " flip_lat=%.2fms",
+                 ctx->kms.flips, ctx->kms.vblank_repeats,
+                 ctx->kms.flips ? ctx->kms.total_flip_lat_ms / (double)ctx->kms.flips : 0.0);
+
     avg_ms = ctx->loop_samples ? (ctx->total_loop_ms / (double)ctx->loop_samples) : 0.0;
     avg_slot_wait_ms = ctx->slot_wait_samples
         ? ((double)ctx->slot_wait_total_us / (double)ctx->slot_wait_samples / 1000.0)
         : 0.0;
+    avg_capture_lat_ms = ctx->capture_lat_samples
+        ? (ctx->total_capture_lat_ms / (double)ctx->capture_lat_samples)
+        : 0.0;
 
     get_slot_counts(ctx, &free_slots, &used_slots);
 
     fprintf(stderr,
             "[stats] cap=%" PRIu64 " push=%" PRIu64 " rel=%" PRIu64
             " free=%d used=%d timeout=%" PRIu64
-            " fps=%.2f rel_fps=%.2f avg_loop=%.2fms avg_slot_wait=%.2fms\n",
+            " fps=%.2f rel_fps=%.2f avg_loop=%.2fms avg_slot_wait=%.2fms"
+            " dma_drop=%u cap_lat=%.2fms%s\n",
             ctx->captured_frames,
             ctx->pushed_frames,
             ctx->released_frames,
@@ -1009,7 +1842,10 @@ static void print_stats(struct app_ctx *ctx)
             (double)(ctx->captured_frames - ctx->last_stats_captured) * 1000000.0 / (double)dt,
             (double)(ctx->released_frames - ctx->last_stats_released) * 1000000.0 / (double)dt,
             avg_ms,
-            avg_slot_wait_ms);
+            avg_slot_wait_ms,
+            ctx->dma_dropped,
+            avg_capture_lat_ms,
+            extra);
 
     ctx->last_stats_captured = ctx->captured_frames;
     ctx->last_stats_released = ctx->released_frames;
@@ -1139,6 +1975,10 @@ static void cleanup(struct app_ctx *ctx)
     if (ctx->pipeline)
         gst_object_unref(ctx->pipeline);
 
+    /* Before the ring mmaps go: the planes may still scan them out. */
+    if (ctx->drm_fd >= 0)
+        kms_release(ctx);
+
     if (ctx->dma_map_size > 0) {
         for (i = 0; i < ctx->dma_map_count; i++) {
             if (ctx->dma_maps[i])
@@ -1204,17 +2044,31 @@ int main(int argc, char **argv)
     if (init_fpga_dma(&ctx) < 0)
         goto out;
 
+    if (ctx.opt.output == OUTPUT_KMS && kms_init(&ctx) < 0) {
+        fprintf(stderr, "[kms] direct output unavailable, falling back to GStreamer kmssink\n");
+        kms_release(&ctx);
+    }
+
     if (init_copy_slots(&ctx) < 0)
         goto out;
 
-    if (build_pipeline(&ctx) < 0)
+    if (ctx.opt.frame_drop < 0)
+        ctx.opt.frame_drop = ctx.kms.active ? 1 : 0;
+
+    if (!ctx.kms.active && build_pipeline(&ctx) < 0)
+        goto out;
+
+    if (ctx.async_dma && !ctx.zero_copy_mode && queue_staged_dma_buffers(&ctx) < 0)
+        goto out;
+
+    if (ctx.async_dma && ctx.opt.dma_stream && start_dma_streaming(&ctx) < 0)
         goto out;
 
     fprintf(stderr,
-            "Start display loop: fps=%d src_fmt=%s io-mode=%s mmap-mode=%s zero-copy=%s display-sync=%s pixel-order=%s swap16=%s timeout=%dms copy_buffers=%d queue_depth=%d\n",
+            "Start display loop: fps=%d src_fmt=%s io-mode=%s mmap-mode=%s zero-copy=%s display-sync=%s pixel-order=%s swap16=%s timeout=%dms copy_buffers=%d queue_depth=%d dma_queue=%d dma_stream=%s pixconv=%s output=%s frame_drop=%d\n",
             ctx.opt.fps,
             pixel_format_name(ctx.pixel_format),
-            (ctx.opt.io_mode == IO_MODE_MMAP) ? "mmap" : "copy",
+            io_mode_name(ctx.opt.io_mode),
             active_mmap_mode_name(&ctx),
             ctx.zero_copy_mode ? "on" : "off",
             ctx.opt.display_sync ? "on" : "off",
@@ -1222,7 +2076,12 @@ int main(int argc, char **argv)
             ctx.opt.swap16 ? "on" : "off",
             ctx.opt.timeout_ms,
             ctx.opt.copy_buffers,
-            ctx.opt.queue_depth);
+            ctx.opt.queue_depth,
+            ctx.async_dma ? ctx.dma_map_count : 0,
+            (ctx.async_dma && ctx.opt.dma_stream) ? "on" : "off",
+            pixconv_backend_name(),
+            ctx.kms.active ? "kms" : "gst",
+            ctx.opt.frame_drop);
 
     ctx.start_us = mono_us();
     ctx.last_stats_us = ctx.start_us;
@@ -1241,48 +2100,99 @@ int main(int argc, char **argv)
             break;
         if (!ctx.running)
             break;
+        /* KMS: capture right after the last flip lands, so it is ready for the next vblank. */
+        if (ctx.kms.active && kms_wait_flip(&ctx) < 0)
+            break;
 
         t0 = mono_us();
 
-        if (acquire_free_slot(&ctx, &ticket) < 0)
-            break;
-        ticket_valid = true;
+        if (ctx.async_dma && ctx.zero_copy_mode) {
+            if (dequeue_zero_copy_slot(&ctx, &ticket) < 0) {
+                fprintf(stderr, "DMA dequeue failed\n");
+                break;
+            }
+            ticket_valid = true;
+            ctx.captured_frames++;
+        } else if (ctx.async_dma) {
+            uint32_t buf_index;
 
-        if (trigger_frame_dma(&ctx, ctx.zero_copy_mode ? (uint32_t)ticket.idx : 0U) < 0) {
-            fprintf(stderr, "DMA trigger failed\n");
-            release_slot_ticket(&ctx, &ticket, false);
-            break;
+            if (acquire_free_slot(&ctx, &ticket) < 0)
+                break;
+            ticket_valid = true;
+
+            if (dequeue_latest_dma_buffer(&ctx, &buf_index) < 0) {
+                fprintf(stderr, "DMA dequeue failed\n");
+                release_slot_ticket(&ctx, &ticket, false);
+                break;
+            }
+            ctx.captured_frames++;
+
+            /* Convert out of the landed buffer while the next ones are in flight. */
+            prepare_display_frame(&ctx, ctx.slots[ticket.idx].data,
+                                  (const uint8_t *)ctx.dma_maps[buf_index]);
+            if (queue_dma_buffer(&ctx, buf_index) < 0) {
+                release_slot_ticket(&ctx, &ticket, false);
+                break;
+            }
+        } else {
+            int dma_ret;
+
+            if (acquire_free_slot(&ctx, &ticket) < 0)
+                break;
+            ticket_valid = true;
+
+            if (ctx.opt.io_mode == IO_MODE_USERPTR)
+                dma_ret = trigger_frame_dma_user(&ctx, ctx.dma_copy ? ctx.dma_copy
+                                                                    : ctx.slots[ticket.idx].data);
+            else
+                dma_ret = trigger_frame_dma(&ctx, ctx.zero_copy_mode ? (uint32_t)ticket.idx : 0U);
+            if (dma_ret < 0) {
+                fprintf(stderr, "DMA trigger failed\n");
+                release_slot_ticket(&ctx, &ticket, false);
+                break;
+            }
+            ctx.captured_frames++;
         }
-        ctx.captured_frames++;
 
-        if (!ctx.zero_copy_mode) {
-            frame_src = (ctx.opt.io_mode == IO_MODE_COPY)
-                ? ctx.dma_copy
-                : (const uint8_t *)ctx.dma_maps[0];
+        if (!ctx.zero_copy_mode && !ctx.async_dma) {
+            if (ctx.opt.io_mode == IO_MODE_MMAP)
+                frame_src = (const uint8_t *)ctx.dma_maps[0];
+            else if (ctx.dma_copy)
+                frame_src = ctx.dma_copy;
+            else
+                frame_src = ctx.slots[ticket.idx].data;  /* userptr BGRX: already in place */
             if (!frame_src) {
                 fprintf(stderr, "Frame source is null in io-mode=%s\n",
-                        (ctx.opt.io_mode == IO_MODE_MMAP) ? "mmap" : "copy");
+                        io_mode_name(ctx.opt.io_mode));
                 release_slot_ticket(&ctx, &ticket, false);
                 break;
             }
             prepare_display_frame(&ctx, ctx.slots[ticket.idx].data, frame_src);
         }
 
-        buf = build_frame_buffer(&ctx, &ticket);
-        if (!buf) {
-            fprintf(stderr, "Failed to build GstBuffer for slot %d\n", ticket.idx);
-            release_slot_ticket(&ctx, &ticket, false);
-            break;
-        }
-
-        flow = gst_app_src_push_buffer(GST_APP_SRC(ctx.appsrc), buf);
-        if (flow != GST_FLOW_OK) {
-            fprintf(stderr, "gst_app_src_push_buffer failed: %d\n", flow);
-            if (ticket_valid)
+        if (ctx.kms.active) {
+            if (kms_present(&ctx, &ticket) < 0) {
                 release_slot_ticket(&ctx, &ticket, false);
-            break;
+                break;
+            }
+        } else {
+            buf = build_frame_buffer(&ctx, &ticket);
+            if (!buf) {
+                fprintf(stderr, "Failed to build GstBuffer for slot %d\n", ticket.idx);
+                release_slot_ticket(&ctx, &ticket, false);
+                break;
+            }
+
+            flow = gst_app_src_push_buffer(GST_APP_SRC(ctx.appsrc), buf);
+            if (flow != GST_FLOW_OK) {
+                fprintf(stderr, "gst_app_src_push_buffer failed: %d\n", flow);
+                if (ticket_valid)
+                    release_slot_ticket(&ctx, &ticket, false);
+                break;
+            }
         }
         ctx.pushed_frames++;
+        account_capture_latency(&ctx);
 
         t1 = mono_us();
         ctx.total_loop_ms += (double)(t1 - t0) / 1000.0;
@@ -1290,16 +2200,18 @@ int main(int argc, char **argv)
 
         print_stats(&ctx);
 
-        if ((t1 - t0) < target_us)
+        if (!ctx.kms.active && (t1 - t0) < target_us)
             usleep((useconds_t)(target_us - (t1 - t0)));
     }
 
     fprintf(stderr,
-            "Exit: captured=%" PRIu64 " pushed=%" PRIu64 " released=%" PRIu64 " slot_timeout=%" PRIu64 "\n",
+            "Exit: captured=%" PRIu64 " pushed=%" PRIu64 " released=%" PRIu64 " slot_timeout=%" PRIu64
+            " dma_drop=%u\n",
             ctx.captured_frames,
             ctx.pushed_frames,
             ctx.released_frames,
-            ctx.slot_wait_timeout_count);
+            ctx.slot_wait_timeout_count,
+            ctx.dma_dropped);
 
     ret = 0;
 
@@ -7,17 +7,28 @@
  *
  * Inference path:
  *   Dedicated worker thread converts BGR565 to RGB888 for RKNN only.
+ *
+ * With --pipeline 1 the display path runs as three pinned stages
+ * (capture -> convert+overlay -> push) joined by SPSC rings.
  */
 
+#define _GNU_SOURCE
+
 #include <errno.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,8 +42,19 @@
 #include <gst/app/gstappsrc.h>
 #include <gst/gst.h>
 #include <rknn_api.h>
+#include <drm_fourcc.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#ifdef HAVE_RGA
+#include <im2d.h>
+#include <rga.h>
+#endif
 
+#include "det_nms.h"
+#include "frame_record.h"
 #include "pcie_fpga_dma.h"
+#include "pixel_convert.h"
 
 #define DEFAULT_DEVICE "/dev/" FPGA_DMA_DEV_NAME
 #define DEFAULT_DRM_CARD "/dev/dri/card0"
@@ -41,13 +63,18 @@
 #define DEFAULT_STATS_INTERVAL 1
 #define DEFAULT_COPY_BUFFERS 2
 #define DEFAULT_QUEUE_DEPTH 1
+#define DEFAULT_DMA_QUEUE 0
 #define DEFAULT_QUAD_REFINER_MODEL "stage1_r18_gt_best.rknn"
 #define MIN_COPY_BUFFERS 2
 #define MAX_COPY_BUFFERS 6
+/* Capture frames kept when DMA lands in app memory (blocking READ_FRAME). */
+#define HEAP_FRAME_BUFFERS 5
+#define MAX_CAPTURE_FRAMES FPGA_DMA_MAX_RING_BUFFERS
+/* Power of two; must cover both MAX_CAPTURE_FRAMES and MAX_COPY_BUFFERS. */
+#define STAGE_QUEUE_DEPTH 8
 
 #define MAX_LABELS 256
 #define MAX_LABEL_LEN 64
-#define MAX_DETS 128
 #define MAX_OCR_KEYS 128
 #define MAX_OCR_KEY_LEN 16
 #define ALGO_STREAM_SIZE 640
@@ -56,14 +83,30 @@
 #define OBB_POINT_COUNT 8400
 #define OCR_TRACK_MAX 24
 #define OCR_TRACK_HIST 8
+#define OCR_CACHE_MIN_HITS 3
+#define MOTION_TILE 64
+#define MOTION_STEP 4
+#define MOTION_TILES_X ((1280 + MOTION_TILE - 1) / MOTION_TILE)
+#define MOTION_TILES_Y ((720 + MOTION_TILE - 1) / MOTION_TILE)
+#define MOTION_LUMA_DELTA 24
+#define OCR_CACHE_MIN_IOU 0.70f
 #define MAX_UTF8_TOKEN_BYTES 8
 #define MAX_PLATE_TOKENS 16
+#define OFFLINE_MAX_WORKERS 8
+/* Images a batch worker may finish ahead of the in-order writer, per worker */
+#define OFFLINE_WINDOW_PER_WORKER 4
 
 #define COLOR_YELLOW_565 0xFFE0
 #define COLOR_CYAN_565 0x07FF
 #define COLOR_RED_565 0xF800
 #define COLOR_GREEN_565 0x07E0
 #define OVERLAY_TEXT_SCALE 3
+#define COLOR_YELLOW_ARGB 0xFFFFFF00U
+#define COLOR_CYAN_ARGB 0xFF00FFFFU
+#define COLOR_RED_ARGB 0xFFFF0000U
+#define COLOR_GREEN_ARGB 0xFF00FF00U
+#define OVERLAY_PLANE_BUFS 2
+#define OVERLAY_DIRTY_MAX 64
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -91,6 +134,18 @@ enum plate_type {
     PLATE_TYPE_UNKNOWN,
 };
 
+enum log_level {
+    LOG_ERR = 0,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG,
+};
+
+enum pred_log_format {
+    PRED_LOG_CSV = 0,
+    PRED_LOG_BIN,
+};
+
 enum plate_decode_mode {
     PLATE_DECODE_NONE = 0,
     PLATE_DECODE_ROWS,
@@ -133,6 +188,11 @@ enum det_resize_mode {
     DET_RESIZE_LETTERBOX,
 };
 
+enum preproc_backend {
+    PREPROC_CPU = 0,
+    PREPROC_RGA,
+};
+
 enum ocr_preproc_mode {
     OCR_PREPROC_NONE = 0,
     OCR_PREPROC_GRAY,
@@ -151,6 +211,10 @@ struct options {
     const char *pred_log_path;
     const char *offline_image_path;
     const char *offline_roi_arg;
+    const char *offline_batch_path;
+    const char *replay_path;
+    float replay_speed;
+    int replay_loop;
     int connector_id;
     int fps;
     enum pixel_order pixel_order;
@@ -158,6 +222,34 @@ struct options {
     int stats_interval;
     int copy_buffers;
     int queue_depth;
+    int dma_queue;
+    int dma_stream;
+    int dma_userptr;
+    int fpga_tensor;
+    int pipeline;
+    int cpu_capture;
+    int cpu_convert;
+    int cpu_push;
+    int cpu_infer;
+    int cpu_post;
+    int infer_pipeline;
+    int veh_every;
+    int npu_zero_copy;
+    int int8_decode;
+    int ocr_cache_ttl;
+    float ocr_cache_conf;
+    int motion_gate;
+    int motion_refresh;
+    float motion_tile_thr;
+    int plate_cascade;
+    int overlay_plane;
+    int prof;
+    const char *prof_trace_path;
+    enum log_level log_level;
+    int log_async;
+    enum pred_log_format pred_log_format;
+    const char *pixconv;
+    int preproc_backend;
     float min_car_conf;
     float min_plate_conf;
     int plate_on_car_only;
@@ -189,25 +281,10 @@ struct options {
     int ocr_crop_dump_max;
     const char *ocr_crop_dump_dir;
     int offline_detect_plate;
+    int offline_workers;
     bool swap16;
 };
 
-struct det_box {
-    int x1;
-    int y1;
-    int x2;
-    int y2;
-    float conf;
-    int cls;
-    int has_obb;
-    float cx;
-    float cy;
-    float w;
-    float h;
-    float angle;
-    float quad[8];
-};
-
 struct plate_det {
     struct det_box box;
     struct det_box crop_box;
@@ -226,14 +303,22 @@ struct frame_slot {
     uint64_t generation;
 };
 
+/*
+ * One captured source frame: a DMA ring slot (async capture) or a heap
+ * buffer (blocking capture). Display and infer each hold a reference; the
+ * last put requeues the ring slot or returns the heap buffer to capture.
+ */
+struct frame_buf {
+    uint8_t *data;
+    int refs;
+};
+
+/* Scalars first: readers copy up to `cars`, then only the live entries. */
 struct lpr_results {
-    struct det_box cars[MAX_DETS];
     int car_count;
     int car_raw_count;
-    struct det_box persons[MAX_DETS];
     int person_count;
     int person_raw_count;
-    struct plate_det plates[MAX_DETS];
     int plate_count;
     int plate_raw_count;
     int plate_rows_raw;
@@ -244,6 +329,7 @@ struct lpr_results {
     int ocr_run_count;
     int ocr_skip_size;
     int ocr_skip_blur;
+    int ocr_cache_hit;
     int ocr_nonempty_count;
     int overlay_text_nonempty_count;
     struct det_box a_roi;
@@ -255,6 +341,25 @@ struct lpr_results {
     double infer_ms_last;
     uint64_t infer_frames_total;
     double infer_ms_total;
+    struct det_box cars[MAX_DETS];
+    struct det_box persons[MAX_DETS];
+    struct plate_det plates[MAX_DETS];
+};
+
+/*
+ * Published results. The post stage is the only writer. It fills the slot
+ * that `cur` does not point at, then flips `cur`. Each slot has a seqlock
+ * count, so a reader that a second publish laps retries; the writer never
+ * waits for readers.
+ */
+struct result_slot {
+    atomic_uint seq;                /* odd while the writer fills the slot */
+    struct lpr_results r;
+};
+
+struct result_board {
+    atomic_uint cur;
+    struct result_slot slot[2];
 };
 
 struct detect_decode_diag {
@@ -300,6 +405,41 @@ struct ocr_track {
     int hist_next;
     char province_tok[MAX_UTF8_TOKEN_BYTES];
     float province_score;
+    /* --ocr-cache-ttl: last smoothed OCR result and how often it repeated */
+    char cache_text[64];
+    float cache_conf;
+    struct det_box cache_box;
+    uint64_t cache_seq;
+    int cache_hits;
+};
+
+#define RKNN_IO_MAX_OUTPUTS 8
+
+/*
+ * Persistent NPU I/O for one rknn context. Outputs always land in
+ * preallocated float buffers, so no per-call runtime allocation. With
+ * --npu-zero-copy 1 and a UINT8 input, the input and outputs are bound
+ * once with rknn_set_io_mem: preprocessing writes straight into the input
+ * tensor memory, and the quantized outputs are dequantized into the same
+ * float buffers the decoders already read. Detectors with --int8-decode 1
+ * skip that step and read the INT8 tensors themselves.
+ */
+struct rknn_io {
+    bool zero_copy;
+    uint32_t n_output;
+    rknn_tensor_mem *in_mem;
+    size_t in_row_bytes;        /* dense row the preprocessing produces */
+    size_t in_stride_bytes;     /* row pitch of in_mem */
+    uint32_t in_rows;
+    rknn_tensor_mem *out_mem[RKNN_IO_MAX_OUTPUTS];
+    rknn_tensor_attr out_attr[RKNN_IO_MAX_OUTPUTS];     /* as bound to out_mem */
+    float *out_f32[RKNN_IO_MAX_OUTPUTS];
+    uint32_t out_elems[RKNN_IO_MAX_OUTPUTS];
+    /* Every output is affine INT8: rknn_io_run can hand them over undequantized. */
+    bool quant_ok;
+    int8_t *out_q[RKNN_IO_MAX_OUTPUTS];     /* host copies when not zero-copy */
+    int32_t out_zp[RKNN_IO_MAX_OUTPUTS];
+    float out_scale[RKNN_IO_MAX_OUTPUTS];
 };
 
 struct yolo_model {
@@ -317,6 +457,12 @@ struct yolo_model {
     float nms_iou_thr;
     int max_det;
     int class_filter;
+    bool int8_decode;       /* decode straight from INT8 outputs (--int8-decode) */
+    int prof_stage;         /* PROF_*_PRE of this detector for --prof */
+    struct rknn_io io;
+    /* Serialises input fill + rknn_run when detect and post stages share the model. */
+    pthread_mutex_t run_lock;
+    bool run_lock_ready;
 };
 
 struct ocr_model {
@@ -329,6 +475,17 @@ struct ocr_model {
     uint32_t in_w;
     uint32_t in_h;
     uint32_t in_c;
+    uint32_t batch;         /* plates per rknn_run: input dims[0] */
+    struct rknn_io io;
+};
+
+/* Input plus result of one plate in a run_model_ocr_batch call. */
+struct ocr_slot {
+    float occ_ratio;
+    int ret;
+    char text[64];
+    float conf;
+    struct ocr_diag diag;
 };
 
 struct quad_refiner_model {
@@ -341,9 +498,11 @@ struct quad_refiner_model {
     uint32_t in_w;
     uint32_t in_h;
     uint32_t in_c;
+    struct rknn_io io;
 };
 
 struct app_ctx;
+struct stage_pipeline;
 
 static bool run_quad_refiner(const struct app_ctx *ctx,
                               const uint8_t *rgb, int img_w, int img_h,
@@ -359,13 +518,83 @@ static void bbox_from_quad_float(const float q[8], int img_w, int img_h,
                                  int *x1, int *y1, int *x2, int *y2);
 static bool decode_refiner_output_layout(const rknn_tensor_attr *a, int *h, int *w, int *c, bool *is_nchw);
 
+struct overlay_rect {
+    int x1;
+    int y1;
+    int x2;
+    int y2;
+};
+
+struct overlay_buf {
+    uint32_t handle;
+    uint32_t fb_id;
+    uint32_t pitch;
+    size_t size;
+    uint32_t *pix;
+    /* Drawn since the last clear; -1 when the whole buffer must be cleared */
+    struct overlay_rect dirty[OVERLAY_DIRTY_MAX];
+    int dirty_count;
+};
+
+struct overlay_plane {
+    bool active;
+    uint32_t plane_id;
+    uint32_t crtc_id;
+    uint32_t crtc_w;
+    uint32_t crtc_h;
+    int w;
+    int h;
+    int back;
+    uint64_t rendered_seq;
+    uint64_t render_count;
+    uint64_t flip_errors;
+    struct overlay_buf bufs[OVERLAY_PLANE_BUFS];
+};
+
+/* --replay: a FRAW recording mapped read-only in place of /dev/fpga_dma0 */
+struct replay_src {
+    uint8_t *map;
+    size_t map_size;
+    const struct frame_record_header *hdr;
+    uint64_t count;
+    uint64_t next;
+    uint64_t ts0_ns;       /* recorded timestamp of the first frame of this pass */
+    int64_t wall0_us;      /* mono_us() when that frame was replayed */
+    uint64_t passes;
+};
+
 struct app_ctx {
     struct options opt;
     int dev_fd;
+    struct replay_src replay;
     int drm_fd;
-    void *dma_map;
+    void *dma_maps[FPGA_DMA_MAX_RING_BUFFERS];
     size_t dma_map_size;
-    uint8_t *dma_copy;
+    int dma_map_count;
+    bool async_dma;
+    /* --fpga-tensor: detector tensor paired with each ring slot */
+    bool fpga_tensor;
+    void *tensor_maps[FPGA_DMA_MAX_RING_BUFFERS];
+    size_t tensor_map_size;
+    bool frame_tensor[MAX_CAPTURE_FRAMES];  /* last DQBUF of the slot filled its tensor */
+    struct letterbox_meta tensor_lb;
+    int dma_queued;
+    /* Written by the capture/push stages under --pipeline, read by print_stats. */
+    atomic_uint dma_dropped;
+    uint64_t last_dma_ts_ns;
+    atomic_uint_fast64_t total_capture_lat_us;
+    atomic_uint_fast64_t capture_lat_samples;
+    struct frame_buf frames[MAX_CAPTURE_FRAMES];
+#ifdef HAVE_RGA
+    /* Ring slots exported as dma-buf and imported into RGA (0 = use the mapping). */
+    int rga_dmabuf_fds[MAX_CAPTURE_FRAMES];
+    rga_buffer_handle_t rga_frame_handles[MAX_CAPTURE_FRAMES];
+#endif
+    int frame_count;
+    int frame_infer_held;
+    GMutex frame_lock;
+    GCond frame_cond;
+    struct stage_pipeline *stages;
     uint32_t frame_width;
     uint32_t frame_height;
     uint32_t src_frame_bpp;
@@ -386,9 +615,10 @@ struct app_ctx {
     GstBus *bus;
 
     bool running;
-    uint64_t captured_frames;
-    uint64_t pushed_frames;
-    uint64_t released_frames;
+    /* Stage threads bump these under --pipeline; relaxed, stats only. */
+    atomic_uint_fast64_t captured_frames;
+    atomic_uint_fast64_t pushed_frames;
+    atomic_uint_fast64_t released_frames;
     uint64_t next_pts_ns;
     int64_t last_stats_us;
     uint64_t last_stats_cap;
@@ -396,16 +626,16 @@ struct app_ctx {
     uint64_t last_stats_infer;
     uint64_t slot_wait_timeout_count;
     uint64_t infer_overwrite_count;
+    uint64_t infer_busy_skip_count;
 
     pthread_t infer_thread;
     pthread_mutex_t infer_lock;
     pthread_cond_t infer_cond;
-    uint8_t *infer_latest_raw;
+    int infer_latest_idx;
     bool infer_has_new;
     uint64_t infer_frame_seq;
 
-    pthread_mutex_t result_lock;
-    struct lpr_results results;
+    struct result_board results;
 
     struct yolo_model veh_model;
     struct yolo_model plate_model;
@@ -440,8 +670,26 @@ struct app_ctx {
     int ped_next_track_id;
     int ped_red_streak;
 
+    /* Detect-stage vehicle boxes, reused between --veh-every runs */
+    struct det_box veh_cache[MAX_DETS];
+    int veh_cache_count;
+    uint64_t veh_tick;
+
+    /* Detect-stage --motion-gate state; plate_cache stands in on static frames */
+    uint8_t *motion_prev;
+    bool motion_prev_valid;
+    int motion_since_detect;
+    uint64_t motion_gated_frames;
+    struct det_box plate_cache[MAX_DETS];
+    int plate_cache_count;
+    struct detect_decode_diag plate_cache_diag;
+    bool plate_cache_valid;
+
     struct ocr_track ocr_tracks[OCR_TRACK_MAX];
     uint64_t ocr_track_age_seq;
+
+    /* --overlay-plane layer, drawn by the post stage */
+    struct overlay_plane overlay;
 };
 
 struct slot_ticket {
@@ -466,11 +714,15 @@ static void resize_rgb888_letterbox_kernel(const uint8_t *src, int sw, int sh,
                                            uint8_t *dst, int dw, int dh, uint8_t pad,
                                            int kernel, struct letterbox_meta *meta);
 static void ocr_preprocess_rgb888(uint8_t *rgb, int w, int h, int mode);
-static float box_iou(const struct det_box *a, const struct det_box *b);
 static float laplacian_variance_rgb888(const uint8_t *rgb, int w, int h);
 static uint8_t *prepare_ocr_input_rgb888(const struct app_ctx *ctx,
                                          const uint8_t *crop_rgb, int crop_w, int crop_h,
                                          float *occ_ratio_out);
+static bool preproc_rga_resize(const struct app_ctx *ctx, const uint8_t *src, int sw, int sh,
+                               uint8_t *dst, int dw, int dh, int x, int y, int w, int h);
+static bool preproc_rga_letterbox(const struct app_ctx *ctx, const uint8_t *src, int sw, int sh,
+                                  uint8_t *dst, int dw, int dh, uint8_t pad,
+                                  struct letterbox_meta *meta);
 static bool append_utf8_token(char *dst, size_t dst_len, const char *token);
 static int rknn_quad_refiner_model_load(struct quad_refiner_model *m, const char *name, const char *path);
 static void rknn_quad_refiner_model_release(struct quad_refiner_model *m);
@@ -500,6 +752,376 @@ static int64_t mono_us(void)
     return g_get_monotonic_time();
 }
 
+/*
+ * --prof stage profiler. prof_end() adds each scoped timing to a lock-free
+ * log-bucket histogram of its stage: exact below 8 us, then four
+ * sub-buckets per power of two. print_stats reports p50/p95/p99 over the
+ * interval. With --prof-trace, the spans are also recorded into a
+ * preallocated buffer and written as Chrome trace JSON at exit. When off,
+ * a timer costs one flag check.
+ */
+enum prof_stage {
+    PROF_VEH_PRE = 0,               /* per detector: PRE, NPU, DECODE in this order */
+    PROF_VEH_NPU,
+    PROF_VEH_DECODE,
+    PROF_PLATE_PRE,
+    PROF_PLATE_NPU,
+    PROF_PLATE_DECODE,
+    PROF_CONVERT,
+    PROF_SW_PREPROC,
+    PROF_PLATE_DETECT,
+    PROF_PLATE_RETRY,
+    PROF_TRACK,
+    PROF_REFINE,
+    PROF_CROP,
+    PROF_SHARPNESS,
+    PROF_OCR_PREP,
+    PROF_OCR,
+    PROF_DETECT,
+    PROF_POST,
+    PROF_STAGE_COUNT,
+};
+
+static const char *const prof_stage_names[PROF_STAGE_COUNT] = {
+    "veh_pre", "veh_npu", "veh_decode", "plate_pre", "plate_npu", "plate_decode",
+    "convert", "sw_preproc", "plate_det", "plate_retry", "track", "refine",
+    "crop", "sharp", "ocr_prep", "ocr", "detect", "post",
+};
+
+#define PROF_BUCKETS 128
+#define PROF_MAX_THREADS 16
+#define PROF_TRACE_MAX (256U * 1024U)
+
+struct prof_event {
+    int64_t ts_us;
+    int32_t dur_us;
+    uint8_t stage;
+    uint8_t tid;
+};
+
+struct prof_state {
+    bool enabled;
+    atomic_ullong hist[PROF_STAGE_COUNT][PROF_BUCKETS];
+    unsigned long long last[PROF_STAGE_COUNT][PROF_BUCKETS];   /* reporter's snapshot */
+    atomic_uint next_tid;
+    const char *thread_names[PROF_MAX_THREADS];
+    struct prof_event *trace;
+    atomic_uint trace_next;
+};
+
+static struct prof_state g_prof;
+static __thread int g_prof_tid = -1;
+
+static int prof_bucket(int64_t us)
+{
+    int e;
+    int b;
+    if (us < 8)
+        return us < 0 ? 0 : (int)us;
+    e = 63 - __builtin_clzll((unsigned long long)us);
+    b = 8 + (e - 3) * 4 + (int)((us >> (e - 2)) & 3);
+    return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+/* Largest value that lands in bucket @b. */
+static int64_t prof_bucket_max(int b)
+{
+    int e;
+    if (b < 8)
+        return b;
+    e = (b - 8) / 4 + 3;
+    return ((int64_t)(4 + (b - 8) % 4 + 1) << (e - 2)) - 1;
+}
+
+static int prof_thread_id(const char *name)
+{
+    if (g_prof_tid < 0) {
+        unsigned int id = atomic_fetch_add_explicit(&g_prof.next_tid, 1U, memory_order_relaxed);
+        g_prof_tid = (int)(id % PROF_MAX_THREADS);
+    }
+    if (name)
+        g_prof.thread_names[g_prof_tid] = name;
+    return g_prof_tid;
+}
+
+static int64_t prof_begin(void)
+{
+    return g_prof.enabled ? mono_us() : 0;
+}
+
+static void prof_end(int stage, int64_t t0)
+{
+    int64_t now;
+    unsigned int idx;
+
+    if (!g_prof.enabled)
+        return;
+    now = mono_us();
+    atomic_fetch_add_explicit(&g_prof.hist[stage][prof_bucket(now - t0)], 1ULL, memory_order_relaxed);
+    if (!g_prof.trace)
+        return;
+    idx = atomic_fetch_add_explicit(&g_prof.trace_next, 1U, memory_order_relaxed);
+    if (idx < PROF_TRACE_MAX) {
+        struct prof_event *ev = &g_prof.trace[idx];
+        ev->ts_us = t0;
+        ev->dur_us = (int32_t)(now - t0);
+        ev->stage = (uint8_t)stage;
+        ev->tid = (uint8_t)prof_thread_id(NULL);
+    }
+}
+
+static int prof_init(bool enabled, const char *trace_path)
+{
+    memset(&g_prof, 0, sizeof(g_prof));
+    g_prof.enabled = enabled || (trace_path && trace_path[0] != '\0');
+    if (g_prof.enabled && trace_path && trace_path[0] != '\0') {
+        g_prof.trace = calloc(PROF_TRACE_MAX, sizeof(*g_prof.trace));
+        if (!g_prof.trace)
+            return -1;
+    }
+    return 0;
+}
+
+/* One line of p50/p95/p99 in ms per stage that ran; @total reports since start. */
+static void prof_report(bool total)
+{
+    static const unsigned int pct[3] = {50, 95, 99};
+    char line[2048];
+    size_t len;
+    int s;
+
+    if (!g_prof.enabled)
+        return;
+    len = (size_t)snprintf(line, sizeof(line), "[prof]%s", total ? " total" : "");
+    for (s = 0; s < PROF_STAGE_COUNT; s++) {
+        unsigned long long d[PROF_BUCKETS];
+        unsigned long long n = 0;
+        unsigned long long acc = 0;
+        int64_t pv[3] = {0, 0, 0};
+        int k = 0;
+        int b;
+
+        for (b = 0; b < PROF_BUCKETS; b++) {
+            unsigned long long v = atomic_load_explicit(&g_prof.hist[s][b], memory_order_relaxed);
+            d[b] = total ? v : v - g_prof.last[s][b];
+            g_prof.last[s][b] = v;
+            n += d[b];
+        }
+        if (n == 0)
+            continue;
+        for (b = 0; b < PROF_BUCKETS && k < 3; b++) {
+            acc += d[b];
+            while (k < 3 && acc * 100ULL >= n * pct[k])
+                pv[k++] = prof_bucket_max(b);
+        }
+        if (len < sizeof(line))
+            len += (size_t)snprintf(line + len, sizeof(line) - len, " %s=%.2f/%.2f/%.2f(%llu)",
+                                    prof_stage_names[s], (double)pv[0] / 1000.0,
+                                    (double)pv[1] / 1000.0, (double)pv[2] / 1000.0, n);
+    }
+    fprintf(stderr, "%s\n", line);
+}
+
+/* Call after the profiled threads are joined. */
+static void prof_trace_write(const char *path)
+{
+    unsigned int n;
+    unsigned int i;
+    const char *sep = "";
+    FILE *fp;
+
+    if (!g_prof.trace)
+        return;
+    n = atomic_load_explicit(&g_prof.trace_next, memory_order_relaxed);
+    if (n > PROF_TRACE_MAX)
+        n = PROF_TRACE_MAX;
+    fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "[prof] cannot write trace %s: %s\n", path, strerror(errno));
+        return;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = 0; i < PROF_MAX_THREADS; i++) {
+        if (!g_prof.thread_names[i])
+            continue;
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                sep, i, g_prof.thread_names[i]);
+        sep = ",\n";
+    }
+    for (i = 0; i < n; i++) {
+        const struct prof_event *ev = &g_prof.trace[i];
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%" PRId64 ",\"dur\":%d}",
+                sep, prof_stage_names[ev->stage], (unsigned int)ev->tid, ev->ts_us, (int)ev->dur_us);
+        sep = ",\n";
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    fprintf(stderr, "[prof] trace: %u events -> %s%s\n", n, path,
+            atomic_load_explicit(&g_prof.trace_next, memory_order_relaxed) > PROF_TRACE_MAX ? " (buffer full)" : "");
+}
+
+/*
+ * Diagnostic and prediction logging. lpr_log() drops lines above the
+ * runtime --log-level; lines above LPR_LOG_LEVEL_MAX are compiled out.
+ * With --log-async 1, text lines, prediction records and crop dumps go
+ * through a bounded lock-free MPSC ring (per-cell sequence numbers) to a
+ * writer thread, so a slow serial console or disk never stalls the
+ * inference threads. A full ring drops the entry and counts it rather
+ * than block. Without the writer everything is written inline as before.
+ */
+#ifndef LPR_LOG_LEVEL_MAX
+#define LPR_LOG_LEVEL_MAX LOG_DEBUG
+#endif
+
+#define LOG_RING_SIZE 1024          /* power of two */
+#define LOG_LINE_MAX 256
+
+enum log_kind {
+    LOG_KIND_TEXT = 0,
+    LOG_KIND_PRED,
+    LOG_KIND_DUMP,
+};
+
+/*
+ * --pred-log-format bin: "LPRB", u32 version, u32 record size, then one
+ * record per prediction, little endian. pred_bin_to_csv.py turns it back
+ * into the CSV eval_lpr.py reads.
+ */
+#define PRED_BIN_MAGIC "LPRB"
+#define PRED_BIN_VERSION 2U      /* v2: text[] grew from 40 to 64 bytes */
+
+struct pred_record {
+    uint64_t frame_id;
+    int64_t ts_us;
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+    float conf;
+    uint8_t type;                   /* enum plate_type */
+    uint8_t color;                  /* enum plate_color */
+    uint16_t reserved;
+    char text[64];                  /* UTF-8, NUL padded; holds all of plate_det.ocr_text */
+};
+
+_Static_assert(sizeof(struct pred_record) == 104, "pred_record is the on-disk .bin layout");
+_Static_assert(sizeof(((struct pred_record *)0)->text) == sizeof(((struct plate_det *)0)->ocr_text),
+               "pred_record.text must not truncate ocr_text");
+
+/* Crop dump handed to the writer; both images live in data[] */
+struct log_dump_job {
+    int idx;
+    uint64_t frame_id;
+    struct plate_det pd;
+    int crop_w;
+    int crop_h;
+    int ocr_w;
+    int ocr_h;
+    uint8_t data[];
+};
+
+struct log_entry {
+    atomic_uint seq;
+    enum log_kind kind;
+    union {
+        char text[LOG_LINE_MAX];
+        struct pred_record pred;
+        struct log_dump_job *dump;
+    } u;
+};
+
+struct log_state {
+    enum log_level level;
+    bool async;                     /* writer thread running */
+    struct log_entry *ring;
+    atomic_uint head;
+    unsigned int tail;              /* writer thread only */
+    atomic_ulong dropped;
+    atomic_bool stop;
+    sem_t wake;
+    pthread_t thread;
+};
+
+static struct log_state g_log = { .level = LOG_INFO };
+
+#define lpr_log(lvl, ...)                                                   \
+    do {                                                                    \
+        if ((lvl) <= LPR_LOG_LEVEL_MAX && (lvl) <= g_log.level)             \
+            log_text(__VA_ARGS__);                                          \
+    } while (0)
+
+/* Producer side; NULL when the ring is full */
+static struct log_entry *log_ring_claim(void)
+{
+    unsigned int pos = atomic_load_explicit(&g_log.head, memory_order_relaxed);
+
+    for (;;) {
+        struct log_entry *e = &g_log.ring[pos & (LOG_RING_SIZE - 1)];
+        unsigned int seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+        int diff = (int)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_log.head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return e;
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&g_log.head, memory_order_relaxed);
+        }
+    }
+}
+
+static void log_ring_commit(struct log_entry *e)
+{
+    unsigned int seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&e->seq, seq + 1, memory_order_release);
+    sem_post(&g_log.wake);
+}
+
+/* Writer side */
+static struct log_entry *log_ring_peek(void)
+{
+    struct log_entry *e = &g_log.ring[g_log.tail & (LOG_RING_SIZE - 1)];
+
+    if (atomic_load_explicit(&e->seq, memory_order_acquire) != g_log.tail + 1)
+        return NULL;
+    return e;
+}
+
+static void log_ring_release(struct log_entry *e)
+{
+    atomic_store_explicit(&e->seq, g_log.tail + LOG_RING_SIZE, memory_order_release);
+    g_log.tail++;
+}
+
+static void log_text(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void log_text(const char *fmt, ...)
+{
+    struct log_entry *e;
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    if (!g_log.async) {
+        vfprintf(stderr, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    e = log_ring_claim();
+    if (e) {
+        n = vsnprintf(e->u.text, sizeof(e->u.text), fmt, ap);
+        if (n >= (int)sizeof(e->u.text))
+            e->u.text[sizeof(e->u.text) - 2] = '\n';
+        e->kind = LOG_KIND_TEXT;
+        log_ring_commit(e);
+    }
+    va_end(ap);
+}
+
 static void signal_handler(int signo)
 {
     if (signo == SIGINT || signo == SIGTERM)
@@ -522,6 +1144,12 @@ static void print_usage(const char *prog)
             "  --offline-image <path>  One-shot offline infer on PPM(P6) image and exit\n"
             "  --offline-roi <x1,y1,x2,y2>  Optional plate ROI on offline image\n"
             "  --offline-detect-plate <0|1> Auto detect plate on offline image (default: 1)\n"
+            "  --offline-batch <dir|list>  Offline infer every *.ppm in a directory, or each line\n"
+            "                          \"<path> [frame_id] [x1,y1,x2,y2]\" of a manifest, and exit\n"
+            "  --offline-workers <n>   Batch worker threads, each with its own RKNN contexts (default: 0=CPU count, max %d)\n"
+            "  --replay <file>         Feed the live pipeline from a fpga_dma_test --record file instead of --device\n"
+            "  --replay-speed <x>      Replay pacing: 1=recorded timing, 2=twice as fast, 0=as fast as possible (default: 1)\n"
+            "  --replay-loop <0|1>     Restart the recording at its end instead of stopping (default: 0)\n"
             "  --connector-id <id>     Optional KMS connector id\n"
             "  --fps <num>             Target FPS (default: %d)\n"
             "  --pixel-order <mode>    bgr565|rgb565 (default: bgr565)\n"
@@ -530,6 +1158,34 @@ static void print_usage(const char *prog)
             "  --stats-interval <sec>  Stats print interval (default: %d)\n"
             "  --copy-buffers <num>    Copy ring size (default: %d)\n"
             "  --queue-depth <num>     appsrc max frame queue (default: %d)\n"
+            "  --dma-queue <num>       DMA ring buffers kept in flight via QBUF/DQBUF (0=blocking, default: %d)\n"
+            "  --dma-stream <0|1>      Free-running capture, driver overwrites stale frames (default: 0)\n"
+            "  --dma-userptr <0|1>     Blocking capture DMAs straight into the app buffer (default: 0);\n"
+            "                          one command only if the buffer maps to one IOVA range, else\n"
+            "                          ~900 serial 4 KB chunks per frame (well below ring fps)\n"
+            "  --fpga-tensor <0|1>     Detectors read the FPGA 640x640 letterboxed RGB888 tensor (needs --dma-queue, dma_tensor=1; default: 0)\n"
+            "  --pipeline <0|1>        Run capture/convert/push as separate threads (default: 0)\n"
+            "  --cpu-capture <n>       Pin capture stage to CPU n (-1: unpinned, default)\n"
+            "  --cpu-convert <n>       Pin convert+overlay stage to CPU n (-1: unpinned, default)\n"
+            "  --cpu-push <n>          Pin GStreamer push stage to CPU n (-1: unpinned, default)\n"
+            "  --cpu-infer <n>         Pin inference thread to CPU n (-1: unpinned, default)\n"
+            "  --infer-pipeline <0|1>  Overlap NPU detect of frame N+1 with post/OCR of frame N (default: 0)\n"
+            "  --cpu-post <n>          Pin inference post stage to CPU n (-1: unpinned, default)\n"
+            "  --veh-every <n>         Run the vehicle model every n-th inferred frame (default: 1)\n"
+            "  --npu-zero-copy <0|1>   Bind model I/O once with rknn_set_io_mem (default: 0)\n"
+            "  --int8-decode <0|1>     Decode detector heads from raw INT8 outputs (default: 0)\n"
+            "  --motion-gate <0|1>     Skip detection on frames without motion, reuse last boxes (default: 0)\n"
+            "  --motion-refresh <n>    With --motion-gate, detect at least every n frames (default: 30)\n"
+            "  --motion-tile-thr <v>   Changed-sample ratio that marks a 64x64 tile as moving (default: 0.02)\n"
+            "  --plate-cascade <0|1>   Detect plates on vehicle crops tiled at native scale (default: 0, needs --plate-only 0)\n"
+            "  --overlay-plane <id>    Draw results on a KMS overlay plane: -1 off, 0 auto, else plane id (default: -1)\n"
+            "  --prof <0|1>            Report per-stage p50/p95/p99 latency with [stats] (default: 0)\n"
+            "  --prof-trace <path>     Also write stage spans as Chrome trace JSON at exit (implies --prof 1)\n"
+            "  --log-level <l>         Diagnostic log level: err|warn|info|debug (default: info)\n"
+            "  --log-async <0|1>       Write logs, predictions and crop dumps from a background thread (default: 0)\n"
+            "  --pred-log-format <f>   --pred-log format: csv|bin (default: csv, bin -> pred_bin_to_csv.py)\n"
+            "  --pixconv <m>           Pixel conversion kernels: auto|scalar|neon (default: auto)\n"
+            "  --preproc <m>           Detect/OCR preprocessing: cpu|rga (default: cpu, rga needs HAVE_RGA build)\n"
             "  --min-car-conf <v>      Car confidence threshold (default: 0.35)\n"
             "  --min-plate-conf <v>    Plate confidence threshold (default: 0.45)\n"
             "  --plate-on-car-only <0|1>  Reserve switch (default: 0)\n"
@@ -556,13 +1212,15 @@ static void print_usage(const char *prog)
             "  --show-crop-box <0|1>   Overlay OCR crop box in red (default: 0)\n"
             "  --ocr-min-plate-h <n>   Skip OCR if plate box h < n (default: 24)\n"
             "  --ocr-min-sharpness <v> Skip OCR if Laplacian var < v (default: 20)\n"
+            "  --ocr-cache-ttl <n>     Reuse a converged track's text for up to n frames (default: 0, off)\n"
+            "  --ocr-cache-conf <v>    Min smoothed confidence for --ocr-cache-ttl reuse (default: 0.85)\n"
             "  --ocr-min-occ-ratio <v> Re-crop once if OCR width occupancy < v (default: 0)\n"
             "  --ocr-ctc-diag <0|1>    Print CTC decode diagnostics (default: 0)\n"
             "  --ocr-crop-dump-dir <p> Dump OCR crops+inputs to directory (default: off)\n"
             "  --ocr-crop-dump-max <n> Max dumped OCR samples (default: 20)\n"
             "  --help                  Show this help\n",
-            prog, DEFAULT_DEVICE, DEFAULT_DRM_CARD, DEFAULT_FPS, DEFAULT_TIMEOUT_MS,
-            DEFAULT_STATS_INTERVAL, DEFAULT_COPY_BUFFERS, DEFAULT_QUEUE_DEPTH);
+            prog, DEFAULT_DEVICE, DEFAULT_DRM_CARD, OFFLINE_MAX_WORKERS, DEFAULT_FPS, DEFAULT_TIMEOUT_MS,
+            DEFAULT_STATS_INTERVAL, DEFAULT_COPY_BUFFERS, DEFAULT_QUEUE_DEPTH, DEFAULT_DMA_QUEUE);
 }
 
 static int parse_options(int argc, char **argv, struct options *opt)
@@ -580,6 +1238,11 @@ static int parse_options(int argc, char **argv, struct options *opt)
         {"offline-image", required_argument, NULL, 36},
         {"offline-roi", required_argument, NULL, 37},
         {"offline-detect-plate", required_argument, NULL, 38},
+        {"offline-batch", required_argument, NULL, 78},
+        {"offline-workers", required_argument, NULL, 79},
+        {"replay", required_argument, NULL, 80},
+        {"replay-speed", required_argument, NULL, 81},
+        {"replay-loop", required_argument, NULL, 82},
         {"connector-id", required_argument, NULL, 9},
         {"fps", required_argument, NULL, 10},
         {"pixel-order", required_argument, NULL, 11},
@@ -588,6 +1251,34 @@ static int parse_options(int argc, char **argv, struct options *opt)
         {"stats-interval", required_argument, NULL, 14},
         {"copy-buffers", required_argument, NULL, 15},
         {"queue-depth", required_argument, NULL, 16},
+        {"dma-queue", required_argument, NULL, 51},
+        {"dma-stream", required_argument, NULL, 52},
+        {"dma-userptr", required_argument, NULL, 53},
+        {"fpga-tensor", required_argument, NULL, 83},
+        {"pipeline", required_argument, NULL, 54},
+        {"cpu-capture", required_argument, NULL, 55},
+        {"cpu-convert", required_argument, NULL, 56},
+        {"cpu-push", required_argument, NULL, 57},
+        {"cpu-infer", required_argument, NULL, 58},
+        {"pixconv", required_argument, NULL, 59},
+        {"preproc", required_argument, NULL, 60},
+        {"infer-pipeline", required_argument, NULL, 61},
+        {"cpu-post", required_argument, NULL, 62},
+        {"veh-every", required_argument, NULL, 63},
+        {"npu-zero-copy", required_argument, NULL, 64},
+        {"int8-decode", required_argument, NULL, 65},
+        {"ocr-cache-ttl", required_argument, NULL, 66},
+        {"ocr-cache-conf", required_argument, NULL, 67},
+        {"motion-gate", required_argument, NULL, 68},
+        {"motion-refresh", required_argument, NULL, 69},
+        {"motion-tile-thr", required_argument, NULL, 70},
+        {"plate-cascade", required_argument, NULL, 71},
+        {"overlay-plane", required_argument, NULL, 72},
+        {"prof", required_argument, NULL, 73},
+        {"prof-trace", required_argument, NULL, 74},
+        {"log-level", required_argument, NULL, 75},
+        {"log-async", required_argument, NULL, 76},
+        {"pred-log-format", required_argument, NULL, 77},
         {"min-car-conf", required_argument, NULL, 17},
         {"min-plate-conf", required_argument, NULL, 18},
         {"plate-on-car-only", required_argument, NULL, 19},
@@ -635,6 +1326,19 @@ static int parse_options(int argc, char **argv, struct options *opt)
     opt->stats_interval = DEFAULT_STATS_INTERVAL;
     opt->copy_buffers = DEFAULT_COPY_BUFFERS;
     opt->queue_depth = DEFAULT_QUEUE_DEPTH;
+    opt->dma_queue = DEFAULT_DMA_QUEUE;
+    opt->cpu_capture = -1;
+    opt->cpu_convert = -1;
+    opt->cpu_push = -1;
+    opt->cpu_infer = -1;
+    opt->cpu_post = -1;
+    opt->veh_every = 1;
+    opt->ocr_cache_conf = 0.85f;
+    opt->motion_refresh = 30;
+    opt->overlay_plane = -1;
+    opt->log_level = LOG_INFO;
+    opt->motion_tile_thr = 0.02f;
+    opt->pixconv = "auto";
     opt->min_car_conf = 0.35f;
     opt->min_plate_conf = 0.45f;
     opt->plate_on_car_only = 0;
@@ -666,6 +1370,7 @@ static int parse_options(int argc, char **argv, struct options *opt)
     opt->ocr_crop_dump_max = 20;
     opt->ocr_crop_dump_dir = NULL;
     opt->offline_detect_plate = 1;
+    opt->replay_speed = 1.0f;
 
     while ((c = getopt_long(argc, argv, "h", long_opts, NULL)) != -1) {
         switch (c) {
@@ -686,6 +1391,11 @@ static int parse_options(int argc, char **argv, struct options *opt)
         case 36: opt->offline_image_path = optarg; break;
         case 37: opt->offline_roi_arg = optarg; break;
         case 38: opt->offline_detect_plate = atoi(optarg) ? 1 : 0; break;
+        case 78: opt->offline_batch_path = optarg; break;
+        case 79: opt->offline_workers = atoi(optarg); break;
+        case 80: opt->replay_path = optarg; break;
+        case 81: opt->replay_speed = (float)atof(optarg); break;
+        case 82: opt->replay_loop = atoi(optarg) ? 1 : 0; break;
         case 9: opt->connector_id = atoi(optarg); break;
         case 10: opt->fps = atoi(optarg); break;
         case 11:
@@ -701,6 +1411,59 @@ static int parse_options(int argc, char **argv, struct options *opt)
         case 14: opt->stats_interval = atoi(optarg); break;
         case 15: opt->copy_buffers = atoi(optarg); break;
         case 16: opt->queue_depth = atoi(optarg); break;
+        case 51: opt->dma_queue = atoi(optarg); break;
+        case 52: opt->dma_stream = atoi(optarg) ? 1 : 0; break;
+        case 53: opt->dma_userptr = atoi(optarg) ? 1 : 0; break;
+        case 83: opt->fpga_tensor = atoi(optarg) ? 1 : 0; break;
+        case 54: opt->pipeline = atoi(optarg) ? 1 : 0; break;
+        case 55: opt->cpu_capture = atoi(optarg); break;
+        case 56: opt->cpu_convert = atoi(optarg); break;
+        case 57: opt->cpu_push = atoi(optarg); break;
+        case 58: opt->cpu_infer = atoi(optarg); break;
+        case 59: opt->pixconv = optarg; break;
+        case 60:
+            if (strcmp(optarg, "cpu") == 0)
+                opt->preproc_backend = PREPROC_CPU;
+            else if (strcmp(optarg, "rga") == 0)
+                opt->preproc_backend = PREPROC_RGA;
+            else
+                return -1;
+            break;
+        case 61: opt->infer_pipeline = atoi(optarg) ? 1 : 0; break;
+        case 62: opt->cpu_post = atoi(optarg); break;
+        case 63: opt->veh_every = atoi(optarg); break;
+        case 64: opt->npu_zero_copy = atoi(optarg) ? 1 : 0; break;
+        case 65: opt->int8_decode = atoi(optarg) ? 1 : 0; break;
+        case 66: opt->ocr_cache_ttl = atoi(optarg); break;
+        case 67: opt->ocr_cache_conf = (float)atof(optarg); break;
+        case 68: opt->motion_gate = atoi(optarg) ? 1 : 0; break;
+        case 69: opt->motion_refresh = atoi(optarg); break;
+        case 70: opt->motion_tile_thr = (float)atof(optarg); break;
+        case 71: opt->plate_cascade = atoi(optarg) ? 1 : 0; break;
+        case 72: opt->overlay_plane = atoi(optarg); break;
+        case 73: opt->prof = atoi(optarg) ? 1 : 0; break;
+        case 74: opt->prof_trace_path = optarg; break;
+        case 75:
+            if (strcmp(optarg, "err") == 0)
+                opt->log_level = LOG_ERR;
+            else if (strcmp(optarg, "warn") == 0)
+                opt->log_level = LOG_WARN;
+            else if (strcmp(optarg, "info") == 0)
+                opt->log_level = LOG_INFO;
+            else if (strcmp(optarg, "debug") == 0)
+                opt->log_level = LOG_DEBUG;
+            else
+                return -1;
+            break;
+        case 76: opt->log_async = atoi(optarg) ? 1 : 0; break;
+        case 77:
+            if (strcmp(optarg, "csv") == 0)
+                opt->pred_log_format = PRED_LOG_CSV;
+            else if (strcmp(optarg, "bin") == 0)
+                opt->pred_log_format = PRED_LOG_BIN;
+            else
+                return -1;
+            break;
         case 17: opt->min_car_conf = (float)atof(optarg); break;
         case 18: opt->min_plate_conf = (float)atof(optarg); break;
         case 19: opt->plate_on_car_only = atoi(optarg) ? 1 : 0; break;
@@ -804,6 +1567,24 @@ static int parse_options(int argc, char **argv, struct options *opt)
         return -1;
     if (opt->queue_depth <= 0)
         return -1;
+    if (opt->dma_queue < 0 || opt->dma_queue > (int)FPGA_DMA_MAX_RING_BUFFERS)
+        return -1;
+    if (pixconv_select(opt->pixconv) < 0)
+        return -1;
+#ifndef HAVE_RGA
+    if (opt->preproc_backend == PREPROC_RGA) {
+        fprintf(stderr, "[cfg] --preproc rga: built without HAVE_RGA\n");
+        return -1;
+    }
+#endif
+    if (opt->cpu_capture < -1 || opt->cpu_capture >= CPU_SETSIZE ||
+        opt->cpu_convert < -1 || opt->cpu_convert >= CPU_SETSIZE ||
+        opt->cpu_push < -1 || opt->cpu_push >= CPU_SETSIZE ||
+        opt->cpu_infer < -1 || opt->cpu_infer >= CPU_SETSIZE ||
+        opt->cpu_post < -1 || opt->cpu_post >= CPU_SETSIZE)
+        return -1;
+    if (opt->veh_every < 1 || opt->veh_every > 1000)
+        return -1;
     if (opt->a_proj_ratio <= 0.0f || opt->a_proj_ratio >= 1.0f)
         return -1;
     if (opt->a_roi_iou_min < 0.0f || opt->a_roi_iou_min > 1.0f)
@@ -826,9 +1607,29 @@ static int parse_options(int argc, char **argv, struct options *opt)
         return -1;
     if (opt->ocr_min_occ_ratio < 0.0f || opt->ocr_min_occ_ratio > 1.0f)
         return -1;
+    if (opt->ocr_cache_ttl < 0 || opt->ocr_cache_ttl > 1000)
+        return -1;
+    if (opt->ocr_cache_conf < 0.0f || opt->ocr_cache_conf > 1.0f)
+        return -1;
+    if (opt->motion_refresh < 1 || opt->motion_refresh > 10000)
+        return -1;
+    if (opt->motion_tile_thr <= 0.0f || opt->motion_tile_thr > 1.0f)
+        return -1;
+    if (opt->plate_cascade && opt->plate_only)
+        return -1;
     if (opt->ocr_crop_dump_max < 0 || opt->ocr_crop_dump_max > 100000)
         return -1;
-    if (opt->offline_image_path && opt->offline_image_path[0] != '\0') {
+    if (opt->offline_workers < 0 || opt->offline_workers > OFFLINE_MAX_WORKERS)
+        return -1;
+    if (opt->offline_image_path && opt->offline_image_path[0] != '\0' &&
+        opt->offline_batch_path && opt->offline_batch_path[0] != '\0')
+        return -1;
+    if (opt->replay_speed < 0.0f)
+        return -1;
+    if ((opt->offline_image_path && opt->offline_image_path[0] != '\0') ||
+        (opt->offline_batch_path && opt->offline_batch_path[0] != '\0')) {
+        if (opt->replay_path && opt->replay_path[0] != '\0')
+            return -1;
         if (!opt->plate_model_path || !opt->ocr_model_path || !opt->ocr_keys_path)
             return -1;
     } else {
@@ -839,31 +1640,15 @@ static int parse_options(int argc, char **argv, struct options *opt)
     return 0;
 }
 
-static void decode_pixel565(const struct options *opt, uint8_t lo_in, uint8_t hi_in,
-                            uint8_t *r8, uint8_t *g8, uint8_t *b8)
+/* Flags describing the live 16-bit source for the pixconv kernels. */
+static unsigned int pixconv_flags_565(const struct options *opt)
 {
-    uint8_t lo = lo_in;
-    uint8_t hi = hi_in;
-    uint16_t pix;
-    uint8_t r5, g6, b5;
-    if (opt->swap16) {
-        uint8_t t = lo;
-        lo = hi;
-        hi = t;
-    }
-    pix = (uint16_t)lo | ((uint16_t)hi << 8);
-    if (opt->pixel_order == PIXEL_ORDER_BGR565) {
-        r5 = pix & 0x1F;
-        g6 = (pix >> 5) & 0x3F;
-        b5 = (pix >> 11) & 0x1F;
-    } else {
-        r5 = (pix >> 11) & 0x1F;
-        g6 = (pix >> 5) & 0x3F;
-        b5 = pix & 0x1F;
-    }
-    *r8 = (uint8_t)((r5 << 3) | (r5 >> 2));
-    *g8 = (uint8_t)((g6 << 2) | (g6 >> 4));
-    *b8 = (uint8_t)((b5 << 3) | (b5 >> 2));
+    unsigned int flags = 0;
+    if (opt->swap16)
+        flags |= PIXCONV_565_SWAP16;
+    if (opt->pixel_order == PIXEL_ORDER_BGR565)
+        flags |= PIXCONV_565_RED_LOW;
+    return flags;
 }
 
 static int load_labels(struct app_ctx *ctx, const char *path)
@@ -938,56 +1723,285 @@ static int load_ocr_keys(struct app_ctx *ctx, const char *path)
     return 0;
 }
 
-static int rknn_ocr_model_load(struct ocr_model *m, const char *name, const char *path)
+static void rknn_io_free(rknn_context c, struct rknn_io *rio)
 {
-    FILE *fp;
-    long sz;
-    void *data;
     uint32_t i;
-    memset(m, 0, sizeof(*m));
-    m->name = name;
-    m->path = path;
 
-    fp = fopen(path, "rb");
-    if (!fp) return -1;
-    fseek(fp, 0, SEEK_END);
-    sz = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    data = malloc((size_t)sz);
-    if (!data) { fclose(fp); return -1; }
-    if (fread(data, 1, (size_t)sz, fp) != (size_t)sz) { fclose(fp); free(data); return -1; }
-    fclose(fp);
+    for (i = 0; i < RKNN_IO_MAX_OUTPUTS; i++) {
+        if (rio->out_mem[i]) {
+            /* Float outputs are read in place from the tensor memory. */
+            if (rio->out_f32[i] == (float *)rio->out_mem[i]->virt_addr)
+                rio->out_f32[i] = NULL;
+            rknn_destroy_mem(c, rio->out_mem[i]);
+        }
+        free(rio->out_f32[i]);
+        free(rio->out_q[i]);
+    }
+    if (rio->in_mem)
+        rknn_destroy_mem(c, rio->in_mem);
+    memset(rio, 0, sizeof(*rio));
+}
 
-    if (rknn_init(&m->ctx, data, (uint32_t)sz, 0, NULL) < 0) { free(data); return -1; }
-    free(data);
-    if (rknn_query(m->ctx, RKNN_QUERY_IN_OUT_NUM, &m->io_num, sizeof(m->io_num)) < 0)
-        return -1;
-    if (m->io_num.n_output == 0 || m->io_num.n_output > 4)
-        return -1;
+static bool rknn_io_out_bindable(const rknn_tensor_attr *a)
+{
+    return (a->type == RKNN_TENSOR_INT8 && a->qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC) ||
+           a->type == RKNN_TENSOR_FLOAT32;
+}
 
-    memset(&m->input_attr, 0, sizeof(m->input_attr));
-    m->input_attr.index = 0;
-    if (rknn_query(m->ctx, RKNN_QUERY_INPUT_ATTR, &m->input_attr, sizeof(m->input_attr)) < 0)
-        return -1;
-    if (m->input_attr.fmt == RKNN_TENSOR_NCHW) {
-        m->in_c = m->input_attr.dims[1];
-        m->in_h = m->input_attr.dims[2];
-        m->in_w = m->input_attr.dims[3];
-    } else {
-        m->in_h = m->input_attr.dims[1];
-        m->in_w = m->input_attr.dims[2];
-        m->in_c = m->input_attr.dims[3];
+/* 1 = bound, 0 = model not eligible (nothing bound), -1 = binding failed midway. */
+static int rknn_io_bind(rknn_context c, const char *name, uint32_t in_w, uint32_t in_h,
+                        const rknn_tensor_attr *out_attrs, struct rknn_io *rio)
+{
+    rknn_tensor_attr in_attr;
+    uint32_t i;
+
+    for (i = 0; i < rio->n_output; i++) {
+        if (!rknn_io_out_bindable(&out_attrs[i])) {
+            fprintf(stderr, "[%s] out[%u] type=%d not bindable, keeping rknn_outputs_get\n",
+                    name, i, out_attrs[i].type);
+            return 0;
+        }
     }
+    memset(&in_attr, 0, sizeof(in_attr));
+    in_attr.index = 0;
+    if (rknn_query(c, RKNN_QUERY_NATIVE_INPUT_ATTR, &in_attr, sizeof(in_attr)) < 0)
+        return 0;
+    in_attr.type = RKNN_TENSOR_UINT8;
+    in_attr.fmt = RKNN_TENSOR_NHWC;
+    rio->in_rows = in_h;
+    rio->in_row_bytes = (size_t)in_w * 3U;
+    rio->in_stride_bytes = (size_t)(in_attr.w_stride ? in_attr.w_stride : in_w) * 3U;
+    rio->in_mem = rknn_create_mem(c, in_attr.size_with_stride ? in_attr.size_with_stride
+                                                              : (uint32_t)(rio->in_stride_bytes * in_h));
+    if (!rio->in_mem || rknn_set_io_mem(c, rio->in_mem, &in_attr) < 0)
+        return -1;
 
-    for (i = 0; i < m->io_num.n_output; i++) {
+    for (i = 0; i < rio->n_output; i++) {
+        rknn_tensor_attr a = out_attrs[i];
+        size_t elem = (a.type == RKNN_TENSOR_INT8) ? 1U : sizeof(float);
+
+        rio->out_mem[i] = rknn_create_mem(c, (uint32_t)(a.n_elems * elem));
+        if (!rio->out_mem[i] || rknn_set_io_mem(c, rio->out_mem[i], &a) < 0)
+            return -1;
+        rio->out_attr[i] = a;
+        if (a.type == RKNN_TENSOR_FLOAT32) {
+            free(rio->out_f32[i]);
+            rio->out_f32[i] = (float *)rio->out_mem[i]->virt_addr;
+        }
+    }
+    return 1;
+}
+
+/* Allocate the persistent output buffers and, if asked and possible, bind zero-copy I/O. */
+static int rknn_io_init(rknn_context c, const char *name, const rknn_input_output_num *io_num,
+                        const rknn_tensor_attr *out_attrs, uint32_t in_w, uint32_t in_h,
+                        bool zero_copy, struct rknn_io *rio)
+{
+    uint32_t i;
+    int bound;
+
+    memset(rio, 0, sizeof(*rio));
+    if (io_num->n_output > RKNN_IO_MAX_OUTPUTS)
+        return -1;
+    rio->n_output = io_num->n_output;
+    rio->quant_ok = rio->n_output > 0;
+    for (i = 0; i < rio->n_output; i++) {
+        rio->out_elems[i] = out_attrs[i].n_elems;
+        rio->out_zp[i] = out_attrs[i].zp;
+        rio->out_scale[i] = out_attrs[i].scale;
+        if (out_attrs[i].type != RKNN_TENSOR_INT8 ||
+            out_attrs[i].qnt_type != RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC || out_attrs[i].scale <= 0.0f)
+            rio->quant_ok = false;
+        rio->out_f32[i] = malloc((size_t)rio->out_elems[i] * sizeof(float));
+        if (!rio->out_f32[i]) {
+            rknn_io_free(c, rio);
+            return -1;
+        }
+    }
+    if (!zero_copy) {
+        for (i = 0; rio->quant_ok && i < rio->n_output; i++) {
+            rio->out_q[i] = malloc(rio->out_elems[i]);
+            if (!rio->out_q[i]) {
+                rknn_io_free(c, rio);
+                return -1;
+            }
+        }
+        return 0;
+    }
+    bound = rknn_io_bind(c, name, in_w, in_h, out_attrs, rio);
+    if (bound == 0)
+        return 0;
+    if (bound < 0) {
+        /* A context with partially bound memory cannot go back to inputs_set. */
+        fprintf(stderr, "[%s] zero-copy I/O setup failed\n", name);
+        return -1;
+    }
+    rio->zero_copy = true;
+    fprintf(stderr, "[%s] zero-copy I/O: input stride=%zu row=%zu\n",
+            name, rio->in_stride_bytes, rio->in_row_bytes);
+    return 0;
+}
+
+/* Where preprocessing may write the model input directly, or NULL to pass a buffer to rknn_io_run. */
+static uint8_t *rknn_io_input(const struct rknn_io *rio)
+{
+    if (!rio->zero_copy || rio->in_stride_bytes != rio->in_row_bytes)
+        return NULL;
+    return (uint8_t *)rio->in_mem->virt_addr;
+}
+
+/*
+ * Feed @in (ignored when it already is the bound input memory), run, and
+ * point outs[i].buf at output data valid until the next run: float, or the
+ * raw INT8 tensors when @quantized (requires rio->quant_ok).
+ */
+static int rknn_io_run(rknn_context c, const struct rknn_io *rio,
+                       const void *in, uint32_t in_size, rknn_tensor_type in_type,
+                       rknn_tensor_format in_fmt, bool quantized, rknn_output *outs)
+{
+    uint32_t i;
+    int ret;
+
+    memset(outs, 0, sizeof(*outs) * rio->n_output);
+    if (!rio->zero_copy) {
+        rknn_input inp;
+
+        memset(&inp, 0, sizeof(inp));
+        inp.index = 0;
+        inp.buf = (void *)in;
+        inp.size = in_size;
+        inp.type = in_type;
+        inp.fmt = in_fmt;
+        ret = rknn_inputs_set(c, 1, &inp);
+        if (ret < 0)
+            return ret;
+        ret = rknn_run(c, NULL);
+        if (ret < 0)
+            return ret;
+        for (i = 0; i < rio->n_output; i++) {
+            outs[i].want_float = quantized ? 0 : 1;
+            outs[i].is_prealloc = 1;
+            outs[i].index = i;
+            if (quantized) {
+                outs[i].buf = rio->out_q[i];
+                outs[i].size = rio->out_elems[i];
+            } else {
+                outs[i].buf = rio->out_f32[i];
+                outs[i].size = rio->out_elems[i] * (uint32_t)sizeof(float);
+            }
+        }
+        return rknn_outputs_get(c, rio->n_output, outs, NULL);
+    }
+
+    if (in && in != rio->in_mem->virt_addr) {
+        uint8_t *dst = (uint8_t *)rio->in_mem->virt_addr;
+        const uint8_t *src = (const uint8_t *)in;
+        uint32_t y;
+
+        if (rio->in_stride_bytes == rio->in_row_bytes) {
+            memcpy(dst, src, rio->in_row_bytes * rio->in_rows);
+        } else {
+            for (y = 0; y < rio->in_rows; y++)
+                memcpy(dst + y * rio->in_stride_bytes, src + y * rio->in_row_bytes, rio->in_row_bytes);
+        }
+    }
+    rknn_mem_sync(c, rio->in_mem, RKNN_MEMORY_SYNC_TO_DEVICE);
+    ret = rknn_run(c, NULL);
+    if (ret < 0)
+        return ret;
+    for (i = 0; i < rio->n_output; i++) {
+        const rknn_tensor_attr *a = &rio->out_attr[i];
+
+        rknn_mem_sync(c, rio->out_mem[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+        outs[i].index = i;
+        if (quantized) {
+            outs[i].buf = rio->out_mem[i]->virt_addr;
+            outs[i].size = rio->out_elems[i];
+            continue;
+        }
+        if (a->type == RKNN_TENSOR_INT8) {
+            const int8_t *q = (const int8_t *)rio->out_mem[i]->virt_addr;
+            float *f = rio->out_f32[i];
+            uint32_t k;
+
+            for (k = 0; k < rio->out_elems[i]; k++)
+                f[k] = ((float)q[k] - (float)a->zp) * a->scale;
+        }
+        outs[i].buf = rio->out_f32[i];
+        outs[i].size = rio->out_elems[i] * (uint32_t)sizeof(float);
+    }
+    return 0;
+}
+
+/* Dequantize one INT8 output from a quantized run into its float buffer. */
+static const float *rknn_io_dequant(const struct rknn_io *rio, const rknn_output *outs, uint32_t i)
+{
+    const int8_t *q = (const int8_t *)outs[i].buf;
+    float *f = rio->out_f32[i];
+    uint32_t k;
+
+    for (k = 0; k < rio->out_elems[i]; k++)
+        f[k] = ((float)q[k] - (float)rio->out_zp[i]) * rio->out_scale[i];
+    return f;
+}
+
+static void rknn_io_outputs_done(rknn_context c, const struct rknn_io *rio, rknn_output *outs)
+{
+    if (!rio->zero_copy)
+        rknn_outputs_release(c, rio->n_output, outs);
+}
+
+static int rknn_ocr_model_load(struct ocr_model *m, const char *name, const char *path)
+{
+    FILE *fp;
+    long sz;
+    void *data;
+    uint32_t i;
+    memset(m, 0, sizeof(*m));
+    m->name = name;
+    m->path = path;
+
+    fp = fopen(path, "rb");
+    if (!fp) return -1;
+    fseek(fp, 0, SEEK_END);
+    sz = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = malloc((size_t)sz);
+    if (!data) { fclose(fp); return -1; }
+    if (fread(data, 1, (size_t)sz, fp) != (size_t)sz) { fclose(fp); free(data); return -1; }
+    fclose(fp);
+
+    if (rknn_init(&m->ctx, data, (uint32_t)sz, 0, NULL) < 0) { free(data); return -1; }
+    free(data);
+    if (rknn_query(m->ctx, RKNN_QUERY_IN_OUT_NUM, &m->io_num, sizeof(m->io_num)) < 0)
+        return -1;
+    if (m->io_num.n_output == 0 || m->io_num.n_output > 4)
+        return -1;
+
+    memset(&m->input_attr, 0, sizeof(m->input_attr));
+    m->input_attr.index = 0;
+    if (rknn_query(m->ctx, RKNN_QUERY_INPUT_ATTR, &m->input_attr, sizeof(m->input_attr)) < 0)
+        return -1;
+    if (m->input_attr.fmt == RKNN_TENSOR_NCHW) {
+        m->in_c = m->input_attr.dims[1];
+        m->in_h = m->input_attr.dims[2];
+        m->in_w = m->input_attr.dims[3];
+    } else {
+        m->in_h = m->input_attr.dims[1];
+        m->in_w = m->input_attr.dims[2];
+        m->in_c = m->input_attr.dims[3];
+    }
+    m->batch = (m->input_attr.n_dims == 4 && m->input_attr.dims[0] > 1) ? m->input_attr.dims[0] : 1U;
+
+    for (i = 0; i < m->io_num.n_output; i++) {
         memset(&m->output_attrs[i], 0, sizeof(m->output_attrs[i]));
         m->output_attrs[i].index = i;
         if (rknn_query(m->ctx, RKNN_QUERY_OUTPUT_ATTR, &m->output_attrs[i], sizeof(m->output_attrs[i])) < 0)
             return -1;
     }
 
-    fprintf(stderr, "[%s] loaded input=%ux%ux%u outputs=%u\n",
-            name, m->in_w, m->in_h, m->in_c, m->io_num.n_output);
+    fprintf(stderr, "[%s] loaded input=%ux%ux%u batch=%u outputs=%u\n",
+            name, m->in_w, m->in_h, m->in_c, m->batch, m->io_num.n_output);
     fprintf(stderr, "[%s] input_attr fmt=%d type=%d qnt=%d zp=%d scale=%.6f\n",
             name,
             m->input_attr.fmt,
@@ -1000,6 +2014,7 @@ static int rknn_ocr_model_load(struct ocr_model *m, const char *name, const char
 
 static void rknn_ocr_model_release(struct ocr_model *m)
 {
+    rknn_io_free(m->ctx, &m->io);
     if (m->ctx)
         rknn_destroy(m->ctx);
     memset(m, 0, sizeof(*m));
@@ -1076,11 +2091,44 @@ static int rknn_quad_refiner_model_load(struct quad_refiner_model *m, const char
 
 static void rknn_quad_refiner_model_release(struct quad_refiner_model *m)
 {
+    rknn_io_free(m->ctx, &m->io);
     if (m->ctx)
         rknn_destroy(m->ctx);
     memset(m, 0, sizeof(*m));
 }
 
+/* The quad refiner feeds normalised float input, so it only gets preallocated outputs. */
+static int init_npu_io(struct app_ctx *ctx)
+{
+    bool zc = ctx->opt.npu_zero_copy != 0;
+
+    if (ctx->veh_model.ctx &&
+        rknn_io_init(ctx->veh_model.ctx, "vehicle", &ctx->veh_model.io_num, ctx->veh_model.output_attrs,
+                     ctx->veh_model.in_w, ctx->veh_model.in_h, zc, &ctx->veh_model.io) < 0)
+        return -1;
+    if (ctx->plate_model.ctx &&
+        rknn_io_init(ctx->plate_model.ctx, "plate", &ctx->plate_model.io_num, ctx->plate_model.output_attrs,
+                     ctx->plate_model.in_w, ctx->plate_model.in_h, zc, &ctx->plate_model.io) < 0)
+        return -1;
+    if (ctx->ocr_model.ctx &&
+        rknn_io_init(ctx->ocr_model.ctx, "ocr", &ctx->ocr_model.io_num, ctx->ocr_model.output_attrs,
+                     ctx->ocr_model.in_w, ctx->ocr_model.in_h * ctx->ocr_model.batch, zc,
+                     &ctx->ocr_model.io) < 0)
+        return -1;
+    if (ctx->quad_refiner_model.ctx &&
+        rknn_io_init(ctx->quad_refiner_model.ctx, "quad_refiner", &ctx->quad_refiner_model.io_num,
+                     ctx->quad_refiner_model.output_attrs, ctx->quad_refiner_model.in_w,
+                     ctx->quad_refiner_model.in_h, false, &ctx->quad_refiner_model.io) < 0)
+        return -1;
+    /* Only models whose outputs are all affine INT8 can skip dequantization. */
+    ctx->veh_model.int8_decode = ctx->opt.int8_decode && ctx->veh_model.io.quant_ok;
+    ctx->plate_model.int8_decode = ctx->opt.int8_decode && ctx->plate_model.io.quant_ok;
+    if (ctx->opt.int8_decode)
+        fprintf(stderr, "[npu] int8 decode: vehicle=%d plate=%d\n",
+                ctx->veh_model.int8_decode, ctx->plate_model.int8_decode);
+    return 0;
+}
+
 static bool build_ocr_layout(const rknn_tensor_attr *a, int *t_size, int *c_size, int *t_stride, int *c_stride)
 {
     if (a->n_dims == 2) {
@@ -1598,42 +2646,248 @@ static void ocr_temporal_smooth(struct app_ctx *ctx, const struct det_box *box,
             float old_conf = *conf;
             copy_cstr_trunc(text, text_len, smooth);
             *conf = fmaxf(old_conf * 0.90f, smooth_conf);
-            fprintf(stderr,
+            lpr_log(LOG_INFO,
                     "[ocr-smooth] frame=%" PRIu64 " raw=(%.2f,%s) smooth=(%.2f,%s)\n",
                     frame_seq, old_conf, raw_text, *conf, text);
         }
     }
 }
 
-static uint8_t *prepare_ocr_input_rgb888(const struct app_ctx *ctx,
-                                         const uint8_t *crop_rgb, int crop_w, int crop_h,
-                                         float *occ_ratio_out)
+/* Existing track overlapping @box, or -1. */
+static int match_ocr_track(const struct app_ctx *ctx, const struct det_box *box)
+{
+    int i;
+    int best_idx = -1;
+    float best_iou = 0.25f;
+
+    for (i = 0; i < OCR_TRACK_MAX; i++) {
+        const struct ocr_track *tr = &ctx->ocr_tracks[i];
+        float iou;
+        if (!tr->used)
+            continue;
+        iou = box_iou(box, &tr->box);
+        if (iou >= best_iou) {
+            best_iou = iou;
+            best_idx = i;
+        }
+    }
+    return best_idx;
+}
+
+/*
+ * --ocr-cache-ttl: a track whose smoothed text repeated OCR_CACHE_MIN_HITS
+ * times at >= --ocr-cache-conf is not re-read until the TTL runs out or the
+ * box moves away from where it was last read.
+ */
+static bool ocr_cache_lookup(struct app_ctx *ctx, const struct det_box *box, uint64_t frame_seq,
+                             char *text, size_t text_len, float *conf)
+{
+    struct ocr_track *tr;
+    int idx;
+
+    if (ctx->opt.ocr_cache_ttl <= 0)
+        return false;
+    idx = match_ocr_track(ctx, box);
+    if (idx < 0)
+        return false;
+    tr = &ctx->ocr_tracks[idx];
+    if (tr->cache_hits < OCR_CACHE_MIN_HITS ||
+        tr->cache_conf < ctx->opt.ocr_cache_conf ||
+        frame_seq - tr->cache_seq > (uint64_t)ctx->opt.ocr_cache_ttl ||
+        box_iou(box, &tr->cache_box) < OCR_CACHE_MIN_IOU)
+        return false;
+
+    tr->ttl = 10;
+    tr->last_seq = frame_seq;
+    tr->box = *box;
+    copy_cstr_trunc(text, text_len, tr->cache_text);
+    *conf = tr->cache_conf;
+    return true;
+}
+
+static void ocr_cache_update(struct app_ctx *ctx, const struct det_box *box, uint64_t frame_seq,
+                             const char *text, float conf)
+{
+    struct ocr_track *tr;
+    int idx;
+
+    if (ctx->opt.ocr_cache_ttl <= 0)
+        return;
+    idx = match_ocr_track(ctx, box);
+    if (idx < 0)
+        return;
+    tr = &ctx->ocr_tracks[idx];
+    if (strcmp(tr->cache_text, text) == 0) {
+        tr->cache_hits++;
+    } else {
+        copy_cstr_trunc(tr->cache_text, sizeof(tr->cache_text), text);
+        tr->cache_hits = 1;
+    }
+    tr->cache_conf = conf;
+    tr->cache_box = *box;
+    tr->cache_seq = frame_seq;
+}
+
+/*
+ * Per-thread frame arena for inference scratch. frame_alloc() bumps from
+ * the arena bound to the calling thread. frame_free() marks a block freed
+ * and rewinds past every freed block on top, so alloc/free pairs inside a
+ * frame reuse the same bytes. frame_arena_reset() runs at the top of each
+ * frame. If the previous frame spilled to malloc, reset first grows the
+ * arena to that frame's demand. After warm-up, frames make no heap calls.
+ * With no arena bound, or once it is full, allocations come from malloc
+ * and frame_free() frees them.
+ */
+#define FRAME_ARENA_ALIGN 64
+#define FRAME_ARENA_GRANULE (64U * 1024U)
+
+struct frame_arena {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t top;                     /* header offset of the newest live block, SIZE_MAX if none */
+    size_t spilled;                 /* bytes that went to malloc this frame */
+    size_t demand;                  /* peak used + spilled over this frame */
+    uint64_t grows;
+};
+
+/* Sits in the FRAME_ARENA_ALIGN bytes in front of each block. */
+struct frame_block {
+    size_t prev;
+    bool freed;
+};
+
+static __thread struct frame_arena *g_frame_arena;
+
+static int frame_arena_init(struct frame_arena *a, size_t size)
+{
+    void *p = NULL;
+    memset(a, 0, sizeof(*a));
+    a->top = SIZE_MAX;
+    size = (size + FRAME_ARENA_GRANULE - 1U) / FRAME_ARENA_GRANULE * FRAME_ARENA_GRANULE;
+    if (size == 0U || posix_memalign(&p, FRAME_ARENA_ALIGN, size) != 0)
+        return -1;
+    a->base = (uint8_t *)p;
+    a->size = size;
+    return 0;
+}
+
+static void frame_arena_release(struct frame_arena *a)
+{
+    free(a->base);
+    memset(a, 0, sizeof(*a));
+    a->top = SIZE_MAX;
+}
+
+/* Start a frame; nothing allocated from @a may still be live. */
+static void frame_arena_reset(struct frame_arena *a)
+{
+    if (a->demand > a->size) {
+        size_t want = a->demand + a->demand / 4U;
+        uint64_t grows = a->grows + 1U;
+        frame_arena_release(a);
+        if (frame_arena_init(a, want) == 0)
+            fprintf(stderr, "[arena] grown to %zu KiB\n", a->size / 1024U);
+        a->grows = grows;
+    }
+    a->used = 0;
+    a->top = SIZE_MAX;
+    a->spilled = 0;
+    a->demand = 0;
+}
+
+static void *frame_alloc(size_t size)
+{
+    struct frame_arena *a = g_frame_arena;
+    size_t need = FRAME_ARENA_ALIGN + (size + FRAME_ARENA_ALIGN - 1U) / FRAME_ARENA_ALIGN * FRAME_ARENA_ALIGN;
+
+    if (!a)
+        return malloc(size);
+    if (a->base && need <= a->size - a->used) {
+        struct frame_block *h = (struct frame_block *)(a->base + a->used);
+        h->prev = a->top;
+        h->freed = false;
+        a->top = a->used;
+        a->used += need;
+        if (a->used + a->spilled > a->demand)
+            a->demand = a->used + a->spilled;
+        return a->base + a->top + FRAME_ARENA_ALIGN;
+    }
+    a->spilled += need;
+    if (a->used + a->spilled > a->demand)
+        a->demand = a->used + a->spilled;
+    return malloc(size);
+}
+
+static void *frame_calloc(size_t n, size_t size)
+{
+    void *p = frame_alloc(n * size);
+    if (p)
+        memset(p, 0, n * size);
+    return p;
+}
+
+static void frame_free(void *p)
+{
+    struct frame_arena *a = g_frame_arena;
+    uint8_t *b = (uint8_t *)p;
+
+    if (!p)
+        return;
+    if (!a || !a->base || b < a->base || b >= a->base + a->size) {
+        free(p);
+        return;
+    }
+    ((struct frame_block *)(b - FRAME_ARENA_ALIGN))->freed = true;
+    while (a->top != SIZE_MAX) {
+        struct frame_block *t = (struct frame_block *)(a->base + a->top);
+        if (!t->freed)
+            break;
+        a->used = a->top;
+        a->top = t->prev;
+    }
+}
+
+/* Startup arena size from the frame and model input dims; reset grows it past this. */
+static size_t frame_arena_estimate(const struct app_ctx *ctx)
+{
+    size_t pixels = (size_t)ctx->frame_width * ctx->frame_height;
+    size_t ocr_slot = (size_t)ctx->ocr_model.in_w * ctx->ocr_model.in_h * 3U;
+    size_t est = pixels * 3U;                               /* sw_preprocess_rgb888 planes */
+
+    est += ((size_t)ctx->ocr_model.batch + 1U) * ocr_slot;  /* unpooled OCR input + dump copy */
+    est += (size_t)ctx->quad_refiner_model.in_w * ctx->quad_refiner_model.in_h * 3U * sizeof(float);
+    est += (size_t)(ctx->frame_width + ctx->frame_height) * sizeof(int);
+    return est + est / 4U;
+}
+
+/* Build the OCR model input into @ocr_in (in_w x in_h RGB888). */
+static bool prepare_ocr_input_into(const struct app_ctx *ctx,
+                                   const uint8_t *crop_rgb, int crop_w, int crop_h,
+                                   uint8_t *ocr_in, float *occ_ratio_out)
 {
     const struct ocr_model *m = &ctx->ocr_model;
     uint8_t *crop_work = NULL;
-    uint8_t *ocr_in = NULL;
     struct letterbox_meta lb;
     float occ = 1.0f;
 
     if (occ_ratio_out)
         *occ_ratio_out = 0.0f;
 
-    crop_work = malloc((size_t)crop_w * crop_h * 3U);
-    ocr_in = malloc((size_t)m->in_w * m->in_h * 3U);
-    if (!crop_work || !ocr_in) {
-        free(crop_work);
-        free(ocr_in);
-        return NULL;
-    }
+    crop_work = frame_alloc((size_t)crop_w * crop_h * 3U);
+    if (!crop_work)
+        return false;
 
     memcpy(crop_work, crop_rgb, (size_t)crop_w * crop_h * 3U);
     ocr_preprocess_rgb888(crop_work, crop_w, crop_h, ctx->opt.ocr_preproc_mode);
 
     if (ctx->opt.ocr_resize_mode == OCR_RESIZE_LETTERBOX) {
         memset(&lb, 0, sizeof(lb));
-        resize_rgb888_letterbox_kernel(crop_work, crop_w, crop_h, ocr_in,
-                                       (int)m->in_w, (int)m->in_h, 0U,
-                                       ctx->opt.ocr_resize_kernel, &lb);
+        if (!preproc_rga_letterbox(ctx, crop_work, crop_w, crop_h, ocr_in,
+                                   (int)m->in_w, (int)m->in_h, 0U, &lb))
+            resize_rgb888_letterbox_kernel(crop_work, crop_w, crop_h, ocr_in,
+                                           (int)m->in_w, (int)m->in_h, 0U,
+                                           ctx->opt.ocr_resize_kernel, &lb);
         if (lb.valid && m->in_w > 0) {
             int scaled_w = (int)((float)crop_w * lb.scale + 0.5f);
             if (scaled_w < 1) scaled_w = 1;
@@ -1643,8 +2897,10 @@ static uint8_t *prepare_ocr_input_rgb888(const struct app_ctx *ctx,
             occ = 0.0f;
         }
     } else {
-        resize_rgb888_with_kernel(crop_work, crop_w, crop_h, ocr_in, (int)m->in_w, (int)m->in_h,
-                                  ctx->opt.ocr_resize_kernel);
+        if (!preproc_rga_resize(ctx, crop_work, crop_w, crop_h, ocr_in, (int)m->in_w, (int)m->in_h,
+                                0, 0, (int)m->in_w, (int)m->in_h))
+            resize_rgb888_with_kernel(crop_work, crop_w, crop_h, ocr_in, (int)m->in_w, (int)m->in_h,
+                                      ctx->opt.ocr_resize_kernel);
         occ = 1.0f;
     }
     if (occ_ratio_out)
@@ -1661,60 +2917,41 @@ static uint8_t *prepare_ocr_input_rgb888(const struct app_ctx *ctx,
         }
     }
 
-    free(crop_work);
+    frame_free(crop_work);
+    return true;
+}
+
+static uint8_t *prepare_ocr_input_rgb888(const struct app_ctx *ctx,
+                                         const uint8_t *crop_rgb, int crop_w, int crop_h,
+                                         float *occ_ratio_out)
+{
+    const struct ocr_model *m = &ctx->ocr_model;
+    uint8_t *ocr_in = frame_alloc((size_t)m->in_w * m->in_h * 3U);
+
+    if (!ocr_in)
+        return NULL;
+    if (!prepare_ocr_input_into(ctx, crop_rgb, crop_w, crop_h, ocr_in, occ_ratio_out)) {
+        frame_free(ocr_in);
+        return NULL;
+    }
     return ocr_in;
 }
 
-static int run_model_ocr(struct app_ctx *ctx, const uint8_t *crop_rgb, int crop_w, int crop_h,
-                         char *text, size_t text_len, float *conf_out,
-                         struct ocr_diag *diag, uint8_t **model_input_out)
+/* CTC-decode batch slot @slot of one OCR run. */
+static int decode_ocr_slot(struct app_ctx *ctx, const rknn_output *outs, uint32_t slot,
+                           char *text, size_t text_len, float *conf_out, struct ocr_diag *diag)
 {
     struct ocr_model *m = &ctx->ocr_model;
-    rknn_input in;
-    rknn_output outs[4];
-    uint8_t *ocr_in = NULL;
     const rknn_tensor_attr *out_attr;
     uint32_t decode_output_idx = 0;
     int t_size, c_size, t_stride, c_stride;
-    int ret = -1;
-    uint32_t i;
-    float occ_ratio = 0.0f;
-
-    if (diag)
-        memset(diag, 0, sizeof(*diag));
-
-    ocr_in = prepare_ocr_input_rgb888(ctx, crop_rgb, crop_w, crop_h, &occ_ratio);
-    if (!ocr_in) {
-        return -1;
-    }
-
-    memset(&in, 0, sizeof(in));
-    in.index = 0;
-    in.buf = (void *)ocr_in;
-    in.size = m->in_w * m->in_h * 3;
-    in.type = RKNN_TENSOR_UINT8;
-    in.fmt = RKNN_TENSOR_NHWC;
-    ret = rknn_inputs_set(m->ctx, 1, &in);
-    if (ret < 0)
-        goto out;
-    ret = rknn_run(m->ctx, NULL);
-    if (ret < 0)
-        goto out;
-
-    memset(outs, 0, sizeof(outs));
-    for (i = 0; i < m->io_num.n_output; i++)
-        outs[i].want_float = 1;
-    ret = rknn_outputs_get(m->ctx, m->io_num.n_output, outs, NULL);
-    if (ret < 0)
-        goto out;
+    size_t slot_elems;
 
     if (m->io_num.n_output >= 2)
         decode_output_idx = 1; /* 临时 green8 测试模式：多头时优先取 green8 head */
     out_attr = &m->output_attrs[decode_output_idx];
-    if (!build_ocr_layout(out_attr, &t_size, &c_size, &t_stride, &c_stride)) {
-        ret = -1;
-        goto out_release;
-    }
+    if (!build_ocr_layout(out_attr, &t_size, &c_size, &t_stride, &c_stride))
+        return -1;
     if (ctx->ocr_blank_index < 0 || ctx->ocr_blank_index >= c_size) {
         if (c_size == ctx->ocr_key_count + 1)
             ctx->ocr_blank_index = ctx->ocr_key_count;
@@ -1734,59 +2971,135 @@ static int run_model_ocr(struct app_ctx *ctx, const uint8_t *crop_rgb, int crop_
                 (m->io_num.n_output >= 2) ? " (temporary green8 head test mode)" : "");
         ctx->ocr_keysize_warned = true;
     }
-    ret = ctc_decode_logits((const float *)outs[decode_output_idx].buf, t_size, c_size, t_stride, c_stride,
-                            ctx, text, text_len, conf_out, diag);
-    if (diag)
-        diag->in_occ_ratio = occ_ratio;
-    fprintf(stderr, "[ocrin] resize_mode=%s kernel=%s in_occ_ratio=%.3f\n",
-            (ctx->opt.ocr_resize_mode == OCR_RESIZE_LETTERBOX) ? "letterbox" : "stretch",
-            (ctx->opt.ocr_resize_kernel == OCR_KERNEL_BILINEAR) ? "bilinear" : "nn",
-            occ_ratio);
-
-out_release:
-    rknn_outputs_release(m->ctx, m->io_num.n_output, outs);
-out:
-    if (model_input_out && ret == 0) {
-        *model_input_out = malloc((size_t)m->in_w * m->in_h * 3U);
-        if (*model_input_out)
-            memcpy(*model_input_out, ocr_in, (size_t)m->in_w * m->in_h * 3U);
-    }
-    free(ocr_in);
-    return ret;
+    slot_elems = (size_t)out_attr->n_elems / m->batch;
+    return ctc_decode_logits((const float *)outs[decode_output_idx].buf + slot * slot_elems,
+                             t_size, c_size, t_stride, c_stride,
+                             ctx, text, text_len, conf_out, diag);
 }
 
-static int init_fpga_dma(struct app_ctx *ctx)
+/*
+ * OCR @n model inputs packed back to back in @in, with room for @n rounded up
+ * to the model batch. A batch-N model takes N plates per rknn_run, so a busy
+ * frame costs ceil(n / N) NPU invocations. Each slot gets its own ret.
+ */
+static void run_model_ocr_batch(struct app_ctx *ctx, const uint8_t *in, int n, struct ocr_slot *slots)
 {
-    struct fpga_info info;
-    struct buffer_map map;
-    uint32_t inferred_format;
+    struct ocr_model *m = &ctx->ocr_model;
+    size_t slot_bytes = (size_t)m->in_w * m->in_h * 3U;
+    int batch = (int)m->batch;
+    int base;
 
-    ctx->dev_fd = open(ctx->opt.device_path, O_RDWR | O_CLOEXEC);
-    if (ctx->dev_fd < 0)
-        return -1;
-    if (ioctl(ctx->dev_fd, FPGA_DMA_GET_INFO, &info) < 0)
-        return -1;
-    if (info.frame_width != 1280 || info.frame_height != 720)
+    for (base = 0; base < n; base += batch) {
+        rknn_output outs[4];
+        int k;
+        int ret = rknn_io_run(m->ctx, &m->io, in + (size_t)base * slot_bytes,
+                              (uint32_t)(slot_bytes * (size_t)batch), RKNN_TENSOR_UINT8,
+                              RKNN_TENSOR_NHWC, false, outs);
+
+        for (k = 0; k < batch && base + k < n; k++) {
+            struct ocr_slot *os = &slots[base + k];
+
+            memset(&os->diag, 0, sizeof(os->diag));
+            os->ret = ret;
+            if (ret < 0)
+                continue;
+            os->ret = decode_ocr_slot(ctx, outs, (uint32_t)k, os->text, sizeof(os->text),
+                                      &os->conf, &os->diag);
+            os->diag.in_occ_ratio = os->occ_ratio;
+            lpr_log(LOG_DEBUG, "[ocrin] resize_mode=%s kernel=%s in_occ_ratio=%.3f\n",
+                    (ctx->opt.ocr_resize_mode == OCR_RESIZE_LETTERBOX) ? "letterbox" : "stretch",
+                    (ctx->opt.ocr_resize_kernel == OCR_KERNEL_BILINEAR) ? "bilinear" : "nn",
+                    os->occ_ratio);
+        }
+        if (ret >= 0)
+            rknn_io_outputs_done(m->ctx, &m->io, outs);
+    }
+}
+
+static int run_model_ocr(struct app_ctx *ctx, const uint8_t *crop_rgb, int crop_w, int crop_h,
+                         char *text, size_t text_len, float *conf_out,
+                         struct ocr_diag *diag, uint8_t **model_input_out)
+{
+    struct ocr_model *m = &ctx->ocr_model;
+    size_t slot_bytes = (size_t)m->in_w * m->in_h * 3U;
+    uint8_t *ocr_in = (m->batch == 1) ? rknn_io_input(&m->io) : NULL;
+    bool own_in = false;
+    struct ocr_slot os;
+
+    if (diag)
+        memset(diag, 0, sizeof(*diag));
+
+    memset(&os, 0, sizeof(os));
+    if (!ocr_in) {
+        /* Batched models still take a full batch; the unused slots stay zero. */
+        ocr_in = frame_calloc(m->batch, slot_bytes);
+        if (!ocr_in)
+            return -1;
+        own_in = true;
+    }
+    if (!prepare_ocr_input_into(ctx, crop_rgb, crop_w, crop_h, ocr_in, &os.occ_ratio)) {
+        os.ret = -1;
+        goto out;
+    }
+
+    run_model_ocr_batch(ctx, ocr_in, 1, &os);
+    if (os.ret == 0) {
+        copy_cstr_trunc(text, text_len, os.text);
+        *conf_out = os.conf;
+        if (diag)
+            *diag = os.diag;
+    }
+
+out:
+    if (model_input_out && os.ret == 0) {
+        *model_input_out = frame_alloc(slot_bytes);
+        if (*model_input_out)
+            memcpy(*model_input_out, ocr_in, slot_bytes);
+    }
+    if (own_in)
+        frame_free(ocr_in);
+    return os.ret;
+}
+
+static uint8_t *alloc_capture_buffer(const struct app_ctx *ctx)
+{
+    if (ctx->opt.dma_userptr && !ctx->async_dma) {
+        /* USERPTR targets must be cache-line aligned; page alignment covers it. */
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        void *p = NULL;
+        if (posix_memalign(&p, page, (ctx->src_frame_size + page - 1) & ~(page - 1)) != 0)
+            return NULL;
+        return (uint8_t *)p;
+    }
+    return malloc(ctx->src_frame_size);
+}
+
+/* Source geometry from the driver (or a recording's header); returns -1 if unsupported. */
+static int set_capture_format(struct app_ctx *ctx, struct fpga_info *info)
+{
+    uint32_t inferred_format;
+
+    if (info->frame_width != 1280 || info->frame_height != 720)
         return -1;
 
-    inferred_format = info.pixel_format;
+    inferred_format = info->pixel_format;
 
     if (inferred_format != FPGA_PIXEL_FORMAT_BGR565 &&
         inferred_format != FPGA_PIXEL_FORMAT_BGRX8888) {
-        if (info.frame_bpp == 4)
+        if (info->frame_bpp == 4)
             inferred_format = FPGA_PIXEL_FORMAT_BGRX8888;
         else
             inferred_format = FPGA_PIXEL_FORMAT_BGR565;
     }
     if (inferred_format == FPGA_PIXEL_FORMAT_BGRX8888)
-        info.frame_bpp = 4;
+        info->frame_bpp = 4;
     else
-        info.frame_bpp = 2;
+        info->frame_bpp = 2;
 
-    ctx->frame_width = info.frame_width;
-    ctx->frame_height = info.frame_height;
-    ctx->src_frame_bpp = info.frame_bpp;
-    ctx->src_is_bgrx = (inferred_format == FPGA_PIXEL_FORMAT_BGRX8888) || (info.frame_bpp == 4);
+    ctx->frame_width = info->frame_width;
+    ctx->frame_height = info->frame_height;
+    ctx->src_frame_bpp = info->frame_bpp;
+    ctx->src_is_bgrx = (inferred_format == FPGA_PIXEL_FORMAT_BGRX8888) || (info->frame_bpp == 4);
     ctx->src_frame_size = (size_t)ctx->frame_width * ctx->frame_height * ctx->src_frame_bpp;
     /* Internal pipeline keeps BGR565 for overlay and drawing. */
     ctx->frame_bpp = 2;
@@ -1794,35 +3107,479 @@ static int init_fpga_dma(struct app_ctx *ctx)
 
     if (ctx->src_is_bgrx)
         ctx->opt.swap16 = false;
+    return 0;
+}
+
+/*
+ * --fpga-tensor: map the tensor slot paired with each ring slot. Anything the
+ * FPGA letterbox cannot stand in for keeps the CPU path with a warning.
+ */
+static void init_fpga_tensor(struct app_ctx *ctx)
+{
+    struct letterbox_meta *lb = &ctx->tensor_lb;
+    struct fpga_tensor_info info;
+    struct buffer_map map;
+    int i;
+
+    if (!ctx->opt.fpga_tensor)
+        return;
+    memset(&info, 0, sizeof(info));
+    if (ioctl(ctx->dev_fd, FPGA_DMA_GET_TENSOR_INFO, &info) < 0 ||
+        info.count < (uint32_t)ctx->dma_map_count ||
+        info.width != ALGO_STREAM_SIZE || info.height != ALGO_STREAM_SIZE ||
+        info.format != FPGA_PIXEL_FORMAT_RGB888) {
+        fprintf(stderr, "[dma] no %dx%d tensor channel (load the driver with dma_tensor=1), "
+                "using the CPU letterbox\n", ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
+        return;
+    }
+    if (ctx->opt.sw_preproc || ctx->opt.det_resize_mode != DET_RESIZE_LETTERBOX) {
+        fprintf(stderr, "[dma] fpga-tensor only replaces the plain letterbox "
+                "(sw-preproc 0, det-resize letterbox), using the CPU path\n");
+        return;
+    }
+    for (i = 0; i < ctx->dma_map_count; i++) {
+        void *mapped;
+
+        memset(&map, 0, sizeof(map));
+        map.index = FPGA_DMA_TENSOR_INDEX_BASE + (uint32_t)i;
+        if (ioctl(ctx->dev_fd, FPGA_DMA_MAP_BUFFER, &map) < 0 ||
+            map.size < (size_t)info.stride * info.height)
+            break;
+        mapped = mmap(NULL, map.size, PROT_READ, MAP_SHARED, ctx->dev_fd, (off_t)map.offset);
+        if (mapped == MAP_FAILED)
+            break;
+        ctx->tensor_maps[i] = mapped;
+        ctx->tensor_map_size = map.size;
+    }
+    if (i < ctx->dma_map_count) {
+        fprintf(stderr, "[dma] tensor slot %d map failed: %s, using the CPU letterbox\n",
+                i, strerror(errno));
+        while (--i >= 0) {
+            munmap(ctx->tensor_maps[i], ctx->tensor_map_size);
+            ctx->tensor_maps[i] = NULL;
+        }
+        return;
+    }
+
+    memset(lb, 0, sizeof(*lb));
+    lb->scale = (float)info.scale_q16 / 65536.0f;
+    lb->pad_x = (int)info.pad_x;
+    lb->pad_y = (int)info.pad_y;
+    lb->src_w = (int)ctx->frame_width;
+    lb->src_h = (int)ctx->frame_height;
+    lb->dst_w = ALGO_STREAM_SIZE;
+    lb->dst_h = ALGO_STREAM_SIZE;
+    lb->valid = true;
+    ctx->fpga_tensor = true;
+}
+
+static int init_fpga_dma(struct app_ctx *ctx)
+{
+    struct fpga_info info;
+    struct buffer_map map;
+    int map_count;
+    int i;
+
+    ctx->dev_fd = open(ctx->opt.device_path, O_RDWR | O_CLOEXEC);
+    if (ctx->dev_fd < 0)
+        return -1;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_GET_INFO, &info) < 0)
+        return -1;
+    if (set_capture_format(ctx, &info) < 0)
+        return -1;
+
+    ctx->async_dma = ctx->opt.dma_queue > 0;
+    map_count = ctx->async_dma ? ctx->opt.dma_queue : 1;
+    for (i = 0; i < map_count; i++) {
+        void *mapped;
+
+        memset(&map, 0, sizeof(map));
+        map.index = (uint32_t)i;
+        if (ioctl(ctx->dev_fd, FPGA_DMA_MAP_BUFFER, &map) < 0) {
+            /* Driver may have allocated fewer ring buffers than requested. */
+            if (i > 0 && errno == EINVAL)
+                break;
+            return -1;
+        }
+        if (map.size < ctx->src_frame_size)
+            return -1;
+        ctx->dma_map_size = map.size;
+        mapped = mmap(NULL, ctx->dma_map_size, PROT_READ, MAP_SHARED, ctx->dev_fd, (off_t)map.offset);
+        if (mapped == MAP_FAILED)
+            return -1;
+        ctx->dma_maps[i] = mapped;
+        ctx->dma_map_count++;
+    }
+    if (ctx->async_dma && ctx->dma_map_count < map_count)
+        fprintf(stderr, "[dma] only %d ring buffers available, dma-queue=%d\n",
+                ctx->dma_map_count, map_count);
+
+    if (ctx->async_dma) {
+        for (i = 0; i < ctx->dma_map_count; i++)
+            ctx->frames[i].data = (uint8_t *)ctx->dma_maps[i];
+        ctx->frame_count = ctx->dma_map_count;
+        init_fpga_tensor(ctx);
+        return 0;
+    }
+    for (i = 0; i < HEAP_FRAME_BUFFERS; i++) {
+        ctx->frames[i].data = alloc_capture_buffer(ctx);
+        if (!ctx->frames[i].data)
+            return -1;
+        ctx->frame_count++;
+    }
+    return 0;
+}
+
+/*
+ * --replay: map the recording and run capture on heap frames, exactly like
+ * the READ_FRAME path; trigger_frame_dma() copies the next recorded slot in
+ * where the driver would have. A frame_count of 0 (recorder interrupted
+ * before writing the header's count) is recovered from the file size.
+ */
+static int init_replay(struct app_ctx *ctx)
+{
+    const struct frame_record_header *h;
+    struct replay_src *r = &ctx->replay;
+    struct fpga_info info;
+    struct stat st;
+    uint64_t avail;
+    void *p;
+    int fd;
+    int i;
+
+    fd = open(ctx->opt.replay_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[replay] %s: %s\n", ctx->opt.replay_path, strerror(errno));
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < FRAME_RECORD_ALIGN) {
+        fprintf(stderr, "[replay] %s: too short for a recording\n", ctx->opt.replay_path);
+        close(fd);
+        return -1;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "[replay] mmap failed: %s\n", strerror(errno));
+        return -1;
+    }
+    r->map = (uint8_t *)p;
+    r->map_size = (size_t)st.st_size;
+    madvise(r->map, r->map_size, MADV_SEQUENTIAL);
 
-    memset(&map, 0, sizeof(map));
-    map.index = 0;
-    if (ioctl(ctx->dev_fd, FPGA_DMA_MAP_BUFFER, &map) < 0)
+    h = (const struct frame_record_header *)r->map;
+    r->hdr = h;
+    if (h->magic != FRAME_RECORD_MAGIC || h->version != FRAME_RECORD_VERSION ||
+        h->data_offset < sizeof(*h) || h->slot_bytes < h->frame_bytes + FRAME_RECORD_ENTRY_BYTES) {
+        fprintf(stderr, "[replay] %s: not a FRAW v%u recording\n", ctx->opt.replay_path,
+                FRAME_RECORD_VERSION);
+        return -1;
+    }
+    avail = h->data_offset < r->map_size ? (r->map_size - h->data_offset) / h->slot_bytes : 0;
+    r->count = h->frame_count;
+    if (r->count == 0) {
+        /* Unfinished: slots are written in order, preallocated ones read as zero. */
+        while (r->count < avail && frame_record_entry_at(r->map, h, r->count)->size != 0)
+            r->count++;
+    } else if (r->count > avail) {
+        r->count = avail;
+    }
+    if (r->count == 0) {
+        fprintf(stderr, "[replay] %s: no frames\n", ctx->opt.replay_path);
         return -1;
-    if (map.size < ctx->src_frame_size)
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.frame_width = h->width;
+    info.frame_height = h->height;
+    info.frame_bpp = h->bpp;
+    info.pixel_format = h->pixel_format;
+    if (set_capture_format(ctx, &info) < 0 || h->frame_bytes < ctx->src_frame_size) {
+        fprintf(stderr, "[replay] unsupported recording %ux%u bpp=%u fmt=%u\n",
+                h->width, h->height, h->bpp, h->pixel_format);
         return -1;
-    ctx->dma_map_size = map.size;
-    ctx->dma_map = mmap(NULL, ctx->dma_map_size, PROT_READ, MAP_SHARED, ctx->dev_fd, 0);
-    if (ctx->dma_map == MAP_FAILED) {
-        ctx->dma_map = NULL;
+    }
+
+    ctx->async_dma = false;
+    for (i = 0; i < HEAP_FRAME_BUFFERS; i++) {
+        ctx->frames[i].data = alloc_capture_buffer(ctx);
+        if (!ctx->frames[i].data)
+            return -1;
+        ctx->frame_count++;
+    }
+    fprintf(stderr, "[replay] %s: %" PRIu64 " frames %ux%u %s%s\n",
+            ctx->opt.replay_path, r->count, h->width, h->height,
+            ctx->src_is_bgrx ? "bgrx8888" : "bgr565",
+            h->frame_count == 0 ? " (unfinished recording)" : "");
+    return 0;
+}
+
+/*
+ * Copy the next recorded frame into heap frame @idx. With replay_speed > 0
+ * it waits until the frame is due relative to the first one of the pass.
+ * Returns -1 at the end of a non-looping recording.
+ */
+static int replay_next_frame(struct app_ctx *ctx, int idx)
+{
+    struct replay_src *r = &ctx->replay;
+    const struct frame_record_entry *e;
+    int64_t due_us;
+    int64_t now_us;
+
+    if (r->next >= r->count) {
+        if (!ctx->opt.replay_loop) {
+            fprintf(stderr, "[replay] end of recording after %" PRIu64 " frames\n", r->count);
+            return -1;
+        }
+        r->next = 0;
+        r->passes++;
+    }
+    e = frame_record_entry_at(r->map, r->hdr, r->next);
+    if (r->next == 0) {
+        r->ts0_ns = e->timestamp_ns;
+        r->wall0_us = mono_us();
+    }
+    if (ctx->opt.replay_speed > 0.0f && e->timestamp_ns > r->ts0_ns) {
+        due_us = r->wall0_us +
+                 (int64_t)((double)(e->timestamp_ns - r->ts0_ns) / 1000.0 / ctx->opt.replay_speed);
+        now_us = mono_us();
+        if (due_us > now_us)
+            usleep((useconds_t)(due_us - now_us));
+    }
+    memcpy(ctx->frames[idx].data, frame_record_payload(r->map, r->hdr, r->next), ctx->src_frame_size);
+    atomic_store_explicit(&ctx->dma_dropped, e->driver_dropped, memory_order_relaxed);
+    /* Latency is measured from when the frame "lands" now, not from the recording. */
+    ctx->last_dma_ts_ns = (uint64_t)mono_us() * 1000ULL;
+    r->next++;
+    return 0;
+}
+
+static int queue_dma_buffer(struct app_ctx *ctx, uint32_t buf_index)
+{
+    struct dma_buffer_req req;
+    memset(&req, 0, sizeof(req));
+    req.index = buf_index;
+    req.size = (uint32_t)ctx->src_frame_size;
+    if (ctx->fpga_tensor)
+        req.flags |= FPGA_DMA_BUF_FLAG_TENSOR;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_QBUF, &req) < 0) {
+        fprintf(stderr, "[dma] QBUF[%u] failed: %s\n", buf_index, strerror(errno));
         return -1;
     }
+    ctx->dma_queued++;
+    return 0;
+}
+
+static int queue_all_dma_buffers(struct app_ctx *ctx)
+{
+    int i;
+    for (i = 0; i < ctx->dma_map_count; i++) {
+        if (queue_dma_buffer(ctx, (uint32_t)i) < 0)
+            return -1;
+    }
+    return 0;
+}
 
-    ctx->dma_copy = malloc(ctx->src_frame_size);
-    if (!ctx->dma_copy)
+static int start_dma_streaming(struct app_ctx *ctx)
+{
+    if (ioctl(ctx->dev_fd, FPGA_DMA_STREAMON) < 0) {
+        fprintf(stderr, "[dma] STREAMON failed: %s\n", strerror(errno));
         return -1;
+    }
     return 0;
 }
 
+/* Pin the calling thread to one core (cpu < 0 leaves it floating) and name it for top/perf. */
+static void pin_current_thread(const char *name, int cpu)
+{
+    cpu_set_t set;
+    int err;
+
+    pthread_setname_np(pthread_self(), name);
+    prof_thread_id(name);
+    if (cpu < 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+        fprintf(stderr, "[cpu] pin %s to cpu%d failed: %s\n", name, cpu, strerror(err));
+}
+
+/* Hand over the completion timestamp of the frame just captured (0 if unknown). */
+static uint64_t take_dma_timestamp(struct app_ctx *ctx)
+{
+    uint64_t ts_ns = ctx->last_dma_ts_ns;
+    ctx->last_dma_ts_ns = 0;
+    return ts_ns;
+}
+
+/* Capture-to-push latency, measured from the driver's completion timestamp. */
+static void account_capture_latency(struct app_ctx *ctx, uint64_t dma_ts_ns)
+{
+    int64_t now_ns;
+    if (dma_ts_ns == 0)
+        return;
+    now_ns = mono_us() * 1000LL;
+    if (now_ns > (int64_t)dma_ts_ns) {
+        atomic_fetch_add_explicit(&ctx->total_capture_lat_us,
+                                  (uint64_t)(now_ns - (int64_t)dma_ts_ns) / 1000ULL, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ctx->capture_lat_samples, 1, memory_order_relaxed);
+    }
+}
+
+static void frame_ref(struct app_ctx *ctx, int idx)
+{
+    g_mutex_lock(&ctx->frame_lock);
+    ctx->frames[idx].refs++;
+    g_mutex_unlock(&ctx->frame_lock);
+}
+
+static void frame_unref_locked(struct app_ctx *ctx, int idx)
+{
+    if (--ctx->frames[idx].refs > 0)
+        return;
+    /* Nobody reads the slot any more: give it back to the FPGA. */
+    if (ctx->async_dma && queue_dma_buffer(ctx, (uint32_t)idx) < 0)
+        ctx->running = false;
+    g_cond_broadcast(&ctx->frame_cond);
+}
+
+static void frame_unref(struct app_ctx *ctx, int idx)
+{
+    g_mutex_lock(&ctx->frame_lock);
+    frame_unref_locked(ctx, idx);
+    g_mutex_unlock(&ctx->frame_lock);
+}
+
+/*
+ * Infer may pin at most frame_count - 2 frames (mailbox plus the one it is
+ * converting), leaving one for display and one for capture to fill.
+ * Replacing an untaken mailbox frame reuses its budget.
+ */
+static bool frame_lend_to_infer(struct app_ctx *ctx, int idx, bool replacing)
+{
+    int limit = ctx->frame_count - 2;
+    bool lent = false;
+    if (limit < 1)
+        limit = 1;
+    g_mutex_lock(&ctx->frame_lock);
+    if (replacing || ctx->frame_infer_held < limit) {
+        ctx->frames[idx].refs++;
+        if (!replacing)
+            ctx->frame_infer_held++;
+        lent = true;
+    }
+    g_mutex_unlock(&ctx->frame_lock);
+    return lent;
+}
+
+static void frame_infer_done(struct app_ctx *ctx, int idx)
+{
+    g_mutex_lock(&ctx->frame_lock);
+    ctx->frame_infer_held--;
+    frame_unref_locked(ctx, idx);
+    g_mutex_unlock(&ctx->frame_lock);
+}
+
+/*
+ * Wait until capture has a frame to work with: a queued ring slot for DQBUF
+ * (the driver refuses DQBUF with nothing queued) or an unreferenced heap
+ * buffer. Returns the heap index, 0 for the ring, or -1 on timeout/stop.
+ */
+static int wait_capture_frame(struct app_ctx *ctx)
+{
+    int64_t deadline_us = mono_us() + (int64_t)ctx->opt.timeout_ms * 1000LL;
+    int ret = -1;
+
+    g_mutex_lock(&ctx->frame_lock);
+    while (ctx->running) {
+        int64_t wake_us;
+        int i;
+
+        if (ctx->async_dma) {
+            if (ctx->dma_queued > 0) {
+                ret = 0;
+                break;
+            }
+        } else {
+            for (i = 0; i < ctx->frame_count; i++) {
+                if (ctx->frames[i].refs == 0)
+                    break;
+            }
+            if (i < ctx->frame_count) {
+                ctx->frames[i].refs = 1;
+                ret = i;
+                break;
+            }
+        }
+        if (mono_us() >= deadline_us)
+            break;
+        wake_us = mono_us() + 20000;
+        if (wake_us > deadline_us)
+            wake_us = deadline_us;
+        g_cond_wait_until(&ctx->frame_cond, &ctx->frame_lock, wake_us);
+    }
+    g_mutex_unlock(&ctx->frame_lock);
+    return ret;
+}
+
+/*
+ * Async capture: take the oldest landed ring buffer and read it in place.
+ * The slot is requeued once display and infer have dropped their references,
+ * so the FPGA keeps filling the others meanwhile.
+ */
+static int dequeue_frame_dma(struct app_ctx *ctx)
+{
+    struct dma_buffer_req req;
+    memset(&req, 0, sizeof(req));
+    if (ioctl(ctx->dev_fd, FPGA_DMA_DQBUF, &req) < 0) {
+        fprintf(stderr, "[dma] DQBUF failed: %s\n", strerror(errno));
+        return -1;
+    }
+    g_mutex_lock(&ctx->frame_lock);
+    ctx->dma_queued--;
+    g_mutex_unlock(&ctx->frame_lock);
+    if (req.index >= (uint32_t)ctx->dma_map_count)
+        return -1;
+    atomic_store_explicit(&ctx->dma_dropped, req.dropped, memory_order_relaxed);
+    ctx->last_dma_ts_ns = req.timestamp_ns;
+    if (req.result != 0) {
+        fprintf(stderr, "[dma] slot %u result error: %d\n", req.index, req.result);
+        return -1;
+    }
+    ctx->frame_tensor[req.index] = (req.flags & FPGA_DMA_BUF_FLAG_TENSOR) != 0;
+    frame_ref(ctx, (int)req.index);
+    return (int)req.index;
+}
+
+/* Capture one frame; returns its index in ctx->frames holding one reference. */
 static int trigger_frame_dma(struct app_ctx *ctx)
 {
     struct dma_transfer t;
+    int idx = wait_capture_frame(ctx);
+    if (idx < 0)
+        return -1;
+    if (ctx->async_dma)
+        return dequeue_frame_dma(ctx);
+    if (ctx->replay.map) {
+        if (replay_next_frame(ctx, idx) < 0) {
+            frame_unref(ctx, idx);
+            return -1;
+        }
+        return idx;
+    }
     memset(&t, 0, sizeof(t));
     t.size = (uint32_t)ctx->src_frame_size;
-    t.user_buf = (uint64_t)(uintptr_t)ctx->dma_copy;
-    if (ioctl(ctx->dev_fd, FPGA_DMA_READ_FRAME, &t) < 0)
+    t.user_buf = (uint64_t)(uintptr_t)ctx->frames[idx].data;
+    /* Userptr: the FPGA writes the frame buffer itself instead of a kernel copy_to_user. */
+    if (ctx->opt.dma_userptr)
+        t.flags = FPGA_DMA_XFER_FLAG_USERPTR;
+    if (ioctl(ctx->dev_fd, FPGA_DMA_READ_FRAME, &t) < 0 || t.result != 0) {
+        frame_unref(ctx, idx);
         return -1;
-    return t.result == 0 ? 0 : -1;
+    }
+    return idx;
 }
 
 static int init_copy_slots(struct app_ctx *ctx)
@@ -1842,25 +3599,11 @@ static int init_copy_slots(struct app_ctx *ctx)
 
 static void copy_frame_to_slot565(struct app_ctx *ctx, uint8_t *dst, const uint8_t *src)
 {
-    size_t i;
     size_t pixels = (size_t)ctx->frame_width * ctx->frame_height;
 
     if (ctx->src_is_bgrx) {
-        for (i = 0; i < pixels; i++) {
-            const uint8_t *p = src + i * 4U;
-            uint8_t b = p[0];
-            uint8_t g = p[1];
-            uint8_t r = p[2];
-            uint16_t pix565;
-
-            if (ctx->opt.pixel_order == PIXEL_ORDER_BGR565)
-                pix565 = (uint16_t)(((b >> 3) << 11) | ((g >> 2) << 5) | (r >> 3));
-            else
-                pix565 = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
-
-            dst[i * 2U + 0] = (uint8_t)(pix565 & 0xFF);
-            dst[i * 2U + 1] = (uint8_t)(pix565 >> 8);
-        }
+        pixconv_bgrx_to_565(src, dst, pixels,
+                            (ctx->opt.pixel_order == PIXEL_ORDER_BGR565) ? PIXCONV_565_RED_LOW : 0U);
         return;
     }
 
@@ -1868,10 +3611,7 @@ static void copy_frame_to_slot565(struct app_ctx *ctx, uint8_t *dst, const uint8
         memcpy(dst, src, ctx->frame_size);
         return;
     }
-    for (i = 0; i + 1 < ctx->frame_size; i += 2) {
-        dst[i] = src[i + 1];
-        dst[i + 1] = src[i];
-    }
+    pixconv_swap16(src, dst, pixels);
 }
 
 static void draw_hline_565(uint16_t *pix, int w, int h, int x1, int x2, int y, uint16_t c)
@@ -1958,6 +3698,19 @@ static uint8_t glyph5x7(char ch, int row)
     }
 }
 
+/* glyph5x7 rows for every byte value, filled once at startup */
+static uint8_t g_glyph_atlas[256][7];
+
+static void glyph_atlas_init(void)
+{
+    int ch;
+    int row;
+    for (ch = 0; ch < 256; ch++) {
+        for (row = 0; row < 7; row++)
+            g_glyph_atlas[ch][row] = glyph5x7((char)ch, row);
+    }
+}
+
 static void draw_text_565(uint16_t *pix, int w, int h, int x, int y, const char *s, uint16_t c, int scale)
 {
     int i;
@@ -1970,7 +3723,7 @@ static void draw_text_565(uint16_t *pix, int w, int h, int x, int y, const char
         int col;
         int ox = x + i * advance;
         for (row = 0; row < 7; row++) {
-            uint8_t bits = glyph5x7(s[i], row);
+            uint8_t bits = g_glyph_atlas[(unsigned char)s[i]][row];
             for (col = 0; col < 5; col++) {
                 if (bits & (1U << (4 - col))) {
                     int sy;
@@ -1993,6 +3746,64 @@ static void draw_text_565(uint16_t *pix, int w, int h, int x, int y, const char
     }
 }
 
+/* ARGB8888 overlay layer drawing: clipped rectangle fills, glyph rows as spans */
+static void fill_rect_argb(uint32_t *pix, int stride, int w, int h,
+                           int x1, int y1, int x2, int y2, uint32_t c)
+{
+    int x;
+    int y;
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 >= w) x2 = w - 1;
+    if (y2 >= h) y2 = h - 1;
+    for (y = y1; y <= y2; y++) {
+        uint32_t *row = pix + (size_t)y * (size_t)stride;
+        for (x = x1; x <= x2; x++)
+            row[x] = c;
+    }
+}
+
+static void draw_rect_argb(uint32_t *pix, int stride, int w, int h, const struct det_box *b, uint32_t c)
+{
+    int x1 = b->x1 < b->x2 ? b->x1 : b->x2;
+    int x2 = b->x1 < b->x2 ? b->x2 : b->x1;
+    int y1 = b->y1 < b->y2 ? b->y1 : b->y2;
+    int y2 = b->y1 < b->y2 ? b->y2 : b->y1;
+    fill_rect_argb(pix, stride, w, h, x1, y1, x2, y1 + 1, c);
+    fill_rect_argb(pix, stride, w, h, x1, y2 - 1, x2, y2, c);
+    fill_rect_argb(pix, stride, w, h, x1, y1, x1 + 1, y2, c);
+    fill_rect_argb(pix, stride, w, h, x2 - 1, y1, x2, y2, c);
+}
+
+static void draw_text_argb(uint32_t *pix, int stride, int w, int h, int x, int y,
+                           const char *s, uint32_t c, int scale)
+{
+    int i;
+    if (!s || scale < 1)
+        return;
+    for (i = 0; s[i] != '\0'; i++) {
+        const uint8_t *rows = g_glyph_atlas[(unsigned char)s[i]];
+        int ox = x + i * 6 * scale;
+        int row;
+        for (row = 0; row < 7; row++) {
+            int py = y + row * scale;
+            int col = 0;
+            while (col < 5) {
+                int end;
+                if (!(rows[row] & (1U << (4 - col)))) {
+                    col++;
+                    continue;
+                }
+                for (end = col; end + 1 < 5 && (rows[row] & (1U << (3 - end))); end++)
+                    ;
+                fill_rect_argb(pix, stride, w, h, ox + col * scale, py,
+                               ox + (end + 1) * scale - 1, py + scale - 1, c);
+                col = end + 1;
+            }
+        }
+    }
+}
+
 static void release_slot_ticket(struct app_ctx *ctx, const struct slot_ticket *ticket, bool count_release)
 {
     g_mutex_lock(&ctx->slots_lock);
@@ -2001,7 +3812,7 @@ static void release_slot_ticket(struct app_ctx *ctx, const struct slot_ticket *t
         ctx->slots[ticket->idx].generation == ticket->generation) {
         ctx->slots[ticket->idx].in_use = false;
         if (count_release)
-            ctx->released_frames++;
+            atomic_fetch_add_explicit(&ctx->released_frames, 1, memory_order_relaxed);
         g_cond_signal(&ctx->slots_cond);
     }
     g_mutex_unlock(&ctx->slots_lock);
@@ -2181,62 +3992,28 @@ static float sigmoidf_local(float x)
     return 1.0f / (1.0f + expf(-x));
 }
 
-struct point2f {
-    float x;
-    float y;
-};
-
-static float box_iou(const struct det_box *a, const struct det_box *b)
-{
-    int x1 = a->x1 > b->x1 ? a->x1 : b->x1;
-    int y1 = a->y1 > b->y1 ? a->y1 : b->y1;
-    int x2 = a->x2 < b->x2 ? a->x2 : b->x2;
-    int y2 = a->y2 < b->y2 ? a->y2 : b->y2;
-    int iw = x2 - x1 + 1;
-    int ih = y2 - y1 + 1;
-    int ia;
-    int ua;
-    if (iw <= 0 || ih <= 0)
-        return 0.0f;
-    ia = iw * ih;
-    ua = (a->x2 - a->x1 + 1) * (a->y2 - a->y1 + 1) +
-         (b->x2 - b->x1 + 1) * (b->y2 - b->y1 + 1) - ia;
-    if (ua <= 0)
-        return 0.0f;
-    return (float)ia / (float)ua;
-}
-
-static int det_conf_cmp(const void *pa, const void *pb)
+/*
+ * Lowest INT8 logit whose sigmoid can still reach @prob. Rounded down, so an
+ * integer compare only rejects values the float check would reject too;
+ * survivors are still checked in float after dequantization.
+ */
+static int quant_logit_floor(float prob, int32_t zp, float scale)
 {
-    const struct det_box *a = pa;
-    const struct det_box *b = pb;
-    if (a->conf < b->conf) return 1;
-    if (a->conf > b->conf) return -1;
-    return 0;
+    float logit;
+    float q;
+
+    if (prob <= 1e-6f)
+        return -128;
+    if (prob >= 1.0f - 1e-6f)
+        return 127;
+    logit = logf(prob / (1.0f - prob));
+    q = floorf(logit / scale + (float)zp);
+    if (q < -128.0f) return -128;
+    if (q > 127.0f) return 127;
+    return (int)q;
 }
 
-static void nms_inplace(struct det_box *dets, int *count, float iou_thr)
-{
-    bool removed[MAX_DETS];
-    int i;
-    int j;
-    int out = 0;
-    memset(removed, 0, sizeof(removed));
-    qsort(dets, (size_t)(*count), sizeof(dets[0]), det_conf_cmp);
-    for (i = 0; i < *count; i++) {
-        if (removed[i]) continue;
-        dets[out++] = dets[i];
-        for (j = i + 1; j < *count; j++) {
-            if (removed[j] || dets[i].cls != dets[j].cls)
-                continue;
-            if (box_iou(&dets[i], &dets[j]) > iou_thr)
-                removed[j] = true;
-        }
-    }
-    *count = out;
-}
-
-static void det_quad_from_obb(struct det_box *d)
+static void det_quad_from_obb(struct det_box *d)
 {
     float c = cosf(d->angle);
     float s = sinf(d->angle);
@@ -2270,168 +4047,6 @@ static void det_quad_from_obb(struct det_box *d)
     d->has_obb = 1;
 }
 
-static float polygon_area_signed(const struct point2f *pts, int n)
-{
-    float acc = 0.0f;
-    int i;
-    for (i = 0; i < n; i++) {
-        const struct point2f *a = &pts[i];
-        const struct point2f *b = &pts[(i + 1) % n];
-        acc += a->x * b->y - b->x * a->y;
-    }
-    return 0.5f * acc;
-}
-
-static float polygon_area_abs(const struct point2f *pts, int n)
-{
-    float a = polygon_area_signed(pts, n);
-    return (a >= 0.0f) ? a : -a;
-}
-
-static bool clip_inside(const struct point2f *p, const struct point2f *a,
-                        const struct point2f *b, float orient_sign)
-{
-    float cross = (b->x - a->x) * (p->y - a->y) - (b->y - a->y) * (p->x - a->x);
-    if (orient_sign >= 0.0f)
-        return cross >= -1e-6f;
-    return cross <= 1e-6f;
-}
-
-static struct point2f line_intersection(const struct point2f *s, const struct point2f *e,
-                                        const struct point2f *a, const struct point2f *b)
-{
-    struct point2f out = *e;
-    float x1 = s->x, y1 = s->y;
-    float x2 = e->x, y2 = e->y;
-    float x3 = a->x, y3 = a->y;
-    float x4 = b->x, y4 = b->y;
-    float den = (x1 - x2) * (y3 - y4) - (y1 - y2) * (x3 - x4);
-    if (fabsf(den) < 1e-8f)
-        return out;
-    out.x = ((x1 * y2 - y1 * x2) * (x3 - x4) - (x1 - x2) * (x3 * y4 - y3 * x4)) / den;
-    out.y = ((x1 * y2 - y1 * x2) * (y3 - y4) - (y1 - y2) * (x3 * y4 - y3 * x4)) / den;
-    return out;
-}
-
-static int convex_clip_polygon(const struct point2f *subject, int subject_n,
-                               const struct point2f *clip, int clip_n,
-                               struct point2f *out, int out_cap)
-{
-    struct point2f in_buf[16];
-    struct point2f out_buf[16];
-    int in_n = subject_n;
-    int i;
-    if (subject_n <= 0 || clip_n <= 0 || out_cap <= 0)
-        return 0;
-    if (subject_n > 16 || clip_n > 16)
-        return 0;
-    memcpy(in_buf, subject, (size_t)subject_n * sizeof(subject[0]));
-    for (i = 0; i < clip_n; i++) {
-        struct point2f a = clip[i];
-        struct point2f b = clip[(i + 1) % clip_n];
-        float orient = polygon_area_signed(clip, clip_n);
-        int j;
-        int out_n = 0;
-        if (in_n <= 0)
-            return 0;
-        for (j = 0; j < in_n; j++) {
-            struct point2f cur = in_buf[j];
-            struct point2f prev = in_buf[(j + in_n - 1) % in_n];
-            bool cur_in = clip_inside(&cur, &a, &b, orient);
-            bool prev_in = clip_inside(&prev, &a, &b, orient);
-            if (cur_in) {
-                if (!prev_in && out_n < 16)
-                    out_buf[out_n++] = line_intersection(&prev, &cur, &a, &b);
-                if (out_n < 16)
-                    out_buf[out_n++] = cur;
-            } else if (prev_in) {
-                if (out_n < 16)
-                    out_buf[out_n++] = line_intersection(&prev, &cur, &a, &b);
-            }
-        }
-        memcpy(in_buf, out_buf, (size_t)out_n * sizeof(out_buf[0]));
-        in_n = out_n;
-    }
-    if (in_n > out_cap)
-        in_n = out_cap;
-    memcpy(out, in_buf, (size_t)in_n * sizeof(out[0]));
-    return in_n;
-}
-
-static void det_to_quad_points(const struct det_box *d, struct point2f q[4])
-{
-    if (d->has_obb) {
-        int i;
-        for (i = 0; i < 4; i++) {
-            q[i].x = d->quad[i * 2 + 0];
-            q[i].y = d->quad[i * 2 + 1];
-        }
-        return;
-    }
-    q[0].x = (float)d->x1; q[0].y = (float)d->y1;
-    q[1].x = (float)d->x2; q[1].y = (float)d->y1;
-    q[2].x = (float)d->x2; q[2].y = (float)d->y2;
-    q[3].x = (float)d->x1; q[3].y = (float)d->y2;
-}
-
-static float rotated_iou(const struct det_box *a, const struct det_box *b)
-{
-    struct point2f qa[4];
-    struct point2f qb[4];
-    struct point2f inter[16];
-    float area_a;
-    float area_b;
-    float inter_area;
-    float denom;
-    int inter_n;
-    if (box_iou(a, b) <= 0.0f)
-        return 0.0f;
-    det_to_quad_points(a, qa);
-    det_to_quad_points(b, qb);
-    area_a = polygon_area_abs(qa, 4);
-    area_b = polygon_area_abs(qb, 4);
-    if (area_a <= 1e-6f || area_b <= 1e-6f)
-        return 0.0f;
-    inter_n = convex_clip_polygon(qa, 4, qb, 4, inter, 16);
-    if (inter_n <= 2)
-        return 0.0f;
-    inter_area = polygon_area_abs(inter, inter_n);
-    if (inter_area <= 1e-6f)
-        return 0.0f;
-    denom = area_a + area_b - inter_area;
-    if (denom <= 1e-6f)
-        return 0.0f;
-    return inter_area / denom;
-}
-
-static void rotated_nms_inplace(struct det_box *dets, int *count, float iou_thr, int max_det)
-{
-    bool removed[MAX_DETS * 4];
-    int n = *count;
-    int i;
-    int j;
-    int out = 0;
-    if (max_det <= 0 || max_det > MAX_DETS)
-        max_det = MAX_DETS;
-    if (n < 0)
-        n = 0;
-    if (n > (int)(sizeof(removed) / sizeof(removed[0])))
-        n = (int)(sizeof(removed) / sizeof(removed[0]));
-    memset(removed, 0, sizeof(removed));
-    qsort(dets, (size_t)n, sizeof(dets[0]), det_conf_cmp);
-    for (i = 0; i < n && out < max_det; i++) {
-        if (removed[i]) continue;
-        dets[out++] = dets[i];
-        for (j = i + 1; j < n; j++) {
-            if (removed[j] || dets[i].cls != dets[j].cls)
-                continue;
-            if (rotated_iou(&dets[i], &dets[j]) > iou_thr)
-                removed[j] = true;
-        }
-    }
-    *count = out;
-}
-
 static const char *tensor_fmt_name(rknn_tensor_format fmt)
 {
     switch (fmt) {
@@ -2480,6 +4095,8 @@ static int rknn_model_load(struct yolo_model *m, const char *name, const char *p
     void *data;
     uint32_t i;
     memset(m, 0, sizeof(*m));
+    pthread_mutex_init(&m->run_lock, NULL);
+    m->run_lock_ready = true;
     m->name = name;
     m->path = path;
     m->class_count = class_count;
@@ -2538,20 +4155,134 @@ static int rknn_model_load(struct yolo_model *m, const char *name, const char *p
 
 static void rknn_model_release(struct yolo_model *m)
 {
+    rknn_io_free(m->ctx, &m->io);
     if (m->ctx)
         rknn_destroy(m->ctx);
+    if (m->run_lock_ready)
+        pthread_mutex_destroy(&m->run_lock);
     memset(m, 0, sizeof(*m));
 }
 
-static void resize_rgb888_nn(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh)
+/*
+ * Resize kernels take a destination row stride (in pixels) so the letterbox
+ * variants scale straight into the padded canvas. Bilinear is a two-pass
+ * fixed-point resampler: per-axis source index / weight tables are built once
+ * per (src, dst) size and cached per thread, rows are filtered horizontally
+ * once and blended vertically. Output matches the float reference within 1 LSB.
+ */
+#define RESIZE_FIX_BITS     11
+#define RESIZE_FIX_ONE      (1 << RESIZE_FIX_BITS)
+#define RESIZE_AXIS_CACHE   4
+
+struct resize_axis {
+    int src;
+    int dst;
+    int cap;
+    int *i0;
+    int *i1;
+    int *w1;        /* weight of i1 in RESIZE_FIX_ONE units */
+};
+
+struct resize_scratch {
+    struct resize_axis x[RESIZE_AXIS_CACHE];
+    struct resize_axis y[RESIZE_AXIS_CACHE];
+    unsigned int x_next;
+    unsigned int y_next;
+    int *nn_x;
+    int nn_src;
+    int nn_dst;
+    int nn_cap;
+    uint32_t *rows[2];
+    int row_cap;
+};
+
+static __thread struct resize_scratch g_resize;
+
+static bool resize_axis_build(struct resize_axis *a, int src, int dst)
+{
+    int i;
+
+    if (dst > a->cap) {
+        int *buf = realloc(a->i0, (size_t)dst * 3U * sizeof(int));
+        if (!buf)
+            return false;
+        a->i0 = buf;
+        a->cap = dst;
+    }
+    a->i1 = a->i0 + a->cap;
+    a->w1 = a->i0 + 2 * a->cap;
+    for (i = 0; i < dst; i++) {
+        float f = ((float)i + 0.5f) * (float)src / (float)dst - 0.5f;
+        int p0 = (int)floorf(f);
+        float w;
+
+        if (p0 < 0) p0 = 0;
+        if (p0 > src - 1) p0 = src - 1;
+        w = f - (float)p0;
+        if (w < 0.0f) w = 0.0f;
+        if (w > 1.0f) w = 1.0f;
+        a->i0[i] = p0;
+        a->i1[i] = (p0 + 1 > src - 1) ? src - 1 : p0 + 1;
+        a->w1[i] = (int)(w * (float)RESIZE_FIX_ONE + 0.5f);
+    }
+    return true;
+}
+
+static const struct resize_axis *resize_axis_get(struct resize_axis *cache, unsigned int *next,
+                                                 int src, int dst)
+{
+    struct resize_axis *a;
+    int k;
+
+    for (k = 0; k < RESIZE_AXIS_CACHE; k++) {
+        if (cache[k].src == src && cache[k].dst == dst)
+            return &cache[k];
+    }
+    a = &cache[*next % RESIZE_AXIS_CACHE];
+    (*next)++;
+    a->src = 0;
+    a->dst = 0;
+    if (!resize_axis_build(a, src, dst))
+        return NULL;
+    a->src = src;
+    a->dst = dst;
+    return a;
+}
+
+static const int *resize_nn_x_table(int sw, int dw)
+{
+    struct resize_scratch *s = &g_resize;
+    int x;
+
+    if (s->nn_x && s->nn_src == sw && s->nn_dst == dw)
+        return s->nn_x;
+    if (dw > s->nn_cap) {
+        int *buf = realloc(s->nn_x, (size_t)dw * sizeof(int));
+        if (!buf)
+            return NULL;
+        s->nn_x = buf;
+        s->nn_cap = dw;
+    }
+    for (x = 0; x < dw; x++)
+        s->nn_x[x] = ((x * sw) / dw) * 3;
+    s->nn_src = sw;
+    s->nn_dst = dw;
+    return s->nn_x;
+}
+
+static void resize_rgb888_nn_into(const uint8_t *src, int sw, int sh,
+                                  uint8_t *dst, int dst_stride, int dw, int dh)
 {
+    const int *xt = resize_nn_x_table(sw, dw);
     int x, y;
+
+    if (!xt)
+        return;
     for (y = 0; y < dh; y++) {
-        int sy = (y * sh) / dh;
-        for (x = 0; x < dw; x++) {
-            int sx = (x * sw) / dw;
-            const uint8_t *p = src + (sy * sw + sx) * 3;
-            uint8_t *q = dst + (y * dw + x) * 3;
+        const uint8_t *row = src + (size_t)((y * sh) / dh) * (size_t)sw * 3U;
+        uint8_t *q = dst + (size_t)y * (size_t)dst_stride * 3U;
+        for (x = 0; x < dw; x++, q += 3) {
+            const uint8_t *p = row + xt[x];
             q[0] = p[0];
             q[1] = p[1];
             q[2] = p[2];
@@ -2559,62 +4290,103 @@ static void resize_rgb888_nn(const uint8_t *src, int sw, int sh, uint8_t *dst, i
     }
 }
 
-static void resize_rgb888_bilinear(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh)
+static void resize_hpass_rgb888(const uint8_t *row, const struct resize_axis *ax, uint32_t *out)
 {
-    int x, y;
-    if (!src || !dst || sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
-        return;
+    int x;
+
+    for (x = 0; x < ax->dst; x++, out += 3) {
+        const uint8_t *p0 = row + ax->i0[x] * 3;
+        const uint8_t *p1 = row + ax->i1[x] * 3;
+        uint32_t w1 = (uint32_t)ax->w1[x];
+        uint32_t w0 = RESIZE_FIX_ONE - w1;
+
+        out[0] = p0[0] * w0 + p1[0] * w1;
+        out[1] = p0[1] * w0 + p1[1] * w1;
+        out[2] = p0[2] * w0 + p1[2] * w1;
+    }
+}
+
+static void resize_rgb888_bilinear_into(const uint8_t *src, int sw, int sh,
+                                        uint8_t *dst, int dst_stride, int dw, int dh)
+{
+    struct resize_scratch *s = &g_resize;
+    const struct resize_axis *ax;
+    const struct resize_axis *ay;
+    size_t row_len = (size_t)dw * 3U;
+    int row_src[2] = { -1, -1 };
+    int y;
+
     if (sw == 1 || sh == 1) {
-        resize_rgb888_nn(src, sw, sh, dst, dw, dh);
+        resize_rgb888_nn_into(src, sw, sh, dst, dst_stride, dw, dh);
+        return;
+    }
+    ax = resize_axis_get(s->x, &s->x_next, sw, dw);
+    ay = resize_axis_get(s->y, &s->y_next, sh, dh);
+    if (!ax || !ay)
         return;
+    if (dw > s->row_cap) {
+        uint32_t *r0 = realloc(s->rows[0], row_len * sizeof(uint32_t));
+        uint32_t *r1;
+
+        if (!r0)
+            return;
+        s->rows[0] = r0;
+        r1 = realloc(s->rows[1], row_len * sizeof(uint32_t));
+        if (!r1)
+            return;
+        s->rows[1] = r1;
+        s->row_cap = dw;
     }
+
     for (y = 0; y < dh; y++) {
-        float fy = ((float)y + 0.5f) * (float)sh / (float)dh - 0.5f;
-        int y0 = (int)floorf(fy);
-        int y1;
-        float wy;
-        if (y0 < 0) y0 = 0;
-        if (y0 > sh - 1) y0 = sh - 1;
-        y1 = y0 + 1;
-        if (y1 > sh - 1) y1 = sh - 1;
-        wy = fy - (float)y0;
-        if (wy < 0.0f) wy = 0.0f;
-        if (wy > 1.0f) wy = 1.0f;
-        for (x = 0; x < dw; x++) {
-            float fx = ((float)x + 0.5f) * (float)sw / (float)dw - 0.5f;
-            int x0 = (int)floorf(fx);
-            int x1;
-            float wx;
-            const uint8_t *p00, *p01, *p10, *p11;
-            uint8_t *q;
-            int c;
-
-            if (x0 < 0) x0 = 0;
-            if (x0 > sw - 1) x0 = sw - 1;
-            x1 = x0 + 1;
-            if (x1 > sw - 1) x1 = sw - 1;
-            wx = fx - (float)x0;
-            if (wx < 0.0f) wx = 0.0f;
-            if (wx > 1.0f) wx = 1.0f;
-
-            p00 = src + ((size_t)y0 * (size_t)sw + (size_t)x0) * 3U;
-            p01 = src + ((size_t)y0 * (size_t)sw + (size_t)x1) * 3U;
-            p10 = src + ((size_t)y1 * (size_t)sw + (size_t)x0) * 3U;
-            p11 = src + ((size_t)y1 * (size_t)sw + (size_t)x1) * 3U;
-            q = dst + ((size_t)y * (size_t)dw + (size_t)x) * 3U;
-            for (c = 0; c < 3; c++) {
-                float v0 = p00[c] * (1.0f - wx) + p01[c] * wx;
-                float v1 = p10[c] * (1.0f - wx) + p11[c] * wx;
-                float vv = v0 * (1.0f - wy) + v1 * wy;
-                int iv = (int)(vv + 0.5f);
-                if (iv < 0) iv = 0;
-                if (iv > 255) iv = 255;
-                q[c] = (uint8_t)iv;
+        int y0 = ay->i0[y];
+        int y1 = ay->i1[y];
+        uint32_t wy1 = (uint32_t)ay->w1[y];
+        uint32_t wy0 = RESIZE_FIX_ONE - wy1;
+        const uint32_t *r0;
+        const uint32_t *r1;
+        uint8_t *q = dst + (size_t)y * (size_t)dst_stride * 3U;
+        size_t i;
+
+        /* Rows advance monotonically: reuse the previous pair where possible. */
+        if (row_src[0] != y0) {
+            if (row_src[1] == y0) {
+                uint32_t *t = s->rows[0];
+                s->rows[0] = s->rows[1];
+                s->rows[1] = t;
+                row_src[0] = y0;
+                row_src[1] = -1;
+            } else {
+                resize_hpass_rgb888(src + (size_t)y0 * (size_t)sw * 3U, ax, s->rows[0]);
+                row_src[0] = y0;
             }
         }
+        if (y1 != y0 && row_src[1] != y1) {
+            resize_hpass_rgb888(src + (size_t)y1 * (size_t)sw * 3U, ax, s->rows[1]);
+            row_src[1] = y1;
+        }
+        r0 = s->rows[0];
+        r1 = (y1 == y0) ? r0 : s->rows[1];
+        for (i = 0; i < row_len; i++)
+            q[i] = (uint8_t)((r0[i] * wy0 + r1[i] * wy1 + (1U << (2 * RESIZE_FIX_BITS - 1)))
+                             >> (2 * RESIZE_FIX_BITS));
     }
 }
 
+static void resize_rgb888_nn(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh)
+{
+    if (!src || !dst || sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
+        return;
+    resize_rgb888_nn_into(src, sw, sh, dst, dw, dw, dh);
+}
+
+static void resize_rgb888_bilinear(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh)
+{
+    if (!src || !dst || sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
+        return;
+    resize_rgb888_bilinear_into(src, sw, sh, dst, dw, dw, dh);
+}
+
 static void resize_rgb888_with_kernel(const uint8_t *src, int sw, int sh,
                                       uint8_t *dst, int dw, int dh, int kernel)
 {
@@ -2624,197 +4396,103 @@ static void resize_rgb888_with_kernel(const uint8_t *src, int sw, int sh,
         resize_rgb888_nn(src, sw, sh, dst, dw, dh);
 }
 
-static void __attribute__((unused)) resize_rgb888_nn_letterbox(const uint8_t *src, int sw, int sh,
-                                                               uint8_t *dst, int dw, int dh, uint8_t pad)
+/* Same geometry as the CPU letterbox helpers: centred, aspect preserved. */
+static bool letterbox_geometry(int sw, int sh, int dw, int dh,
+                               struct letterbox_meta *lb, int *scaled_w, int *scaled_h)
 {
-    int scaled_w, scaled_h;
-    int off_x, off_y;
-    float sx, sy, scale;
-    uint8_t *tmp = NULL;
-    size_t dst_sz;
+    float sx, sy;
 
+    memset(lb, 0, sizeof(*lb));
+    lb->src_w = sw;
+    lb->src_h = sh;
+    lb->dst_w = dw;
+    lb->dst_h = dh;
     if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
-        return;
-
-    dst_sz = (size_t)dw * dh * 3U;
-    memset(dst, pad, dst_sz);
-
+        return false;
     sx = (float)dw / (float)sw;
     sy = (float)dh / (float)sh;
-    scale = (sx < sy) ? sx : sy;
-    if (scale <= 0.0f)
-        return;
-
-    scaled_w = (int)((float)sw * scale + 0.5f);
-    scaled_h = (int)((float)sh * scale + 0.5f);
-    if (scaled_w < 1) scaled_w = 1;
-    if (scaled_h < 1) scaled_h = 1;
-    if (scaled_w > dw) scaled_w = dw;
-    if (scaled_h > dh) scaled_h = dh;
-
-    off_x = (dw - scaled_w) / 2;
-    off_y = (dh - scaled_h) / 2;
+    lb->scale = (sx < sy) ? sx : sy;
+    if (lb->scale <= 0.0f)
+        return false;
+    *scaled_w = (int)((float)sw * lb->scale + 0.5f);
+    *scaled_h = (int)((float)sh * lb->scale + 0.5f);
+    if (*scaled_w < 1) *scaled_w = 1;
+    if (*scaled_h < 1) *scaled_h = 1;
+    if (*scaled_w > dw) *scaled_w = dw;
+    if (*scaled_h > dh) *scaled_h = dh;
+    lb->pad_x = (dw - *scaled_w) / 2;
+    lb->pad_y = (dh - *scaled_h) / 2;
+    lb->valid = true;
+    return true;
+}
 
-    tmp = malloc((size_t)scaled_w * scaled_h * 3U);
-    if (!tmp)
-        return;
+/* Fill only the border around the scaled image; the image area is overwritten anyway. */
+static void letterbox_fill_pad(uint8_t *dst, const struct letterbox_meta *lb,
+                               int scaled_w, int scaled_h, uint8_t pad)
+{
+    size_t stride = (size_t)lb->dst_w * 3U;
+    size_t left = (size_t)lb->pad_x * 3U;
+    size_t right = (size_t)(lb->dst_w - lb->pad_x - scaled_w) * 3U;
+    int y;
 
-    resize_rgb888_nn(src, sw, sh, tmp, scaled_w, scaled_h);
-    for (int y = 0; y < scaled_h; y++) {
-        const uint8_t *src_row = tmp + (size_t)y * scaled_w * 3U;
-        uint8_t *dst_row = dst + ((size_t)(off_y + y) * dw + (size_t)off_x) * 3U;
-        memcpy(dst_row, src_row, (size_t)scaled_w * 3U);
+    memset(dst, pad, (size_t)lb->pad_y * stride);
+    for (y = lb->pad_y; y < lb->pad_y + scaled_h; y++) {
+        uint8_t *row = dst + (size_t)y * stride;
+        if (left)
+            memset(row, pad, left);
+        if (right)
+            memset(row + stride - right, pad, right);
     }
-    free(tmp);
+    memset(dst + (size_t)(lb->pad_y + scaled_h) * stride, pad,
+           (size_t)(lb->dst_h - lb->pad_y - scaled_h) * stride);
 }
 
 static void resize_rgb888_letterbox_kernel(const uint8_t *src, int sw, int sh,
                                            uint8_t *dst, int dw, int dh, uint8_t pad,
                                            int kernel, struct letterbox_meta *meta)
 {
+    struct letterbox_meta lb;
     int scaled_w, scaled_h;
-    int off_x, off_y;
-    float sx, sy, scale;
-    uint8_t *tmp = NULL;
-    size_t dst_sz;
-
-    if (meta) {
-        memset(meta, 0, sizeof(*meta));
-        meta->src_w = sw;
-        meta->src_h = sh;
-        meta->dst_w = dw;
-        meta->dst_h = dh;
-    }
-
-    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
-        return;
-
-    dst_sz = (size_t)dw * (size_t)dh * 3U;
-    memset(dst, pad, dst_sz);
-
-    sx = (float)dw / (float)sw;
-    sy = (float)dh / (float)sh;
-    scale = (sx < sy) ? sx : sy;
-    if (scale <= 0.0f)
-        return;
-
-    scaled_w = (int)((float)sw * scale + 0.5f);
-    scaled_h = (int)((float)sh * scale + 0.5f);
-    if (scaled_w < 1) scaled_w = 1;
-    if (scaled_h < 1) scaled_h = 1;
-    if (scaled_w > dw) scaled_w = dw;
-    if (scaled_h > dh) scaled_h = dh;
-
-    off_x = (dw - scaled_w) / 2;
-    off_y = (dh - scaled_h) / 2;
+    uint8_t *box;
 
-    tmp = malloc((size_t)scaled_w * (size_t)scaled_h * 3U);
-    if (!tmp)
+    if (!letterbox_geometry(sw, sh, dw, dh, &lb, &scaled_w, &scaled_h)) {
+        if (meta)
+            *meta = lb;
         return;
-
-    resize_rgb888_with_kernel(src, sw, sh, tmp, scaled_w, scaled_h, kernel);
-    for (int y = 0; y < scaled_h; y++) {
-        const uint8_t *src_row = tmp + (size_t)y * (size_t)scaled_w * 3U;
-        uint8_t *dst_row = dst + ((size_t)(off_y + y) * (size_t)dw + (size_t)off_x) * 3U;
-        memcpy(dst_row, src_row, (size_t)scaled_w * 3U);
     }
-    free(tmp);
+    letterbox_fill_pad(dst, &lb, scaled_w, scaled_h, pad);
+    box = dst + ((size_t)lb.pad_y * (size_t)dw + (size_t)lb.pad_x) * 3U;
+    if (kernel == OCR_KERNEL_BILINEAR)
+        resize_rgb888_bilinear_into(src, sw, sh, box, dw, scaled_w, scaled_h);
+    else
+        resize_rgb888_nn_into(src, sw, sh, box, dw, scaled_w, scaled_h);
+    if (meta)
+        *meta = lb;
+}
 
-    if (meta) {
-        meta->scale = scale;
-        meta->pad_x = off_x;
-        meta->pad_y = off_y;
-        meta->valid = true;
-    }
+static void __attribute__((unused)) resize_rgb888_nn_letterbox(const uint8_t *src, int sw, int sh,
+                                                               uint8_t *dst, int dw, int dh, uint8_t pad)
+{
+    resize_rgb888_letterbox_kernel(src, sw, sh, dst, dw, dh, pad, OCR_KERNEL_NN, NULL);
 }
 
 static void resize_rgb888_nn_letterbox_meta(const uint8_t *src, int sw, int sh,
                                             uint8_t *dst, int dw, int dh, uint8_t pad,
                                             struct letterbox_meta *meta)
 {
-    int scaled_w, scaled_h;
-    int off_x, off_y;
-    float sx, sy, scale;
-    uint8_t *tmp = NULL;
-    size_t dst_sz;
-
-    if (meta) {
-        memset(meta, 0, sizeof(*meta));
-        meta->src_w = sw;
-        meta->src_h = sh;
-        meta->dst_w = dw;
-        meta->dst_h = dh;
-    }
-
-    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0)
-        return;
-
-    dst_sz = (size_t)dw * dh * 3U;
-    memset(dst, pad, dst_sz);
-
-    sx = (float)dw / (float)sw;
-    sy = (float)dh / (float)sh;
-    scale = (sx < sy) ? sx : sy;
-    if (scale <= 0.0f)
-        return;
-
-    scaled_w = (int)((float)sw * scale + 0.5f);
-    scaled_h = (int)((float)sh * scale + 0.5f);
-    if (scaled_w < 1) scaled_w = 1;
-    if (scaled_h < 1) scaled_h = 1;
-    if (scaled_w > dw) scaled_w = dw;
-    if (scaled_h > dh) scaled_h = dh;
-
-    off_x = (dw - scaled_w) / 2;
-    off_y = (dh - scaled_h) / 2;
-
-    tmp = malloc((size_t)scaled_w * scaled_h * 3U);
-    if (!tmp)
-        return;
-
-    resize_rgb888_nn(src, sw, sh, tmp, scaled_w, scaled_h);
-    for (int y = 0; y < scaled_h; y++) {
-        const uint8_t *src_row = tmp + (size_t)y * scaled_w * 3U;
-        uint8_t *dst_row = dst + ((size_t)(off_y + y) * dw + (size_t)off_x) * 3U;
-        memcpy(dst_row, src_row, (size_t)scaled_w * 3U);
-    }
-    free(tmp);
-
-    if (meta) {
-        meta->scale = scale;
-        meta->pad_x = off_x;
-        meta->pad_y = off_y;
-        meta->valid = true;
-    }
+    resize_rgb888_letterbox_kernel(src, sw, sh, dst, dw, dh, pad, OCR_KERNEL_NN, meta);
 }
 
 static void raw565_to_rgb888_full(struct app_ctx *ctx, const uint8_t *raw, uint8_t *rgb)
 {
-    size_t i;
     size_t pixels = (size_t)ctx->frame_width * ctx->frame_height;
-    for (i = 0; i < pixels; i++) {
-        uint8_t r, g, b;
-        decode_pixel565(&ctx->opt, raw[i * 2], raw[i * 2 + 1], &r, &g, &b);
-        rgb[i * 3 + 0] = r;
-        rgb[i * 3 + 1] = g;
-        rgb[i * 3 + 2] = b;
-    }
+    pixconv_565_to_rgb(raw, rgb, pixels, pixconv_flags_565(&ctx->opt));
 }
 
 static void bgrx8888_to_rgb888_and_a(const uint8_t *src_bgrx, int w, int h,
                                      uint8_t *dst_rgb, uint8_t *dst_a)
 {
-    size_t i;
-    size_t pixels = (size_t)w * h;
-    for (i = 0; i < pixels; i++) {
-        const uint8_t *p = src_bgrx + i * 4U;
-        uint8_t *q = dst_rgb + i * 3U;
-        q[0] = p[2];
-        q[1] = p[1];
-        q[2] = p[0];
-        if (dst_a)
-            dst_a[i] = p[3];
-    }
+    pixconv_bgrx_to_rgb_a(src_bgrx, dst_rgb, dst_a, (size_t)w * h);
 }
 
 static inline uint8_t clip_u8(int v)
@@ -2890,7 +4568,7 @@ static void ocr_preprocess_rgb888(uint8_t *rgb, int w, int h, int mode)
     if (mode == OCR_PREPROC_NONE || w <= 1 || h <= 1)
         return;
 
-    gray = malloc(pixels);
+    gray = frame_alloc(pixels);
     if (!gray)
         return;
 
@@ -2911,13 +4589,13 @@ static void ocr_preprocess_rgb888(uint8_t *rgb, int w, int h, int mode)
                 q[2] = g;
             }
         }
-        free(gray);
+        frame_free(gray);
         return;
     }
 
-    tmp = malloc(pixels);
+    tmp = frame_alloc(pixels);
     if (!tmp) {
-        free(gray);
+        frame_free(gray);
         return;
     }
 
@@ -2966,21 +4644,21 @@ static void ocr_preprocess_rgb888(uint8_t *rgb, int w, int h, int mode)
         }
     }
 
-    free(tmp);
-    free(gray);
+    frame_free(tmp);
+    frame_free(gray);
 }
 
 static void sw_preprocess_rgb888(uint8_t *rgb, int w, int h)
 {
     size_t pixels = (size_t)w * h;
-    uint8_t *gray = malloc(pixels);
-    uint8_t *filt = malloc(pixels);
-    uint8_t *edge = malloc(pixels);
+    uint8_t *gray = frame_alloc(pixels);
+    uint8_t *filt = frame_alloc(pixels);
+    uint8_t *edge = frame_alloc(pixels);
     int x, y;
     if (!gray || !filt || !edge) {
-        free(gray);
-        free(filt);
-        free(edge);
+        frame_free(gray);
+        frame_free(filt);
+        frame_free(edge);
         return;
     }
 
@@ -3036,16 +4714,16 @@ static void sw_preprocess_rgb888(uint8_t *rgb, int w, int h)
         }
     }
 
-    free(gray);
-    free(filt);
-    free(edge);
+    frame_free(gray);
+    frame_free(filt);
+    frame_free(edge);
 }
 
 static int extract_a_channel_roi(const uint8_t *a_map, int w, int h, float proj_ratio,
                                  struct det_box *roi, float *red_ratio_out)
 {
-    int *hist_x = calloc((size_t)w, sizeof(int));
-    int *hist_y = calloc((size_t)h, sizeof(int));
+    int *hist_x = frame_calloc((size_t)w, sizeof(int));
+    int *hist_y = frame_calloc((size_t)h, sizeof(int));
     int x, y;
     int edge_total = 0;
     int valid_total = 0;
@@ -3054,8 +4732,8 @@ static int extract_a_channel_roi(const uint8_t *a_map, int w, int h, float proj_
     int x1 = -1, x2 = -1, y1 = -1, y2 = -1;
 
     if (!hist_x || !hist_y) {
-        free(hist_x);
-        free(hist_y);
+        frame_free(hist_x);
+        frame_free(hist_y);
         return 0;
     }
 
@@ -3084,8 +4762,8 @@ static int extract_a_channel_roi(const uint8_t *a_map, int w, int h, float proj_
         *red_ratio_out = (valid_total > 0) ? ((float)red_total / (float)valid_total) : 0.0f;
     }
     if (edge_total <= 0) {
-        free(hist_x);
-        free(hist_y);
+        frame_free(hist_x);
+        frame_free(hist_y);
         return 0;
     }
 
@@ -3095,8 +4773,8 @@ static int extract_a_channel_roi(const uint8_t *a_map, int w, int h, float proj_
         if (hist_y[y] > max_y) max_y = hist_y[y];
 
     if (max_x <= 0 || max_y <= 0) {
-        free(hist_x);
-        free(hist_y);
+        frame_free(hist_x);
+        frame_free(hist_y);
         return 0;
     }
 
@@ -3117,8 +4795,8 @@ static int extract_a_channel_roi(const uint8_t *a_map, int w, int h, float proj_
         }
     }
 
-    free(hist_x);
-    free(hist_y);
+    frame_free(hist_x);
+    frame_free(hist_y);
 
     if (x1 < 0 || y1 < 0 || x2 <= x1 || y2 <= y1)
         return 0;
@@ -3321,64 +4999,315 @@ static void map_box_from_detect_space(struct det_box *b, int det_resize_mode,
         map_box_between_spaces(b, det_w, det_h, src_w, src_h);
 }
 
-static void prepare_detect_canvas(const struct app_ctx *ctx, const uint8_t *src_rgb, int src_w, int src_h,
-                                  uint8_t *det_rgb, struct letterbox_meta *lb)
+static void offset_box(struct det_box *b, int dx, int dy, int img_w, int img_h)
 {
-    if (ctx->opt.det_resize_mode == DET_RESIZE_LETTERBOX) {
-        resize_rgb888_nn_letterbox_meta(src_rgb, src_w, src_h,
-                                        det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE, 0U, lb);
-        return;
-    }
-    if (lb) {
-        memset(lb, 0, sizeof(*lb));
-        lb->src_w = src_w;
-        lb->src_h = src_h;
-        lb->dst_w = ALGO_STREAM_SIZE;
-        lb->dst_h = ALGO_STREAM_SIZE;
+    b->x1 += dx;
+    b->x2 += dx;
+    b->y1 += dy;
+    b->y2 += dy;
+    if (b->has_obb) {
+        int k;
+        b->cx += (float)dx;
+        b->cy += (float)dy;
+        for (k = 0; k < 4; k++) {
+            b->quad[k * 2 + 0] += (float)dx;
+            b->quad[k * 2 + 1] += (float)dy;
+        }
     }
-    resize_rgb888_nn(src_rgb, src_w, src_h, det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
+    clamp_box(b, img_w, img_h);
 }
 
-static int run_detect_on_rgb(struct app_ctx *ctx, struct yolo_model *m,
-                             const uint8_t *src_rgb, int src_w, int src_h,
-                             float conf_thr, uint8_t *det_rgb, uint8_t *model_in,
-                             struct det_box *out, int *out_count,
-                             struct detect_decode_diag *diag)
-{
+/*
+ * One source rectangle placed in a shared detector canvas: lb.scale and
+ * lb.pad_x/pad_y give its placement, src_x/src_y its origin in the frame.
+ */
+struct detect_tile {
     struct letterbox_meta lb;
-    int i;
+    int src_x;
+    int src_y;
+};
 
-    prepare_detect_canvas(ctx, src_rgb, src_w, src_h, det_rgb, &lb);
-    if (m->in_w == ALGO_STREAM_SIZE && m->in_h == ALGO_STREAM_SIZE)
-        memcpy(model_in, det_rgb, (size_t)ALGO_STREAM_SIZE * ALGO_STREAM_SIZE * 3U);
+/* map_box_from_detect_space for a box found inside tile @t. */
+static void map_box_from_detect_tile(struct det_box *b, const struct detect_tile *t, int img_w, int img_h)
+{
+    if (b->has_obb)
+        map_obb_from_detect_space(b, DET_RESIZE_LETTERBOX, &t->lb, t->lb.src_w, t->lb.src_h,
+                                  t->lb.dst_w, t->lb.dst_h);
     else
-        resize_rgb888_nn(det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
-                         model_in, (int)m->in_w, (int)m->in_h);
+        map_box_from_letterbox(b, &t->lb);
+    offset_box(b, t->src_x, t->src_y, img_w, img_h);
+}
 
-    if (run_model_detect(m, model_in, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
-                         conf_thr, out, out_count, diag) < 0) {
-        *out_count = 0;
-        return -1;
-    }
-    for (i = 0; i < *out_count; i++) {
-        if (out[i].has_obb) {
-            map_obb_from_detect_space(&out[i], ctx->opt.det_resize_mode, &lb,
-                                      src_w, src_h, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
-        } else {
-            map_box_from_detect_space(&out[i], ctx->opt.det_resize_mode, &lb,
-                                      src_w, src_h, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
-        }
+/*
+ * Preprocessing backend. PREPROC_RGA hands colour conversion and scaling to
+ * the RK3568 RGA 2D engine (build with -DHAVE_RGA, link -lrga). Anything the
+ * engine rejects, e.g. an odd OCR crop size, falls back to the CPU path for
+ * that call. RGA scales bilinearly, so NN-kernel paths differ slightly.
+ */
+static const char *preproc_backend_str(int backend)
+{
+    return backend == PREPROC_RGA ? "rga" : "cpu";
+}
+
+#ifdef HAVE_RGA
+static bool rga_status_ok(IM_STATUS st, const char *what)
+{
+    static int reported;
+    if (st == IM_STATUS_SUCCESS || st == IM_STATUS_NOERROR)
+        return true;
+    if (reported < 8) {
+        reported++;
+        fprintf(stderr, "[rga] %s failed: %s, using CPU path\n", what, imStrError(st));
     }
-    return 0;
+    return false;
 }
+#endif
 
-static void compute_center_crop_box(const struct det_box *src, int img_w, int img_h,
-                                    int crop_w, int crop_h, struct det_box *crop)
+/* RGB888 src scaled into the dst sub-rectangle (x, y, w, h); false = do it on the CPU. */
+static bool preproc_rga_resize(const struct app_ctx *ctx, const uint8_t *src, int sw, int sh,
+                               uint8_t *dst, int dw, int dh, int x, int y, int w, int h)
 {
-    int cx = (src->x1 + src->x2) / 2;
-    int cy = (src->y1 + src->y2) / 2;
-    int x1 = cx - crop_w / 2;
-    int y1 = cy - crop_h / 2;
+#ifdef HAVE_RGA
+    rga_buffer_t src_buf;
+    rga_buffer_t dst_buf;
+    rga_buffer_t pat;
+    im_rect srect = { 0, 0, sw, sh };
+    im_rect drect = { x, y, w, h };
+    im_rect prect;
+
+    if (ctx->opt.preproc_backend != PREPROC_RGA)
+        return false;
+    memset(&pat, 0, sizeof(pat));
+    memset(&prect, 0, sizeof(prect));
+    src_buf = wrapbuffer_virtualaddr((void *)src, sw, sh, RK_FORMAT_RGB_888);
+    dst_buf = wrapbuffer_virtualaddr(dst, dw, dh, RK_FORMAT_RGB_888);
+    return rga_status_ok(improcess(src_buf, dst_buf, pat, srect, drect, prect, IM_SYNC), "resize");
+#else
+    (void)ctx; (void)src; (void)sw; (void)sh; (void)dst; (void)dw; (void)dh;
+    (void)x; (void)y; (void)w; (void)h;
+    return false;
+#endif
+}
+
+static bool preproc_rga_letterbox(const struct app_ctx *ctx, const uint8_t *src, int sw, int sh,
+                                  uint8_t *dst, int dw, int dh, uint8_t pad,
+                                  struct letterbox_meta *meta)
+{
+    struct letterbox_meta lb;
+    int scaled_w;
+    int scaled_h;
+
+    if (ctx->opt.preproc_backend != PREPROC_RGA)
+        return false;
+    if (!letterbox_geometry(sw, sh, dw, dh, &lb, &scaled_w, &scaled_h))
+        return false;
+    letterbox_fill_pad(dst, &lb, scaled_w, scaled_h, pad);
+    if (!preproc_rga_resize(ctx, src, sw, sh, dst, dw, dh, lb.pad_x, lb.pad_y, scaled_w, scaled_h))
+        return false;
+    if (meta)
+        *meta = lb;
+    return true;
+}
+
+/* BGRX capture frame -> full-res RGB888, read through its dma-buf when imported. */
+static bool preproc_rga_frame_to_rgb(const struct app_ctx *ctx, int frame_idx, uint8_t *rgb)
+{
+#ifdef HAVE_RGA
+    int w = (int)ctx->frame_width;
+    int h = (int)ctx->frame_height;
+    rga_buffer_t src_buf;
+    rga_buffer_t dst_buf;
+
+    if (ctx->opt.preproc_backend != PREPROC_RGA || !ctx->src_is_bgrx)
+        return false;
+    if (ctx->rga_frame_handles[frame_idx])
+        src_buf = wrapbuffer_handle(ctx->rga_frame_handles[frame_idx], w, h, RK_FORMAT_BGRX_8888);
+    else
+        src_buf = wrapbuffer_virtualaddr(ctx->frames[frame_idx].data, w, h, RK_FORMAT_BGRX_8888);
+    dst_buf = wrapbuffer_virtualaddr(rgb, w, h, RK_FORMAT_RGB_888);
+    return rga_status_ok(imcvtcolor(src_buf, dst_buf, RK_FORMAT_BGRX_8888, RK_FORMAT_RGB_888),
+                         "cvtcolor");
+#else
+    (void)ctx; (void)frame_idx; (void)rgb;
+    return false;
+#endif
+}
+
+/* Import every ring slot into RGA once; slots that fail keep the mmap path. */
+static void init_rga_frames(struct app_ctx *ctx)
+{
+#ifdef HAVE_RGA
+    int i;
+
+    if (ctx->opt.preproc_backend != PREPROC_RGA || !ctx->async_dma)
+        return;
+    for (i = 0; i < ctx->frame_count; i++) {
+        struct dma_buffer_export exp;
+
+        memset(&exp, 0, sizeof(exp));
+        exp.index = (uint32_t)i;
+        exp.flags = O_CLOEXEC;
+        if (ioctl(ctx->dev_fd, FPGA_DMA_EXPORT_DMABUF, &exp) < 0) {
+            fprintf(stderr, "[rga] export ring slot %d failed: %s\n", i, strerror(errno));
+            continue;
+        }
+        ctx->rga_dmabuf_fds[i] = exp.fd;
+        ctx->rga_frame_handles[i] = importbuffer_fd(exp.fd, (int)exp.size);
+        if (!ctx->rga_frame_handles[i])
+            fprintf(stderr, "[rga] import ring slot %d failed\n", i);
+    }
+#else
+    (void)ctx;
+#endif
+}
+
+static void release_rga_frames(struct app_ctx *ctx)
+{
+#ifdef HAVE_RGA
+    int i;
+
+    for (i = 0; i < MAX_CAPTURE_FRAMES; i++) {
+        if (ctx->rga_frame_handles[i])
+            releasebuffer_handle(ctx->rga_frame_handles[i]);
+        ctx->rga_frame_handles[i] = 0;
+        if (ctx->rga_dmabuf_fds[i] > 0)
+            close(ctx->rga_dmabuf_fds[i]);
+        ctx->rga_dmabuf_fds[i] = 0;
+    }
+#else
+    (void)ctx;
+#endif
+}
+
+static void prepare_detect_canvas(const struct app_ctx *ctx, int resize_mode,
+                                  const uint8_t *src_rgb, int src_w, int src_h,
+                                  uint8_t *det_rgb, struct letterbox_meta *lb)
+{
+    if (resize_mode == DET_RESIZE_LETTERBOX) {
+        if (preproc_rga_letterbox(ctx, src_rgb, src_w, src_h,
+                                  det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE, 0U, lb))
+            return;
+        resize_rgb888_nn_letterbox_meta(src_rgb, src_w, src_h,
+                                        det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE, 0U, lb);
+        return;
+    }
+    if (lb) {
+        memset(lb, 0, sizeof(*lb));
+        lb->src_w = src_w;
+        lb->src_h = src_h;
+        lb->dst_w = ALGO_STREAM_SIZE;
+        lb->dst_h = ALGO_STREAM_SIZE;
+    }
+    if (preproc_rga_resize(ctx, src_rgb, src_w, src_h, det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                           0, 0, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE))
+        return;
+    resize_rgb888_nn(src_rgb, src_w, src_h, det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
+}
+
+static void map_dets_from_detect_space(struct det_box *out, int count, int resize_mode,
+                                       const struct letterbox_meta *lb, int src_w, int src_h)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (out[i].has_obb) {
+            map_obb_from_detect_space(&out[i], resize_mode, lb,
+                                      src_w, src_h, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
+        } else {
+            map_box_from_detect_space(&out[i], resize_mode, lb,
+                                      src_w, src_h, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE);
+        }
+    }
+}
+
+static int run_detect_on_rgb(struct app_ctx *ctx, struct yolo_model *m, int resize_mode,
+                             const uint8_t *src_rgb, int src_w, int src_h,
+                             float conf_thr, uint8_t *det_rgb, uint8_t *model_in,
+                             struct det_box *out, int *out_count,
+                             struct detect_decode_diag *diag)
+{
+    struct letterbox_meta lb;
+    uint8_t *npu_in;
+    int64_t pt;
+    int ret;
+
+    pthread_mutex_lock(&m->run_lock);
+    pt = prof_begin();
+    npu_in = rknn_io_input(&m->io);
+    if (npu_in)
+        model_in = npu_in;
+    /* At the canvas size the canvas is the model input; build it in place. */
+    if (m->in_w == ALGO_STREAM_SIZE && m->in_h == ALGO_STREAM_SIZE) {
+        prepare_detect_canvas(ctx, resize_mode, src_rgb, src_w, src_h, model_in, &lb);
+    } else {
+        prepare_detect_canvas(ctx, resize_mode, src_rgb, src_w, src_h, det_rgb, &lb);
+        if (!preproc_rga_resize(ctx, det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                                model_in, (int)m->in_w, (int)m->in_h,
+                                0, 0, (int)m->in_w, (int)m->in_h))
+            resize_rgb888_nn(det_rgb, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                             model_in, (int)m->in_w, (int)m->in_h);
+    }
+    prof_end(m->prof_stage, pt);
+
+    ret = run_model_detect(m, model_in, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                           conf_thr, out, out_count, diag);
+    pthread_mutex_unlock(&m->run_lock);
+    if (ret < 0) {
+        *out_count = 0;
+        return -1;
+    }
+    map_dets_from_detect_space(out, *out_count, resize_mode, &lb, src_w, src_h);
+    return 0;
+}
+
+/*
+ * Same as run_detect_on_rgb() in letterbox mode, with the canvas built by
+ * the FPGA: a model at the canvas size reads the tensor as its input.
+ */
+static int run_detect_on_tensor(struct app_ctx *ctx, struct yolo_model *m, const uint8_t *tensor,
+                                float conf_thr, uint8_t *model_in,
+                                struct det_box *out, int *out_count,
+                                struct detect_decode_diag *diag)
+{
+    const uint8_t *in = tensor;
+    uint8_t *npu_in;
+    int64_t pt;
+    int ret;
+
+    pthread_mutex_lock(&m->run_lock);
+    if (m->in_w != ALGO_STREAM_SIZE || m->in_h != ALGO_STREAM_SIZE) {
+        pt = prof_begin();
+        npu_in = rknn_io_input(&m->io);
+        if (npu_in)
+            model_in = npu_in;
+        if (!preproc_rga_resize(ctx, tensor, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                                model_in, (int)m->in_w, (int)m->in_h,
+                                0, 0, (int)m->in_w, (int)m->in_h))
+            resize_rgb888_nn(tensor, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                             model_in, (int)m->in_w, (int)m->in_h);
+        in = model_in;
+        prof_end(m->prof_stage, pt);
+    }
+
+    ret = run_model_detect(m, in, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                           conf_thr, out, out_count, diag);
+    pthread_mutex_unlock(&m->run_lock);
+    if (ret < 0) {
+        *out_count = 0;
+        return -1;
+    }
+    map_dets_from_detect_space(out, *out_count, DET_RESIZE_LETTERBOX, &ctx->tensor_lb,
+                               (int)ctx->frame_width, (int)ctx->frame_height);
+    return 0;
+}
+
+static void compute_center_crop_box(const struct det_box *src, int img_w, int img_h,
+                                    int crop_w, int crop_h, struct det_box *crop)
+{
+    int cx = (src->x1 + src->x2) / 2;
+    int cy = (src->y1 + src->y2) / 2;
+    int x1 = cx - crop_w / 2;
+    int y1 = cy - crop_h / 2;
 
     if (x1 < 0) x1 = 0;
     if (y1 < 0) y1 = 0;
@@ -3875,7 +5804,6 @@ static bool run_quad_refiner(const struct app_ctx *ctx,
                               float refined_quad_out[8])
 {
     const struct quad_refiner_model *m = &ctx->quad_refiner_model;
-    rknn_input in;
     rknn_output outs[4];
     float ordered[8];
     float pred_ordered[8];
@@ -3938,7 +5866,7 @@ static bool run_quad_refiner(const struct app_ctx *ctx,
 
     input_count = (size_t)3 * (size_t)ref_h * (size_t)ref_w;
     input_size = input_count * sizeof(float);
-    input_buf = (float *)malloc(input_size);
+    input_buf = (float *)frame_alloc(input_size);
     if (!input_buf)
         return false;
 
@@ -3966,23 +5894,8 @@ static bool run_quad_refiner(const struct app_ctx *ctx,
         }
     }
 
-    memset(&in, 0, sizeof(in));
-    in.index = 0;
-    in.buf = input_buf;
-    in.size = input_size;
-    in.type = RKNN_TENSOR_FLOAT32;
-    in.fmt = m->input_attr.fmt;
-    ret = rknn_inputs_set(m->ctx, 1, &in);
-    if (ret < 0)
-        goto out;
-    ret = rknn_run(m->ctx, NULL);
-    if (ret < 0)
-        goto out;
-
-    memset(outs, 0, sizeof(outs));
-    for (i = 0; i < (int)m->io_num.n_output; i++)
-        outs[i].want_float = 1;
-    ret = rknn_outputs_get(m->ctx, m->io_num.n_output, outs, NULL);
+    ret = rknn_io_run(m->ctx, &m->io, input_buf, (uint32_t)input_size, RKNN_TENSOR_FLOAT32,
+                      m->input_attr.fmt, false, outs);
     if (ret < 0)
         goto out;
 
@@ -3991,7 +5904,7 @@ static bool run_quad_refiner(const struct app_ctx *ctx,
     if (hm_c != 4)
         goto out_release;
 
-    heatmaps = (float *)malloc((size_t)hm_h * (size_t)hm_w * 4U * sizeof(float));
+    heatmaps = (float *)frame_alloc((size_t)hm_h * (size_t)hm_w * 4U * sizeof(float));
     if (!heatmaps)
         goto out_release;
 
@@ -4150,10 +6063,10 @@ static bool run_quad_refiner(const struct app_ctx *ctx,
     ret = 0;
 out_release:
     if (m->ctx)
-        rknn_outputs_release(m->ctx, m->io_num.n_output, outs);
+        rknn_io_outputs_done(m->ctx, &m->io, outs);
 out:
-    free(input_buf);
-    free(heatmaps);
+    frame_free(input_buf);
+    frame_free(heatmaps);
     if (ret == 0) {
         fprintf(stderr,
                 "[quad_refiner] gate ACCEPT conf=[%.3f %.3f %.3f %.3f] area_ratio=%.3f center_shift=%.3f/%.3f corner_shift=%.3f/%.3f edge_ratio=%.3f/%.3f\n",
@@ -4243,15 +6156,15 @@ static bool refine_plate_box_local(struct app_ctx *ctx, const uint8_t *rgb_full,
     if (roi_w < 8 || roi_h < 8)
         return false;
 
-    roi_rgb = malloc((size_t)roi_w * roi_h * 3U);
+    roi_rgb = frame_alloc((size_t)roi_w * roi_h * 3U);
     if (!roi_rgb)
         return false;
     copy_crop_rgb888(rgb_full, img_w, &roi, roi_rgb);
 
     det_thr = fmaxf(0.03f, ctx->opt.min_plate_conf * 0.8f);
-    if (run_detect_on_rgb(ctx, &ctx->plate_model, roi_rgb, roi_w, roi_h,
+    if (run_detect_on_rgb(ctx, &ctx->plate_model, ctx->opt.det_resize_mode, roi_rgb, roi_w, roi_h,
                           det_thr, det_rgb, plate_in, cand, &count, NULL) < 0 || count <= 0) {
-        free(roi_rgb);
+        frame_free(roi_rgb);
         return false;
     }
 
@@ -4269,30 +6182,169 @@ static bool refine_plate_box_local(struct app_ctx *ctx, const uint8_t *rgb_full,
         }
     }
     if (best < 0) {
-        free(roi_rgb);
+        frame_free(roi_rgb);
         return false;
     }
 
     *out_box = cand[best];
-    out_box->x1 += roi.x1;
-    out_box->x2 += roi.x1;
-    out_box->y1 += roi.y1;
-    out_box->y2 += roi.y1;
-    if (out_box->has_obb) {
-        int k;
-        out_box->cx += (float)roi.x1;
-        out_box->cy += (float)roi.y1;
-        for (k = 0; k < 4; k++) {
-            out_box->quad[k * 2 + 0] += (float)roi.x1;
-            out_box->quad[k * 2 + 1] += (float)roi.y1;
+    offset_box(out_box, roi.x1, roi.y1, img_w, img_h);
+
+    frame_free(roi_rgb);
+    return true;
+}
+
+#define CASCADE_MAX_TILES 16
+#define CASCADE_GAP 4
+
+/*
+ * Shelf-pack the vehicle ROIs into the ALGO_STREAM_SIZE canvas, all at
+ * @scale. Tallest first; returns false if they do not fit.
+ */
+static bool cascade_pack_tiles(const struct det_box *rois, int n, float scale, struct detect_tile *tiles)
+{
+    int order[CASCADE_MAX_TILES];
+    int shelf_y = 0;
+    int shelf_h = 0;
+    int x = 0;
+    int i, j;
+
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    for (i = 1; i < n; i++) {
+        int k = order[i];
+        int hk = rois[k].y2 - rois[k].y1;
+        for (j = i; j > 0 && rois[order[j - 1]].y2 - rois[order[j - 1]].y1 < hk; j--)
+            order[j] = order[j - 1];
+        order[j] = k;
+    }
+    for (i = 0; i < n; i++) {
+        const struct det_box *r = &rois[order[i]];
+        struct detect_tile *t = &tiles[order[i]];
+        int rw = r->x2 - r->x1 + 1;
+        int rh = r->y2 - r->y1 + 1;
+        int tw = (int)((float)rw * scale + 0.5f);
+        int th = (int)((float)rh * scale + 0.5f);
+
+        if (tw < 1) tw = 1;
+        if (th < 1) th = 1;
+        if (tw > ALGO_STREAM_SIZE || th > ALGO_STREAM_SIZE)
+            return false;
+        if (x + tw > ALGO_STREAM_SIZE) {
+            shelf_y += shelf_h + CASCADE_GAP;
+            shelf_h = 0;
+            x = 0;
         }
+        if (shelf_y + th > ALGO_STREAM_SIZE)
+            return false;
+        memset(t, 0, sizeof(*t));
+        t->lb.scale = (float)tw / (float)rw;
+        t->lb.pad_x = x;
+        t->lb.pad_y = shelf_y;
+        t->lb.src_w = rw;
+        t->lb.src_h = rh;
+        t->lb.dst_w = tw;
+        t->lb.dst_h = th;
+        t->lb.valid = true;
+        t->src_x = r->x1;
+        t->src_y = r->y1;
+        x += tw + CASCADE_GAP;
+        if (th > shelf_h)
+            shelf_h = th;
     }
-    clamp_box(out_box, img_w, img_h);
-
-    free(roi_rgb);
     return true;
 }
 
+/*
+ * --plate-cascade: run the plate model once over the vehicle ROIs tiled
+ * into one canvas at native scale, or the largest downscale that still
+ * beats the full-frame letterbox (0.5 for 1280x720). Boxes are assigned to
+ * the tile holding their centre and mapped back to the frame. Returns -1
+ * when the ROIs do not fit; the caller then runs the full-frame pass.
+ */
+static int run_plate_cascade(struct app_ctx *ctx, const uint8_t *rgb, const struct det_box *cars, int car_count,
+                             float conf_thr, uint8_t *det_rgb, uint8_t *model_in,
+                             struct det_box *out, int *out_count, struct detect_decode_diag *diag)
+{
+    static const float scales[] = { 1.0f, 0.85f, 0.7f, 0.6f };
+    struct yolo_model *m = &ctx->plate_model;
+    int img_w = (int)ctx->frame_width;
+    int img_h = (int)ctx->frame_height;
+    struct det_box rois[CASCADE_MAX_TILES];
+    struct detect_tile tiles[CASCADE_MAX_TILES];
+    struct det_box cand[MAX_DETS];
+    int cand_count = 0;
+    int n = 0;
+    int i, k;
+    bool packed = false;
+    uint8_t *canvas;
+    uint8_t *npu_in;
+    int ret;
+
+    *out_count = 0;
+    for (i = 0; i < car_count; i++) {
+        if (cars[i].cls != ctx->car_class_id)
+            continue;
+        if (n == CASCADE_MAX_TILES)
+            return -1;
+        compute_expand_crop_box(&cars[i], img_w, img_h, 0.05f, 0.05f, &rois[n++]);
+    }
+    if (n == 0) {
+        if (diag)
+            memset(diag, 0, sizeof(*diag));
+        return 0;
+    }
+    for (k = 0; k < (int)(sizeof(scales) / sizeof(scales[0])) && !packed; k++)
+        packed = cascade_pack_tiles(rois, n, scales[k], tiles);
+    if (!packed)
+        return -1;
+
+    pthread_mutex_lock(&m->run_lock);
+    npu_in = rknn_io_input(&m->io);
+    if (npu_in)
+        model_in = npu_in;
+    canvas = (m->in_w == ALGO_STREAM_SIZE && m->in_h == ALGO_STREAM_SIZE) ? model_in : det_rgb;
+    memset(canvas, 0, (size_t)ALGO_STREAM_SIZE * ALGO_STREAM_SIZE * 3U);
+    for (i = 0; i < n; i++) {
+        const struct detect_tile *t = &tiles[i];
+
+        pixconv_rgb888_blit_nn(rgb + ((size_t)t->src_y * img_w + (size_t)t->src_x) * 3U, img_w,
+                               t->lb.src_w, t->lb.src_h,
+                               canvas + ((size_t)t->lb.pad_y * ALGO_STREAM_SIZE + (size_t)t->lb.pad_x) * 3U,
+                               ALGO_STREAM_SIZE, t->lb.dst_w, t->lb.dst_h);
+    }
+    if (canvas != model_in) {
+        if (!preproc_rga_resize(ctx, canvas, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                                model_in, (int)m->in_w, (int)m->in_h,
+                                0, 0, (int)m->in_w, (int)m->in_h))
+            resize_rgb888_nn(canvas, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                             model_in, (int)m->in_w, (int)m->in_h);
+    }
+    ret = run_model_detect(m, model_in, ALGO_STREAM_SIZE, ALGO_STREAM_SIZE,
+                           conf_thr, cand, &cand_count, diag);
+    pthread_mutex_unlock(&m->run_lock);
+    if (ret < 0)
+        return -1;
+
+    for (k = 0; k < cand_count && *out_count < MAX_DETS; k++) {
+        int cx = (cand[k].x1 + cand[k].x2) / 2;
+        int cy = (cand[k].y1 + cand[k].y2) / 2;
+        for (i = 0; i < n; i++) {
+            const struct letterbox_meta *lb = &tiles[i].lb;
+            if (cx >= lb->pad_x && cx < lb->pad_x + lb->dst_w &&
+                cy >= lb->pad_y && cy < lb->pad_y + lb->dst_h)
+                break;
+        }
+        if (i == n)
+            continue;
+        out[*out_count] = cand[k];
+        map_box_from_detect_tile(&out[*out_count], &tiles[i], img_w, img_h);
+        (*out_count)++;
+    }
+    /* Overlapping vehicle ROIs can each see the same plate. */
+    nms_inplace(out, out_count, m->nms_iou_thr);
+    return 0;
+}
+
 static float rows_get_value(const float *buf, bool transposed, int n_rows, int n_cols, int r, int c)
 {
     if (transposed)
@@ -4537,6 +6589,10 @@ struct yolo_head_view {
     int attrs;
     int stride;
     int layout;
+    const float *buf;
+    const int8_t *qbuf;     /* INT8 decode: raw tensor, read via zp/scale */
+    int32_t zp;
+    float scale;
 };
 
 static bool parse_yolo_head_view(const struct yolo_model *m, uint32_t out_idx, struct yolo_head_view *hv)
@@ -4633,7 +6689,7 @@ static void sort_heads_by_stride(struct yolo_head_view *heads, int n)
     }
 }
 
-static float head_read(const float *buf, const struct yolo_head_view *hv, int a, int gy, int gx, int k)
+static size_t head_index(const struct yolo_head_view *hv, int a, int gy, int gx, int k)
 {
     size_t idx = 0;
     if (hv->layout == YOLO_HEAD_4D_NCHW) {
@@ -4647,10 +6703,18 @@ static float head_read(const float *buf, const struct yolo_head_view *hv, int a,
     } else {
         idx = ((((size_t)gy * (size_t)hv->w + (size_t)gx) * (size_t)hv->anchors + (size_t)a) * (size_t)hv->attrs) + (size_t)k;
     }
-    return buf[idx];
+    return idx;
+}
+
+static float head_read(const struct yolo_head_view *hv, int a, int gy, int gx, int k)
+{
+    size_t idx = head_index(hv, a, gy, gx, k);
+    if (hv->qbuf)
+        return ((float)hv->qbuf[idx] - (float)hv->zp) * hv->scale;
+    return hv->buf[idx];
 }
 
-static void decode_yolo_head_output(const float *buf, const struct yolo_head_view *hv,
+static void decode_yolo_head_output(const struct yolo_head_view *hv,
                                     const float anchors[3][2], int class_count, float conf_thr,
                                     int src_w, int src_h, int in_w, int in_h,
                                     struct det_box *out, int *out_count)
@@ -4660,6 +6724,7 @@ static void decode_yolo_head_output(const float *buf, const struct yolo_head_vie
     int a;
     int classes = hv->attrs - 5;
     int cls_lim = class_count;
+    int q_obj_min = hv->qbuf ? quant_logit_floor(conf_thr * 0.5f, hv->zp, hv->scale) : 0;
     if (classes <= 0)
         return;
     if (cls_lim <= 0)
@@ -4670,12 +6735,8 @@ static void decode_yolo_head_output(const float *buf, const struct yolo_head_vie
     for (gy = 0; gy < hv->h && *out_count < MAX_DETS; gy++) {
         for (gx = 0; gx < hv->w && *out_count < MAX_DETS; gx++) {
             for (a = 0; a < 3 && *out_count < MAX_DETS; a++) {
-                float tx = head_read(buf, hv, a, gy, gx, 0);
-                float ty = head_read(buf, hv, a, gy, gx, 1);
-                float tw = head_read(buf, hv, a, gy, gx, 2);
-                float th = head_read(buf, hv, a, gy, gx, 3);
-                float to = head_read(buf, hv, a, gy, gx, 4);
-                float obj = sigmoidf_local(to);
+                float tx, ty, tw, th;
+                float obj;
                 float best = (cls_lim > 0) ? 0.0f : 1.0f;
                 int best_id = 0;
                 int c;
@@ -4686,11 +6747,15 @@ static void decode_yolo_head_output(const float *buf, const struct yolo_head_vie
                 float bh;
                 float conf;
 
+                /* Objectness first: almost every anchor stops here. */
+                if (hv->qbuf && hv->qbuf[head_index(hv, a, gy, gx, 4)] < q_obj_min)
+                    continue;
+                obj = sigmoidf_local(head_read(hv, a, gy, gx, 4));
                 if (obj < conf_thr * 0.5f)
                     continue;
 
                 for (c = 0; c < cls_lim; c++) {
-                    float p = sigmoidf_local(head_read(buf, hv, a, gy, gx, 5 + c));
+                    float p = sigmoidf_local(head_read(hv, a, gy, gx, 5 + c));
                     if (p > best) {
                         best = p;
                         best_id = c;
@@ -4701,6 +6766,11 @@ static void decode_yolo_head_output(const float *buf, const struct yolo_head_vie
                 if (conf < conf_thr)
                     continue;
 
+                tx = head_read(hv, a, gy, gx, 0);
+                ty = head_read(hv, a, gy, gx, 1);
+                tw = head_read(hv, a, gy, gx, 2);
+                th = head_read(hv, a, gy, gx, 3);
+
                 bx = ((sigmoidf_local(tx) * 2.0f - 0.5f) + (float)gx) * (float)hv->stride;
                 by = ((sigmoidf_local(ty) * 2.0f - 0.5f) + (float)gy) * (float)hv->stride;
                 bw = powf(sigmoidf_local(tw) * 2.0f, 2.0f) * anchors[a][0];
@@ -4721,7 +6791,7 @@ static void decode_yolo_head_output(const float *buf, const struct yolo_head_vie
 }
 
 static void decode_yolo_heads_outputs(const struct yolo_model *m, const rknn_output *outs,
-                                      float conf_thr, int src_w, int src_h,
+                                      bool quantized, float conf_thr, int src_w, int src_h,
                                       struct det_box *out, int *out_count)
 {
     static const float anchors_p5[3][3][2] = {
@@ -4759,7 +6829,16 @@ static void decode_yolo_heads_outputs(const struct yolo_model *m, const rknn_out
         if (!anchors)
             continue;
 
-        decode_yolo_head_output((const float *)outs[heads[i].out_idx].buf, &heads[i], anchors,
+        heads[i].buf = NULL;
+        heads[i].qbuf = NULL;
+        if (quantized) {
+            heads[i].qbuf = (const int8_t *)outs[heads[i].out_idx].buf;
+            heads[i].zp = m->output_attrs[heads[i].out_idx].zp;
+            heads[i].scale = m->output_attrs[heads[i].out_idx].scale;
+        } else {
+            heads[i].buf = (const float *)outs[heads[i].out_idx].buf;
+        }
+        decode_yolo_head_output(&heads[i], anchors,
                                 m->class_count, conf_thr, src_w, src_h,
                                 (int)m->in_w, (int)m->in_h, out, out_count);
     }
@@ -4767,6 +6846,9 @@ static void decode_yolo_heads_outputs(const struct yolo_model *m, const rknn_out
 
 struct tensor_cn_view {
     const float *buf;
+    const int8_t *qbuf;     /* INT8 decode: raw tensor, read via zp/scale */
+    int32_t zp;
+    float scale;
     int c;
     int n;
     bool c_major;
@@ -4833,11 +6915,34 @@ static bool build_tensor_cn_view(const rknn_tensor_attr *a, const float *buf, st
     return false;
 }
 
-static float tensor_cn_read(const struct tensor_cn_view *tv, int c, int n)
+static size_t tensor_cn_index(const struct tensor_cn_view *tv, int c, int n)
 {
     if (tv->c_major)
-        return tv->buf[(size_t)c * (size_t)tv->n + (size_t)n];
-    return tv->buf[(size_t)n * (size_t)tv->c + (size_t)c];
+        return (size_t)c * (size_t)tv->n + (size_t)n;
+    return (size_t)n * (size_t)tv->c + (size_t)c;
+}
+
+static float tensor_cn_read(const struct tensor_cn_view *tv, int c, int n)
+{
+    size_t idx = tensor_cn_index(tv, c, n);
+    if (tv->qbuf)
+        return ((float)tv->qbuf[idx] - (float)tv->zp) * tv->scale;
+    return tv->buf[idx];
+}
+
+/* build_tensor_cn_view over output @i, switched to INT8 reads when @quantized. */
+static bool build_output_cn_view(const struct yolo_model *m, const rknn_output *outs, bool quantized,
+                                 uint32_t i, struct tensor_cn_view *tv)
+{
+    if (!build_tensor_cn_view(&m->output_attrs[i], (const float *)outs[i].buf, tv))
+        return false;
+    if (quantized) {
+        tv->qbuf = (const int8_t *)outs[i].buf;
+        tv->buf = NULL;
+        tv->zp = m->output_attrs[i].zp;
+        tv->scale = m->output_attrs[i].scale;
+    }
+    return true;
 }
 
 static void tensor_sample_minmax(const struct tensor_cn_view *tv, float *min_v, float *max_v)
@@ -4900,7 +7005,7 @@ static bool build_obb_anchor_cache(struct obb_anchor_cache *cache)
     return true;
 }
 
-static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output *outs,
+static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output *outs, bool quantized,
                                    struct tensor_cn_view *dist_view,
                                    struct tensor_cn_view *cls_view,
                                    struct tensor_cn_view *angle_view)
@@ -4925,9 +7030,9 @@ static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output
         struct tensor_cn_view tv0;
         struct tensor_cn_view tv1;
         struct tensor_cn_view tv2;
-        if (build_tensor_cn_view(&m->output_attrs[0], (const float *)outs[0].buf, &tv0) &&
-            build_tensor_cn_view(&m->output_attrs[1], (const float *)outs[1].buf, &tv1) &&
-            build_tensor_cn_view(&m->output_attrs[2], (const float *)outs[2].buf, &tv2) &&
+        if (build_output_cn_view(m, outs, quantized, 0, &tv0) &&
+            build_output_cn_view(m, outs, quantized, 1, &tv1) &&
+            build_output_cn_view(m, outs, quantized, 2, &tv2) &&
             tv0.c == 4 && tv0.n == OBB_POINT_COUNT &&
             tv1.c >= 1 && tv1.n == OBB_POINT_COUNT &&
             tv2.c == 1 && tv2.n == OBB_POINT_COUNT) {
@@ -4940,7 +7045,7 @@ static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output
 
     for (i = 0; i < m->io_num.n_output; i++) {
         struct tensor_cn_view tv;
-        if (!build_tensor_cn_view(&m->output_attrs[i], (const float *)outs[i].buf, &tv))
+        if (!build_output_cn_view(m, outs, quantized, i, &tv))
             continue;
         if (tv.n != OBB_POINT_COUNT)
             continue;
@@ -4962,8 +7067,8 @@ static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output
         struct tensor_cn_view t0;
         struct tensor_cn_view t1;
         float mn0, mx0, mn1, mx1;
-        build_tensor_cn_view(&m->output_attrs[ones[0]], (const float *)outs[ones[0]].buf, &t0);
-        build_tensor_cn_view(&m->output_attrs[ones[1]], (const float *)outs[ones[1]].buf, &t1);
+        build_output_cn_view(m, outs, quantized, ones[0], &t0);
+        build_output_cn_view(m, outs, quantized, ones[1], &t1);
         tensor_sample_minmax(&t0, &mn0, &mx0);
         tensor_sample_minmax(&t1, &mn1, &mx1);
         if (mn0 >= -1.2f && mx0 <= 3.2f) {
@@ -4985,11 +7090,11 @@ static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output
     if (cls_idx < 0 || angle_idx < 0)
         return false;
 
-    if (!build_tensor_cn_view(&m->output_attrs[dist_idx], (const float *)outs[dist_idx].buf, dist_view))
+    if (!build_output_cn_view(m, outs, quantized, dist_idx, dist_view))
         return false;
-    if (!build_tensor_cn_view(&m->output_attrs[cls_idx], (const float *)outs[cls_idx].buf, cls_view))
+    if (!build_output_cn_view(m, outs, quantized, cls_idx, cls_view))
         return false;
-    if (!build_tensor_cn_view(&m->output_attrs[angle_idx], (const float *)outs[angle_idx].buf, angle_view))
+    if (!build_output_cn_view(m, outs, quantized, angle_idx, angle_view))
         return false;
     return dist_view->c == 4 && angle_view->c == 1 && cls_view->c >= 1 &&
            dist_view->n == OBB_POINT_COUNT && cls_view->n == OBB_POINT_COUNT &&
@@ -4997,7 +7102,7 @@ static bool infer_obb_output_views(const struct yolo_model *m, const rknn_output
 }
 
 static int decode_yolov8_obb_outputs(const struct yolo_model *m, const rknn_output *outs,
-                                     float conf_thr, int src_w, int src_h,
+                                     bool quantized, float conf_thr, int src_w, int src_h,
                                      struct det_box *out, int *out_count)
 {
     static struct obb_anchor_cache anchor_cache = {0};
@@ -5011,14 +7116,17 @@ static int decode_yolov8_obb_outputs(const struct yolo_model *m, const rknn_outp
     int cls_end;
     int i;
     int count = 0;
+    int q_cls_min = 0;
 
     *out_count = 0;
     if (m->in_w != ALGO_STREAM_SIZE || m->in_h != ALGO_STREAM_SIZE)
         return -1;
     if (!build_obb_anchor_cache(&anchor_cache))
         return -1;
-    if (!infer_obb_output_views(m, outs, &dist_view, &cls_view, &angle_view))
+    if (!infer_obb_output_views(m, outs, quantized, &dist_view, &cls_view, &angle_view))
         return -1;
+    if (cls_view.qbuf)
+        q_cls_min = quant_logit_floor(conf_thr, cls_view.zp, cls_view.scale);
 
     cls_count = cls_view.c;
     if (m->class_count > 0 && m->class_count < cls_count)
@@ -5045,11 +7153,26 @@ static int decode_yolov8_obb_outputs(const struct yolo_model *m, const rknn_outp
         float stride;
         struct det_box det;
 
-        for (c = cls_start; c < cls_end; c++) {
-            float p = sigmoidf_local(tensor_cn_read(&cls_view, c, i));
-            if (p > best) {
-                best = p;
-                best_id = c;
+        if (cls_view.qbuf) {
+            /* Argmax on raw logits, then one dequant + sigmoid per anchor. */
+            int best_q = -129;
+            for (c = cls_start; c < cls_end; c++) {
+                int q = cls_view.qbuf[tensor_cn_index(&cls_view, c, i)];
+                if (q > best_q) {
+                    best_q = q;
+                    best_id = c;
+                }
+            }
+            if (best_q < q_cls_min)
+                continue;
+            best = sigmoidf_local(((float)best_q - (float)cls_view.zp) * cls_view.scale);
+        } else {
+            for (c = cls_start; c < cls_end; c++) {
+                float p = sigmoidf_local(tensor_cn_read(&cls_view, c, i));
+                if (p > best) {
+                    best = p;
+                    best_id = c;
+                }
             }
         }
         if (best < conf_thr)
@@ -5106,16 +7229,18 @@ static int decode_yolov8_obb_outputs(const struct yolo_model *m, const rknn_outp
     return 0;
 }
 
+/* Caller holds m->run_lock. */
 static int run_model_detect(struct yolo_model *m, const uint8_t *in_rgb, int src_w, int src_h,
                             float conf_thr, struct det_box *out, int *out_count,
                             struct detect_decode_diag *diag)
 {
-    rknn_input in;
     rknn_output outs[8];
     struct det_box rows_out[MAX_DETS];
     struct det_box heads_out[MAX_DETS];
     int rows_count = 0;
     int heads_count = 0;
+    bool quantized = m->int8_decode;
+    int64_t pt;
     uint32_t i;
     int ret;
 
@@ -5123,28 +7248,18 @@ static int run_model_detect(struct yolo_model *m, const uint8_t *in_rgb, int src
     if (diag)
         memset(diag, 0, sizeof(*diag));
 
-    memset(&in, 0, sizeof(in));
-    in.index = 0;
-    in.buf = (void *)in_rgb;
-    in.size = m->in_w * m->in_h * 3;
-    in.type = RKNN_TENSOR_UINT8;
-    in.fmt = RKNN_TENSOR_NHWC;
-    ret = rknn_inputs_set(m->ctx, 1, &in);
-    if (ret < 0) return ret;
-    ret = rknn_run(m->ctx, NULL);
-    if (ret < 0) return ret;
-
-    memset(outs, 0, sizeof(outs));
-    for (i = 0; i < m->io_num.n_output; i++)
-        outs[i].want_float = 1;
-    ret = rknn_outputs_get(m->ctx, m->io_num.n_output, outs, NULL);
+    pt = prof_begin();
+    ret = rknn_io_run(m->ctx, &m->io, in_rgb, m->in_w * m->in_h * 3, RKNN_TENSOR_UINT8,
+                      RKNN_TENSOR_NHWC, quantized, outs);
+    prof_end(m->prof_stage + 1, pt);
     if (ret < 0) return ret;
+    pt = prof_begin();
 
     if (m->detector_type == DETECTOR_YOLOV8_OBB_RKNN) {
-        ret = decode_yolov8_obb_outputs(m, outs, conf_thr, src_w, src_h, out, out_count);
+        ret = decode_yolov8_obb_outputs(m, outs, quantized, conf_thr, src_w, src_h, out, out_count);
         if (ret < 0) {
             *out_count = 0;
-            rknn_outputs_release(m->ctx, m->io_num.n_output, outs);
+            rknn_io_outputs_done(m->ctx, &m->io, outs);
             return ret;
         }
         if (diag) {
@@ -5154,18 +7269,21 @@ static int run_model_detect(struct yolo_model *m, const uint8_t *in_rgb, int src
             diag->heads_keep = *out_count;
             diag->mode = (*out_count > 0) ? PLATE_DECODE_OBB : PLATE_DECODE_NONE;
         }
-        rknn_outputs_release(m->ctx, m->io_num.n_output, outs);
+        rknn_io_outputs_done(m->ctx, &m->io, outs);
+        prof_end(m->prof_stage + 2, pt);
         return 0;
     }
 
     for (i = 0; i < m->io_num.n_output; i++) {
         const rknn_tensor_attr *a = &m->output_attrs[i];
+        /* Row tensors are small; a float copy keeps their decoder unchanged. */
         if (a->n_dims == 3 && rows_count == 0)
-            decode_rows_tensor_output(a, (const float *)outs[i].buf, m->class_count,
+            decode_rows_tensor_output(a, quantized ? rknn_io_dequant(&m->io, outs, i)
+                                                   : (const float *)outs[i].buf, m->class_count,
                                       conf_thr, src_w, src_h, (int)m->in_w, (int)m->in_h,
                                       rows_out, &rows_count);
     }
-    decode_yolo_heads_outputs(m, outs, conf_thr, src_w, src_h, heads_out, &heads_count);
+    decode_yolo_heads_outputs(m, outs, quantized, conf_thr, src_w, src_h, heads_out, &heads_count);
 
     if (diag) {
         diag->rows_raw = rows_count;
@@ -5217,7 +7335,8 @@ static int run_model_detect(struct yolo_model *m, const uint8_t *in_rgb, int src
     if (*out_count > MAX_DETS)
         *out_count = MAX_DETS;
 
-    rknn_outputs_release(m->ctx, m->io_num.n_output, outs);
+    rknn_io_outputs_done(m->ctx, &m->io, outs);
+    prof_end(m->prof_stage + 2, pt);
     return 0;
 }
 
@@ -5725,7 +7844,31 @@ static int parse_roi_arg(const char *arg, struct det_box *b)
     return 0;
 }
 
-static int run_offline_once(struct app_ctx *ctx)
+/* One offline image: the prediction and, when asked, the crop pair to dump. */
+struct offline_result {
+    struct plate_det pd;
+    uint8_t *crop;          /* crop_w x crop_h RGB888, NULL unless a dump was asked for */
+    int crop_w;
+    int crop_h;
+    uint8_t *ocr_in;        /* OCR model input, set together with crop */
+};
+
+static void offline_result_free(struct offline_result *res)
+{
+    free(res->crop);
+    free(res->ocr_in);
+    res->crop = NULL;
+    res->ocr_in = NULL;
+}
+
+/*
+ * Detect (or take @roi_arg), crop and OCR one PPM. Touches no shared output
+ * state, so batch workers can run it on private contexts; the caller logs
+ * the result. @arena is kept across calls and grows to the largest image.
+ */
+static int offline_infer_image(struct app_ctx *ctx, struct frame_arena *arena,
+                               const char *path, const char *roi_arg, bool want_dump,
+                               struct offline_result *res)
 {
     uint8_t *rgb = NULL;
     uint8_t *rgb_detect = NULL;
@@ -5747,18 +7890,22 @@ static int run_offline_once(struct app_ctx *ctx)
     int crop_w;
     int crop_h;
     int ret = -1;
-    int64_t ts_us;
     const uint8_t *det_src_rgb = NULL;
     float occ_ratio = 0.0f;
     bool used_obb_warp = false;
 
-    if (read_ppm_rgb888(ctx->opt.offline_image_path, &rgb, &w, &h) < 0) {
-        fprintf(stderr, "Offline image load failed (need PPM P6): %s\n",
-                ctx->opt.offline_image_path ? ctx->opt.offline_image_path : "<null>");
+    memset(res, 0, sizeof(*res));
+    if (read_ppm_rgb888(path, &rgb, &w, &h) < 0) {
+        fprintf(stderr, "Offline image load failed (need PPM P6): %s\n", path ? path : "<null>");
         return -1;
     }
     ctx->frame_width = (uint32_t)w;
     ctx->frame_height = (uint32_t)h;
+    /* Failure only means every scratch allocation goes to malloc. */
+    if (!arena->base)
+        frame_arena_init(arena, frame_arena_estimate(ctx));
+    g_frame_arena = arena;
+    frame_arena_reset(arena);
     det_src_rgb = rgb;
     plate_crop = malloc((size_t)w * h * 3U);
     if (!plate_crop)
@@ -5777,8 +7924,8 @@ static int run_offline_once(struct app_ctx *ctx)
     memset(&plate_diag, 0, sizeof(plate_diag));
     memset(&box, 0, sizeof(box));
 
-    if (ctx->opt.offline_roi_arg && ctx->opt.offline_roi_arg[0] != '\0') {
-        if (parse_roi_arg(ctx->opt.offline_roi_arg, &box) < 0) {
+    if (roi_arg && roi_arg[0] != '\0') {
+        if (parse_roi_arg(roi_arg, &box) < 0) {
             fprintf(stderr, "Invalid --offline-roi, expect x1,y1,x2,y2\n");
             goto out;
         }
@@ -5789,7 +7936,7 @@ static int run_offline_once(struct app_ctx *ctx)
         if (!algo_rgb || !plate_in)
             goto out;
 
-        if (run_detect_on_rgb(ctx, &ctx->plate_model, det_src_rgb, w, h,
+        if (run_detect_on_rgb(ctx, &ctx->plate_model, ctx->opt.det_resize_mode, det_src_rgb, w, h,
                               ctx->opt.min_plate_conf, algo_rgb, plate_in,
                               dets, &det_count, &plate_diag) < 0) {
             fprintf(stderr, "Offline plate detect failed\n");
@@ -5813,15 +7960,12 @@ static int run_offline_once(struct app_ctx *ctx)
             if (valid_count > 0) {
                 fprintf(stderr, "Offline plate detect fallback(relaxed=%d raw=%d)\n", valid_count, det_count);
             } else if (ctx->opt.det_resize_mode == DET_RESIZE_LETTERBOX) {
-                int saved_mode = ctx->opt.det_resize_mode;
                 fprintf(stderr, "Offline plate detect retry with stretch(raw=%d)\n", det_count);
-                ctx->opt.det_resize_mode = DET_RESIZE_STRETCH;
-                if (run_detect_on_rgb(ctx, &ctx->plate_model, det_src_rgb, w, h,
+                if (run_detect_on_rgb(ctx, &ctx->plate_model, DET_RESIZE_STRETCH, det_src_rgb, w, h,
                                       ctx->opt.min_plate_conf, algo_rgb, plate_in,
                                       dets, &det_count, &plate_diag) < 0) {
                     det_count = 0;
                 }
-                ctx->opt.det_resize_mode = saved_mode;
                 for (i = 0; i < det_count && valid_count < MAX_DETS; i++) {
                     if (plate_box_pass_rules(&dets[i], w, h) ||
                         plate_box_pass_rules_relaxed(&dets[i], w, h))
@@ -5876,7 +8020,7 @@ static int run_offline_once(struct app_ctx *ctx)
             have_recap = true;
         }
         if (!have_recap) {
-            fprintf(stderr, "[ocr-recrop] trigger=0 old_occ=%.3f mode=match-ytrim reason=not-improvable\n", old_occ);
+            lpr_log(LOG_INFO, "[ocr-recrop] trigger=0 old_occ=%.3f mode=match-ytrim reason=not-improvable\n", old_occ);
         } else {
             new_w = recrop_box.x2 - recrop_box.x1 + 1;
             new_h = recrop_box.y2 - recrop_box.y1 + 1;
@@ -5886,13 +8030,13 @@ static int run_offline_once(struct app_ctx *ctx)
                 crop_w = new_w;
                 crop_h = new_h;
                 occ_ratio = estimate_ocr_occ_ratio(ctx, crop_w, crop_h);
-                fprintf(stderr, "[ocr-recrop] trigger=1 old_occ=%.3f new_mode=%s new_occ=%.3f\n",
+                lpr_log(LOG_INFO, "[ocr-recrop] trigger=1 old_occ=%.3f new_mode=%s new_occ=%.3f\n",
                         old_occ, mode_tag, occ_ratio);
             }
         }
     }
     pd.ocr_in_occ_ratio = occ_ratio;
-    fprintf(stderr, "[crop-geom] box=[%d,%d,%d,%d] crop=[%d,%d,%d,%d] iou=%.3f\n",
+    lpr_log(LOG_DEBUG, "[crop-geom] box=[%d,%d,%d,%d] crop=[%d,%d,%d,%d] iou=%.3f\n",
             pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
             pd.crop_box.x1, pd.crop_box.y1, pd.crop_box.x2, pd.crop_box.y2,
             box_iou(&pd.box, &pd.crop_box));
@@ -5912,7 +8056,7 @@ static int run_offline_once(struct app_ctx *ctx)
             fprintf(stderr, "[offline][skip] reason=blur sharp=%.2f min=%.2f\n",
                     sharp, ctx->opt.ocr_min_sharpness);
         } else {
-            if (ctx->ocr_crop_index_fp && ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max)
+            if (want_dump)
                 ret = run_model_ocr(ctx, plate_crop, crop_w, crop_h,
                                     pd.ocr_text, sizeof(pd.ocr_text), &pd.ocr_conf,
                                     &odiag, &ocr_input_dump);
@@ -5932,7 +8076,7 @@ static int run_offline_once(struct app_ctx *ctx)
 
     fprintf(stderr,
             "[offline] image=%s size=%dx%d box=[%d,%d,%d,%d] crop=[%d,%d,%d,%d]\n",
-            ctx->opt.offline_image_path, w, h,
+            path, w, h,
             pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
             pd.crop_box.x1, pd.crop_box.y1, pd.crop_box.x2, pd.crop_box.y2);
     if (ctx->opt.ocr_ctc_diag) {
@@ -5944,22 +8088,30 @@ static int run_offline_once(struct app_ctx *ctx)
             "[offline][pred] text=%s conf=%.4f type=%s color=%s\n",
             pd.ocr_text, pd.ocr_conf, plate_type_str(pd.type), plate_color_str(pd.color));
 
-    ts_us = mono_us();
-    log_prediction_row(ctx, 0, ts_us, &pd);
-    if (!ocr_input_dump && ctx->ocr_crop_index_fp &&
-        ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max) {
+    if (want_dump && !ocr_input_dump)
         ocr_input_dump = prepare_ocr_input_rgb888(ctx, plate_crop, crop_w, crop_h, NULL);
-    }
     if (ocr_input_dump) {
-        dump_ocr_pair(ctx, 0, &pd, plate_crop, crop_w, crop_h,
-                      ocr_input_dump, (int)ctx->ocr_model.in_w, (int)ctx->ocr_model.in_h);
-        free(ocr_input_dump);
-        ocr_input_dump = NULL;
+        /* Arena memory is reused by the next image, so the pair is copied out. */
+        size_t crop_bytes = (size_t)crop_w * crop_h * 3U;
+        size_t in_bytes = (size_t)ctx->ocr_model.in_w * ctx->ocr_model.in_h * 3U;
+
+        res->crop = malloc(crop_bytes);
+        res->ocr_in = malloc(in_bytes);
+        if (res->crop && res->ocr_in) {
+            memcpy(res->crop, plate_crop, crop_bytes);
+            memcpy(res->ocr_in, ocr_input_dump, in_bytes);
+            res->crop_w = crop_w;
+            res->crop_h = crop_h;
+        } else {
+            offline_result_free(res);
+        }
     }
+    res->pd = pd;
     ret = 0;
 
 out:
-    free(ocr_input_dump);
+    frame_free(ocr_input_dump);
+    g_frame_arena = NULL;
     free(plate_crop);
     free(plate_in);
     free(algo_rgb);
@@ -5968,72 +8120,625 @@ out:
     return ret;
 }
 
-static void dump_ocr_pair(struct app_ctx *ctx, uint64_t frame_id, const struct plate_det *pd,
-                          const uint8_t *crop_rgb, int crop_w, int crop_h,
-                          const uint8_t *ocr_in, int ocr_w, int ocr_h)
+static void offline_emit(struct app_ctx *ctx, uint64_t frame_id, const struct offline_result *res)
 {
-    char crop_path[640];
-    char in_path[640];
-    char safe_text[64];
-    int idx;
-    int64_t ts;
+    log_prediction_row(ctx, frame_id, mono_us(), &res->pd);
+    if (res->crop)
+        dump_ocr_pair(ctx, frame_id, &res->pd, res->crop, res->crop_w, res->crop_h,
+                      res->ocr_in, (int)ctx->ocr_model.in_w, (int)ctx->ocr_model.in_h);
+}
 
-    if (!ctx->opt.ocr_crop_dump_dir || ctx->opt.ocr_crop_dump_dir[0] == '\0')
-        return;
-    if (ctx->opt.ocr_crop_dump_max <= 0)
-        return;
-    if (ctx->ocr_crop_dumped >= ctx->opt.ocr_crop_dump_max)
-        return;
-    if (!ctx->ocr_crop_index_fp)
-        return;
+static int run_offline_once(struct app_ctx *ctx)
+{
+    struct offline_result res;
+    struct frame_arena arena;
+    bool want_dump = ctx->ocr_crop_index_fp && ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max;
+    int ret;
 
-    idx = ctx->ocr_crop_dumped;
-    snprintf(crop_path, sizeof(crop_path), "%s/crop_%04d_f%06" PRIu64 ".ppm",
-             ctx->opt.ocr_crop_dump_dir, idx, frame_id);
-    snprintf(in_path, sizeof(in_path), "%s/ocrin_%04d_f%06" PRIu64 ".ppm",
-             ctx->opt.ocr_crop_dump_dir, idx, frame_id);
+    memset(&arena, 0, sizeof(arena));
+    ret = offline_infer_image(ctx, &arena, ctx->opt.offline_image_path, ctx->opt.offline_roi_arg,
+                              want_dump, &res);
+    if (ret == 0)
+        offline_emit(ctx, 0, &res);
+    offline_result_free(&res);
+    frame_arena_release(&arena);
+    return ret;
+}
 
-    if (write_ppm_rgb888(crop_path, crop_rgb, crop_w, crop_h) < 0)
-        return;
-    if (ocr_in && ocr_w > 0 && ocr_h > 0) {
-        if (write_ppm_rgb888(in_path, ocr_in, ocr_w, ocr_h) < 0)
-            return;
-    } else {
-        in_path[0] = '\0';
-    }
+/*
+ * --offline-batch: models are loaded once, then every worker runs on a
+ * private app_ctx copy whose RKNN contexts are rknn_dup_context() clones
+ * (weights shared, I/O buffers private). Workers take images in list order
+ * and the main thread writes results in that same order, so the prediction
+ * log matches a sequential run. The window bounds how far workers may run
+ * ahead, which also bounds the crop pairs held for dumping.
+ */
+struct offline_item {
+    char *path;
+    char *roi;              /* NULL: --offline-roi or plate detection */
+    uint64_t frame_id;
+    int ret;
+    bool done;
+    struct offline_result res;
+};
 
-    ts = mono_us();
-    csv_safe_text(pd->ocr_text, safe_text, sizeof(safe_text));
-    fprintf(ctx->ocr_crop_index_fp,
-            "%d,%" PRIu64 ",%" PRId64 ",%d,%d,%d,%d,%d,%d,%d,%d,%s,%.4f,%.4f,%.4f,%s,%s\n",
-            idx, frame_id, ts,
-            pd->box.x1, pd->box.y1, pd->box.x2, pd->box.y2,
-            pd->crop_box.x1, pd->crop_box.y1, pd->crop_box.x2, pd->crop_box.y2,
-            safe_text, pd->ocr_conf, pd->ocr_blank_top1, pd->ocr_in_occ_ratio, crop_path, in_path);
-    fflush(ctx->ocr_crop_index_fp);
-    ctx->ocr_crop_dumped++;
-}
+struct offline_batch {
+    struct offline_item *items;
+    int count;
+    int cap;
+    int next;               /* next item handed to a worker */
+    int written;            /* items emitted by the main thread */
+    int window;
+    int active;             /* workers still running */
+    bool dump_open;         /* crop dumps still below --ocr-crop-dump-max */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
 
-static void log_prediction_row(struct app_ctx *ctx, uint64_t frame_id, int64_t ts_us,
-                               const struct plate_det *pd)
+struct offline_worker {
+    struct offline_batch *batch;
+    struct app_ctx *ctx;
+    struct frame_arena arena;
+    pthread_t thread;
+    bool started;
+};
+
+static int offline_batch_add(struct offline_batch *b, const char *path, const char *roi,
+                             uint64_t frame_id)
 {
-    char safe_text[64];
-    if (!ctx->pred_log_fp)
-        return;
+    struct offline_item *it;
+
+    if (b->count == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 256;
+        struct offline_item *items = realloc(b->items, (size_t)cap * sizeof(*items));
+        if (!items)
+            return -1;
+        b->items = items;
+        b->cap = cap;
+    }
+    it = &b->items[b->count];
+    memset(it, 0, sizeof(*it));
+    it->path = strdup(path);
+    it->roi = roi ? strdup(roi) : NULL;
+    if (!it->path || (roi && !it->roi)) {
+        free(it->path);
+        free(it->roi);
+        return -1;
+    }
+    it->frame_id = frame_id;
+    b->count++;
+    return 0;
+}
+
+static int offline_ppm_filter(const struct dirent *d)
+{
+    size_t n = strlen(d->d_name);
+    return d->d_name[0] != '.' && n > 4 && strcasecmp(d->d_name + n - 4, ".ppm") == 0;
+}
+
+/* Directory: every *.ppm in name order, frame_id = position. */
+static int offline_batch_scan_dir(struct offline_batch *b, const char *dir)
+{
+    struct dirent **names = NULL;
+    char path[1024];
+    int n;
+    int i;
+    int ret = 0;
+
+    n = scandir(dir, &names, offline_ppm_filter, alphasort);
+    if (n < 0) {
+        fprintf(stderr, "[batch] cannot scan %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name);
+        if (ret == 0 && offline_batch_add(b, path, NULL, (uint64_t)i) < 0)
+            ret = -1;
+        free(names[i]);
+    }
+    free(names);
+    return ret;
+}
+
+/*
+ * Manifest: one "<path> [frame_id] [x1,y1,x2,y2]" per line, '#' comments.
+ * Relative paths are taken from the manifest's directory; frame_id
+ * defaults to the line's position among the images.
+ */
+static int offline_batch_read_manifest(struct offline_batch *b, const char *list)
+{
+    char line[1200];
+    char base[1024];
+    char path[2048];
+    const char *slash;
+    FILE *fp;
+    int lineno = 0;
+    int ret = 0;
+
+    fp = fopen(list, "r");
+    if (!fp) {
+        fprintf(stderr, "[batch] cannot open %s: %s\n", list, strerror(errno));
+        return -1;
+    }
+    slash = strrchr(list, '/');
+    snprintf(base, sizeof(base), "%.*s", slash ? (int)(slash - list) : 1, slash ? list : ".");
+
+    while (ret == 0 && fgets(line, sizeof(line), fp)) {
+        char *save = NULL;
+        char *tok;
+        char *img;
+        char *roi = NULL;
+        uint64_t frame_id = (uint64_t)b->count;
+
+        lineno++;
+        img = strtok_r(line, " \t\r\n", &save);
+        if (!img || img[0] == '#')
+            continue;
+        while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+            if (strchr(tok, ','))
+                roi = tok;
+            else
+                frame_id = strtoull(tok, NULL, 10);
+        }
+        if (img[0] == '/')
+            snprintf(path, sizeof(path), "%s", img);
+        else
+            snprintf(path, sizeof(path), "%s/%s", base, img);
+        if (roi) {
+            struct det_box check;
+            if (parse_roi_arg(roi, &check) < 0) {
+                fprintf(stderr, "[batch] %s:%d: invalid ROI %s\n", list, lineno, roi);
+                ret = -1;
+                break;
+            }
+        }
+        if (offline_batch_add(b, path, roi, frame_id) < 0)
+            ret = -1;
+    }
+    fclose(fp);
+    return ret;
+}
+
+static void offline_worker_ctx_free(struct app_ctx *w)
+{
+    if (!w)
+        return;
+    rknn_model_release(&w->plate_model);
+    rknn_ocr_model_release(&w->ocr_model);
+    rknn_quad_refiner_model_release(&w->quad_refiner_model);
+    free(w);
+}
+
+/* Private copy of @ctx: shared options and keys, cloned RKNN contexts, no log handles. */
+static struct app_ctx *offline_worker_ctx(const struct app_ctx *ctx)
+{
+    struct app_ctx *w = malloc(sizeof(*w));
+    rknn_context src;
+
+    if (!w)
+        return NULL;
+    memcpy(w, ctx, sizeof(*w));
+    memset(&w->veh_model, 0, sizeof(w->veh_model));
+    w->plate_model.ctx = 0;
+    w->plate_model.run_lock_ready = false;
+    w->ocr_model.ctx = 0;
+    w->quad_refiner_model.ctx = 0;
+    memset(&w->plate_model.io, 0, sizeof(w->plate_model.io));
+    memset(&w->ocr_model.io, 0, sizeof(w->ocr_model.io));
+    memset(&w->quad_refiner_model.io, 0, sizeof(w->quad_refiner_model.io));
+    w->pred_log_fp = NULL;
+    w->ocr_crop_index_fp = NULL;
+
+    pthread_mutex_init(&w->plate_model.run_lock, NULL);
+    w->plate_model.run_lock_ready = true;
+    src = ctx->plate_model.ctx;
+    if (rknn_dup_context(&src, &w->plate_model.ctx) < 0)
+        goto fail;
+    src = ctx->ocr_model.ctx;
+    if (rknn_dup_context(&src, &w->ocr_model.ctx) < 0)
+        goto fail;
+    src = ctx->quad_refiner_model.ctx;
+    if (src && rknn_dup_context(&src, &w->quad_refiner_model.ctx) < 0)
+        goto fail;
+    if (init_npu_io(w) < 0)
+        goto fail;
+    return w;
+
+fail:
+    fprintf(stderr, "[batch] rknn_dup_context/io setup failed\n");
+    offline_worker_ctx_free(w);
+    return NULL;
+}
+
+static void *offline_worker_main(void *arg)
+{
+    struct offline_worker *wk = arg;
+    struct offline_batch *b = wk->batch;
+
+    for (;;) {
+        struct offline_item *it;
+        bool want_dump;
+
+        pthread_mutex_lock(&b->lock);
+        while (!g_stop && b->next < b->count && b->next - b->written >= b->window)
+            pthread_cond_wait(&b->cond, &b->lock);
+        if (g_stop || b->next >= b->count) {
+            b->active--;
+            pthread_cond_broadcast(&b->cond);
+            pthread_mutex_unlock(&b->lock);
+            break;
+        }
+        it = &b->items[b->next++];
+        want_dump = b->dump_open;
+        pthread_mutex_unlock(&b->lock);
+
+        it->ret = offline_infer_image(wk->ctx, &wk->arena, it->path,
+                                      it->roi ? it->roi : wk->ctx->opt.offline_roi_arg,
+                                      want_dump, &it->res);
+
+        pthread_mutex_lock(&b->lock);
+        it->done = true;
+        pthread_cond_broadcast(&b->cond);
+        pthread_mutex_unlock(&b->lock);
+    }
+    return NULL;
+}
+
+static int run_offline_batch(struct app_ctx *ctx)
+{
+    struct offline_worker workers[OFFLINE_MAX_WORKERS];
+    struct offline_batch b;
+    struct stat st;
+    int64_t t0;
+    double wall_s;
+    int nworkers = ctx->opt.offline_workers;
+    int ok = 0;
+    int failed = 0;
+    int ret = -1;
+    int i;
+
+    memset(&b, 0, sizeof(b));
+    memset(workers, 0, sizeof(workers));
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.cond, NULL);
+
+    if (stat(ctx->opt.offline_batch_path, &st) < 0) {
+        fprintf(stderr, "[batch] %s: %s\n", ctx->opt.offline_batch_path, strerror(errno));
+        goto out;
+    }
+    if (S_ISDIR(st.st_mode) ? offline_batch_scan_dir(&b, ctx->opt.offline_batch_path) < 0
+                            : offline_batch_read_manifest(&b, ctx->opt.offline_batch_path) < 0)
+        goto out;
+    if (b.count == 0) {
+        fprintf(stderr, "[batch] no images in %s\n", ctx->opt.offline_batch_path);
+        goto out;
+    }
+
+    if (nworkers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (nworkers > OFFLINE_MAX_WORKERS)
+        nworkers = OFFLINE_MAX_WORKERS;
+    if (nworkers > b.count)
+        nworkers = b.count;
+    b.window = nworkers * OFFLINE_WINDOW_PER_WORKER;
+    b.dump_open = ctx->ocr_crop_index_fp && ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max;
+
+    for (i = 0; i < nworkers; i++) {
+        workers[i].batch = &b;
+        workers[i].ctx = offline_worker_ctx(ctx);
+        if (!workers[i].ctx)
+            break;
+    }
+    nworkers = i;
+    if (nworkers == 0)
+        goto out;
+
+    fprintf(stderr, "[batch] images=%d workers=%d window=%d\n", b.count, nworkers, b.window);
+    t0 = mono_us();
+    for (i = 0; i < nworkers; i++) {
+        pthread_mutex_lock(&b.lock);
+        b.active++;
+        pthread_mutex_unlock(&b.lock);
+        if (pthread_create(&workers[i].thread, NULL, offline_worker_main, &workers[i]) != 0) {
+            pthread_mutex_lock(&b.lock);
+            b.active--;
+            pthread_mutex_unlock(&b.lock);
+            break;
+        }
+        workers[i].started = true;
+    }
+
+    for (i = 0; i < b.count; i++) {
+        struct offline_item *it = &b.items[i];
+        bool done;
+
+        pthread_mutex_lock(&b.lock);
+        while (!it->done && !(b.next <= i && b.active == 0))
+            pthread_cond_wait(&b.cond, &b.lock);
+        done = it->done;
+        pthread_mutex_unlock(&b.lock);
+        if (!done)
+            break;
+
+        if (it->ret == 0) {
+            offline_emit(ctx, it->frame_id, &it->res);
+            ok++;
+        } else {
+            failed++;
+        }
+        lpr_log(LOG_INFO, "[batch] frame=%" PRIu64 " ret=%d image=%s\n", it->frame_id, it->ret, it->path);
+        offline_result_free(&it->res);
+
+        pthread_mutex_lock(&b.lock);
+        b.written = i + 1;
+        b.dump_open = ctx->ocr_crop_index_fp && ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max;
+        pthread_cond_broadcast(&b.cond);
+        pthread_mutex_unlock(&b.lock);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+    }
+    wall_s = (double)(mono_us() - t0) / 1e6;
+    fprintf(stderr, "[batch] done images=%d ok=%d failed=%d skipped=%d workers=%d wall=%.2fs (%.2f img/s)\n",
+            b.count, ok, failed, b.count - ok - failed, nworkers, wall_s,
+            wall_s > 0.0 ? (double)(ok + failed) / wall_s : 0.0);
+    ret = (ok + failed == b.count) ? 0 : -1;
+
+out:
+    for (i = 0; i < OFFLINE_MAX_WORKERS; i++) {
+        frame_arena_release(&workers[i].arena);
+        offline_worker_ctx_free(workers[i].ctx);
+    }
+    for (i = 0; i < b.count; i++) {
+        offline_result_free(&b.items[i].res);
+        free(b.items[i].path);
+        free(b.items[i].roi);
+    }
+    free(b.items);
+    pthread_cond_destroy(&b.cond);
+    pthread_mutex_destroy(&b.lock);
+    return ret;
+}
+
+static void dump_ocr_pair_write(struct app_ctx *ctx, int idx, uint64_t frame_id,
+                                const struct plate_det *pd,
+                                const uint8_t *crop_rgb, int crop_w, int crop_h,
+                                const uint8_t *ocr_in, int ocr_w, int ocr_h)
+{
+    char crop_path[640];
+    char in_path[640];
+    char safe_text[64];
+    int64_t ts;
+
+    snprintf(crop_path, sizeof(crop_path), "%s/crop_%04d_f%06" PRIu64 ".ppm",
+             ctx->opt.ocr_crop_dump_dir, idx, frame_id);
+    snprintf(in_path, sizeof(in_path), "%s/ocrin_%04d_f%06" PRIu64 ".ppm",
+             ctx->opt.ocr_crop_dump_dir, idx, frame_id);
+
+    if (write_ppm_rgb888(crop_path, crop_rgb, crop_w, crop_h) < 0)
+        return;
+    if (ocr_in && ocr_w > 0 && ocr_h > 0) {
+        if (write_ppm_rgb888(in_path, ocr_in, ocr_w, ocr_h) < 0)
+            return;
+    } else {
+        in_path[0] = '\0';
+    }
+
+    ts = mono_us();
     csv_safe_text(pd->ocr_text, safe_text, sizeof(safe_text));
-    pthread_mutex_lock(&ctx->pred_log_lock);
+    fprintf(ctx->ocr_crop_index_fp,
+            "%d,%" PRIu64 ",%" PRId64 ",%d,%d,%d,%d,%d,%d,%d,%d,%s,%.4f,%.4f,%.4f,%s,%s\n",
+            idx, frame_id, ts,
+            pd->box.x1, pd->box.y1, pd->box.x2, pd->box.y2,
+            pd->crop_box.x1, pd->crop_box.y1, pd->crop_box.x2, pd->crop_box.y2,
+            safe_text, pd->ocr_conf, pd->ocr_blank_top1, pd->ocr_in_occ_ratio, crop_path, in_path);
+    fflush(ctx->ocr_crop_index_fp);
+}
+
+/*
+ * The sample index is reserved here, on the calling thread, so the
+ * --ocr-crop-dump-max gate stays exact when the writes are deferred.
+ */
+static void dump_ocr_pair(struct app_ctx *ctx, uint64_t frame_id, const struct plate_det *pd,
+                          const uint8_t *crop_rgb, int crop_w, int crop_h,
+                          const uint8_t *ocr_in, int ocr_w, int ocr_h)
+{
+    struct log_dump_job *job;
+    struct log_entry *e;
+    size_t crop_bytes;
+    size_t in_bytes;
+    int idx;
+
+    if (!ctx->opt.ocr_crop_dump_dir || ctx->opt.ocr_crop_dump_dir[0] == '\0')
+        return;
+    if (ctx->opt.ocr_crop_dump_max <= 0)
+        return;
+    if (ctx->ocr_crop_dumped >= ctx->opt.ocr_crop_dump_max)
+        return;
+    if (!ctx->ocr_crop_index_fp)
+        return;
+
+    idx = ctx->ocr_crop_dumped++;
+    if (!g_log.async) {
+        dump_ocr_pair_write(ctx, idx, frame_id, pd, crop_rgb, crop_w, crop_h, ocr_in, ocr_w, ocr_h);
+        return;
+    }
+
+    if (!ocr_in || ocr_w <= 0 || ocr_h <= 0) {
+        ocr_w = 0;
+        ocr_h = 0;
+    }
+    crop_bytes = (size_t)crop_w * crop_h * 3U;
+    in_bytes = (size_t)ocr_w * ocr_h * 3U;
+    job = malloc(sizeof(*job) + crop_bytes + in_bytes);
+    if (!job) {
+        atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    job->idx = idx;
+    job->frame_id = frame_id;
+    job->pd = *pd;
+    job->crop_w = crop_w;
+    job->crop_h = crop_h;
+    job->ocr_w = ocr_w;
+    job->ocr_h = ocr_h;
+    memcpy(job->data, crop_rgb, crop_bytes);
+    if (in_bytes)
+        memcpy(job->data + crop_bytes, ocr_in, in_bytes);
+
+    e = log_ring_claim();
+    if (!e) {
+        free(job);
+        return;
+    }
+    e->kind = LOG_KIND_DUMP;
+    e->u.dump = job;
+    log_ring_commit(e);
+}
+
+static void pred_log_write(struct app_ctx *ctx, const struct pred_record *rec)
+{
+    char safe_text[64];
+
+    if (ctx->opt.pred_log_format == PRED_LOG_BIN) {
+        fwrite(rec, sizeof(*rec), 1, ctx->pred_log_fp);
+        return;
+    }
+    csv_safe_text(rec->text, safe_text, sizeof(safe_text));
     fprintf(ctx->pred_log_fp,
             "%" PRIu64 ",%s,%s,%.4f,%d,%d,%d,%d,%" PRId64 "\n",
-            frame_id,
+            rec->frame_id,
             safe_text,
-            plate_type_str(pd->type),
-            pd->ocr_conf,
-            pd->box.x1, pd->box.y1, pd->box.x2, pd->box.y2,
-            ts_us);
+            plate_type_str((enum plate_type)rec->type),
+            rec->conf,
+            (int)rec->x1, (int)rec->y1, (int)rec->x2, (int)rec->y2,
+            rec->ts_us);
+}
+
+static void log_prediction_row(struct app_ctx *ctx, uint64_t frame_id, int64_t ts_us,
+                               const struct plate_det *pd)
+{
+    struct pred_record rec;
+    struct log_entry *e;
+
+    if (!ctx->pred_log_fp)
+        return;
+    memset(&rec, 0, sizeof(rec));
+    rec.frame_id = frame_id;
+    rec.ts_us = ts_us;
+    rec.x1 = pd->box.x1;
+    rec.y1 = pd->box.y1;
+    rec.x2 = pd->box.x2;
+    rec.y2 = pd->box.y2;
+    rec.conf = pd->ocr_conf;
+    rec.type = (uint8_t)pd->type;
+    rec.color = (uint8_t)pd->color;
+    copy_cstr_trunc(rec.text, sizeof(rec.text), pd->ocr_text);
+
+    if (g_log.async) {
+        e = log_ring_claim();
+        if (e) {
+            e->kind = LOG_KIND_PRED;
+            e->u.pred = rec;
+            log_ring_commit(e);
+        }
+        return;
+    }
+    pthread_mutex_lock(&ctx->pred_log_lock);
+    pred_log_write(ctx, &rec);
     fflush(ctx->pred_log_fp);
     pthread_mutex_unlock(&ctx->pred_log_lock);
 }
 
+static void *log_writer_main(void *arg)
+{
+    struct app_ctx *ctx = arg;
+    bool stop = false;
+
+    while (!stop) {
+        struct log_entry *e;
+        bool preds = false;
+
+        if (sem_wait(&g_log.wake) < 0 && errno == EINTR)
+            continue;
+        stop = atomic_load_explicit(&g_log.stop, memory_order_acquire);
+        while ((e = log_ring_peek()) != NULL) {
+            if (e->kind == LOG_KIND_TEXT) {
+                fputs(e->u.text, stderr);
+            } else if (e->kind == LOG_KIND_PRED) {
+                pred_log_write(ctx, &e->u.pred);
+                preds = true;
+            } else {
+                struct log_dump_job *job = e->u.dump;
+                size_t crop_bytes = (size_t)job->crop_w * job->crop_h * 3U;
+
+                dump_ocr_pair_write(ctx, job->idx, job->frame_id, &job->pd,
+                                    job->data, job->crop_w, job->crop_h,
+                                    job->ocr_w ? job->data + crop_bytes : NULL, job->ocr_w, job->ocr_h);
+                free(job);
+            }
+            log_ring_release(e);
+        }
+        if (preds)
+            fflush(ctx->pred_log_fp);
+    }
+    return NULL;
+}
+
+/* Call once the prediction log and crop index are open. */
+static int log_start(struct app_ctx *ctx)
+{
+    unsigned int i;
+
+    if (!ctx->opt.log_async)
+        return 0;
+    g_log.ring = calloc(LOG_RING_SIZE, sizeof(*g_log.ring));
+    if (!g_log.ring)
+        return -1;
+    for (i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&g_log.ring[i].seq, i);
+    atomic_init(&g_log.head, 0);
+    g_log.tail = 0;
+    atomic_init(&g_log.dropped, 0);
+    atomic_init(&g_log.stop, false);
+    if (sem_init(&g_log.wake, 0, 0) < 0)
+        goto fail;
+    if (pthread_create(&g_log.thread, NULL, log_writer_main, ctx) != 0) {
+        sem_destroy(&g_log.wake);
+        goto fail;
+    }
+    g_log.async = true;
+    return 0;
+
+fail:
+    free(g_log.ring);
+    g_log.ring = NULL;
+    return -1;
+}
+
+/* Call after every producer thread is joined; drains the ring. */
+static void log_stop(void)
+{
+    unsigned long dropped;
+
+    if (!g_log.async)
+        return;
+    atomic_store_explicit(&g_log.stop, true, memory_order_release);
+    sem_post(&g_log.wake);
+    pthread_join(g_log.thread, NULL);
+    g_log.async = false;
+    sem_destroy(&g_log.wake);
+    free(g_log.ring);
+    g_log.ring = NULL;
+    dropped = atomic_load_explicit(&g_log.dropped, memory_order_relaxed);
+    if (dropped)
+        fprintf(stderr, "[log] writer dropped %lu entries (ring full)\n", dropped);
+}
+
 static void build_overlay_ascii_text(const struct plate_det *pd, char *out, size_t out_len)
 {
     size_t i = 0;
@@ -6058,87 +8763,1225 @@ static void build_overlay_ascii_text(const struct plate_det *pd, char *out, size
                 out[i++] = '-';
                 continue;
             }
-            if (ch >= 'a' && ch <= 'z')
-                ch = (unsigned char)(ch - 'a' + 'A');
-            if ((ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z')) {
-                out[i++] = (char)ch;
-                continue;
+            if (ch >= 'a' && ch <= 'z')
+                ch = (unsigned char)(ch - 'a' + 'A');
+            if ((ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z')) {
+                out[i++] = (char)ch;
+                continue;
+            }
+        }
+        if (alias && alias[0] != '\0') {
+            int j;
+            for (j = 0; alias[j] != '\0' && i + 1 < out_len; j++)
+                out[i++] = alias[j];
+        }
+    }
+
+    if (i == 0) {
+        const char *fb = "UNK";
+        if (pd->type == PLATE_TYPE_COMMON_BLUE) fb = "BLUE";
+        else if (pd->type == PLATE_TYPE_COMMON_GREEN) fb = "GREEN";
+        else if (pd->type == PLATE_TYPE_YELLOW) fb = "YELLOW";
+        else if (pd->type == PLATE_TYPE_POLICE) fb = "POLICE";
+        else if (pd->type == PLATE_TYPE_TRAILER) fb = "TRAILER";
+        else if (pd->type == PLATE_TYPE_EMBASSY_CONSULATE) fb = "EMB";
+        while (*fb && i + 1 < out_len)
+            out[i++] = *fb++;
+        if (i == 0) {
+            out[0] = 'U';
+            if (out_len > 1) out[1] = 'N';
+            if (out_len > 2) out[2] = 'K';
+            i = (out_len > 2) ? 3 : out_len - 1;
+        }
+    }
+    out[i] = '\0';
+}
+
+/* Text anchor above a plate box, pushed inside the frame. */
+static void overlay_text_origin(const struct app_ctx *ctx, const struct det_box *box, int text_scale,
+                                int *tx, int *ty)
+{
+    int text_h = 7 * text_scale;
+    *tx = box->x1;
+    *ty = box->y1 - (text_h + 3);
+    if (*ty < 0)
+        *ty = box->y1 + 3;
+    if (*ty + text_h >= (int)ctx->frame_height)
+        *ty = (int)ctx->frame_height - text_h - 1;
+    if (*ty < 0)
+        *ty = 0;
+}
+
+/*
+ * --overlay-plane: results are drawn into an ARGB8888 layer on a KMS overlay
+ * plane and the VOP blends it over the video, so capture frames reach
+ * kmssink untouched. The layer is double buffered and redrawn only when the
+ * post stage publishes a new results frame_seq. Before each redraw, only the
+ * rectangles drawn last time into that buffer are cleared.
+ */
+static void overlay_mark(struct overlay_buf *b, int w, int h, int x1, int y1, int x2, int y2)
+{
+    struct overlay_rect *d;
+    if (b->dirty_count < 0)
+        return;
+    if (b->dirty_count >= OVERLAY_DIRTY_MAX) {
+        b->dirty_count = -1;
+        return;
+    }
+    d = &b->dirty[b->dirty_count++];
+    d->x1 = x1 < 0 ? 0 : x1;
+    d->y1 = y1 < 0 ? 0 : y1;
+    d->x2 = x2 >= w ? w - 1 : x2;
+    d->y2 = y2 >= h ? h - 1 : y2;
+}
+
+static void overlay_clear(struct overlay_plane *ov, struct overlay_buf *b)
+{
+    int stride = (int)(b->pitch / 4U);
+    int i;
+    if (b->dirty_count < 0) {
+        memset(b->pix, 0, b->size);
+    } else {
+        for (i = 0; i < b->dirty_count; i++)
+            fill_rect_argb(b->pix, stride, ov->w, ov->h,
+                           b->dirty[i].x1, b->dirty[i].y1, b->dirty[i].x2, b->dirty[i].y2, 0);
+    }
+    b->dirty_count = 0;
+}
+
+static void overlay_plane_render(struct app_ctx *ctx, const struct lpr_results *r, struct overlay_buf *b)
+{
+    struct overlay_plane *ov = &ctx->overlay;
+    uint32_t *pix = b->pix;
+    int stride = (int)(b->pitch / 4U);
+    int w = ov->w;
+    int h = ov->h;
+    int i;
+
+#define OVL_BOX(box, color)                                                    \
+    do {                                                                       \
+        draw_rect_argb(pix, stride, w, h, (box), (color));                     \
+        overlay_mark(b, w, h, (box)->x1, (box)->y1, (box)->x2, (box)->y2);     \
+    } while (0)
+
+    for (i = 0; i < r->car_count; i++)
+        OVL_BOX(&r->cars[i], COLOR_YELLOW_ARGB);
+    for (i = 0; i < r->person_count; i++)
+        OVL_BOX(&r->persons[i], COLOR_GREEN_ARGB);
+    for (i = 0; i < r->plate_count; i++) {
+        char txt[32];
+        int tx;
+        int ty;
+        overlay_text_origin(ctx, &r->plates[i].box, OVERLAY_TEXT_SCALE, &tx, &ty);
+        build_overlay_ascii_text(&r->plates[i], txt, sizeof(txt));
+        OVL_BOX(&r->plates[i].box, COLOR_CYAN_ARGB);
+        if (ctx->opt.show_crop_box)
+            OVL_BOX(&r->plates[i].crop_box, COLOR_RED_ARGB);
+        draw_text_argb(pix, stride, w, h, tx, ty, txt, COLOR_CYAN_ARGB, OVERLAY_TEXT_SCALE);
+        overlay_mark(b, w, h, tx, ty, tx + (int)strlen(txt) * 6 * OVERLAY_TEXT_SCALE - 1,
+                     ty + 7 * OVERLAY_TEXT_SCALE - 1);
+    }
+    if (ctx->opt.fpga_a_mask && r->a_roi_valid)
+        OVL_BOX(&r->a_roi, COLOR_GREEN_ARGB);
+#undef OVL_BOX
+    if (ctx->opt.ped_event) {
+        int y = (int)((float)h * ctx->opt.stopline_ratio);
+        fill_rect_argb(pix, stride, w, h, 0, y, w - 1, y,
+                       r->light_red ? COLOR_RED_ARGB : COLOR_GREEN_ARGB);
+        overlay_mark(b, w, h, 0, y, w - 1, y);
+    }
+}
+
+/* Post stage, after publishing @r: redraw the back buffer and flip the plane to it. */
+static void overlay_plane_update(struct app_ctx *ctx, const struct lpr_results *r)
+{
+    struct overlay_plane *ov = &ctx->overlay;
+    struct overlay_buf *b;
+
+    if (!ov->active || r->frame_seq == ov->rendered_seq)
+        return;
+    b = &ov->bufs[ov->back];
+    overlay_clear(ov, b);
+    overlay_plane_render(ctx, r, b);
+    if (drmModeSetPlane(ctx->drm_fd, ov->plane_id, ov->crtc_id, b->fb_id, 0,
+                        0, 0, ov->crtc_w, ov->crtc_h,
+                        0, 0, (uint32_t)ov->w << 16, (uint32_t)ov->h << 16) != 0) {
+        ov->flip_errors++;
+    } else {
+        ov->back = (ov->back + 1) % OVERLAY_PLANE_BUFS;
+        ov->render_count++;
+    }
+    ov->rendered_seq = r->frame_seq;
+}
+
+/* Plane property lookup; @max gets the upper bound of range properties. */
+static bool drm_plane_prop(int fd, uint32_t plane_id, const char *name,
+                           uint32_t *prop_id, uint64_t *value, uint64_t *max, bool *mutable_prop)
+{
+    drmModeObjectProperties *props = drmModeObjectGetProperties(fd, plane_id, DRM_MODE_OBJECT_PLANE);
+    bool found = false;
+    uint32_t i;
+
+    if (!props)
+        return false;
+    for (i = 0; i < props->count_props && !found; i++) {
+        drmModePropertyRes *p = drmModeGetProperty(fd, props->props[i]);
+        if (!p)
+            continue;
+        if (strcmp(p->name, name) == 0) {
+            found = true;
+            if (prop_id) *prop_id = p->prop_id;
+            if (value) *value = props->prop_values[i];
+            if (max)
+                *max = ((p->flags & DRM_MODE_PROP_RANGE) && p->count_values >= 2) ? p->values[1] : 0;
+            if (mutable_prop) *mutable_prop = !(p->flags & DRM_MODE_PROP_IMMUTABLE);
+        }
+        drmModeFreeProperty(p);
+    }
+    drmModeFreeObjectProperties(props);
+    return found;
+}
+
+/* CRTC driving the connector kmssink is told to use (or the first connected one). */
+static int overlay_find_crtc(struct app_ctx *ctx, drmModeRes *res, int *crtc_idx)
+{
+    int i;
+    for (i = 0; i < res->count_connectors; i++) {
+        drmModeConnector *conn = drmModeGetConnector(ctx->drm_fd, res->connectors[i]);
+        drmModeEncoder *enc;
+        uint32_t crtc_id = 0;
+        int j;
+        if (!conn)
+            continue;
+        if ((ctx->opt.connector_id < 0 || conn->connector_id == (uint32_t)ctx->opt.connector_id) &&
+            conn->connection == DRM_MODE_CONNECTED && conn->encoder_id) {
+            enc = drmModeGetEncoder(ctx->drm_fd, conn->encoder_id);
+            if (enc) {
+                crtc_id = enc->crtc_id;
+                drmModeFreeEncoder(enc);
+            }
+        }
+        drmModeFreeConnector(conn);
+        if (!crtc_id)
+            continue;
+        for (j = 0; j < res->count_crtcs; j++) {
+            if (res->crtcs[j] == crtc_id) {
+                *crtc_idx = j;
+                return (int)crtc_id;
+            }
+        }
+    }
+    return -1;
+}
+
+static bool overlay_plane_usable(struct app_ctx *ctx, drmModePlane *p, int crtc_idx)
+{
+    uint64_t type = 0;
+    uint32_t i;
+    if (!(p->possible_crtcs & (1U << crtc_idx)))
+        return false;
+    if (ctx->opt.overlay_plane == 0) {
+        /* Auto: a free overlay plane, not the primary kmssink may scan out from */
+        if (p->crtc_id || p->fb_id)
+            return false;
+        if (drm_plane_prop(ctx->drm_fd, p->plane_id, "type", NULL, &type, NULL, NULL) &&
+            type != DRM_PLANE_TYPE_OVERLAY)
+            return false;
+    } else if (p->plane_id != (uint32_t)ctx->opt.overlay_plane) {
+        return false;
+    }
+    for (i = 0; i < p->count_formats; i++) {
+        if (p->formats[i] == DRM_FORMAT_ARGB8888)
+            return true;
+    }
+    return false;
+}
+
+static int overlay_buf_create(int fd, struct overlay_buf *b, int w, int h)
+{
+    struct drm_mode_create_dumb creq;
+    struct drm_mode_map_dumb mreq;
+    uint32_t handles[4] = {0};
+    uint32_t pitches[4] = {0};
+    uint32_t offsets[4] = {0};
+    void *map;
+
+    memset(&creq, 0, sizeof(creq));
+    creq.width = (uint32_t)w;
+    creq.height = (uint32_t)h;
+    creq.bpp = 32;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0)
+        return -1;
+    b->handle = creq.handle;
+    b->pitch = creq.pitch;
+    b->size = (size_t)creq.size;
+    handles[0] = b->handle;
+    pitches[0] = b->pitch;
+    if (drmModeAddFB2(fd, (uint32_t)w, (uint32_t)h, DRM_FORMAT_ARGB8888,
+                      handles, pitches, offsets, &b->fb_id, 0) != 0)
+        return -1;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.handle = b->handle;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0)
+        return -1;
+    map = mmap(NULL, b->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)mreq.offset);
+    if (map == MAP_FAILED)
+        return -1;
+    b->pix = (uint32_t *)map;
+    memset(b->pix, 0, b->size);
+    b->dirty_count = 0;
+    return 0;
+}
+
+static void overlay_plane_release(struct app_ctx *ctx)
+{
+    struct overlay_plane *ov = &ctx->overlay;
+    int i;
+
+    if (ctx->drm_fd < 0)
+        return;
+    if (ov->active)
+        drmModeSetPlane(ctx->drm_fd, ov->plane_id, ov->crtc_id, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    for (i = 0; i < OVERLAY_PLANE_BUFS; i++) {
+        struct overlay_buf *b = &ov->bufs[i];
+        if (b->pix)
+            munmap(b->pix, b->size);
+        if (b->fb_id)
+            drmModeRmFB(ctx->drm_fd, b->fb_id);
+        if (b->handle) {
+            struct drm_mode_destroy_dumb dreq;
+            dreq.handle = b->handle;
+            drmIoctl(ctx->drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+        }
+    }
+    memset(ov, 0, sizeof(*ov));
+}
+
+/*
+ * Set up the overlay plane after kmssink holds the display. On any failure
+ * the overlay falls back to drawing into the video frame.
+ */
+static void overlay_plane_init(struct app_ctx *ctx)
+{
+    struct overlay_plane *ov = &ctx->overlay;
+    drmModeRes *res = NULL;
+    drmModePlaneRes *pres = NULL;
+    drmModeCrtc *crtc = NULL;
+    uint32_t zpos_id = 0;
+    uint64_t zpos_max = 0;
+    bool zpos_mutable = false;
+    int crtc_idx = -1;
+    int crtc_id;
+    int i;
+
+    memset(ov, 0, sizeof(*ov));
+    if (ctx->opt.overlay_plane < 0 || ctx->drm_fd < 0)
+        return;
+    ov->rendered_seq = UINT64_MAX;
+    ov->w = (int)ctx->frame_width;
+    ov->h = (int)ctx->frame_height;
+    if (drmSetClientCap(ctx->drm_fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0)
+        fprintf(stderr, "[overlay] universal planes unavailable, plane type not checked\n");
+
+    res = drmModeGetResources(ctx->drm_fd);
+    if (!res)
+        goto fail;
+    crtc_id = overlay_find_crtc(ctx, res, &crtc_idx);
+    if (crtc_id < 0)
+        goto fail;
+    ov->crtc_id = (uint32_t)crtc_id;
+    crtc = drmModeGetCrtc(ctx->drm_fd, ov->crtc_id);
+    if (!crtc || !crtc->mode_valid)
+        goto fail;
+    /* kmssink scales the video to fit the mode; cover the same area. */
+    ov->crtc_w = crtc->mode.hdisplay;
+    ov->crtc_h = crtc->mode.vdisplay;
+
+    pres = drmModeGetPlaneResources(ctx->drm_fd);
+    if (!pres)
+        goto fail;
+    /* Walk from the top: kmssink takes the first overlay plane it finds. */
+    for (i = (int)pres->count_planes - 1; i >= 0 && !ov->plane_id; i--) {
+        drmModePlane *p = drmModeGetPlane(ctx->drm_fd, pres->planes[i]);
+        if (!p)
+            continue;
+        if (overlay_plane_usable(ctx, p, crtc_idx))
+            ov->plane_id = p->plane_id;
+        drmModeFreePlane(p);
+    }
+    if (!ov->plane_id)
+        goto fail;
+
+    for (i = 0; i < OVERLAY_PLANE_BUFS; i++) {
+        if (overlay_buf_create(ctx->drm_fd, &ov->bufs[i], ov->w, ov->h) < 0)
+            goto fail;
+    }
+    if (drm_plane_prop(ctx->drm_fd, ov->plane_id, "zpos", &zpos_id, NULL, &zpos_max, &zpos_mutable) &&
+        zpos_mutable && zpos_max > 0)
+        drmModeObjectSetProperty(ctx->drm_fd, ov->plane_id, DRM_MODE_OBJECT_PLANE, zpos_id, zpos_max);
+
+    if (drmModeSetPlane(ctx->drm_fd, ov->plane_id, ov->crtc_id, ov->bufs[0].fb_id, 0,
+                        0, 0, ov->crtc_w, ov->crtc_h,
+                        0, 0, (uint32_t)ov->w << 16, (uint32_t)ov->h << 16) != 0) {
+        /* No scaler on this window: show it 1:1 at the origin instead. */
+        ov->crtc_w = (uint32_t)ov->w;
+        ov->crtc_h = (uint32_t)ov->h;
+        if (drmModeSetPlane(ctx->drm_fd, ov->plane_id, ov->crtc_id, ov->bufs[0].fb_id, 0,
+                            0, 0, ov->crtc_w, ov->crtc_h,
+                            0, 0, (uint32_t)ov->w << 16, (uint32_t)ov->h << 16) != 0)
+            goto fail;
+    }
+    ov->back = 1;
+    ov->active = true;
+    fprintf(stderr, "[overlay] plane=%u crtc=%u layer=%dx%d -> %ux%u zpos=%" PRIu64 "\n",
+            ov->plane_id, ov->crtc_id, ov->w, ov->h, ov->crtc_w, ov->crtc_h, zpos_max);
+    goto out;
+
+fail:
+    fprintf(stderr, "[overlay] no usable overlay plane (errno=%d), drawing into video frames\n", errno);
+    overlay_plane_release(ctx);
+out:
+    if (pres)
+        drmModeFreePlaneResources(pres);
+    if (crtc)
+        drmModeFreeCrtc(crtc);
+    if (res)
+        drmModeFreeResources(res);
+}
+
+/*
+ * Inference runs in two stages: detect (frame conversion, vehicle and plate
+ * models) and post (filtering, tracking, plate crops, OCR, result publish).
+ * With --infer-pipeline 1 the post stage gets its own thread and INFER_JOBS
+ * job buffers, so the NPU detects frame N+1 while the CPU finishes frame N
+ * and throughput follows the slower stage instead of their sum. Each piece
+ * of ctx tracking state is owned by exactly one stage.
+ */
+#define INFER_JOBS 2
+
+struct infer_job {
+    uint64_t seq;
+    int64_t det_us;
+    uint8_t *rgb_full;
+    uint8_t *rgb_detect;
+    uint8_t *a_map;
+    const uint8_t *det_src_rgb;
+    const uint8_t *det_tensor;      /* FPGA detector canvas, valid while the frame is held */
+    struct det_box cars[MAX_DETS];
+    int car_count;
+    struct det_box raw_plates[MAX_DETS];
+    int raw_plate_count;
+    struct detect_decode_diag plate_diag;
+    bool light_red;
+    struct det_box a_roi;
+    bool a_roi_valid;
+};
+
+/* A stable plate between crop/gating and its batched OCR result. */
+struct plate_pending {
+    struct plate_det pd;
+    struct ocr_diag odiag;
+    int crop_w;
+    int crop_h;
+    int slot;               /* OCR batch slot, -1 when skipped */
+    bool cached;            /* text came from ocr_cache_lookup */
+    uint8_t *dump_crop;     /* copy kept for --ocr-crop-dump-dir */
+};
+
+/* Per-stage working buffers for the detector canvas, model input and crops. */
+struct infer_scratch {
+    uint8_t *algo_rgb;
+    uint8_t *veh_in;
+    uint8_t *plate_in;
+    uint8_t *plate_crop;
+    struct plate_pending *pending;      /* MAX_DETS */
+    struct ocr_slot *ocr_slots;         /* MAX_DETS */
+    uint8_t *ocr_pool;                  /* packed OCR inputs, grown in whole batches */
+    int ocr_pool_slots;
+    struct frame_arena arena;           /* per-frame scratch of the thread owning this */
+};
+
+struct infer_pipe {
+    struct app_ctx *ctx;
+    struct infer_job jobs[INFER_JOBS];
+    bool ready[INFER_JOBS];
+    struct infer_scratch post_scratch;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+};
+
+static int infer_job_alloc(const struct app_ctx *ctx, struct infer_job *job)
+{
+    size_t pixels = (size_t)ctx->frame_width * ctx->frame_height;
+
+    memset(job, 0, sizeof(*job));
+    job->rgb_full = malloc(pixels * 3U);
+    job->rgb_detect = malloc(pixels * 3U);
+    job->a_map = malloc(pixels);
+    return (job->rgb_full && job->rgb_detect && job->a_map) ? 0 : -1;
+}
+
+static void infer_job_free(struct infer_job *job)
+{
+    free(job->rgb_full); free(job->rgb_detect); free(job->a_map);
+    memset(job, 0, sizeof(*job));
+}
+
+static int infer_scratch_alloc(const struct app_ctx *ctx, struct infer_scratch *sc)
+{
+    memset(sc, 0, sizeof(*sc));
+    sc->algo_rgb = malloc((size_t)ALGO_STREAM_SIZE * ALGO_STREAM_SIZE * 3U);
+    sc->veh_in = malloc((size_t)ctx->veh_model.in_w * ctx->veh_model.in_h * 3U);
+    sc->plate_in = malloc((size_t)ctx->plate_model.in_w * ctx->plate_model.in_h * 3U);
+    sc->plate_crop = malloc((size_t)ctx->frame_width * ctx->frame_height * 3U);
+    sc->pending = calloc(MAX_DETS, sizeof(*sc->pending));
+    sc->ocr_slots = calloc(MAX_DETS, sizeof(*sc->ocr_slots));
+    if (frame_arena_init(&sc->arena, frame_arena_estimate(ctx)) < 0)
+        return -1;
+    return (sc->algo_rgb && sc->veh_in && sc->plate_in && sc->plate_crop &&
+            sc->pending && sc->ocr_slots) ? 0 : -1;
+}
+
+static void infer_scratch_free(struct infer_scratch *sc)
+{
+    free(sc->algo_rgb); free(sc->veh_in); free(sc->plate_in); free(sc->plate_crop);
+    free(sc->pending); free(sc->ocr_slots); free(sc->ocr_pool);
+    frame_arena_release(&sc->arena);
+    memset(sc, 0, sizeof(*sc));
+}
+
+/* OCR input slot @slot of the pool, growing it a whole model batch at a time. */
+static uint8_t *ocr_pool_slot(const struct app_ctx *ctx, struct infer_scratch *sc, int slot)
+{
+    size_t slot_bytes = (size_t)ctx->ocr_model.in_w * ctx->ocr_model.in_h * 3U;
+
+    if (slot >= sc->ocr_pool_slots) {
+        int batch = (int)ctx->ocr_model.batch;
+        int want = ((slot + batch) / batch) * batch;
+        uint8_t *p = realloc(sc->ocr_pool, (size_t)want * slot_bytes);
+
+        if (!p)
+            return NULL;
+        sc->ocr_pool = p;
+        sc->ocr_pool_slots = want;
+    }
+    return sc->ocr_pool + (size_t)slot * slot_bytes;
+}
+
+/*
+ * --motion-gate: compare this frame with the previous one on the 4x
+ * decimated grid hdl/preproc/motion_diff.v uses, and mark each 64x64 tile
+ * whose changed-sample ratio reaches --motion-tile-thr. Where the FPGA
+ * preprocessing flag (alpha bit 7) is set, the sample is the alpha thresh
+ * bit and a flip is motion, as in motion_diff; elsewhere it is luma and a
+ * change above MOTION_LUMA_DELTA is. Returns the number of moving tiles, or
+ * -1 when there is no previous frame yet.
+ */
+static int motion_tiles_update(struct app_ctx *ctx, const uint8_t *rgb, const uint8_t *a_map)
+{
+    int w = (int)ctx->frame_width;
+    int h = (int)ctx->frame_height;
+    int sw = w / MOTION_STEP;
+    int per_tile = (MOTION_TILE / MOTION_STEP) * (MOTION_TILE / MOTION_STEP);
+    int min_changed = (int)ceilf(ctx->opt.motion_tile_thr * (float)per_tile);
+    uint16_t changed[MOTION_TILES_Y][MOTION_TILES_X];
+    bool had_prev = ctx->motion_prev_valid;
+    int active = 0;
+    int x, y;
+
+    if (!ctx->motion_prev) {
+        ctx->motion_prev = malloc((size_t)sw * (size_t)(h / MOTION_STEP));
+        if (!ctx->motion_prev)
+            return -1;
+    }
+    memset(changed, 0, sizeof(changed));
+    for (y = 0; y + MOTION_STEP <= h; y += MOTION_STEP) {
+        uint8_t *prev = ctx->motion_prev + (size_t)(y / MOTION_STEP) * sw;
+        for (x = 0; x + MOTION_STEP <= w; x += MOTION_STEP) {
+            size_t idx = (size_t)y * w + x;
+            const uint8_t *px = rgb + idx * 3U;
+            uint8_t a = a_map[idx];
+            uint8_t v;
+
+            if (a & 0x80)
+                v = (a & 0x20) ? 0xFF : 0x00;
+            else
+                v = (uint8_t)((px[0] >> 2) + (px[1] >> 1) + (px[2] >> 2));
+            if (had_prev && abs((int)v - (int)prev[x / MOTION_STEP]) > MOTION_LUMA_DELTA)
+                changed[y / MOTION_TILE][x / MOTION_TILE]++;
+            prev[x / MOTION_STEP] = v;
+        }
+    }
+    ctx->motion_prev_valid = true;
+    if (!had_prev)
+        return -1;
+    for (y = 0; y < MOTION_TILES_Y; y++) {
+        for (x = 0; x < MOTION_TILES_X; x++) {
+            if (changed[y][x] >= min_changed)
+                active++;
+        }
+    }
+    return active;
+}
+
+static void infer_detect_stage(struct app_ctx *ctx, int frame_idx, uint64_t seq,
+                               struct infer_job *job, struct infer_scratch *sc)
+{
+    const uint8_t *raw = ctx->frames[frame_idx].data;
+    uint8_t *rgb_full = job->rgb_full;
+    uint8_t *a_map = job->a_map;
+    float red_ratio = 0.0f;
+    int64_t t0 = mono_us();
+    int64_t pt;
+    int ret;
+
+    job->seq = seq;
+    job->det_src_rgb = rgb_full;
+    job->det_tensor = ctx->frame_tensor[frame_idx] ? ctx->tensor_maps[frame_idx] : NULL;
+    job->car_count = 0;
+    job->raw_plate_count = 0;
+    job->light_red = false;
+    job->a_roi_valid = false;
+    memset(&job->a_roi, 0, sizeof(job->a_roi));
+    memset(&job->plate_diag, 0, sizeof(job->plate_diag));
+
+    pt = prof_begin();
+    if (preproc_rga_frame_to_rgb(ctx, frame_idx, rgb_full)) {
+        /* RGA drops X; only the A-mask and motion-gate consumers need it split out. */
+        if (ctx->opt.fpga_a_mask || ctx->opt.motion_gate) {
+            size_t p;
+            size_t pixels = (size_t)ctx->frame_width * ctx->frame_height;
+            for (p = 0; p < pixels; p++)
+                a_map[p] = raw[p * 4U + 3U];
+        }
+    } else if (ctx->src_is_bgrx) {
+        bgrx8888_to_rgb888_and_a(raw, (int)ctx->frame_width, (int)ctx->frame_height, rgb_full, a_map);
+    } else {
+        raw565_to_rgb888_full(ctx, raw, rgb_full);
+        memset(a_map, 0, (size_t)ctx->frame_width * ctx->frame_height);
+    }
+    prof_end(PROF_CONVERT, pt);
+    /*
+     * Everything below works on the RGB copy; let capture reuse the frame.
+     * The tensor lives in the paired slot, so with one the frame is held
+     * until the detectors have read it.
+     */
+    if (!job->det_tensor)
+        frame_infer_done(ctx, frame_idx);
+    if (ctx->opt.sw_preproc) {
+        pt = prof_begin();
+        memcpy(job->rgb_detect, rgb_full, (size_t)ctx->frame_width * ctx->frame_height * 3U);
+        sw_preprocess_rgb888(job->rgb_detect, (int)ctx->frame_width, (int)ctx->frame_height);
+        job->det_src_rgb = job->rgb_detect;
+        prof_end(PROF_SW_PREPROC, pt);
+    }
+
+    if (ctx->opt.fpga_a_mask && ctx->src_is_bgrx) {
+        job->a_roi_valid = extract_a_channel_roi(a_map, (int)ctx->frame_width, (int)ctx->frame_height,
+                                                 ctx->opt.a_proj_ratio, &job->a_roi, &red_ratio) ? true : false;
+        if (red_ratio >= ctx->opt.red_ratio_thr)
+            ctx->ped_red_streak++;
+        else
+            ctx->ped_red_streak = 0;
+        job->light_red = (ctx->ped_red_streak >= ctx->opt.red_stable_frames);
+    } else {
+        ctx->ped_red_streak = 0;
+    }
+
+    /*
+     * Both detectors see the whole frame in one NPU run, so gating is per
+     * frame: any moving tile, a stale cache or the refresh period runs them.
+     * Static frames republish the last boxes, which keeps the plate tracks
+     * and the OCR cache warm.
+     */
+    if (ctx->opt.motion_gate) {
+        int moving = motion_tiles_update(ctx, job->det_src_rgb, a_map);
+
+        if (moving == 0 && ctx->plate_cache_valid &&
+            ++ctx->motion_since_detect < ctx->opt.motion_refresh) {
+            job->car_count = ctx->veh_cache_count;
+            memcpy(job->cars, ctx->veh_cache, (size_t)job->car_count * sizeof(job->cars[0]));
+            job->raw_plate_count = ctx->plate_cache_count;
+            memcpy(job->raw_plates, ctx->plate_cache, (size_t)job->raw_plate_count * sizeof(job->raw_plates[0]));
+            job->plate_diag = ctx->plate_cache_diag;
+            ctx->motion_gated_frames++;
+            if (job->det_tensor)
+                frame_infer_done(ctx, frame_idx);
+            job->det_tensor = NULL;
+            job->det_us = mono_us() - t0;
+            prof_end(PROF_DETECT, t0);
+            return;
+        }
+        ctx->motion_since_detect = 0;
+    }
+
+    if (!ctx->opt.plate_only || ctx->opt.ped_event) {
+        /* Vehicles move slowly relative to the frame rate; --veh-every reuses the last boxes. */
+        if (ctx->veh_tick++ % (uint64_t)ctx->opt.veh_every == 0) {
+            if (job->det_tensor)
+                ret = run_detect_on_tensor(ctx, &ctx->veh_model, job->det_tensor,
+                                           ctx->opt.min_car_conf, sc->veh_in,
+                                           ctx->veh_cache, &ctx->veh_cache_count, NULL);
+            else
+                ret = run_detect_on_rgb(ctx, &ctx->veh_model, ctx->opt.det_resize_mode,
+                                        job->det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
+                                        ctx->opt.min_car_conf, sc->algo_rgb, sc->veh_in,
+                                        ctx->veh_cache, &ctx->veh_cache_count, NULL);
+            if (ret < 0)
+                ctx->veh_cache_count = 0;
+        }
+        job->car_count = ctx->veh_cache_count;
+        memcpy(job->cars, ctx->veh_cache, (size_t)job->car_count * sizeof(job->cars[0]));
+    }
+    pt = prof_begin();
+    {
+        float plate_thr = ctx->opt.min_plate_conf;
+        if (ctx->opt.fpga_a_mask && job->a_roi_valid)
+            plate_thr = fmaxf(0.05f, plate_thr - 0.05f);
+        /* The cascade sees plates at native scale; only the full-frame pass needs the retry. */
+        if (ctx->opt.plate_cascade &&
+            run_plate_cascade(ctx, job->det_src_rgb, job->cars, job->car_count, plate_thr,
+                              sc->algo_rgb, sc->plate_in,
+                              job->raw_plates, &job->raw_plate_count, &job->plate_diag) == 0)
+            goto plates_done;
+        if (job->det_tensor)
+            ret = run_detect_on_tensor(ctx, &ctx->plate_model, job->det_tensor, plate_thr,
+                                       sc->plate_in, job->raw_plates, &job->raw_plate_count,
+                                       &job->plate_diag);
+        else
+            ret = run_detect_on_rgb(ctx, &ctx->plate_model, ctx->opt.det_resize_mode,
+                                    job->det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
+                                    plate_thr, sc->algo_rgb, sc->plate_in,
+                                    job->raw_plates, &job->raw_plate_count, &job->plate_diag);
+        if (ret < 0)
+            job->raw_plate_count = 0;
+        if (job->raw_plate_count <= 0 &&
+            ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN &&
+            ctx->opt.det_resize_mode == DET_RESIZE_LETTERBOX) {
+            int64_t rt;
+            lpr_log(LOG_INFO,
+                    "[plate-fallback] frame=%" PRIu64 " retry=stretch reason=raw_empty\n",
+                    seq);
+            rt = prof_begin();
+            if (run_detect_on_rgb(ctx, &ctx->plate_model, DET_RESIZE_STRETCH,
+                                  job->det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
+                                  plate_thr, sc->algo_rgb, sc->plate_in,
+                                  job->raw_plates, &job->raw_plate_count, &job->plate_diag) < 0) {
+                job->raw_plate_count = 0;
+            }
+            prof_end(PROF_PLATE_RETRY, rt);
+        }
+    }
+plates_done:
+    prof_end(PROF_PLATE_DETECT, pt);
+    if (job->det_tensor)
+        frame_infer_done(ctx, frame_idx);
+    job->det_tensor = NULL;
+    if (ctx->opt.motion_gate) {
+        ctx->plate_cache_count = job->raw_plate_count;
+        memcpy(ctx->plate_cache, job->raw_plates, (size_t)job->raw_plate_count * sizeof(ctx->plate_cache[0]));
+        ctx->plate_cache_diag = job->plate_diag;
+        ctx->plate_cache_valid = true;
+    }
+    job->det_us = mono_us() - t0;
+    prof_end(PROF_DETECT, t0);
+}
+
+/* Scalar head plus the live entries; @entries=false copies the head only. */
+static void results_copy(struct lpr_results *dst, const struct lpr_results *src, bool entries)
+{
+    memcpy(dst, src, offsetof(struct lpr_results, cars));
+    /* A torn read may see garbage counts; the seqlock check discards it after. */
+    if (dst->car_count < 0 || dst->car_count > MAX_DETS) dst->car_count = 0;
+    if (dst->person_count < 0 || dst->person_count > MAX_DETS) dst->person_count = 0;
+    if (dst->plate_count < 0 || dst->plate_count > MAX_DETS) dst->plate_count = 0;
+    if (!entries)
+        return;
+    memcpy(dst->cars, src->cars, (size_t)dst->car_count * sizeof(dst->cars[0]));
+    memcpy(dst->persons, src->persons, (size_t)dst->person_count * sizeof(dst->persons[0]));
+    memcpy(dst->plates, src->plates, (size_t)dst->plate_count * sizeof(dst->plates[0]));
+}
+
+/* Writer side only: the last published record, stable until the next publish. */
+static const struct lpr_results *results_last(struct app_ctx *ctx)
+{
+    return &ctx->results.slot[atomic_load_explicit(&ctx->results.cur, memory_order_relaxed)].r;
+}
+
+static void results_publish(struct app_ctx *ctx, const struct lpr_results *r)
+{
+    struct result_board *b = &ctx->results;
+    unsigned int w = atomic_load_explicit(&b->cur, memory_order_relaxed) ^ 1U;
+    struct result_slot *slot = &b->slot[w];
+    unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&slot->seq, seq + 1U, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    results_copy(&slot->r, r, true);
+    atomic_store_explicit(&slot->seq, seq + 2U, memory_order_release);
+    atomic_store_explicit(&b->cur, w, memory_order_release);
+}
+
+static void results_read(struct app_ctx *ctx, struct lpr_results *dst, bool entries)
+{
+    struct result_board *b = &ctx->results;
+    for (;;) {
+        unsigned int i = atomic_load_explicit(&b->cur, memory_order_acquire);
+        struct result_slot *slot = &b->slot[i];
+        unsigned int s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (s1 & 1U)
+            continue;
+        results_copy(dst, &slot->r, entries);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == s1)
+            return;
+    }
+}
+
+static void infer_post_stage(struct app_ctx *ctx, struct infer_job *job, struct infer_scratch *sc)
+{
+    struct det_box *cars = job->cars;
+    struct det_box *raw_plates = job->raw_plates;
+    struct det_box filtered_plates[MAX_DETS];
+    struct det_box roi_plates[MAX_DETS];
+    struct det_box stable_plates[MAX_DETS];
+    struct det_box persons[MAX_DETS];
+    struct det_box tracked_persons[MAX_DETS];
+    struct lpr_results r;
+    const struct lpr_results *prev;
+    int car_count = job->car_count;
+    int raw_plate_count = job->raw_plate_count;
+    int filtered_plate_count = 0;
+    int stable_plate_count = 0;
+    int person_count = 0;
+    int tracked_person_count = 0;
+    int ped_events = 0;
+    int ocr_run_count = 0;
+    int ocr_skip_size = 0;
+    int ocr_skip_blur = 0;
+    int ocr_cache_hit = 0;
+    int ocr_nonempty_count = 0;
+    int overlay_nonempty_count = 0;
+    int pending_count = 0;
+    int ocr_slot_count = 0;
+    const struct detect_decode_diag plate_diag = job->plate_diag;
+    bool light_red = job->light_red;
+    struct det_box a_roi = job->a_roi;
+    bool a_roi_valid = job->a_roi_valid;
+    int i;
+    int64_t t0, t1;
+    uint64_t seq = job->seq;
+    const uint8_t *rgb_full = job->rgb_full;
+    const uint8_t *det_src_rgb = job->det_src_rgb;
+    uint8_t *algo_rgb = sc->algo_rgb;
+    uint8_t *plate_in = sc->plate_in;
+    uint8_t *plate_crop = sc->plate_crop;
+
+    t0 = mono_us();
+    age_ocr_tracks(ctx, seq);
+
+    if (raw_plate_count > 0) {
+        ctx->gate_plate_raw_positive_frames++;
+        ctx->gate_plate_raw_positive_streak++;
+    } else {
+        ctx->gate_plate_raw_positive_streak = 0;
+    }
+
+    for (i = 0; i < car_count && person_count < MAX_DETS; i++) {
+        if (cars[i].cls == ctx->person_class_id)
+            persons[person_count++] = cars[i];
+    }
+    if (ctx->opt.ped_event)
+        ped_events = update_ped_tracks_nn(ctx, persons, person_count, light_red, seq,
+                                          tracked_persons, &tracked_person_count);
+
+    for (i = 0; i < raw_plate_count && filtered_plate_count < MAX_DETS; i++) {
+        bool keep = plate_box_pass_rules(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height);
+        if (!keep && ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN) {
+            keep = plate_box_pass_rules_obb(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height) ||
+                   plate_box_pass_rules_relaxed(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height);
+        }
+        if (keep)
+            filtered_plates[filtered_plate_count++] = raw_plates[i];
+    }
+    if (filtered_plate_count == 0 &&
+        raw_plate_count > 0 &&
+        ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN) {
+        int best_i = 0;
+        float best_conf = raw_plates[0].conf;
+        for (i = 1; i < raw_plate_count; i++) {
+            if (raw_plates[i].conf > best_conf) {
+                best_conf = raw_plates[i].conf;
+                best_i = i;
+            }
+        }
+        if (best_conf >= fmaxf(0.50f, ctx->opt.min_plate_conf)) {
+            filtered_plates[filtered_plate_count++] = raw_plates[best_i];
+            lpr_log(LOG_INFO,
+                    "[plate-fallback] frame=%" PRIu64 " keep=top1 conf=%.3f reason=filtered_empty\n",
+                    seq, best_conf);
+        }
+    }
+    if (ctx->opt.fpga_a_mask && a_roi_valid) {
+        int roi_count = filter_boxes_by_roi(filtered_plates, filtered_plate_count, &a_roi,
+                                            ctx->opt.a_roi_iou_min, roi_plates, MAX_DETS);
+        if (roi_count > 0) {
+            memcpy(filtered_plates, roi_plates, (size_t)roi_count * sizeof(roi_plates[0]));
+            filtered_plate_count = roi_count;
+        }
+    }
+
+    temporal_confirm_and_update(ctx, filtered_plates, filtered_plate_count,
+                                stable_plates, &stable_plate_count);
+    t1 = mono_us();
+    prof_end(PROF_TRACK, t0);
+
+    memset(&r, 0, offsetof(struct lpr_results, cars));
+    r.car_raw_count = car_count;
+    r.person_raw_count = person_count;
+    r.plate_raw_count = raw_plate_count;
+    r.plate_rows_raw = plate_diag.rows_raw;
+    r.plate_heads_raw = plate_diag.heads_raw;
+    r.plate_rows_keep = plate_diag.rows_keep;
+    r.plate_heads_keep = plate_diag.heads_keep;
+    r.plate_decode_mode = plate_diag.mode;
+    r.ocr_run_count = 0;
+    r.ocr_skip_size = 0;
+    r.ocr_skip_blur = 0;
+    r.ocr_nonempty_count = 0;
+    r.overlay_text_nonempty_count = 0;
+    r.a_roi_valid = a_roi_valid ? 1 : 0;
+    r.a_roi = a_roi;
+    r.light_red = light_red ? 1 : 0;
+    for (i = 0; i < car_count && r.car_count < MAX_DETS; i++) {
+        if (cars[i].cls == ctx->car_class_id)
+            r.cars[r.car_count++] = cars[i];
+    }
+    if (!ctx->opt.ped_event) {
+        for (i = 0; i < person_count && r.person_count < MAX_DETS; i++)
+            r.persons[r.person_count++] = persons[i];
+    } else {
+        for (i = 0; i < tracked_person_count && r.person_count < MAX_DETS; i++)
+            r.persons[r.person_count++] = tracked_persons[i];
+    }
+
+    /* Crop and gate every plate, packing the ones that need OCR into the pool. */
+    for (i = 0; i < stable_plate_count && pending_count < MAX_DETS; i++) {
+        struct plate_pending *pp = &sc->pending[pending_count];
+        struct plate_det pd;
+        struct ocr_diag odiag;
+        int parent = -1;
+        int crop_w;
+        int crop_h;
+        int plate_h;
+        float sharpness = 0.0f;
+        float occ_ratio = 0.0f;
+        bool used_obb_warp = false;
+        bool crop_ok;
+        int64_t pt;
+        pd.box = stable_plates[i];
+        if (ctx->opt.plate_refine) {
+            struct det_box refined = pd.box;
+            pt = prof_begin();
+            if (refine_plate_box_local(ctx, det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
+                                       &pd.box, algo_rgb, plate_in, &refined))
+                pd.box = refined;
+            prof_end(PROF_REFINE, pt);
+        }
+        if (!ctx->opt.plate_only)
+            parent = find_parent_car(&pd.box, r.cars, r.car_count);
+        if (!ctx->opt.plate_only && ctx->opt.plate_on_car_only && parent < 0)
+            continue;
+        pd.parent_car = parent;
+        pd.color = classify_plate_color_rgb(rgb_full, (int)ctx->frame_width, (int)ctx->frame_height, &pd.box);
+        pt = prof_begin();
+        crop_ok = prepare_plate_crop_rgb888(ctx, rgb_full, (int)ctx->frame_width, (int)ctx->frame_height,
+                                            &pd.box, plate_crop, (int)ctx->frame_width, (int)ctx->frame_height,
+                                            &pd.crop_box, &crop_w, &crop_h, &occ_ratio, &used_obb_warp);
+        prof_end(PROF_CROP, pt);
+        if (!crop_ok)
+            continue;
+        if (ctx->opt.ocr_min_occ_ratio > 0.0f &&
+            occ_ratio < ctx->opt.ocr_min_occ_ratio &&
+            ctx->opt.ocr_crop_mode != OCR_CROP_TIGHT &&
+            !used_obb_warp) {
+            struct det_box recrop_box;
+            float old_occ = occ_ratio;
+            int new_w, new_h;
+            const char *mode_tag = "tight";
+            bool have_recap = false;
+            bool is_match_mode = (ctx->opt.ocr_crop_mode == OCR_CROP_MATCH);
+            if (ctx->opt.ocr_crop_mode == OCR_CROP_MATCH) {
+                have_recap = compute_match_ytrim_crop(ctx, &pd.crop_box, ctx->opt.ocr_min_occ_ratio, &recrop_box);
+                mode_tag = "match-ytrim";
+            }
+            if (!have_recap && !is_match_mode) {
+                compute_expand_crop_box(&pd.box, (int)ctx->frame_width, (int)ctx->frame_height, 0.08f, 0.16f, &recrop_box);
+                have_recap = true;
+            }
+            if (!have_recap) {
+                lpr_log(LOG_INFO,
+                        "[ocr-recrop] frame=%" PRIu64 " trigger=0 old_occ=%.3f mode=match-ytrim reason=not-improvable\n",
+                        seq, old_occ);
+            } else {
+                new_w = recrop_box.x2 - recrop_box.x1 + 1;
+                new_h = recrop_box.y2 - recrop_box.y1 + 1;
+                if (new_w > 0 && new_h > 0 &&
+                    new_w <= (int)ctx->frame_width && new_h <= (int)ctx->frame_height) {
+                    copy_crop_rgb888(rgb_full, (int)ctx->frame_width, &recrop_box, plate_crop);
+                    pd.crop_box = recrop_box;
+                    crop_w = new_w;
+                    crop_h = new_h;
+                    occ_ratio = estimate_ocr_occ_ratio(ctx, crop_w, crop_h);
+                    lpr_log(LOG_INFO,
+                            "[ocr-recrop] frame=%" PRIu64 " trigger=1 old_occ=%.3f new_mode=%s new_occ=%.3f\n",
+                            seq, old_occ, mode_tag, occ_ratio);
+                }
+            }
+        }
+        pd.ocr_in_occ_ratio = occ_ratio;
+        lpr_log(LOG_DEBUG,
+                "[crop-geom] frame=%" PRIu64 " box=[%d,%d,%d,%d] crop=[%d,%d,%d,%d] iou=%.3f\n",
+                seq,
+                pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
+                pd.crop_box.x1, pd.crop_box.y1, pd.crop_box.x2, pd.crop_box.y2,
+                box_iou(&pd.box, &pd.crop_box));
+        plate_h = pd.box.y2 - pd.box.y1 + 1;
+        pp->slot = -1;
+        pp->cached = false;
+        pp->dump_crop = NULL;
+        memset(&odiag, 0, sizeof(odiag));
+        if (plate_h < ctx->opt.ocr_min_plate_h) {
+            pd.ocr_text[0] = '\0';
+            pd.ocr_conf = 0.0f;
+            pd.ocr_blank_top1 = 0.0f;
+            memset(&odiag, 0, sizeof(odiag));
+            ocr_skip_size++;
+            lpr_log(LOG_INFO,
+                    "[ocr-skip] frame=%" PRIu64 " reason=size plate_h=%d min_h=%d bbox=[%d,%d,%d,%d]\n",
+                    seq, plate_h, ctx->opt.ocr_min_plate_h,
+                    pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2);
+        } else if (ocr_cache_lookup(ctx, &pd.box, seq, pd.ocr_text, sizeof(pd.ocr_text), &pd.ocr_conf)) {
+            pd.ocr_blank_top1 = 0.0f;
+            pp->cached = true;
+            ocr_cache_hit++;
+        } else {
+            pt = prof_begin();
+            sharpness = laplacian_variance_rgb888(plate_crop, crop_w, crop_h);
+            prof_end(PROF_SHARPNESS, pt);
+            if (sharpness < ctx->opt.ocr_min_sharpness) {
+                pd.ocr_text[0] = '\0';
+                pd.ocr_conf = 0.0f;
+                pd.ocr_blank_top1 = 0.0f;
+                memset(&odiag, 0, sizeof(odiag));
+                ocr_skip_blur++;
+                lpr_log(LOG_INFO,
+                        "[ocr-skip] frame=%" PRIu64 " reason=blur sharp=%.2f min=%.2f bbox=[%d,%d,%d,%d]\n",
+                        seq, sharpness, ctx->opt.ocr_min_sharpness,
+                        pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2);
+            } else {
+                uint8_t *slot_in = ocr_pool_slot(ctx, sc, ocr_slot_count);
+                struct ocr_slot *os = &sc->ocr_slots[ocr_slot_count];
+                bool prep_ok;
+
+                pt = prof_begin();
+                prep_ok = slot_in && prepare_ocr_input_into(ctx, plate_crop, crop_w, crop_h,
+                                                            slot_in, &os->occ_ratio);
+                prof_end(PROF_OCR_PREP, pt);
+                if (prep_ok) {
+                    pp->slot = ocr_slot_count++;
+                } else {
+                    snprintf(pd.ocr_text, sizeof(pd.ocr_text), "UNK");
+                    pd.ocr_conf = 0.0f;
+                    pd.ocr_blank_top1 = 0.0f;
+                }
             }
         }
-        if (alias && alias[0] != '\0') {
-            int j;
-            for (j = 0; alias[j] != '\0' && i + 1 < out_len; j++)
-                out[i++] = alias[j];
+        if (ctx->ocr_crop_index_fp &&
+            ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max) {
+            pp->dump_crop = frame_alloc((size_t)crop_w * crop_h * 3U);
+            if (pp->dump_crop)
+                memcpy(pp->dump_crop, plate_crop, (size_t)crop_w * crop_h * 3U);
+        }
+        pp->pd = pd;
+        pp->odiag = odiag;
+        pp->crop_w = crop_w;
+        pp->crop_h = crop_h;
+        pending_count++;
+    }
+
+    if (ocr_slot_count > 0) {
+        int64_t pt = prof_begin();
+        run_model_ocr_batch(ctx, sc->ocr_pool, ocr_slot_count, sc->ocr_slots);
+        prof_end(PROF_OCR, pt);
+    }
+
+    for (i = 0; i < pending_count; i++) {
+        struct plate_pending *pp = &sc->pending[i];
+        struct plate_det pd = pp->pd;
+        struct ocr_diag odiag = pp->odiag;
+        uint8_t *ocr_input_dump = NULL;
+        bool own_dump = false;
+        char overlay_txt[32];
+
+        if (pp->slot >= 0) {
+            const struct ocr_slot *os = &sc->ocr_slots[pp->slot];
+            if (os->ret < 0) {
+                snprintf(pd.ocr_text, sizeof(pd.ocr_text), "UNK");
+                pd.ocr_conf = 0.0f;
+                pd.ocr_blank_top1 = 0.0f;
+            } else {
+                copy_cstr_trunc(pd.ocr_text, sizeof(pd.ocr_text), os->text);
+                pd.ocr_conf = os->conf;
+                odiag = os->diag;
+                pd.ocr_blank_top1 = odiag.blank_top1_ratio;
+                pd.ocr_in_occ_ratio = odiag.in_occ_ratio;
+                ocr_run_count++;
+            }
         }
-    }
-
-    if (i == 0) {
-        const char *fb = "UNK";
-        if (pd->type == PLATE_TYPE_COMMON_BLUE) fb = "BLUE";
-        else if (pd->type == PLATE_TYPE_COMMON_GREEN) fb = "GREEN";
-        else if (pd->type == PLATE_TYPE_YELLOW) fb = "YELLOW";
-        else if (pd->type == PLATE_TYPE_POLICE) fb = "POLICE";
-        else if (pd->type == PLATE_TYPE_TRAILER) fb = "TRAILER";
-        else if (pd->type == PLATE_TYPE_EMBASSY_CONSULATE) fb = "EMB";
-        while (*fb && i + 1 < out_len)
-            out[i++] = *fb++;
-        if (i == 0) {
-            out[0] = 'U';
-            if (out_len > 1) out[1] = 'N';
-            if (out_len > 2) out[2] = 'K';
-            i = (out_len > 2) ? 3 : out_len - 1;
+        if (ctx->opt.ocr_ctc_diag) {
+            lpr_log(LOG_INFO,
+                    "[ctc] frame=%" PRIu64 " bbox=[%d,%d,%d,%d] t=%d c=%d blank=%d blank_top1=%.3f text=%s\n",
+                    seq,
+                    pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
+                    odiag.t_size, odiag.c_size, odiag.blank_idx, odiag.blank_top1_ratio,
+                    pd.ocr_text);
+        }
+        if (pd.ocr_text[0] != '\0' && !pp->cached) {
+            ocr_temporal_smooth(ctx, &pd.box, seq, pd.ocr_text, sizeof(pd.ocr_text), &pd.ocr_conf);
+            if (pp->slot >= 0 && sc->ocr_slots[pp->slot].ret == 0)
+                ocr_cache_update(ctx, &pd.box, seq, pd.ocr_text, pd.ocr_conf);
+        }
+        if (pd.ocr_text[0] != '\0')
+            ocr_nonempty_count++;
+        pd.type = classify_plate_type(pd.color, pd.ocr_text);
+        build_overlay_ascii_text(&pd, overlay_txt, sizeof(overlay_txt));
+        if (overlay_txt[0] != '\0')
+            overlay_nonempty_count++;
+        if (pp->dump_crop && ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max) {
+            if (pp->slot >= 0 && sc->ocr_slots[pp->slot].ret == 0) {
+                ocr_input_dump = ocr_pool_slot(ctx, sc, pp->slot);
+            } else {
+                ocr_input_dump = prepare_ocr_input_rgb888(ctx, pp->dump_crop, pp->crop_w, pp->crop_h, NULL);
+                own_dump = true;
+            }
+        }
+        if (ocr_input_dump) {
+            dump_ocr_pair(ctx, seq, &pd, pp->dump_crop, pp->crop_w, pp->crop_h,
+                          ocr_input_dump, (int)ctx->ocr_model.in_w, (int)ctx->ocr_model.in_h);
+            if (own_dump)
+                frame_free(ocr_input_dump);
+        }
+        frame_free(pp->dump_crop);
+        pp->dump_crop = NULL;
+        lpr_log(LOG_INFO,
+                "[pred] frame=%" PRIu64 " ts_us=%" PRId64 " bbox=[%d,%d,%d,%d] text=%s conf=%.2f type=%s color=%s\n",
+                seq,
+                mono_us(),
+                pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
+                pd.ocr_text,
+                pd.ocr_conf,
+                plate_type_str(pd.type),
+                plate_color_str(pd.color));
+        log_prediction_row(ctx, seq, mono_us(), &pd);
+        ctx->pred_rows_total++;
+        r.plates[r.plate_count++] = pd;
+    }
+    r.ocr_run_count = ocr_run_count;
+    r.ocr_skip_size = ocr_skip_size;
+    r.ocr_skip_blur = ocr_skip_blur;
+    r.ocr_cache_hit = ocr_cache_hit;
+    r.ocr_nonempty_count = ocr_nonempty_count;
+    r.overlay_text_nonempty_count = overlay_nonempty_count;
+    r.frame_seq = seq;
+    r.infer_ms_last = (double)(job->det_us + t1 - t0) / 1000.0;
+    prev = results_last(ctx);
+    r.infer_frames_total = prev->infer_frames_total + 1;
+    r.infer_ms_total = prev->infer_ms_total + r.infer_ms_last;
+    r.ped_event_total = prev->ped_event_total + (uint64_t)ped_events;
+    r.ped_event_last_frame = (ped_events > 0) ? seq : prev->ped_event_last_frame;
+    results_publish(ctx, &r);
+    overlay_plane_update(ctx, &r);
+    prof_end(PROF_POST, t0);
+}
+
+static void *infer_post_thread_main(void *arg)
+{
+    struct infer_pipe *pipe = (struct infer_pipe *)arg;
+    int next = 0;
+
+    pin_current_thread("lpr-post", pipe->ctx->opt.cpu_post);
+    g_frame_arena = &pipe->post_scratch.arena;
+    for (;;) {
+        pthread_mutex_lock(&pipe->lock);
+        while (!pipe->ready[next] && !pipe->stop)
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
+        if (!pipe->ready[next]) {
+            pthread_mutex_unlock(&pipe->lock);
+            break;
         }
+        pthread_mutex_unlock(&pipe->lock);
+
+        frame_arena_reset(&pipe->post_scratch.arena);
+        infer_post_stage(pipe->ctx, &pipe->jobs[next], &pipe->post_scratch);
+
+        pthread_mutex_lock(&pipe->lock);
+        pipe->ready[next] = false;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+        next = (next + 1) % INFER_JOBS;
     }
-    out[i] = '\0';
+    g_frame_arena = NULL;
+    return NULL;
 }
 
 static void *infer_thread_main(void *arg)
 {
     struct app_ctx *ctx = (struct app_ctx *)arg;
-    uint8_t *raw_local = malloc(ctx->src_frame_size);
-    uint8_t *rgb_full = malloc((size_t)ctx->frame_width * ctx->frame_height * 3U);
-    uint8_t *rgb_detect = malloc((size_t)ctx->frame_width * ctx->frame_height * 3U);
-    uint8_t *a_map = malloc((size_t)ctx->frame_width * ctx->frame_height);
-    uint8_t *algo_rgb = malloc((size_t)ALGO_STREAM_SIZE * ALGO_STREAM_SIZE * 3U);
-    uint8_t *veh_in = malloc((size_t)ctx->veh_model.in_w * ctx->veh_model.in_h * 3U);
-    uint8_t *plate_in = malloc((size_t)ctx->plate_model.in_w * ctx->plate_model.in_h * 3U);
-    uint8_t *plate_crop = malloc((size_t)ctx->frame_width * ctx->frame_height * 3U);
-    if (!raw_local || !rgb_full || !rgb_detect || !a_map || !algo_rgb || !veh_in || !plate_in || !plate_crop) {
-        free(raw_local); free(rgb_full); free(rgb_detect); free(a_map); free(algo_rgb);
-        free(veh_in); free(plate_in); free(plate_crop);
-        return NULL;
+    struct infer_pipe pipe;
+    struct infer_scratch det_scratch;
+    pthread_t post_thread;
+    bool post_started = false;
+    int njobs = ctx->opt.infer_pipeline ? INFER_JOBS : 1;
+    int next = 0;
+    int i;
+
+    pin_current_thread("lpr-infer", ctx->opt.cpu_infer);
+    memset(&pipe, 0, sizeof(pipe));
+    pipe.ctx = ctx;
+    pthread_mutex_init(&pipe.lock, NULL);
+    pthread_cond_init(&pipe.cond, NULL);
+    if (infer_scratch_alloc(ctx, &det_scratch) < 0)
+        goto out;
+    g_frame_arena = &det_scratch.arena;
+    for (i = 0; i < njobs; i++) {
+        if (infer_job_alloc(ctx, &pipe.jobs[i]) < 0)
+            goto out;
+    }
+    if (ctx->opt.infer_pipeline) {
+        if (infer_scratch_alloc(ctx, &pipe.post_scratch) < 0)
+            goto out;
+        if (pthread_create(&post_thread, NULL, infer_post_thread_main, &pipe) != 0) {
+            fprintf(stderr, "[infer] post thread failed, running stages inline\n");
+            infer_scratch_free(&pipe.post_scratch);
+        } else {
+            post_started = true;
+        }
     }
 
     while (ctx->running) {
-        struct det_box cars[MAX_DETS];
-        struct det_box raw_plates[MAX_DETS];
-        struct det_box filtered_plates[MAX_DETS];
-        struct det_box roi_plates[MAX_DETS];
-        struct det_box stable_plates[MAX_DETS];
-        struct det_box persons[MAX_DETS];
-        struct det_box tracked_persons[MAX_DETS];
-        struct lpr_results r;
-        int car_count = 0;
-        int raw_plate_count = 0;
-        int filtered_plate_count = 0;
-        int stable_plate_count = 0;
-        int person_count = 0;
-        int tracked_person_count = 0;
-        int ped_events = 0;
-        int ocr_run_count = 0;
-        int ocr_skip_size = 0;
-        int ocr_skip_blur = 0;
-        int ocr_nonempty_count = 0;
-        int overlay_nonempty_count = 0;
-        struct detect_decode_diag plate_diag;
-        bool light_red = false;
-        float red_ratio = 0.0f;
-        struct det_box a_roi = {0};
-        bool a_roi_valid = false;
-        int i;
-        int64_t t0, t1;
+        struct infer_job *job = &pipe.jobs[next];
         uint64_t seq;
-        const uint8_t *det_src_rgb = rgb_full;
+        int frame_idx;
+
+        /* The post thread always drains, so this wait cannot outlive shutdown. */
+        if (post_started) {
+            pthread_mutex_lock(&pipe.lock);
+            while (pipe.ready[next])
+                pthread_cond_wait(&pipe.cond, &pipe.lock);
+            pthread_mutex_unlock(&pipe.lock);
+        }
 
         pthread_mutex_lock(&ctx->infer_lock);
         while (ctx->running && !ctx->infer_has_new)
@@ -6147,326 +9990,39 @@ static void *infer_thread_main(void *arg)
             pthread_mutex_unlock(&ctx->infer_lock);
             break;
         }
-        memcpy(raw_local, ctx->infer_latest_raw, ctx->src_frame_size);
+        frame_idx = ctx->infer_latest_idx;
         seq = ctx->infer_frame_seq;
         ctx->infer_has_new = false;
         pthread_mutex_unlock(&ctx->infer_lock);
 
-        age_ocr_tracks(ctx, seq);
-
-        t0 = mono_us();
-        if (ctx->src_is_bgrx) {
-            bgrx8888_to_rgb888_and_a(raw_local, (int)ctx->frame_width, (int)ctx->frame_height, rgb_full, a_map);
-        } else {
-            raw565_to_rgb888_full(ctx, raw_local, rgb_full);
-            memset(a_map, 0, (size_t)ctx->frame_width * ctx->frame_height);
-        }
-        if (ctx->opt.sw_preproc) {
-            memcpy(rgb_detect, rgb_full, (size_t)ctx->frame_width * ctx->frame_height * 3U);
-            sw_preprocess_rgb888(rgb_detect, (int)ctx->frame_width, (int)ctx->frame_height);
-            det_src_rgb = rgb_detect;
-        }
-
-        if (ctx->opt.fpga_a_mask && ctx->src_is_bgrx) {
-            a_roi_valid = extract_a_channel_roi(a_map, (int)ctx->frame_width, (int)ctx->frame_height,
-                                                ctx->opt.a_proj_ratio, &a_roi, &red_ratio) ? true : false;
-            if (red_ratio >= ctx->opt.red_ratio_thr)
-                ctx->ped_red_streak++;
-            else
-                ctx->ped_red_streak = 0;
-            light_red = (ctx->ped_red_streak >= ctx->opt.red_stable_frames);
-        } else {
-            ctx->ped_red_streak = 0;
-            light_red = false;
-        }
-
-        memset(&plate_diag, 0, sizeof(plate_diag));
-
-        if (!ctx->opt.plate_only || ctx->opt.ped_event) {
-            if (run_detect_on_rgb(ctx, &ctx->veh_model, det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
-                                  ctx->opt.min_car_conf, algo_rgb, veh_in, cars, &car_count, NULL) < 0)
-                car_count = 0;
-        }
-        {
-            float plate_thr = ctx->opt.min_plate_conf;
-            if (ctx->opt.fpga_a_mask && a_roi_valid)
-                plate_thr = fmaxf(0.05f, plate_thr - 0.05f);
-            if (run_detect_on_rgb(ctx, &ctx->plate_model, det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
-                                  plate_thr, algo_rgb, plate_in, raw_plates, &raw_plate_count, &plate_diag) < 0)
-                raw_plate_count = 0;
-            if (raw_plate_count <= 0 &&
-                ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN &&
-                ctx->opt.det_resize_mode == DET_RESIZE_LETTERBOX) {
-                int saved_mode = ctx->opt.det_resize_mode;
-                fprintf(stderr,
-                        "[plate-fallback] frame=%" PRIu64 " retry=stretch reason=raw_empty\n",
-                        seq);
-                ctx->opt.det_resize_mode = DET_RESIZE_STRETCH;
-                if (run_detect_on_rgb(ctx, &ctx->plate_model, det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
-                                      plate_thr, algo_rgb, plate_in, raw_plates, &raw_plate_count, &plate_diag) < 0) {
-                    raw_plate_count = 0;
-                }
-                ctx->opt.det_resize_mode = saved_mode;
-            }
-        }
-        if (raw_plate_count > 0) {
-            ctx->gate_plate_raw_positive_frames++;
-            ctx->gate_plate_raw_positive_streak++;
-        } else {
-            ctx->gate_plate_raw_positive_streak = 0;
-        }
-
-        for (i = 0; i < car_count && person_count < MAX_DETS; i++) {
-            if (cars[i].cls == ctx->person_class_id)
-                persons[person_count++] = cars[i];
-        }
-        if (ctx->opt.ped_event)
-            ped_events = update_ped_tracks_nn(ctx, persons, person_count, light_red, seq,
-                                              tracked_persons, &tracked_person_count);
-
-        for (i = 0; i < raw_plate_count && filtered_plate_count < MAX_DETS; i++) {
-            bool keep = plate_box_pass_rules(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height);
-            if (!keep && ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN) {
-                keep = plate_box_pass_rules_obb(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height) ||
-                       plate_box_pass_rules_relaxed(&raw_plates[i], (int)ctx->frame_width, (int)ctx->frame_height);
-            }
-            if (keep)
-                filtered_plates[filtered_plate_count++] = raw_plates[i];
-        }
-        if (filtered_plate_count == 0 &&
-            raw_plate_count > 0 &&
-            ctx->opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN) {
-            int best_i = 0;
-            float best_conf = raw_plates[0].conf;
-            for (i = 1; i < raw_plate_count; i++) {
-                if (raw_plates[i].conf > best_conf) {
-                    best_conf = raw_plates[i].conf;
-                    best_i = i;
-                }
-            }
-            if (best_conf >= fmaxf(0.50f, ctx->opt.min_plate_conf)) {
-                filtered_plates[filtered_plate_count++] = raw_plates[best_i];
-                fprintf(stderr,
-                        "[plate-fallback] frame=%" PRIu64 " keep=top1 conf=%.3f reason=filtered_empty\n",
-                        seq, best_conf);
-            }
-        }
-        if (ctx->opt.fpga_a_mask && a_roi_valid) {
-            int roi_count = filter_boxes_by_roi(filtered_plates, filtered_plate_count, &a_roi,
-                                                ctx->opt.a_roi_iou_min, roi_plates, MAX_DETS);
-            if (roi_count > 0) {
-                memcpy(filtered_plates, roi_plates, (size_t)roi_count * sizeof(roi_plates[0]));
-                filtered_plate_count = roi_count;
-            }
+        frame_arena_reset(&det_scratch.arena);
+        infer_detect_stage(ctx, frame_idx, seq, job, &det_scratch);
+        if (!post_started) {
+            infer_post_stage(ctx, job, &det_scratch);
+            continue;
         }
+        pthread_mutex_lock(&pipe.lock);
+        pipe.ready[next] = true;
+        pthread_cond_broadcast(&pipe.cond);
+        pthread_mutex_unlock(&pipe.lock);
+        next = (next + 1) % INFER_JOBS;
+    }
 
-        temporal_confirm_and_update(ctx, filtered_plates, filtered_plate_count,
-                                    stable_plates, &stable_plate_count);
-        t1 = mono_us();
-
-        memset(&r, 0, sizeof(r));
-        r.car_raw_count = car_count;
-        r.person_raw_count = person_count;
-        r.plate_raw_count = raw_plate_count;
-        r.plate_rows_raw = plate_diag.rows_raw;
-        r.plate_heads_raw = plate_diag.heads_raw;
-        r.plate_rows_keep = plate_diag.rows_keep;
-        r.plate_heads_keep = plate_diag.heads_keep;
-        r.plate_decode_mode = plate_diag.mode;
-        r.ocr_run_count = 0;
-        r.ocr_skip_size = 0;
-        r.ocr_skip_blur = 0;
-        r.ocr_nonempty_count = 0;
-        r.overlay_text_nonempty_count = 0;
-        r.a_roi_valid = a_roi_valid ? 1 : 0;
-        r.a_roi = a_roi;
-        r.light_red = light_red ? 1 : 0;
-        for (i = 0; i < car_count && r.car_count < MAX_DETS; i++) {
-            if (cars[i].cls == ctx->car_class_id)
-                r.cars[r.car_count++] = cars[i];
-        }
-        if (!ctx->opt.ped_event) {
-            for (i = 0; i < person_count && r.person_count < MAX_DETS; i++)
-                r.persons[r.person_count++] = persons[i];
-        } else {
-            for (i = 0; i < tracked_person_count && r.person_count < MAX_DETS; i++)
-                r.persons[r.person_count++] = tracked_persons[i];
-        }
-
-        for (i = 0; i < stable_plate_count && r.plate_count < MAX_DETS; i++) {
-            struct plate_det pd;
-            struct ocr_diag odiag;
-            uint8_t *ocr_input_dump = NULL;
-            uint8_t **ocr_input_out = NULL;
-            int parent = -1;
-            int crop_w;
-            int crop_h;
-            int plate_h;
-            float sharpness = 0.0f;
-            float occ_ratio = 0.0f;
-            bool used_obb_warp = false;
-            char overlay_txt[32];
-            pd.box = stable_plates[i];
-            if (ctx->opt.plate_refine) {
-                struct det_box refined = pd.box;
-                if (refine_plate_box_local(ctx, det_src_rgb, (int)ctx->frame_width, (int)ctx->frame_height,
-                                           &pd.box, algo_rgb, plate_in, &refined))
-                    pd.box = refined;
-            }
-            if (!ctx->opt.plate_only)
-                parent = find_parent_car(&pd.box, r.cars, r.car_count);
-            if (!ctx->opt.plate_only && ctx->opt.plate_on_car_only && parent < 0)
-                continue;
-            pd.parent_car = parent;
-            pd.color = classify_plate_color_rgb(rgb_full, (int)ctx->frame_width, (int)ctx->frame_height, &pd.box);
-            if (!prepare_plate_crop_rgb888(ctx, rgb_full, (int)ctx->frame_width, (int)ctx->frame_height,
-                                           &pd.box, plate_crop, (int)ctx->frame_width, (int)ctx->frame_height,
-                                           &pd.crop_box, &crop_w, &crop_h, &occ_ratio, &used_obb_warp))
-                continue;
-            if (ctx->opt.ocr_min_occ_ratio > 0.0f &&
-                occ_ratio < ctx->opt.ocr_min_occ_ratio &&
-                ctx->opt.ocr_crop_mode != OCR_CROP_TIGHT &&
-                !used_obb_warp) {
-                struct det_box recrop_box;
-                float old_occ = occ_ratio;
-                int new_w, new_h;
-                const char *mode_tag = "tight";
-                bool have_recap = false;
-                bool is_match_mode = (ctx->opt.ocr_crop_mode == OCR_CROP_MATCH);
-                if (ctx->opt.ocr_crop_mode == OCR_CROP_MATCH) {
-                    have_recap = compute_match_ytrim_crop(ctx, &pd.crop_box, ctx->opt.ocr_min_occ_ratio, &recrop_box);
-                    mode_tag = "match-ytrim";
-                }
-                if (!have_recap && !is_match_mode) {
-                    compute_expand_crop_box(&pd.box, (int)ctx->frame_width, (int)ctx->frame_height, 0.08f, 0.16f, &recrop_box);
-                    have_recap = true;
-                }
-                if (!have_recap) {
-                    fprintf(stderr,
-                            "[ocr-recrop] frame=%" PRIu64 " trigger=0 old_occ=%.3f mode=match-ytrim reason=not-improvable\n",
-                            seq, old_occ);
-                } else {
-                    new_w = recrop_box.x2 - recrop_box.x1 + 1;
-                    new_h = recrop_box.y2 - recrop_box.y1 + 1;
-                    if (new_w > 0 && new_h > 0 &&
-                        new_w <= (int)ctx->frame_width && new_h <= (int)ctx->frame_height) {
-                        copy_crop_rgb888(rgb_full, (int)ctx->frame_width, &recrop_box, plate_crop);
-                        pd.crop_box = recrop_box;
-                        crop_w = new_w;
-                        crop_h = new_h;
-                        occ_ratio = estimate_ocr_occ_ratio(ctx, crop_w, crop_h);
-                        fprintf(stderr,
-                                "[ocr-recrop] frame=%" PRIu64 " trigger=1 old_occ=%.3f new_mode=%s new_occ=%.3f\n",
-                                seq, old_occ, mode_tag, occ_ratio);
-                    }
-                }
-            }
-            pd.ocr_in_occ_ratio = occ_ratio;
-            fprintf(stderr,
-                    "[crop-geom] frame=%" PRIu64 " box=[%d,%d,%d,%d] crop=[%d,%d,%d,%d] iou=%.3f\n",
-                    seq,
-                    pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
-                    pd.crop_box.x1, pd.crop_box.y1, pd.crop_box.x2, pd.crop_box.y2,
-                    box_iou(&pd.box, &pd.crop_box));
-            plate_h = pd.box.y2 - pd.box.y1 + 1;
-            if (ctx->ocr_crop_index_fp &&
-                ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max)
-                ocr_input_out = &ocr_input_dump;
-            if (plate_h < ctx->opt.ocr_min_plate_h) {
-                pd.ocr_text[0] = '\0';
-                pd.ocr_conf = 0.0f;
-                pd.ocr_blank_top1 = 0.0f;
-                memset(&odiag, 0, sizeof(odiag));
-                ocr_skip_size++;
-                fprintf(stderr,
-                        "[ocr-skip] frame=%" PRIu64 " reason=size plate_h=%d min_h=%d bbox=[%d,%d,%d,%d]\n",
-                        seq, plate_h, ctx->opt.ocr_min_plate_h,
-                        pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2);
-            } else {
-                sharpness = laplacian_variance_rgb888(plate_crop, crop_w, crop_h);
-                if (sharpness < ctx->opt.ocr_min_sharpness) {
-                    pd.ocr_text[0] = '\0';
-                    pd.ocr_conf = 0.0f;
-                    pd.ocr_blank_top1 = 0.0f;
-                    memset(&odiag, 0, sizeof(odiag));
-                    ocr_skip_blur++;
-                    fprintf(stderr,
-                            "[ocr-skip] frame=%" PRIu64 " reason=blur sharp=%.2f min=%.2f bbox=[%d,%d,%d,%d]\n",
-                            seq, sharpness, ctx->opt.ocr_min_sharpness,
-                            pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2);
-                } else {
-                    if (run_model_ocr(ctx, plate_crop, crop_w, crop_h,
-                                      pd.ocr_text, sizeof(pd.ocr_text), &pd.ocr_conf,
-                                      &odiag, ocr_input_out) < 0) {
-                        snprintf(pd.ocr_text, sizeof(pd.ocr_text), "UNK");
-                        pd.ocr_conf = 0.0f;
-                        pd.ocr_blank_top1 = 0.0f;
-                        memset(&odiag, 0, sizeof(odiag));
-                    } else {
-                        pd.ocr_blank_top1 = odiag.blank_top1_ratio;
-                        pd.ocr_in_occ_ratio = odiag.in_occ_ratio;
-                        ocr_run_count++;
-                    }
-                }
-            }
-            if (ctx->opt.ocr_ctc_diag) {
-                fprintf(stderr,
-                        "[ctc] frame=%" PRIu64 " bbox=[%d,%d,%d,%d] t=%d c=%d blank=%d blank_top1=%.3f text=%s\n",
-                        seq,
-                        pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
-                        odiag.t_size, odiag.c_size, odiag.blank_idx, odiag.blank_top1_ratio,
-                        pd.ocr_text);
-            }
-            if (pd.ocr_text[0] != '\0') {
-                ocr_temporal_smooth(ctx, &pd.box, seq, pd.ocr_text, sizeof(pd.ocr_text), &pd.ocr_conf);
-            }
-            if (pd.ocr_text[0] != '\0')
-                ocr_nonempty_count++;
-            pd.type = classify_plate_type(pd.color, pd.ocr_text);
-            build_overlay_ascii_text(&pd, overlay_txt, sizeof(overlay_txt));
-            if (overlay_txt[0] != '\0')
-                overlay_nonempty_count++;
-            if (!ocr_input_dump && ctx->ocr_crop_index_fp &&
-                ctx->ocr_crop_dumped < ctx->opt.ocr_crop_dump_max) {
-                ocr_input_dump = prepare_ocr_input_rgb888(ctx, plate_crop, crop_w, crop_h, NULL);
-            }
-            if (ocr_input_dump) {
-                dump_ocr_pair(ctx, seq, &pd, plate_crop, crop_w, crop_h,
-                              ocr_input_dump, (int)ctx->ocr_model.in_w, (int)ctx->ocr_model.in_h);
-                free(ocr_input_dump);
-                ocr_input_dump = NULL;
-            }
-            fprintf(stderr,
-                    "[pred] frame=%" PRIu64 " ts_us=%" PRId64 " bbox=[%d,%d,%d,%d] text=%s conf=%.2f type=%s color=%s\n",
-                    seq,
-                    mono_us(),
-                    pd.box.x1, pd.box.y1, pd.box.x2, pd.box.y2,
-                    pd.ocr_text,
-                    pd.ocr_conf,
-                    plate_type_str(pd.type),
-                    plate_color_str(pd.color));
-            log_prediction_row(ctx, seq, mono_us(), &pd);
-            ctx->pred_rows_total++;
-            r.plates[r.plate_count++] = pd;
-        }
-        r.ocr_run_count = ocr_run_count;
-        r.ocr_skip_size = ocr_skip_size;
-        r.ocr_skip_blur = ocr_skip_blur;
-        r.ocr_nonempty_count = ocr_nonempty_count;
-        r.overlay_text_nonempty_count = overlay_nonempty_count;
-        r.frame_seq = seq;
-        r.infer_ms_last = (double)(t1 - t0) / 1000.0;
-        pthread_mutex_lock(&ctx->result_lock);
-        r.infer_frames_total = ctx->results.infer_frames_total + 1;
-        r.infer_ms_total = ctx->results.infer_ms_total + r.infer_ms_last;
-        r.ped_event_total = ctx->results.ped_event_total + (uint64_t)ped_events;
-        r.ped_event_last_frame = (ped_events > 0) ? seq : ctx->results.ped_event_last_frame;
-        ctx->results = r;
-        pthread_mutex_unlock(&ctx->result_lock);
-    }
-
-    free(raw_local); free(rgb_full); free(rgb_detect); free(a_map); free(algo_rgb);
-    free(veh_in); free(plate_in); free(plate_crop);
+out:
+    if (post_started) {
+        pthread_mutex_lock(&pipe.lock);
+        pipe.stop = true;
+        pthread_cond_broadcast(&pipe.cond);
+        pthread_mutex_unlock(&pipe.lock);
+        pthread_join(post_thread, NULL);
+        infer_scratch_free(&pipe.post_scratch);
+    }
+    for (i = 0; i < INFER_JOBS; i++)
+        infer_job_free(&pipe.jobs[i]);
+    g_frame_arena = NULL;
+    infer_scratch_free(&det_scratch);
+    pthread_cond_destroy(&pipe.cond);
+    pthread_mutex_destroy(&pipe.lock);
     return NULL;
 }
 
@@ -6476,9 +10032,9 @@ static void overlay_results_on_slot(struct app_ctx *ctx, uint8_t *slot_data)
     uint16_t *pix = (uint16_t *)slot_data;
     int i;
     int stopline_y = (int)((float)ctx->frame_height * ctx->opt.stopline_ratio);
-    pthread_mutex_lock(&ctx->result_lock);
-    r = ctx->results;
-    pthread_mutex_unlock(&ctx->result_lock);
+    if (ctx->overlay.active)
+        return;
+    results_read(ctx, &r, true);
 
     for (i = 0; i < r.car_count; i++)
         draw_rect_565(pix, (int)ctx->frame_width, (int)ctx->frame_height, &r.cars[i], COLOR_YELLOW_565);
@@ -6487,21 +10043,14 @@ static void overlay_results_on_slot(struct app_ctx *ctx, uint8_t *slot_data)
 
     for (i = 0; i < r.plate_count; i++) {
         char txt[32];
-        int tx = r.plates[i].box.x1;
-        int text_scale = OVERLAY_TEXT_SCALE;
-        int text_h = 7 * text_scale;
-        int ty = r.plates[i].box.y1 - (text_h + 3);
-        if (ty < 0)
-            ty = r.plates[i].box.y1 + 3;
-        if (ty + text_h >= (int)ctx->frame_height)
-            ty = (int)ctx->frame_height - text_h - 1;
-        if (ty < 0)
-            ty = 0;
+        int tx;
+        int ty;
+        overlay_text_origin(ctx, &r.plates[i].box, OVERLAY_TEXT_SCALE, &tx, &ty);
         build_overlay_ascii_text(&r.plates[i], txt, sizeof(txt));
         draw_rect_565(pix, (int)ctx->frame_width, (int)ctx->frame_height, &r.plates[i].box, COLOR_CYAN_565);
         if (ctx->opt.show_crop_box)
             draw_rect_565(pix, (int)ctx->frame_width, (int)ctx->frame_height, &r.plates[i].crop_box, COLOR_RED_565);
-        draw_text_565(pix, (int)ctx->frame_width, (int)ctx->frame_height, tx, ty, txt, COLOR_CYAN_565, text_scale);
+        draw_text_565(pix, (int)ctx->frame_width, (int)ctx->frame_height, tx, ty, txt, COLOR_CYAN_565, OVERLAY_TEXT_SCALE);
     }
 
     if (ctx->opt.fpga_a_mask && r.a_roi_valid)
@@ -6513,12 +10062,23 @@ static void overlay_results_on_slot(struct app_ctx *ctx, uint8_t *slot_data)
     }
 }
 
-static void push_latest_to_infer(struct app_ctx *ctx, const uint8_t *raw)
+/* Latest-wins mailbox: lend the frame to infer by reference, no copy. */
+static void push_latest_to_infer(struct app_ctx *ctx, int frame_idx)
 {
+    bool replacing;
     pthread_mutex_lock(&ctx->infer_lock);
-    if (ctx->infer_has_new)
+    replacing = ctx->infer_has_new;
+    if (!frame_lend_to_infer(ctx, frame_idx, replacing)) {
+        /* Infer still converts an older frame and the pool is tight. */
+        ctx->infer_busy_skip_count++;
+        pthread_mutex_unlock(&ctx->infer_lock);
+        return;
+    }
+    if (replacing) {
         ctx->infer_overwrite_count++;
-    memcpy(ctx->infer_latest_raw, raw, ctx->src_frame_size);
+        frame_unref(ctx, ctx->infer_latest_idx);
+    }
+    ctx->infer_latest_idx = frame_idx;
     ctx->infer_frame_seq++;
     ctx->infer_has_new = true;
     pthread_cond_signal(&ctx->infer_cond);
@@ -6531,47 +10091,309 @@ static void print_stats(struct app_ctx *ctx)
     int64_t dt = now - ctx->last_stats_us;
     struct lpr_results r;
     const char *decode_mode;
+    double cap_lat_ms;
+    uint64_t cap, push, rel, lat_us, lat_n;
     if (dt < (int64_t)ctx->opt.stats_interval * 1000000LL)
         return;
-    pthread_mutex_lock(&ctx->result_lock);
-    r = ctx->results;
-    pthread_mutex_unlock(&ctx->result_lock);
+    /* Snapshot once; the pipeline stages keep counting while we print. */
+    cap = atomic_load_explicit(&ctx->captured_frames, memory_order_relaxed);
+    push = atomic_load_explicit(&ctx->pushed_frames, memory_order_relaxed);
+    rel = atomic_load_explicit(&ctx->released_frames, memory_order_relaxed);
+    lat_n = atomic_load_explicit(&ctx->capture_lat_samples, memory_order_relaxed);
+    lat_us = atomic_load_explicit(&ctx->total_capture_lat_us, memory_order_relaxed);
+    cap_lat_ms = lat_n ? ((double)lat_us / 1000.0 / (double)lat_n) : 0.0;
+    results_read(ctx, &r, false);
     decode_mode = plate_decode_mode_str(r.plate_decode_mode);
     fprintf(stderr,
             "[stats] cap=%" PRIu64 " push=%" PRIu64 " rel=%" PRIu64
             " infer=%" PRIu64 " infer_ms=%.2f cars=%d(raw=%d) persons=%d(raw=%d)"
-            " plates=%d(raw=%d) rows=%d/%d heads=%d/%d mode=%s ocr=%d run=%d skip_sz=%d skip_blur=%d ovtxt=%d aroi=%d red=%d ped_evt=%" PRIu64
-            " gate_raw_pos=%" PRIu64 " gate_streak=%" PRIu64 " pred_rows=%" PRIu64 " drop=%" PRIu64
-            " cap_fps=%.2f disp_fps=%.2f infer_fps=%.2f\n",
-            ctx->captured_frames, ctx->pushed_frames, ctx->released_frames,
+            " plates=%d(raw=%d) rows=%d/%d heads=%d/%d mode=%s ocr=%d run=%d skip_sz=%d skip_blur=%d cache=%d ovtxt=%d aroi=%d red=%d ped_evt=%" PRIu64
+            " gate_raw_pos=%" PRIu64 " gate_streak=%" PRIu64 " pred_rows=%" PRIu64 " drop=%" PRIu64 " infer_skip=%" PRIu64 " mgate=%" PRIu64 " ovl=%" PRIu64
+            " dma_drop=%u cap_lat=%.2fms cap_fps=%.2f disp_fps=%.2f infer_fps=%.2f\n",
+            cap, push, rel,
             r.infer_frames_total, r.infer_ms_last,
             r.car_count, r.car_raw_count,
             r.person_count, r.person_raw_count,
             r.plate_count, r.plate_raw_count,
             r.plate_rows_raw, r.plate_rows_keep,
             r.plate_heads_raw, r.plate_heads_keep, decode_mode,
-            r.ocr_nonempty_count, r.ocr_run_count, r.ocr_skip_size, r.ocr_skip_blur, r.overlay_text_nonempty_count,
+            r.ocr_nonempty_count, r.ocr_run_count, r.ocr_skip_size, r.ocr_skip_blur,
+            r.ocr_cache_hit, r.overlay_text_nonempty_count,
             r.a_roi_valid, r.light_red, r.ped_event_total,
             ctx->gate_plate_raw_positive_frames, ctx->gate_plate_raw_positive_streak, ctx->pred_rows_total,
-            ctx->infer_overwrite_count,
-            (double)(ctx->captured_frames - ctx->last_stats_cap) * 1000000.0 / (double)dt,
-            (double)(ctx->released_frames - ctx->last_stats_rel) * 1000000.0 / (double)dt,
+            ctx->infer_overwrite_count, ctx->infer_busy_skip_count, ctx->motion_gated_frames,
+            ctx->overlay.render_count, atomic_load_explicit(&ctx->dma_dropped, memory_order_relaxed), cap_lat_ms,
+            (double)(cap - ctx->last_stats_cap) * 1000000.0 / (double)dt,
+            (double)(rel - ctx->last_stats_rel) * 1000000.0 / (double)dt,
             (double)(r.infer_frames_total - ctx->last_stats_infer) * 1000000.0 / (double)dt);
-    ctx->last_stats_cap = ctx->captured_frames;
-    ctx->last_stats_rel = ctx->released_frames;
+    prof_report(false);
+    ctx->last_stats_cap = cap;
+    ctx->last_stats_rel = rel;
     ctx->last_stats_infer = r.infer_frames_total;
     ctx->last_stats_us = now;
 }
 
+/*
+ * Staged display path: capture -> convert+overlay -> push, one thread each.
+ * Stages are joined by single-producer/single-consumer rings, so a spike in
+ * one stage is absorbed by the queues instead of stalling the other two.
+ * Captured frames (refcounted, see struct frame_buf) go capture -> convert
+ * through raw_full; copy slots go convert -> push -> GStreamer release.
+ * Neither population exceeds STAGE_QUEUE_DEPTH, so a push never finds its
+ * ring full.
+ */
+struct stage_frame {
+    int frame_idx;
+    struct slot_ticket ticket;
+    uint64_t dma_ts_ns;
+};
+
+struct spsc_queue {
+    struct stage_frame items[STAGE_QUEUE_DEPTH];
+    atomic_uint head;
+    atomic_uint tail;
+    /* Only parks an idle consumer; ordering comes from head/tail. */
+    sem_t ready;
+};
+
+struct stage_pipeline {
+    struct app_ctx *ctx;
+    struct spsc_queue raw_full;
+    struct spsc_queue display;
+    pthread_t capture_thread;
+    pthread_t convert_thread;
+    pthread_t push_thread;
+    int threads_started;
+};
+
+static void spsc_init(struct spsc_queue *q)
+{
+    atomic_init(&q->head, 0U);
+    atomic_init(&q->tail, 0U);
+    sem_init(&q->ready, 0, 0);
+}
+
+static int spsc_push(struct spsc_queue *q, const struct stage_frame *f)
+{
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail - head >= STAGE_QUEUE_DEPTH)
+        return -1;
+    q->items[tail & (STAGE_QUEUE_DEPTH - 1U)] = *f;
+    atomic_store_explicit(&q->tail, tail + 1U, memory_order_release);
+    sem_post(&q->ready);
+    return 0;
+}
+
+static bool spsc_try_pop(struct spsc_queue *q, struct stage_frame *f)
+{
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head == tail)
+        return false;
+    *f = q->items[head & (STAGE_QUEUE_DEPTH - 1U)];
+    atomic_store_explicit(&q->head, head + 1U, memory_order_release);
+    return true;
+}
+
+/* Blocks until an item arrives; returns -1 once the app is shutting down. */
+static int spsc_pop_wait(struct app_ctx *ctx, struct spsc_queue *q, struct stage_frame *f)
+{
+    for (;;) {
+        struct timespec ts;
+        if (!ctx->running || g_stop)
+            return -1;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 20000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&q->ready, &ts) < 0) {
+            if (errno == ETIMEDOUT || errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (spsc_try_pop(q, f))
+            return 0;
+    }
+}
+
+static void *capture_stage_main(void *arg)
+{
+    struct stage_pipeline *sp = (struct stage_pipeline *)arg;
+    struct app_ctx *ctx = sp->ctx;
+    int64_t target_us = 1000000LL / ctx->opt.fps;
+
+    pin_current_thread("lpr-capture", ctx->opt.cpu_capture);
+    while (ctx->running && !g_stop) {
+        struct stage_frame f;
+        int64_t t0;
+        int64_t loop_us;
+
+        memset(&f, 0, sizeof(f));
+        t0 = mono_us();
+        f.frame_idx = trigger_frame_dma(ctx);
+        if (f.frame_idx < 0) {
+            ctx->running = false;
+            break;
+        }
+        atomic_fetch_add_explicit(&ctx->captured_frames, 1, memory_order_relaxed);
+        f.dma_ts_ns = take_dma_timestamp(ctx);
+        spsc_push(&sp->raw_full, &f);
+
+        loop_us = mono_us() - t0;
+        if (loop_us < target_us && !ctx->replay.map)
+            usleep((useconds_t)(target_us - loop_us));
+    }
+    return NULL;
+}
+
+static void *convert_stage_main(void *arg)
+{
+    struct stage_pipeline *sp = (struct stage_pipeline *)arg;
+    struct app_ctx *ctx = sp->ctx;
+
+    pin_current_thread("lpr-convert", ctx->opt.cpu_convert);
+    while (ctx->running) {
+        struct stage_frame f;
+        const uint8_t *raw;
+        uint8_t *slot;
+
+        if (spsc_pop_wait(ctx, &sp->raw_full, &f) < 0)
+            break;
+        if (acquire_free_slot(ctx, &f.ticket) < 0) {
+            frame_unref(ctx, f.frame_idx);
+            ctx->running = false;
+            break;
+        }
+        raw = ctx->frames[f.frame_idx].data;
+        slot = ctx->slots[f.ticket.idx].data;
+        copy_frame_to_slot565(ctx, slot, raw);
+        push_latest_to_infer(ctx, f.frame_idx);
+        /* Display is done with the source; capture may refill it while we draw. */
+        frame_unref(ctx, f.frame_idx);
+        overlay_results_on_slot(ctx, slot);
+        spsc_push(&sp->display, &f);
+    }
+    return NULL;
+}
+
+static void *push_stage_main(void *arg)
+{
+    struct stage_pipeline *sp = (struct stage_pipeline *)arg;
+    struct app_ctx *ctx = sp->ctx;
+
+    pin_current_thread("lpr-push", ctx->opt.cpu_push);
+    while (ctx->running) {
+        struct stage_frame f;
+        GstBuffer *buf;
+        GstFlowReturn flow;
+
+        if (spsc_pop_wait(ctx, &sp->display, &f) < 0)
+            break;
+        buf = build_frame_buffer(ctx, &f.ticket);
+        if (!buf) {
+            ctx->running = false;
+            break;
+        }
+        flow = gst_app_src_push_buffer(GST_APP_SRC(ctx->appsrc), buf);
+        if (flow != GST_FLOW_OK) {
+            release_slot_ticket(ctx, &f.ticket, false);
+            ctx->running = false;
+            break;
+        }
+        atomic_fetch_add_explicit(&ctx->pushed_frames, 1, memory_order_relaxed);
+        account_capture_latency(ctx, f.dma_ts_ns);
+    }
+    return NULL;
+}
+
+static void stop_stage_pipeline(struct app_ctx *ctx)
+{
+    struct stage_pipeline *sp = ctx->stages;
+    struct stage_frame f;
+
+    if (!sp)
+        return;
+    ctx->running = false;
+    if (sp->threads_started > 2)
+        pthread_join(sp->capture_thread, NULL);
+    if (sp->threads_started > 1)
+        pthread_join(sp->convert_thread, NULL);
+    if (sp->threads_started > 0)
+        pthread_join(sp->push_thread, NULL);
+    /* Overlaid slots that never reached appsrc go back to the free pool. */
+    while (spsc_try_pop(&sp->display, &f))
+        release_slot_ticket(ctx, &f.ticket, false);
+    while (spsc_try_pop(&sp->raw_full, &f))
+        frame_unref(ctx, f.frame_idx);
+    sem_destroy(&sp->raw_full.ready);
+    sem_destroy(&sp->display.ready);
+    free(sp);
+    ctx->stages = NULL;
+}
+
+static int start_stage_pipeline(struct app_ctx *ctx)
+{
+    struct stage_pipeline *sp = calloc(1, sizeof(*sp));
+
+    if (!sp)
+        return -1;
+    sp->ctx = ctx;
+    spsc_init(&sp->raw_full);
+    spsc_init(&sp->display);
+    ctx->stages = sp;
+
+    if (pthread_create(&sp->push_thread, NULL, push_stage_main, sp) != 0)
+        return -1;
+    sp->threads_started++;
+    if (pthread_create(&sp->convert_thread, NULL, convert_stage_main, sp) != 0)
+        return -1;
+    sp->threads_started++;
+    if (pthread_create(&sp->capture_thread, NULL, capture_stage_main, sp) != 0)
+        return -1;
+    sp->threads_started++;
+    return 0;
+}
+
+/* Main thread only services the bus and stats while the stages run. */
+static int run_stage_pipeline(struct app_ctx *ctx)
+{
+    if (start_stage_pipeline(ctx) < 0) {
+        stop_stage_pipeline(ctx);
+        return -1;
+    }
+    while (ctx->running) {
+        if (g_stop)
+            ctx->running = false;
+        if (!ctx->running)
+            break;
+        if (handle_bus_messages(ctx) < 0)
+            break;
+        print_stats(ctx);
+        usleep(10000);
+    }
+    stop_stage_pipeline(ctx);
+    return 0;
+}
+
 static void cleanup(struct app_ctx *ctx)
 {
     int i;
     ctx->running = false;
+    stop_stage_pipeline(ctx);
     pthread_mutex_lock(&ctx->infer_lock);
     pthread_cond_broadcast(&ctx->infer_cond);
     pthread_mutex_unlock(&ctx->infer_lock);
     if (ctx->infer_thread)
         pthread_join(ctx->infer_thread, NULL);
+    prof_report(true);
+    if (ctx->opt.prof_trace_path)
+        prof_trace_write(ctx->opt.prof_trace_path);
+    free(g_prof.trace);
+    g_prof.trace = NULL;
+    log_stop();
 
     rknn_model_release(&ctx->veh_model);
     rknn_model_release(&ctx->plate_model);
@@ -6596,10 +10418,21 @@ static void cleanup(struct app_ctx *ctx)
     if (ctx->pipeline)
         gst_object_unref(ctx->pipeline);
 
-    if (ctx->dma_map)
-        munmap(ctx->dma_map, ctx->dma_map_size);
-    free(ctx->dma_copy);
-    free(ctx->infer_latest_raw);
+    release_rga_frames(ctx);
+    free(ctx->motion_prev);
+    ctx->motion_prev = NULL;
+    for (i = 0; i < ctx->dma_map_count; i++) {
+        if (ctx->dma_maps[i])
+            munmap(ctx->dma_maps[i], ctx->dma_map_size);
+        if (ctx->tensor_maps[i])
+            munmap(ctx->tensor_maps[i], ctx->tensor_map_size);
+    }
+    if (!ctx->async_dma) {
+        for (i = 0; i < ctx->frame_count; i++)
+            free(ctx->frames[i].data);
+    }
+    if (ctx->replay.map)
+        munmap(ctx->replay.map, ctx->replay.map_size);
 
     if (ctx->slots) {
         for (i = 0; i < ctx->slot_count; i++)
@@ -6609,15 +10442,17 @@ static void cleanup(struct app_ctx *ctx)
 
     if (ctx->dev_fd >= 0)
         close(ctx->dev_fd);
+    overlay_plane_release(ctx);
     if (ctx->drm_fd >= 0)
         close(ctx->drm_fd);
 
     pthread_mutex_destroy(&ctx->infer_lock);
     pthread_cond_destroy(&ctx->infer_cond);
-    pthread_mutex_destroy(&ctx->result_lock);
     pthread_mutex_destroy(&ctx->pred_log_lock);
     g_cond_clear(&ctx->slots_cond);
     g_mutex_clear(&ctx->slots_lock);
+    g_cond_clear(&ctx->frame_cond);
+    g_mutex_clear(&ctx->frame_lock);
 }
 
 int main(int argc, char **argv)
@@ -6632,15 +10467,20 @@ int main(int argc, char **argv)
 
     g_mutex_init(&ctx.slots_lock);
     g_cond_init(&ctx.slots_cond);
+    g_mutex_init(&ctx.frame_lock);
+    g_cond_init(&ctx.frame_cond);
     pthread_mutex_init(&ctx.infer_lock, NULL);
     pthread_cond_init(&ctx.infer_cond, NULL);
-    pthread_mutex_init(&ctx.result_lock, NULL);
     pthread_mutex_init(&ctx.pred_log_lock, NULL);
 
     if (parse_options(argc, argv, &ctx.opt) < 0) {
         print_usage(argv[0]);
         goto out;
     }
+    glyph_atlas_init();
+    if (prof_init(ctx.opt.prof, ctx.opt.prof_trace_path) < 0)
+        goto out;
+    g_log.level = ctx.opt.log_level;
     if (ctx.opt.plate_detector_type == DETECTOR_YOLOV8_OBB_RKNN &&
         ctx.opt.ocr_crop_mode != OCR_CROP_OBB_WARP) {
         fprintf(stderr,
@@ -6665,7 +10505,8 @@ int main(int argc, char **argv)
                 "[cfg] detector=yolov8_obb_rknn keeps OCR contract, force ocr-resize-kernel=nn\n");
         ctx.opt.ocr_resize_kernel = OCR_KERNEL_NN;
     }
-    offline_mode = (ctx.opt.offline_image_path && ctx.opt.offline_image_path[0] != '\0');
+    offline_mode = (ctx.opt.offline_image_path && ctx.opt.offline_image_path[0] != '\0') ||
+                   (ctx.opt.offline_batch_path && ctx.opt.offline_batch_path[0] != '\0');
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -6681,10 +10522,13 @@ int main(int argc, char **argv)
         goto out;
     if (load_ocr_keys(&ctx, ctx.opt.ocr_keys_path) < 0)
         goto out;
-    if (!offline_mode && init_fpga_dma(&ctx) < 0)
+    if (!offline_mode &&
+        (ctx.opt.replay_path && ctx.opt.replay_path[0] != '\0' ? init_replay(&ctx) : init_fpga_dma(&ctx)) < 0)
         goto out;
     if (!offline_mode && init_copy_slots(&ctx) < 0)
         goto out;
+    if (!offline_mode)
+        init_rga_frames(&ctx);
     if (!offline_mode &&
         rknn_model_load(&ctx.veh_model, "vehicle", ctx.opt.veh_model_path,
                         ctx.label_count, DETECTOR_YOLOV5) < 0)
@@ -6696,16 +10540,26 @@ int main(int argc, char **argv)
     ctx.plate_model.nms_iou_thr = ctx.opt.plate_nms_iou;
     ctx.plate_model.max_det = ctx.opt.plate_max_det;
     ctx.plate_model.class_filter = ctx.opt.plate_class_id;
+    ctx.veh_model.prof_stage = PROF_VEH_PRE;
+    ctx.plate_model.prof_stage = PROF_PLATE_PRE;
     if (rknn_ocr_model_load(&ctx.ocr_model, "ocr", ctx.opt.ocr_model_path) < 0)
         goto out;
     if (rknn_quad_refiner_model_load(&ctx.quad_refiner_model, "quad_refiner", ctx.opt.quad_refiner_model_path) < 0)
         goto out;
+    if (init_npu_io(&ctx) < 0)
+        goto out;
 
     if (ctx.opt.pred_log_path && ctx.opt.pred_log_path[0] != '\0') {
-        ctx.pred_log_fp = fopen(ctx.opt.pred_log_path, "w");
+        ctx.pred_log_fp = fopen(ctx.opt.pred_log_path, "wb");
         if (!ctx.pred_log_fp)
             goto out;
-        fprintf(ctx.pred_log_fp, "frame_id,plate_text_pred,plate_type_pred,conf,x1,y1,x2,y2,ts_us\n");
+        if (ctx.opt.pred_log_format == PRED_LOG_BIN) {
+            uint32_t hdr[2] = { PRED_BIN_VERSION, (uint32_t)sizeof(struct pred_record) };
+            fwrite(PRED_BIN_MAGIC, 1, 4, ctx.pred_log_fp);
+            fwrite(hdr, sizeof(hdr), 1, ctx.pred_log_fp);
+        } else {
+            fprintf(ctx.pred_log_fp, "frame_id,plate_text_pred,plate_type_pred,conf,x1,y1,x2,y2,ts_us\n");
+        }
         fflush(ctx.pred_log_fp);
     }
     if (ctx.opt.ocr_crop_dump_dir && ctx.opt.ocr_crop_dump_dir[0] != '\0') {
@@ -6722,14 +10576,17 @@ int main(int argc, char **argv)
                 "crop_path,ocr_input_path\n");
         fflush(ctx.ocr_crop_index_fp);
     }
+    if (log_start(&ctx) < 0)
+        goto out;
 
     if (offline_mode) {
         fprintf(stderr,
-                "Start OFFLINE OCR: image=%s roi=%s auto_det=%d min_plate=%.2f det_resize=%s plate_refine=%d "
+                "Start OFFLINE OCR: %s=%s roi=%s auto_det=%d min_plate=%.2f det_resize=%s plate_refine=%d "
                 "plate_det=%s nms_iou=%.2f max_det=%d cls_filter=%d "
                 "ocr_ch=%s ocr_crop=%s ocr_resize=%s ocr_kernel=%s ocr_pp=%s min_h=%d min_sharp=%.2f min_occ=%.2f "
                 "crop_src=fullres_raw det_src=%s quad_refiner=%s\n",
-                ctx.opt.offline_image_path,
+                ctx.opt.offline_batch_path ? "batch" : "image",
+                ctx.opt.offline_batch_path ? ctx.opt.offline_batch_path : ctx.opt.offline_image_path,
                 (ctx.opt.offline_roi_arg && ctx.opt.offline_roi_arg[0]) ? ctx.opt.offline_roi_arg : "<none>",
                 ctx.opt.offline_detect_plate,
                 ctx.opt.min_plate_conf,
@@ -6749,26 +10606,30 @@ int main(int argc, char **argv)
                 ctx.opt.ocr_min_occ_ratio,
                 ctx.opt.sw_preproc ? "preproc" : "raw",
                 ctx.opt.quad_refiner_model_path ? ctx.opt.quad_refiner_model_path : "<off>");
-        if (run_offline_once(&ctx) < 0)
+        if (ctx.opt.offline_batch_path ? run_offline_batch(&ctx) < 0 : run_offline_once(&ctx) < 0)
             goto out;
         ret = 0;
         goto out;
     }
 
-    ctx.infer_latest_raw = malloc(ctx.src_frame_size);
-    if (!ctx.infer_latest_raw)
-        goto out;
+    ctx.infer_latest_idx = -1;
     if (build_pipeline(&ctx) < 0)
         goto out;
+    overlay_plane_init(&ctx);
     if (pthread_create(&ctx.infer_thread, NULL, infer_thread_main, &ctx) != 0)
         goto out;
+    if (ctx.async_dma && queue_all_dma_buffers(&ctx) < 0)
+        goto out;
+    if (ctx.async_dma && ctx.opt.dma_stream && start_dma_streaming(&ctx) < 0)
+        goto out;
 
     fprintf(stderr,
             "Start LPR loop: fps=%d src=%s pixel=%s swap16=%s min_car=%.2f min_plate=%.2f plate_only=%d "
             "sw_preproc=%d fpga_a_mask=%d ped_event=%d det_resize=%s plate_refine=%d "
             "plate_det=%s nms_iou=%.2f max_det=%d cls_filter=%d "
             "ocr_ch=%s ocr_crop=%s ocr_resize=%s ocr_kernel=%s ocr_pp=%s min_h=%d min_sharp=%.2f min_occ=%.2f show_crop=%d "
-            "crop_src=fullres_raw det_src=%s ctc_diag=%d ocr_dump=%s max=%d pred_log=%s quad_refiner=%s\n",
+            "crop_src=fullres_raw det_src=%s ctc_diag=%d ocr_dump=%s max=%d pred_log=%s quad_refiner=%s dma_queue=%d dma_stream=%d dma_userptr=%d fpga_tensor=%d pipeline=%d infer_pipeline=%d veh_every=%d npu_zero_copy=%d int8_decode=%d ocr_cache_ttl=%d motion_gate=%d plate_cascade=%d overlay_plane=%d prof=%d log=%d log_async=%d pixconv=%s preproc=%s "
+            "replay=%s replay_speed=%.2f replay_loop=%d\n",
             ctx.opt.fps,
             ctx.src_is_bgrx ? "bgrx8888" : "bgr565",
             (ctx.opt.pixel_order == PIXEL_ORDER_BGR565) ? "bgr565" : "rgb565",
@@ -6798,14 +10659,31 @@ int main(int argc, char **argv)
             ctx.opt.ocr_crop_dump_dir ? ctx.opt.ocr_crop_dump_dir : "<off>",
             ctx.opt.ocr_crop_dump_max,
             ctx.opt.pred_log_path ? ctx.opt.pred_log_path : "<off>",
-            ctx.opt.quad_refiner_model_path ? ctx.opt.quad_refiner_model_path : "<off>");
+            ctx.opt.quad_refiner_model_path ? ctx.opt.quad_refiner_model_path : "<off>",
+            ctx.async_dma ? ctx.dma_map_count : 0,
+            (ctx.async_dma && ctx.opt.dma_stream) ? 1 : 0,
+            (!ctx.async_dma && ctx.opt.dma_userptr) ? 1 : 0,
+            ctx.fpga_tensor ? 1 : 0,
+            ctx.opt.pipeline, ctx.opt.infer_pipeline, ctx.opt.veh_every, ctx.opt.npu_zero_copy,
+            ctx.opt.int8_decode, ctx.opt.ocr_cache_ttl,
+            ctx.opt.motion_gate, ctx.opt.plate_cascade, ctx.overlay.active ? (int)ctx.overlay.plane_id : -1,
+            g_prof.enabled ? 1 : 0,
+            (int)g_log.level, g_log.async ? 1 : 0,
+            pixconv_backend_name(),
+            preproc_backend_str(ctx.opt.preproc_backend),
+            ctx.replay.map ? ctx.opt.replay_path : "<off>",
+            ctx.opt.replay_speed, ctx.opt.replay_loop);
 
     ctx.last_stats_us = mono_us();
 
-    while (ctx.running) {
+    if (ctx.opt.pipeline && run_stage_pipeline(&ctx) < 0)
+        goto out;
+
+    while (ctx.running && !ctx.opt.pipeline) {
         struct slot_ticket ticket;
         GstBuffer *buf;
         GstFlowReturn flow;
+        int frame_idx;
         int64_t t0;
         int64_t loop_us;
         int64_t target_us = 1000000LL / ctx.opt.fps;
@@ -6818,14 +10696,18 @@ int main(int argc, char **argv)
             break;
 
         t0 = mono_us();
-        if (trigger_frame_dma(&ctx) < 0)
+        frame_idx = trigger_frame_dma(&ctx);
+        if (frame_idx < 0)
             break;
-        ctx.captured_frames++;
+        atomic_fetch_add_explicit(&ctx.captured_frames, 1, memory_order_relaxed);
 
-        if (acquire_free_slot(&ctx, &ticket) < 0)
+        if (acquire_free_slot(&ctx, &ticket) < 0) {
+            frame_unref(&ctx, frame_idx);
             break;
-        copy_frame_to_slot565(&ctx, ctx.slots[ticket.idx].data, ctx.dma_copy);
-        push_latest_to_infer(&ctx, ctx.dma_copy);
+        }
+        copy_frame_to_slot565(&ctx, ctx.slots[ticket.idx].data, ctx.frames[frame_idx].data);
+        push_latest_to_infer(&ctx, frame_idx);
+        frame_unref(&ctx, frame_idx);
         overlay_results_on_slot(&ctx, ctx.slots[ticket.idx].data);
 
         buf = build_frame_buffer(&ctx, &ticket);
@@ -6836,16 +10718,18 @@ int main(int argc, char **argv)
             release_slot_ticket(&ctx, &ticket, false);
             break;
         }
-        ctx.pushed_frames++;
+        atomic_fetch_add_explicit(&ctx.pushed_frames, 1, memory_order_relaxed);
+        account_capture_latency(&ctx, take_dma_timestamp(&ctx));
         print_stats(&ctx);
 
         loop_us = mono_us() - t0;
-        if (loop_us < target_us)
+        if (loop_us < target_us && !ctx.replay.map)
             usleep((useconds_t)(target_us - loop_us));
     }
 
-    fprintf(stderr, "Exit: cap=%" PRIu64 " push=%" PRIu64 " rel=%" PRIu64 "\n",
-            ctx.captured_frames, ctx.pushed_frames, ctx.released_frames);
+    fprintf(stderr, "Exit: cap=%" PRIu64 " push=%" PRIu64 " rel=%" PRIu64 " dma_drop=%u\n",
+            (uint64_t)atomic_load(&ctx.captured_frames), (uint64_t)atomic_load(&ctx.pushed_frames),
+            (uint64_t)atomic_load(&ctx.released_frames), atomic_load(&ctx.dma_dropped));
     ret = 0;
 out:
     cleanup(&ctx);
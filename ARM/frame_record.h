@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Raw frame recording container shared by fpga_dma_test (--record) and
+ * fpga_lpr_display (--replay).
+ *
+ * Layout (little endian, native struct packing):
+ *   [0, FRAME_RECORD_ALIGN)       struct frame_record_header, zero padded
+ *   slot i at data_offset + i * slot_bytes:
+ *     struct frame_record_entry, zero padded to FRAME_RECORD_ENTRY_BYTES
+ *     frame payload (frame_bytes)
+ *     zero padding up to slot_bytes
+ *
+ * Every slot is a multiple of FRAME_RECORD_ALIGN so the recorder can write
+ * with O_DIRECT and the replay side can mmap the file as-is.
+ */
+
+#ifndef _FRAME_RECORD_H
+#define _FRAME_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_RECORD_MAGIC        0x57415246U  /* "FRAW" */
+#define FRAME_RECORD_VERSION      1U
+#define FRAME_RECORD_ALIGN        4096U
+#define FRAME_RECORD_ENTRY_BYTES  64U
+
+/* Slot size for a payload, entry header included */
+#define FRAME_RECORD_SLOT_BYTES(frame_bytes) \
+    (((uint64_t)(frame_bytes) + FRAME_RECORD_ENTRY_BYTES + FRAME_RECORD_ALIGN - 1) & \
+     ~(uint64_t)(FRAME_RECORD_ALIGN - 1))
+
+/**
+ * struct frame_record_header - File header, rewritten when recording ends
+ * @magic: FRAME_RECORD_MAGIC
+ * @version: FRAME_RECORD_VERSION
+ * @width: Frame width in pixels
+ * @height: Frame height in pixels
+ * @bpp: Bytes per pixel
+ * @stride: Bytes per line
+ * @pixel_format: FPGA_PIXEL_FORMAT_* of the payload
+ * @frame_bytes: Payload bytes per slot
+ * @slot_bytes: Bytes per slot (entry + payload + padding)
+ * @reserved: Zero
+ * @frame_count: Complete slots in the file, 0 while recording (or after a crash)
+ * @data_offset: Offset of slot 0
+ * @start_ns: CLOCK_MONOTONIC time recording started
+ * @dropped: Frames the recorder could not queue for writing
+ */
+struct frame_record_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bpp;
+    uint32_t stride;
+    uint32_t pixel_format;
+    uint32_t frame_bytes;
+    uint32_t slot_bytes;
+    uint32_t reserved;
+    uint64_t frame_count;
+    uint64_t data_offset;
+    uint64_t start_ns;
+    uint64_t dropped;
+};
+
+/**
+ * struct frame_record_entry - Per-frame header at the start of every slot
+ * @timestamp_ns: DMA completion time (CLOCK_MONOTONIC, from DQBUF)
+ * @sequence: Driver completion sequence number (gaps mean lost frames)
+ * @driver_dropped: Driver streaming drop counter at this frame
+ * @index: Slot number in the file
+ * @size: Payload bytes that landed
+ */
+struct frame_record_entry {
+    uint64_t timestamp_ns;
+    uint32_t sequence;
+    uint32_t driver_dropped;
+    uint32_t index;
+    uint32_t size;
+};
+
+/* Returns the payload of slot @i in a mapped recording */
+static inline const uint8_t *frame_record_payload(const uint8_t *base,
+                                                  const struct frame_record_header *h,
+                                                  uint64_t i)
+{
+    return base + h->data_offset + i * h->slot_bytes + FRAME_RECORD_ENTRY_BYTES;
+}
+
+static inline const struct frame_record_entry *frame_record_entry_at(const uint8_t *base,
+                                                                     const struct frame_record_header *h,
+                                                                     uint64_t i)
+{
+    return (const struct frame_record_entry *)(base + h->data_offset + i * h->slot_bytes);
+}
+
+#endif /* _FRAME_RECORD_H */
@@ -26,6 +26,17 @@
 #include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/version.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/timekeeping.h>
+#include <linux/dma-buf.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/kref.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "pcie_fpga_dma.h"
 
@@ -49,6 +60,11 @@ static int dma_pixel_format = FPGA_PIXEL_FORMAT_BGRX8888;
 static int dma_allow_poll_fallback = 0;
 static int dma_irq_timeout_retry_poll = 1;
 static int dma_ring_buffers = 3;
+static int dma_ring_cached = 0;
+static int dma_poll_frame_mode = 1;   /* polling fallback: one frame-mode command, windowed sentinels */
+static int dma_poll_window = 16;      /* 4 KB chunks probed per poll tick */
+static int dma_poll_period_us = 50;   /* hrtimer poll period for frame-mode polling */
+static int dma_tensor = 0;            /* pair a detector tensor slot with every ring slot */
 
 module_param(major_num, int, 0);
 MODULE_PARM_DESC(major_num, "Major device number (0=dynamic)");
@@ -74,6 +90,62 @@ module_param(dma_irq_timeout_retry_poll, int, 0644);
 MODULE_PARM_DESC(dma_irq_timeout_retry_poll, "Retry once with polling path on IRQ timeout (0=disabled, 1=enabled)");
 module_param(dma_ring_buffers, int, 0644);
 MODULE_PARM_DESC(dma_ring_buffers, "Number of DMA frame ring buffers (1..8)");
+module_param(dma_ring_cached, int, 0644);
+MODULE_PARM_DESC(dma_ring_cached, "Ring memory: 0=coherent (uncached on arm64), 1=cacheable with streaming sync");
+module_param(dma_poll_frame_mode, int, 0644);
+MODULE_PARM_DESC(dma_poll_frame_mode, "Polling fallback engine: 0=serial 4KB chunks (legacy RTL), 1=frame mode with windowed sentinels");
+module_param(dma_poll_window, int, 0644);
+MODULE_PARM_DESC(dma_poll_window, "Frame-mode polling: 4KB chunks checked per poll tick");
+module_param(dma_poll_period_us, int, 0644);
+MODULE_PARM_DESC(dma_poll_period_us, "Frame-mode polling: hrtimer poll period in microseconds");
+module_param(dma_tensor, int, 0644);
+MODULE_PARM_DESC(dma_tensor, "Detector tensor channel: 0=off, 1=allocate a 640x640 RGB888 slot per ring slot (needs tensor RTL)");
+
+/* log2 latency histograms: bucket 0 is <1us, bucket i covers [2^(i-1), 2^i) us */
+#define FPGA_DMA_HIST_BUCKETS 24
+
+/* Per-device DMA counters, protected by stats_lock */
+struct fpga_dma_stats {
+    u64 transfers;
+    u64 bytes;
+    u64 errors;
+    u64 timeouts;
+    u64 poll_fallbacks;                        /* IRQ timeouts retried by polling */
+    u64 irq_latency_hist[FPGA_DMA_HIST_BUCKETS];  /* doorbell -> MSI */
+    u64 ioctl_latency_hist[FPGA_DMA_HIST_BUCKETS]; /* data-path ioctl wall time */
+};
+
+/* Ownership of a ring slot in the asynchronous QBUF/DQBUF queue */
+enum fpga_dma_buf_state {
+    FPGA_DMA_BUF_IDLE = 0,  /* owned by userspace */
+    FPGA_DMA_BUF_QUEUED,    /* waiting for the DMA engine */
+    FPGA_DMA_BUF_ACTIVE,    /* frame transfer in flight */
+    FPGA_DMA_BUF_DONE,      /* landed, waiting for DQBUF */
+};
+
+/* One DMA allocation; the ring slot or tensor it backs is its index in fpga_dma_ring */
+struct fpga_dma_ring_slot {
+    void *vaddr;
+    dma_addr_t dma_handle;
+    size_t size;
+};
+
+/**
+ * struct fpga_dma_ring - Ring and tensor memory, refcounted
+ * @ref: One reference for the device, one per exported dma-buf
+ * @dma_dev: PCI device the memory was allocated against (reference held)
+ * @cached: Allocated with dma_alloc_noncoherent, needs explicit syncs
+ * @slot: Ring slot i at [i], tensor i at [FPGA_DMA_TENSOR_INDEX_BASE + i]
+ *
+ * Exported dma-bufs can outlive the PCI device; the memory is freed on the
+ * last put instead of under importers such as KMS framebuffers.
+ */
+struct fpga_dma_ring {
+    struct kref ref;
+    struct device *dma_dev;
+    bool cached;
+    struct fpga_dma_ring_slot slot[FPGA_DMA_TENSOR_INDEX_BASE + FPGA_DMA_MAX_RING_BUFFERS];
+};
 
 /* Per-device structure */
 struct fpga_dma_dev {
@@ -88,21 +160,59 @@ struct fpga_dma_dev {
     resource_size_t bar1_size;
 
     /* DMA ring buffers */
-    void *dma_bufs[FPGA_DMA_MAX_RING_BUFFERS];
-    dma_addr_t dma_handles[FPGA_DMA_MAX_RING_BUFFERS];
+    struct fpga_dma_ring *ring;
     u32 dma_buf_count;
     size_t dma_buf_size;
+    bool ring_cached;              /* dma_alloc_noncoherent ring, needs explicit syncs */
     struct mutex dma_lock;
 
+    /* Detector tensor slots; tensor i pairs with ring slot i */
+    u32 tensor_count;              /* 0 or dma_buf_count */
+    size_t tensor_buf_size;
+
     /* Completion for DMA transfer */
     struct completion dma_done;
     bool irq_enabled;
     bool use_poll_fallback;
     int irq_vector;
     u64 irq_count;
+    u64 doorbell_ns;               /* ktime of the last frame-mode command */
+
+    /* Performance counters (sysfs) and histograms (debugfs) */
+    spinlock_t stats_lock;
+    struct fpga_dma_stats stats;
+    struct dentry *debugfs_dir;
+
+    /* Asynchronous buffer queue (QBUF/DQBUF), protected by q_lock */
+    spinlock_t q_lock;
+    wait_queue_head_t q_wait;
+    u8 buf_state[FPGA_DMA_MAX_RING_BUFFERS];
+    u32 buf_bytes[FPGA_DMA_MAX_RING_BUFFERS];
+    int buf_result[FPGA_DMA_MAX_RING_BUFFERS];
+    u32 buf_sequence[FPGA_DMA_MAX_RING_BUFFERS];
+    u64 buf_timestamp_ns[FPGA_DMA_MAX_RING_BUFFERS];
+    bool buf_tensor[FPGA_DMA_MAX_RING_BUFFERS];  /* QBUF asked for the paired tensor */
+    u32 q_pending[FPGA_DMA_MAX_RING_BUFFERS];
+    u32 q_pending_head;
+    u32 q_pending_count;
+    u32 q_done[FPGA_DMA_MAX_RING_BUFFERS];
+    u32 q_done_head;
+    u32 q_done_count;
+    int q_active;                  /* ring index in flight, -1 when idle */
+    unsigned long q_active_deadline;
+    bool q_tensor_phase;           /* q_active is on its tensor transfer */
+    bool roi_loaded;               /* ROI_CTRL holds a window, see fpga_dma_single_session() */
+    unsigned int sync_active;      /* blocking READ_FRAME/READ_ROI callers in flight */
+    bool q_streaming;              /* recycle the oldest done slot instead of stalling */
+    u32 q_sequence;
+    u32 q_dropped;
+    struct file *q_owner;
+    struct eventfd_ctx *q_eventfd;
+    struct delayed_work q_timeout_work;
 
     /* Device info */
     struct fpga_info info;
+    struct fpga_tensor_info tensor_info;
 
     /* Character device */
     int major;
@@ -112,11 +222,30 @@ struct fpga_dma_dev {
 static struct class *fpga_dma_class;
 static dev_t fpga_dma_dev_t;
 
+/**
+ * struct fpga_dma_dmabuf - Exporter private data for one ring slot
+ * @ring: Ring memory the slot lives in (reference held)
+ * @vaddr: Kernel virtual address of the ring buffer
+ * @dma_handle: Bus address of the ring buffer
+ * @size: Buffer size in bytes
+ * @index: Ring slot index, for logging
+ * @cached: Buffer comes from the cacheable (noncoherent) ring
+ */
+struct fpga_dma_dmabuf {
+    struct fpga_dma_ring *ring;
+    void *vaddr;
+    dma_addr_t dma_handle;
+    size_t size;
+    u32 index;
+    bool cached;
+};
+
 /* Forward declarations */
 static int fpga_dma_open(struct inode *inode, struct file *file);
 static int fpga_dma_release(struct inode *inode, struct file *file);
 static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 static int fpga_dma_mmap(struct file *file, struct vm_area_struct *vma);
+static __poll_t fpga_dma_poll(struct file *file, poll_table *wait);
 
 static const struct file_operations fpga_dma_fops = {
     .owner = THIS_MODULE,
@@ -125,6 +254,7 @@ static const struct file_operations fpga_dma_fops = {
     .unlocked_ioctl = fpga_dma_ioctl,
     .compat_ioctl = fpga_dma_ioctl,
     .mmap = fpga_dma_mmap,
+    .poll = fpga_dma_poll,
     .llseek = no_llseek,
 };
 
@@ -164,19 +294,118 @@ static size_t fpga_dma_default_frame_size(const struct fpga_info *info)
     return (size_t)info->frame_stride * (size_t)info->frame_height;
 }
 
-static void fpga_dma_free_ring_buffers(struct fpga_dma_dev *dev)
+static struct fpga_dma_ring *fpga_dma_ring_create(struct pci_dev *pdev, bool cached)
+{
+    struct fpga_dma_ring *ring;
+
+    ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+    if (!ring)
+        return NULL;
+    kref_init(&ring->ref);
+    ring->dma_dev = get_device(&pdev->dev);
+    ring->cached = cached;
+    return ring;
+}
+
+static bool fpga_dma_ring_alloc_slot(struct fpga_dma_ring *ring, u32 index, size_t size)
 {
+    struct fpga_dma_ring_slot *slot = &ring->slot[index];
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    if (ring->cached)
+        slot->vaddr = dma_alloc_noncoherent(ring->dma_dev, size, &slot->dma_handle,
+                                            DMA_FROM_DEVICE, GFP_KERNEL);
+    else
+#endif
+        slot->vaddr = dma_alloc_coherent(ring->dma_dev, size, &slot->dma_handle, GFP_KERNEL);
+    if (!slot->vaddr)
+        return false;
+    slot->size = size;
+    return true;
+}
+
+static void fpga_dma_ring_free_slot(struct fpga_dma_ring *ring, u32 index)
+{
+    struct fpga_dma_ring_slot *slot = &ring->slot[index];
+
+    if (!slot->vaddr)
+        return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    if (ring->cached)
+        dma_free_noncoherent(ring->dma_dev, slot->size, slot->vaddr, slot->dma_handle,
+                             DMA_FROM_DEVICE);
+    else
+#endif
+        dma_free_coherent(ring->dma_dev, slot->size, slot->vaddr, slot->dma_handle);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void fpga_dma_ring_release(struct kref *ref)
+{
+    struct fpga_dma_ring *ring = container_of(ref, struct fpga_dma_ring, ref);
     u32 i;
 
-    for (i = 0; i < dev->dma_buf_count; i++) {
-        if (!dev->dma_bufs[i])
-            continue;
-        dma_free_coherent(&dev->pdev->dev, dev->dma_buf_size,
-                          dev->dma_bufs[i], dev->dma_handles[i]);
-        dev->dma_bufs[i] = NULL;
-        dev->dma_handles[i] = (dma_addr_t)0;
-    }
+    for (i = 0; i < ARRAY_SIZE(ring->slot); i++)
+        fpga_dma_ring_free_slot(ring, i);
+    put_device(ring->dma_dev);
+    kfree(ring);
+}
+
+static void fpga_dma_ring_put(struct fpga_dma_ring *ring)
+{
+    kref_put(&ring->ref, fpga_dma_ring_release);
+}
+
+static void fpga_dma_free_tensor_buffers(struct fpga_dma_dev *dev)
+{
+    u32 i;
+
+    for (i = 0; i < FPGA_DMA_MAX_RING_BUFFERS; i++)
+        fpga_dma_ring_free_slot(dev->ring, FPGA_DMA_TENSOR_INDEX_BASE + i);
+    dev->tensor_count = 0;
+}
+
+/* Drops the device reference; exported dma-bufs keep the memory alive. */
+static void fpga_dma_free_ring_buffers(struct fpga_dma_dev *dev)
+{
+    if (!dev->ring)
+        return;
+    if (kref_read(&dev->ring->ref) > 1)
+        dev_info(&dev->pdev->dev, "%u exported dma-buf(s) still alive, ring freed on their last close\n",
+                 kref_read(&dev->ring->ref) - 1);
+    fpga_dma_ring_put(dev->ring);
+    dev->ring = NULL;
     dev->dma_buf_count = 0;
+    dev->tensor_count = 0;
+}
+
+static inline struct fpga_dma_ring_slot *fpga_dma_tensor_slot(struct fpga_dma_dev *dev, u32 idx)
+{
+    return &dev->ring->slot[FPGA_DMA_TENSOR_INDEX_BASE + idx];
+}
+
+/**
+ * fpga_dma_lookup_slot - Resolve a ring slot or FPGA_DMA_TENSOR_INDEX_BASE + i
+ *
+ * Returns false if @index names no allocated buffer.
+ */
+static bool fpga_dma_lookup_slot(struct fpga_dma_dev *dev, u32 index, void **vaddr,
+                                 dma_addr_t *dma_handle, size_t *size)
+{
+    const struct fpga_dma_ring_slot *slot;
+
+    if (index < dev->dma_buf_count) {
+        *size = dev->dma_buf_size;
+    } else if (index >= FPGA_DMA_TENSOR_INDEX_BASE &&
+               index - FPGA_DMA_TENSOR_INDEX_BASE < dev->tensor_count) {
+        *size = dev->tensor_buf_size;
+    } else {
+        return false;
+    }
+    slot = &dev->ring->slot[index];
+    *vaddr = slot->vaddr;
+    *dma_handle = slot->dma_handle;
+    return *vaddr && *dma_handle != (dma_addr_t)0;
 }
 
 /**
@@ -199,34 +428,578 @@ static void fpga_dma_write_reg(struct fpga_dma_dev *dev, u32 offset, u32 value)
     iowrite32(value, dev->bar1 + offset);
 }
 
+/*
+ * Ownership hand-off for the cacheable ring.  Coherent memory needs neither,
+ * so both are no-ops unless dma_ring_cached was set at probe time.
+ */
+static void fpga_dma_sync_for_cpu(struct fpga_dma_dev *dev, dma_addr_t addr, size_t size)
+{
+    if (dev->ring_cached && size > 0)
+        dma_sync_single_for_cpu(&dev->pdev->dev, addr, size, DMA_FROM_DEVICE);
+}
+
+static void fpga_dma_sync_for_device(struct fpga_dma_dev *dev, dma_addr_t addr, size_t size)
+{
+    if (dev->ring_cached && size > 0)
+        dma_sync_single_for_device(&dev->pdev->dev, addr, size, DMA_FROM_DEVICE);
+}
+
 static inline void fpga_dma_flush_posted_writes(struct fpga_dma_dev *dev)
 {
     /* One non-posted read flushes prior posted BAR1 writes on PCIe. */
     (void)ioread32(dev->bar0);
 }
 
+/**
+ * fpga_dma_start_frame - Kick one frame-mode transfer into @dma_handle
+ *
+ * Safe from IRQ context; completion is signalled by the MSI.
+ */
+static void fpga_dma_start_frame(struct fpga_dma_dev *dev, dma_addr_t dma_handle, u32 total_dwords)
+{
+    u32 cmd_reg;
+
+    /* Fixed write order: BAR1+0x120 -> BAR1+0x110 -> BAR1+0x100. */
+    fpga_dma_write_reg(dev, BAR1_DMA_H_ADDR, upper_32_bits(dma_handle));
+    fpga_dma_write_reg(dev, BAR1_DMA_L_ADDR, lower_32_bits(dma_handle));
+    cmd_reg = DMA_CMD_FRAME_MODE | (total_dwords & DMA_CMD_FRAME_DWORDS_MASK);
+    WRITE_ONCE(dev->doorbell_ns, ktime_get_ns());
+    fpga_dma_write_reg(dev, BAR1_DMA_CMD_REG, cmd_reg);
+    fpga_dma_flush_posted_writes(dev);
+}
+
+static unsigned int fpga_dma_hist_bucket(u64 delta_ns)
+{
+    return min_t(unsigned int, fls64(div_u64(delta_ns, NSEC_PER_USEC)),
+                 FPGA_DMA_HIST_BUCKETS - 1);
+}
+
+/**
+ * fpga_dma_stats_account - Count one finished transfer of @bytes
+ */
+static void fpga_dma_stats_account(struct fpga_dma_dev *dev, size_t bytes, int result)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->stats_lock, flags);
+    if (!result) {
+        dev->stats.transfers++;
+        dev->stats.bytes += bytes;
+    } else {
+        dev->stats.errors++;
+        if (result == -ETIMEDOUT)
+            dev->stats.timeouts++;
+    }
+    spin_unlock_irqrestore(&dev->stats_lock, flags);
+}
+
+static void fpga_dma_stats_hist(struct fpga_dma_dev *dev, u64 *hist, u64 delta_ns)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->stats_lock, flags);
+    hist[fpga_dma_hist_bucket(delta_ns)]++;
+    spin_unlock_irqrestore(&dev->stats_lock, flags);
+}
+
+/**
+ * fpga_dma_read_link_status - Fill negotiated link width/speed from LNKSTA
+ *
+ * Leaves @info untouched if the capability cannot be read.
+ */
+static void fpga_dma_read_link_status(struct fpga_dma_dev *dev, struct fpga_info *info)
+{
+    u16 lnksta;
+
+    if (!pci_is_pcie(dev->pdev) ||
+        pcie_capability_read_word(dev->pdev, PCI_EXP_LNKSTA, &lnksta))
+        return;
+    info->link_width = (lnksta & PCI_EXP_LNKSTA_NLW) >> PCI_EXP_LNKSTA_NLW_SHIFT;
+    info->link_speed = lnksta & PCI_EXP_LNKSTA_CLS;  /* 1=2.5GT/s, 2=5GT/s */
+}
+
+/**
+ * fpga_dma_program_roi - Load the frame read window, or restore full frame
+ *
+ * Caller owns the engine: dma_lock with the queue parked (sync_active), or
+ * q_lock while the queue has a slot active.  The writes are posted ahead of
+ * the next BAR1_DMA_L_ADDR write, which starts the session.
+ */
+static void fpga_dma_program_roi(struct fpga_dma_dev *dev, const struct dma_roi_transfer *roi)
+{
+    dev->roi_loaded = roi != NULL;
+    if (!roi) {
+        fpga_dma_write_reg(dev, BAR1_DMA_ROI_CTRL, 0);
+        return;
+    }
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_POS, (roi->y << 16) | roi->x);
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_SIZE, (roi->height << 16) | roi->width);
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_CTRL,
+                       DMA_ROI_CTRL_ENABLE | ((u32)ilog2(roi->decim) & DMA_ROI_CTRL_DECIM_MASK));
+}
+
+/**
+ * fpga_dma_program_tensor - Load the detector tensor window
+ *
+ * The whole frame at 1/FPGA_TENSOR_DECIM, which the RTL packs to RGB888 and
+ * letterboxes with black lines (the pad the CPU letterbox uses), read from
+ * the bank of the display transfer that just completed.  Safe from IRQ
+ * context; the queue owns the engine while a slot is active.
+ */
+static void fpga_dma_program_tensor(struct fpga_dma_dev *dev)
+{
+    dev->roi_loaded = true;
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_POS, 0);
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_SIZE,
+                       (dev->info.frame_height << 16) | dev->info.frame_width);
+    fpga_dma_write_reg(dev, BAR1_DMA_ROI_CTRL,
+                       DMA_ROI_CTRL_ENABLE | DMA_ROI_CTRL_TENSOR | DMA_ROI_CTRL_HOLD_BANK |
+                       (0U << DMA_ROI_CTRL_PAD_SHIFT) |
+                       ((u32)ilog2(FPGA_TENSOR_DECIM) & DMA_ROI_CTRL_DECIM_MASK));
+}
+
+/*
+ * True when a blocking ring transfer runs as one frame-mode session. The
+ * serial chunk engine rewrites L_ADDR per 4 KB chunk, and every L_ADDR write
+ * restarts the RTL session, so a window would restart at every chunk.
+ */
+static bool fpga_dma_single_session(struct fpga_dma_dev *dev)
+{
+    return dev->irq_enabled || dma_poll_frame_mode;
+}
+
+/**
+ * fpga_dma_roi_prepare - Validate a window request and compute its output layout
+ */
+static int fpga_dma_roi_prepare(struct fpga_dma_dev *dev, struct dma_roi_transfer *roi,
+                                size_t *size)
+{
+    u32 out_w;
+    u32 out_h;
+
+    if (dev->info.pixel_format != FPGA_PIXEL_FORMAT_BGRX8888) {
+        dev_err(dev->dev, "ROI transfers require BGRX8888 frames\n");
+        return -EOPNOTSUPP;
+    }
+    /* USERPTR windows are checked once the buffer is mapped. */
+    if ((roi->xfer.flags & FPGA_DMA_XFER_FLAG_USERPTR) ? !dev->irq_enabled
+                                                       : !fpga_dma_single_session(dev)) {
+        dev_err(dev->dev, "ROI transfers need one frame-mode session, not the chunk engine\n");
+        return -EOPNOTSUPP;
+    }
+    if (roi->decim != 1 && roi->decim != 2 && roi->decim != 4) {
+        dev_err(dev->dev, "Invalid ROI decimation %u (1, 2 or 4)\n", roi->decim);
+        return -EINVAL;
+    }
+    if (!roi->width || !roi->height ||
+        (roi->x % FPGA_DMA_ROI_ALIGN) || (roi->width % FPGA_DMA_ROI_ALIGN) ||
+        (roi->height % roi->decim) ||
+        roi->x >= dev->info.frame_width || roi->width > dev->info.frame_width - roi->x ||
+        roi->y >= dev->info.frame_height || roi->height > dev->info.frame_height - roi->y) {
+        dev_err(dev->dev, "Invalid ROI %ux%u+%u+%u (x/width must be multiples of %u)\n",
+                roi->width, roi->height, roi->x, roi->y, FPGA_DMA_ROI_ALIGN);
+        return -EINVAL;
+    }
+
+    out_w = roi->width / roi->decim;
+    out_h = roi->height / roi->decim;
+    roi->stride = out_w * FPGA_FRAME_BPP_BGRX8888;
+    *size = (size_t)roi->stride * out_h;
+    return 0;
+}
+
+static void fpga_dma_queue_notify_locked(struct fpga_dma_dev *dev)
+{
+    if (!dev->q_eventfd)
+        return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+    eventfd_signal(dev->q_eventfd);
+#else
+    eventfd_signal(dev->q_eventfd, 1);
+#endif
+}
+
+/* Hand a finished slot to the done FIFO, or back to idle if its owner went away. */
+static void fpga_dma_queue_finish_locked(struct fpga_dma_dev *dev, u32 idx, int result)
+{
+    fpga_dma_stats_account(dev, dev->buf_bytes[idx], result);
+    dev->buf_result[idx] = result;
+    dev->buf_sequence[idx] = dev->q_sequence++;
+    dev->buf_timestamp_ns[idx] = ktime_get_ns();
+    if (!dev->q_owner) {
+        dev->buf_state[idx] = FPGA_DMA_BUF_IDLE;
+        return;
+    }
+    dev->buf_state[idx] = FPGA_DMA_BUF_DONE;
+    dev->q_done[(dev->q_done_head + dev->q_done_count) % FPGA_DMA_MAX_RING_BUFFERS] = idx;
+    dev->q_done_count++;
+    fpga_dma_queue_notify_locked(dev);
+}
+
+/*
+ * Streaming mode: with nothing queued, overwrite the oldest completed frame
+ * rather than idling.  The newest completed frame is always left for DQBUF.
+ */
+static void fpga_dma_queue_recycle_locked(struct fpga_dma_dev *dev)
+{
+    u32 idx;
+
+    if (!dev->q_streaming || dev->q_pending_count > 0 || dev->q_done_count < 2)
+        return;
+
+    idx = dev->q_done[dev->q_done_head];
+    dev->q_done_head = (dev->q_done_head + 1) % FPGA_DMA_MAX_RING_BUFFERS;
+    dev->q_done_count--;
+    dev->q_dropped++;
+
+    /*
+     * No sync_for_device needed: a slot that was never dequeued was never
+     * synced for the CPU, so it still belongs to the device.
+     */
+    dev->buf_state[idx] = FPGA_DMA_BUF_QUEUED;
+    dev->buf_result[idx] = 0;
+    dev->q_pending[dev->q_pending_head] = idx;
+    dev->q_pending_count = 1;
+}
+
+/* Start the next queued slot if the engine is free. */
+static void fpga_dma_queue_kick_locked(struct fpga_dma_dev *dev)
+{
+    u32 idx;
+
+    if (dev->q_active >= 0 || dev->sync_active)
+        return;
+    fpga_dma_queue_recycle_locked(dev);
+    if (dev->q_pending_count == 0)
+        return;
+
+    idx = dev->q_pending[dev->q_pending_head];
+    dev->q_pending_head = (dev->q_pending_head + 1) % FPGA_DMA_MAX_RING_BUFFERS;
+    dev->q_pending_count--;
+
+    dev->buf_state[idx] = FPGA_DMA_BUF_ACTIVE;
+    dev->q_active = (int)idx;
+    dev->q_active_deadline = jiffies + msecs_to_jiffies(dma_timeout_ms);
+    fpga_dma_start_frame(dev, dev->ring->slot[idx].dma_handle,
+                         DIV_ROUND_UP(dev->buf_bytes[idx], 4U));
+    mod_delayed_work(system_wq, &dev->q_timeout_work, msecs_to_jiffies(dma_timeout_ms));
+}
+
+/* Second half of a tensor slot: same camera frame, into the paired tensor buffer. */
+static void fpga_dma_queue_start_tensor_locked(struct fpga_dma_dev *dev, u32 idx)
+{
+    dev->q_tensor_phase = true;
+    dev->q_active_deadline = jiffies + msecs_to_jiffies(dma_timeout_ms);
+    fpga_dma_program_tensor(dev);
+    fpga_dma_start_frame(dev, fpga_dma_tensor_slot(dev, idx)->dma_handle,
+                         FPGA_TENSOR_FRAME_SIZE / 4U);
+    mod_delayed_work(system_wq, &dev->q_timeout_work, msecs_to_jiffies(dma_timeout_ms));
+}
+
+/* Put the window back to full frame once an active tensor transfer is over. */
+static void fpga_dma_queue_end_tensor_locked(struct fpga_dma_dev *dev)
+{
+    if (!dev->q_tensor_phase)
+        return;
+    fpga_dma_program_roi(dev, NULL);
+    dev->q_tensor_phase = false;
+}
+
 static irqreturn_t fpga_dma_irq_handler(int irq, void *data)
 {
     struct fpga_dma_dev *dev = data;
+    bool queued;
     (void)irq;
 
     dev->irq_count++;
-    complete(&dev->dma_done);
+    fpga_dma_stats_hist(dev, dev->stats.irq_latency_hist,
+                        ktime_get_ns() - READ_ONCE(dev->doorbell_ns));
+
+    spin_lock(&dev->q_lock);
+    queued = dev->q_active >= 0;
+    if (queued && dev->buf_tensor[dev->q_active] && !dev->q_tensor_phase) {
+        /* Display frame landed; the slot completes after its tensor. */
+        fpga_dma_queue_start_tensor_locked(dev, (u32)dev->q_active);
+        spin_unlock(&dev->q_lock);
+        return IRQ_HANDLED;
+    }
+    if (queued) {
+        if (dev->q_tensor_phase)
+            fpga_dma_stats_account(dev, FPGA_TENSOR_FRAME_SIZE, 0);
+        fpga_dma_queue_end_tensor_locked(dev);
+        fpga_dma_queue_finish_locked(dev, (u32)dev->q_active, 0);
+        dev->q_active = -1;
+        fpga_dma_queue_kick_locked(dev);
+        if (dev->q_active < 0)
+            cancel_delayed_work(&dev->q_timeout_work);
+    }
+    spin_unlock(&dev->q_lock);
+
+    if (queued)
+        wake_up_interruptible(&dev->q_wait);
+    else
+        complete(&dev->dma_done);
     return IRQ_HANDLED;
 }
 
+/* Watchdog for queued transfers: nobody sleeps on them, so time out here. */
+static void fpga_dma_queue_timeout_work(struct work_struct *work)
+{
+    struct fpga_dma_dev *dev = container_of(to_delayed_work(work),
+                                            struct fpga_dma_dev, q_timeout_work);
+    unsigned long flags;
+    int idx;
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    idx = dev->q_active;
+    if (idx < 0) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return;
+    }
+    if (time_before(jiffies, dev->q_active_deadline)) {
+        /* A newer transfer was kicked while this work was pending. */
+        mod_delayed_work(system_wq, &dev->q_timeout_work,
+                         dev->q_active_deadline - jiffies);
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return;
+    }
+    dev_err(dev->dev, "Queued frame-mode DMA timeout on ring slot %d (%s, size=%u bytes)\n",
+            idx, dev->q_tensor_phase ? "tensor" : "frame",
+            dev->q_tensor_phase ? FPGA_TENSOR_FRAME_SIZE : dev->buf_bytes[idx]);
+    fpga_dma_queue_end_tensor_locked(dev);
+    fpga_dma_queue_finish_locked(dev, (u32)idx, -ETIMEDOUT);
+    dev->q_active = -1;
+    fpga_dma_queue_kick_locked(dev);
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    wake_up_interruptible(&dev->q_wait);
+}
+
+/* Tail sentinels: the chunk has landed once the device overwrote both. */
+#define FPGA_DMA_TAIL_SENTINEL0   0xDEADBEEFU
+#define FPGA_DMA_TAIL_SENTINEL1   0xA5A55A5AU
+
+/* Clamp a chunk to the dma_max_len_dwords limit and to the next 4 KB boundary. */
+static size_t fpga_dma_chunk_size(dma_addr_t addr, size_t remaining)
+{
+    u32 max_len_dwords = dma_max_len_dwords;
+    size_t chunk_size;
+
+    if (max_len_dwords == 0)
+        max_len_dwords = 1;
+    if (max_len_dwords > DMA_MAX_LEN_DWORDS)
+        max_len_dwords = DMA_MAX_LEN_DWORDS;
+
+    chunk_size = min(remaining, (size_t)max_len_dwords * sizeof(u32));
+    if ((addr & 0xFFF) + chunk_size > 0x1000)
+        chunk_size = 0x1000 - (addr & 0xFFF);
+    return chunk_size;
+}
+
+/*
+ * Seed the tail sentinels of a @chunk_size chunk whose CPU view starts at
+ * @chunk_va.  Returns the sentinel byte length; *@tail1 is NULL for 4-byte
+ * chunks.
+ */
+static size_t fpga_dma_seed_tail(void *chunk_va, size_t chunk_size, u32 **tail0, u32 **tail1)
+{
+    *tail0 = (u32 *)((u8 *)chunk_va + chunk_size - sizeof(u32));
+    WRITE_ONCE(**tail0, FPGA_DMA_TAIL_SENTINEL0);
+    *tail1 = NULL;
+    if (chunk_size < 8)
+        return sizeof(u32);
+    *tail1 = *tail0 - 1;
+    WRITE_ONCE(**tail1, FPGA_DMA_TAIL_SENTINEL1);
+    return 2 * sizeof(u32);
+}
+
+/**
+ * fpga_dma_run_chunk - Issue one MWR chunk and wait until its tail sentinels change
+ * @dev: Device
+ * @bus_addr: Chunk bus address (must not cross a 4 KB boundary)
+ * @chunk_size: Chunk length in bytes
+ * @tail0: CPU view of the last dword of the chunk
+ * @tail1: CPU view of the dword before it, or NULL
+ * @tail_addr: Bus address of the sentinel range
+ * @tail_len: Sentinel range length in bytes
+ * @sync_tail: Target is cacheable; invalidate the sentinels before each read
+ * @chunk_num: Chunk index, for logging
+ */
+static int fpga_dma_run_chunk(struct fpga_dma_dev *dev, dma_addr_t bus_addr, size_t chunk_size,
+                              u32 *tail0, u32 *tail1, dma_addr_t tail_addr, size_t tail_len,
+                              bool sync_tail, int chunk_num)
+{
+    int poll_sleep_cur_us = dma_poll_sleep_us;
+    int poll_sleep_max_us = dma_poll_sleep_max_us;
+    int poll_backoff_polls = dma_poll_backoff_polls;
+    int poll_count = 0;
+    unsigned long deadline;
+    u32 length_in_dwords = (chunk_size + 3) / 4;
+    u32 cmd_reg;
+
+    /* Keep BAR write sequence fixed: 0x120 -> 0x110 -> 0x100. */
+    fpga_dma_write_reg(dev, BAR1_DMA_H_ADDR, upper_32_bits(bus_addr));
+    fpga_dma_write_reg(dev, BAR1_DMA_L_ADDR, lower_32_bits(bus_addr));
+    cmd_reg = ((length_in_dwords - 1) & DMA_CMD_LEN_MASK) | DMA_CMD_64BIT_ADDR | DMA_CMD_WRITE;
+    fpga_dma_write_reg(dev, BAR1_DMA_CMD_REG, cmd_reg);
+    fpga_dma_flush_posted_writes(dev);
+
+    deadline = jiffies + msecs_to_jiffies(dma_timeout_ms);
+    for (;;) {
+        if (sync_tail)
+            dma_sync_single_for_cpu(&dev->pdev->dev, tail_addr, tail_len, DMA_FROM_DEVICE);
+        if ((READ_ONCE(*tail0) != FPGA_DMA_TAIL_SENTINEL0) &&
+            (!tail1 || (READ_ONCE(*tail1) != FPGA_DMA_TAIL_SENTINEL1)))
+            break;
+        if (time_after(jiffies, deadline)) {
+            dev_err(dev->dev,
+                    "Chunk %d timeout waiting RAM overwrite (addr=0x%llx size=%zu)\n",
+                    chunk_num, (u64)bus_addr, chunk_size);
+            return -ETIMEDOUT;
+        }
+        if (poll_sleep_cur_us <= 0) {
+            cpu_relax();
+            continue;
+        }
+
+        if (poll_sleep_max_us > 0 && poll_sleep_cur_us > poll_sleep_max_us)
+            poll_sleep_cur_us = poll_sleep_max_us;
+
+        usleep_range(poll_sleep_cur_us, poll_sleep_cur_us + 5);
+
+        if (poll_backoff_polls > 0 && poll_sleep_max_us > 0 &&
+            poll_sleep_cur_us < poll_sleep_max_us) {
+            poll_count++;
+            if (poll_count >= poll_backoff_polls) {
+                poll_count = 0;
+                poll_sleep_cur_us <<= 1;
+                if (poll_sleep_cur_us > poll_sleep_max_us)
+                    poll_sleep_cur_us = poll_sleep_max_us;
+            }
+        }
+    }
+    dma_rmb();
+
+    if (dma_chunk_delay_us >= 1000)
+        usleep_range(dma_chunk_delay_us, dma_chunk_delay_us + 100);
+    else if (dma_chunk_delay_us > 0)
+        udelay(dma_chunk_delay_us);
+
+    return 0;
+}
+
+/* End offset of 4 KB window @i for a transfer starting @head bytes into its page. */
+static size_t fpga_dma_window_end(size_t head, size_t span, u32 i)
+{
+    return min((size_t)(i + 1) * 0x1000 - head, span);
+}
+
+/* True once the device overwrote the tail sentinels of window [@start, @end). */
+static bool fpga_dma_window_landed(struct fpga_dma_dev *dev, dma_addr_t dma_handle,
+                                   void *dma_buf, size_t start, size_t end)
+{
+    u32 *tail0 = (u32 *)((u8 *)dma_buf + end - sizeof(u32));
+    bool two = (end - start) >= 8;
+
+    fpga_dma_sync_for_cpu(dev, dma_handle + end - (two ? 8 : 4), two ? 8 : 4);
+    if (READ_ONCE(*tail0) == FPGA_DMA_TAIL_SENTINEL0)
+        return false;
+    return !two || READ_ONCE(*(tail0 - 1)) != FPGA_DMA_TAIL_SENTINEL1;
+}
+
+/**
+ * fpga_dma_perform_transfer_poll_frame - Frame-mode transfer with polled completion
+ *
+ * Without MSI the RTL frame engine still splits and pipelines the chunks on
+ * its own; the driver seeds sentinels at the end of every 4 KB window and
+ * probes a window of them per hrtimer tick.  Posted writes land in order, so
+ * a changed tail means every earlier window has landed as well.
+ */
+static int fpga_dma_perform_transfer_poll_frame(struct fpga_dma_dev *dev,
+                                                size_t size,
+                                                dma_addr_t dma_handle,
+                                                void *dma_buf)
+{
+    size_t head = (size_t)(dma_handle & 0xFFF);
+    u32 total_dwords = DIV_ROUND_UP((u32)size, 4U);
+    size_t span = (size_t)total_dwords * sizeof(u32);
+    u32 nr_windows;
+    u32 window;
+    u32 done = 0;
+    u32 i;
+    u64 period_ns;
+    unsigned long deadline;
+    int polls = 0;
+
+    if (!size || total_dwords > DMA_CMD_FRAME_DWORDS_MASK)
+        return -EINVAL;
+
+    nr_windows = (u32)DIV_ROUND_UP(head + span, 0x1000);
+    for (i = 0; i < nr_windows; i++) {
+        size_t start = i ? fpga_dma_window_end(head, span, i - 1) : 0;
+        size_t end = fpga_dma_window_end(head, span, i);
+        size_t tail_len;
+        u32 *tail0;
+        u32 *tail1;
+
+        tail_len = fpga_dma_seed_tail((u8 *)dma_buf + start, end - start, &tail0, &tail1);
+        fpga_dma_sync_for_device(dev, dma_handle + end - tail_len, tail_len);
+    }
+    dma_wmb();
+
+    fpga_dma_start_frame(dev, dma_handle, total_dwords);
+
+    window = clamp_t(u32, dma_poll_window, 1, nr_windows);
+    period_ns = (u64)max(dma_poll_period_us, 1) * NSEC_PER_USEC;
+    deadline = jiffies + msecs_to_jiffies(dma_timeout_ms);
+    while (done < nr_windows) {
+        u32 probe = min(done + window, nr_windows) - 1;
+        ktime_t kt;
+
+        if (fpga_dma_window_landed(dev, dma_handle, dma_buf,
+                                   probe ? fpga_dma_window_end(head, span, probe - 1) : 0,
+                                   fpga_dma_window_end(head, span, probe))) {
+            done = probe + 1;
+            continue;
+        }
+        while (done < probe &&
+               fpga_dma_window_landed(dev, dma_handle, dma_buf,
+                                      done ? fpga_dma_window_end(head, span, done - 1) : 0,
+                                      fpga_dma_window_end(head, span, done)))
+            done++;
+
+        if (time_after(jiffies, deadline)) {
+            dev_err(dev->dev, "Frame-mode poll timeout at window %u/%u (size=%zu bytes)\n",
+                    done, nr_windows, size);
+            return -ETIMEDOUT;
+        }
+        kt = ns_to_ktime(period_ns);
+        set_current_state(TASK_UNINTERRUPTIBLE);
+        schedule_hrtimeout_range(&kt, period_ns / 4, HRTIMER_MODE_REL);
+        polls++;
+    }
+    dma_rmb();
+
+    if (dma_verbose)
+        dev_info(dev->dev, "Frame-mode poll transfer complete: %zu bytes, windows=%u polls=%d\n",
+                 size, nr_windows, polls);
+    return 0;
+}
+
 static int fpga_dma_perform_transfer_polling(struct fpga_dma_dev *dev,
                                              size_t size,
                                              dma_addr_t dma_handle,
                                              void *dma_buf)
 {
-    u32 cmd_reg;
     int ret = 0;
     size_t remaining = size;
     size_t chunk_size;
     dma_addr_t current_addr = dma_handle;
     int chunk_num = 0;
 
+    if (dma_poll_frame_mode)
+        return fpga_dma_perform_transfer_poll_frame(dev, size, dma_handle, dma_buf);
+
     if (dma_verbose) {
         dev_info(dev->dev, "=== DMA MWR Transfer Start (poll fallback) ===\n");
         dev_info(dev->dev, "  Total size: %zu bytes\n", size);
@@ -235,174 +1008,830 @@ static int fpga_dma_perform_transfer_polling(struct fpga_dma_dev *dev,
         dev_info(dev->dev, "  BAR1 base (virt): %px\n", dev->bar1);
     }
 
-    while (remaining > 0) {
-        bool verbose_chunk = dma_verbose && ((chunk_num < 3) || ((chunk_num % 100) == 0));
-        size_t buf_offset;
-        u32 *chunk_tail0;
-        u32 *chunk_tail1 = NULL;
-        const u32 tail_sentinel0 = 0xDEADBEEF;
-        const u32 tail_sentinel1 = 0xA5A55A5A;
-        u32 max_len_dwords = dma_max_len_dwords;
-        int poll_sleep_cur_us = dma_poll_sleep_us;
-        int poll_sleep_max_us = dma_poll_sleep_max_us;
-        int poll_backoff_polls = dma_poll_backoff_polls;
-        int poll_count = 0;
-        unsigned long deadline;
-        u32 length_in_dwords;
-        u32 cmd_length;
-
-        if (max_len_dwords == 0)
-            max_len_dwords = 1;
-        if (max_len_dwords > DMA_MAX_LEN_DWORDS)
-            max_len_dwords = DMA_MAX_LEN_DWORDS;
-
-        chunk_size = min(remaining, (size_t)max_len_dwords * sizeof(u32));
-
-        if ((current_addr & 0xFFF) + chunk_size > 0x1000) {
-            chunk_size = 0x1000 - (current_addr & 0xFFF);
-            if (chunk_size == 0) {
-                current_addr = ALIGN(current_addr, 0x1000);
-                continue;
-            }
-        }
+    while (remaining > 0) {
+        bool verbose_chunk = dma_verbose && ((chunk_num < 3) || ((chunk_num % 100) == 0));
+        size_t buf_offset;
+        size_t tail_len;
+        dma_addr_t tail_addr;
+        u32 *chunk_tail0;
+        u32 *chunk_tail1;
+
+        chunk_size = fpga_dma_chunk_size(current_addr, remaining);
+
+        if (verbose_chunk) {
+            dev_info(dev->dev, "--- Chunk %d ---\n", chunk_num);
+            dev_info(dev->dev, "  Addr: 0x%llx (lo=0x%x hi=0x%x)\n",
+                     (u64)current_addr,
+                     lower_32_bits(current_addr),
+                     upper_32_bits(current_addr));
+            dev_info(dev->dev, "  Size: %zu bytes (%u DWORDs)\n",
+                     chunk_size, (u32)((chunk_size + 3) / 4));
+        }
+
+        buf_offset = (size_t)(current_addr - dma_handle);
+
+        tail_len = fpga_dma_seed_tail((u8 *)dma_buf + buf_offset, chunk_size,
+                                      &chunk_tail0, &chunk_tail1);
+        dma_wmb();
+        /* Cacheable ring: push the sentinels out so the device overwrites them in RAM. */
+        tail_addr = current_addr + chunk_size - tail_len;
+        fpga_dma_sync_for_device(dev, tail_addr, tail_len);
+
+        ret = fpga_dma_run_chunk(dev, current_addr, chunk_size, chunk_tail0, chunk_tail1,
+                                 tail_addr, tail_len, dev->ring_cached, chunk_num);
+        if (ret)
+            return ret;
+
+        remaining -= chunk_size;
+        current_addr += chunk_size;
+        chunk_num++;
+    }
+
+    if (dma_verbose)
+        dev_info(dev->dev, "=== DMA Transfer Complete (poll fallback) chunks=%d ===\n", chunk_num);
+
+    return ret;
+}
+
+static int fpga_dma_perform_transfer_irq(struct fpga_dma_dev *dev,
+                                         size_t size,
+                                         dma_addr_t dma_handle)
+{
+    u32 total_dwords;
+    unsigned long wait_ret;
+
+    if (!size)
+        return -EINVAL;
+
+    total_dwords = DIV_ROUND_UP((u32)size, 4U);
+    if (total_dwords == 0 || total_dwords > DMA_CMD_FRAME_DWORDS_MASK) {
+        dev_err(dev->dev, "Invalid frame size for frame-mode DMA: %zu bytes (%u dwords)\n",
+                size, total_dwords);
+        return -EINVAL;
+    }
+
+    reinit_completion(&dev->dma_done);
+    fpga_dma_start_frame(dev, dma_handle, total_dwords);
+
+    wait_ret = wait_for_completion_timeout(&dev->dma_done, msecs_to_jiffies(dma_timeout_ms));
+    if (!wait_ret) {
+        dev_err(dev->dev, "Frame-mode DMA timeout (size=%zu bytes, dwords=%u)\n",
+                size, total_dwords);
+        return -ETIMEDOUT;
+    }
+
+    return 0;
+}
+
+/*
+ * USERPTR fallback for pages that do not share one bus range: each page
+ * is mapped on its own so the per-chunk sentinel syncs stay within a single
+ * mapping, and the 4 KB MWR chunk engine walks them in order.
+ */
+static int fpga_dma_user_chunks(struct fpga_dma_dev *dev, struct page **pages, int nr_pages,
+                                unsigned long uaddr, size_t size)
+{
+    struct device *ddev = &dev->pdev->dev;
+    dma_addr_t *handles;
+    size_t pos = 0;
+    int chunk_num = 0;
+    int mapped;
+    int ret = 0;
+    int i;
+
+    handles = kvmalloc_array(nr_pages, sizeof(*handles), GFP_KERNEL);
+    if (!handles)
+        return -ENOMEM;
+
+    for (mapped = 0; mapped < nr_pages; mapped++) {
+        size_t off = mapped ? 0 : offset_in_page(uaddr);
+        size_t len = min_t(size_t, PAGE_SIZE - off, size - pos);
+
+        handles[mapped] = dma_map_page(ddev, pages[mapped], off, len, DMA_FROM_DEVICE);
+        if (dma_mapping_error(ddev, handles[mapped])) {
+            ret = -ENOMEM;
+            goto out_unmap;
+        }
+        pos += len;
+    }
+
+    pos = 0;
+    for (i = 0; i < nr_pages; i++) {
+        size_t off = i ? 0 : offset_in_page(uaddr);
+        size_t page_left = min_t(size_t, PAGE_SIZE - off, size - pos);
+        dma_addr_t seg_addr = handles[i];
+        u8 *va = kmap_local_page(pages[i]);
+
+        while (page_left > 0) {
+            size_t chunk_size = fpga_dma_chunk_size(seg_addr, page_left);
+            size_t tail_len;
+            dma_addr_t tail_addr;
+            u32 *chunk_tail0;
+            u32 *chunk_tail1;
+
+            tail_len = fpga_dma_seed_tail(va + off, chunk_size, &chunk_tail0, &chunk_tail1);
+            dma_wmb();
+            tail_addr = seg_addr + chunk_size - tail_len;
+            dma_sync_single_for_device(ddev, tail_addr, tail_len, DMA_FROM_DEVICE);
+
+            ret = fpga_dma_run_chunk(dev, seg_addr, chunk_size, chunk_tail0, chunk_tail1,
+                                     tail_addr, tail_len, true, chunk_num++);
+            if (ret)
+                break;
+
+            seg_addr += chunk_size;
+            off += chunk_size;
+            page_left -= chunk_size;
+            pos += chunk_size;
+        }
+        kunmap_local(va);
+        if (ret)
+            goto out_unmap;
+    }
+
+    if (dma_verbose)
+        dev_info(dev->dev, "USERPTR chunked transfer complete: %zu bytes, pages=%d chunks=%d\n",
+                 size, nr_pages, chunk_num);
+
+out_unmap:
+    pos = 0;
+    for (i = 0; i < mapped; i++) {
+        size_t off = i ? 0 : offset_in_page(uaddr);
+        size_t len = min_t(size_t, PAGE_SIZE - off, size - pos);
+
+        dma_unmap_page(ddev, handles[i], len, DMA_FROM_DEVICE);
+        pos += len;
+    }
+    kvfree(handles);
+    return ret;
+}
+
+/**
+ * fpga_dma_perform_transfer_user - DMA one frame straight into pinned user pages
+ * @dev: Device
+ * @user_addr: Destination in the caller's address space
+ * @size: Bytes to transfer
+ * @need_session: An ROI window is loaded; refuse the chunk engine
+ *
+ * When the pages map to one contiguous bus range (an IOMMU merges them) and
+ * MSI is up, the frame goes out as a single frame-mode command, like the
+ * ring path. Otherwise the frame falls back to the 4 KB chunk engine: about
+ * 900 serial doorbells with sleeping sentinel polls per 1280x720 BGRX frame,
+ * which caps USERPTR far below the ring throughput.
+ */
+static int fpga_dma_perform_transfer_user(struct fpga_dma_dev *dev, u64 user_addr, size_t size,
+                                          bool need_session)
+{
+    struct device *ddev = &dev->pdev->dev;
+    unsigned long uaddr = (unsigned long)user_addr;
+    size_t page_off = offset_in_page(uaddr);
+    unsigned long align = max_t(unsigned long, dma_get_cache_alignment(), sizeof(u32));
+    struct sg_table sgt;
+    struct page **pages;
+    int nr_pages;
+    int pinned;
+    int ret;
+
+    /* Cache-line alignment keeps unmap invalidation off neighbouring data. */
+    if (!size || (uaddr & (align - 1)) || (size & (align - 1))) {
+        dev_err(dev->dev, "USERPTR buffer 0x%lx/%zu must be %lu-byte aligned\n",
+                uaddr, size, align);
+        return -EINVAL;
+    }
+
+    nr_pages = DIV_ROUND_UP(page_off + size, PAGE_SIZE);
+    pages = kvmalloc_array(nr_pages, sizeof(*pages), GFP_KERNEL);
+    if (!pages)
+        return -ENOMEM;
+
+    pinned = pin_user_pages_fast(uaddr & PAGE_MASK, nr_pages, FOLL_WRITE, pages);
+    if (pinned != nr_pages) {
+        ret = pinned < 0 ? pinned : -EFAULT;
+        goto out_unpin;
+    }
+
+    ret = sg_alloc_table_from_pages(&sgt, pages, nr_pages, page_off, size, GFP_KERNEL);
+    if (ret)
+        goto out_unpin;
+    ret = dma_map_sgtable(ddev, &sgt, DMA_FROM_DEVICE, 0);
+    if (ret)
+        goto out_free_table;
+
+    if (sgt.nents == 1 && dev->irq_enabled) {
+        ret = fpga_dma_perform_transfer_irq(dev, size, sg_dma_address(sgt.sgl));
+        dma_sync_sgtable_for_cpu(ddev, &sgt, DMA_FROM_DEVICE);
+        dma_unmap_sgtable(ddev, &sgt, DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+        if (dma_verbose && !ret)
+            dev_info(dev->dev, "USERPTR frame-mode transfer complete: %zu bytes\n", size);
+        goto out_free_table;
+    }
+    dma_unmap_sgtable(ddev, &sgt, DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+
+    if (need_session) {
+        dev_err(dev->dev, "USERPTR ROI needs one bus range and MSI (buffer maps to %u segments)\n",
+                sgt.nents);
+        ret = -EOPNOTSUPP;
+        goto out_free_table;
+    }
+    dev_warn_once(dev->dev,
+                  "USERPTR buffer maps to %u bus segments, using the 4 KB chunk engine (slow)\n",
+                  sgt.nents);
+    ret = fpga_dma_user_chunks(dev, pages, nr_pages, uaddr, size);
+
+out_free_table:
+    sg_free_table(&sgt);
+out_unpin:
+    /* Sentinels may have been written, so always mark the pages dirty. */
+    if (pinned > 0)
+        unpin_user_pages_dirty_lock(pages, pinned, true);
+    kvfree(pages);
+    return ret;
+}
+
+/**
+ * fpga_dma_perform_transfer - Perform a DMA read from FPGA
+ */
+static int fpga_dma_perform_transfer(struct fpga_dma_dev *dev,
+                                     size_t size,
+                                     dma_addr_t dma_handle,
+                                     void *dma_buf)
+{
+    if (dev->irq_enabled) {
+        int ret = fpga_dma_perform_transfer_irq(dev, size, dma_handle);
+
+        /* A chunked retry would restart a loaded window at every chunk. */
+        if (ret == -ETIMEDOUT && dma_irq_timeout_retry_poll &&
+            (dma_poll_frame_mode || !dev->roi_loaded)) {
+            unsigned long flags;
+
+            spin_lock_irqsave(&dev->stats_lock, flags);
+            dev->stats.poll_fallbacks++;
+            spin_unlock_irqrestore(&dev->stats_lock, flags);
+            dev_warn(dev->dev, "IRQ timeout, retrying DMA transfer with polling path\n");
+            ret = fpga_dma_perform_transfer_polling(dev, size, dma_handle, dma_buf);
+        }
+        return ret;
+    }
+    if (dev->use_poll_fallback)
+        return fpga_dma_perform_transfer_polling(dev, size, dma_handle, dma_buf);
+
+    dev_err(dev->dev, "DMA requested but neither IRQ nor fallback path is available\n");
+    return -EIO;
+}
+
+/**
+ * fpga_dma_read_frame_user - FPGA_DMA_READ_FRAME with FPGA_DMA_XFER_FLAG_USERPTR
+ *
+ * Same engine exclusivity as the ring path, but no ring slot and no copy.
+ */
+static int fpga_dma_read_frame_user(struct fpga_dma_dev *dev, struct dma_transfer *transfer,
+                                    size_t size, const struct dma_roi_transfer *roi)
+{
+    unsigned long flags;
+    int ret;
+
+    if (!transfer->user_buf) {
+        dev_err(dev->dev, "USERPTR transfer without user_buf\n");
+        return -EINVAL;
+    }
+    if (size > FPGA_FRAME_MAX_SIZE) {
+        dev_err(dev->dev, "USERPTR size %zu exceeds max frame size %u\n",
+                size, (u32)FPGA_FRAME_MAX_SIZE);
+        return -EINVAL;
+    }
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_active >= 0 || dev->q_pending_count > 0) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return -EBUSY;
+    }
+    dev->sync_active++;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    mutex_lock(&dev->dma_lock);
+    if (roi)
+        fpga_dma_program_roi(dev, roi);
+    ret = fpga_dma_perform_transfer_user(dev, transfer->user_buf, size, roi != NULL);
+    if (roi)
+        fpga_dma_program_roi(dev, NULL);
+    mutex_unlock(&dev->dma_lock);
+    fpga_dma_stats_account(dev, size, ret);
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    /* Only the last blocking caller out may hand the engine back to the queue. */
+    dev->sync_active--;
+    fpga_dma_queue_kick_locked(dev);
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    if (!ret)
+        transfer->result = 0;
+    return ret;
+}
+
+/**
+ * fpga_dma_read_frame_ring - Blocking transfer into ring slot @transfer->offset
+ *
+ * Optionally copies the landed bytes to @transfer->user_buf.  @roi, when set,
+ * is programmed for this transfer only; queued captures always see full frames.
+ */
+static int fpga_dma_read_frame_ring(struct fpga_dma_dev *dev, struct dma_transfer *transfer,
+                                    size_t size, const struct dma_roi_transfer *roi)
+{
+    u32 buf_index = transfer->offset;
+    dma_addr_t dma_handle;
+    void *dma_buf;
+    unsigned long flags;
+    int ret;
+
+    if (buf_index >= dev->dma_buf_count) {
+        dev_err(dev->dev, "Invalid DMA ring index %u (count=%u)\n",
+                buf_index, dev->dma_buf_count);
+        return -EINVAL;
+    }
+
+    if (size > dev->dma_buf_size) {
+        dev_err(dev->dev, "Requested size %zu exceeds buffer size %zu\n",
+                size, dev->dma_buf_size);
+        return -EINVAL;
+    }
+
+    dma_handle = dev->ring->slot[buf_index].dma_handle;
+    dma_buf = dev->ring->slot[buf_index].vaddr;
+    if (!dma_buf || dma_handle == (dma_addr_t)0) {
+        dev_err(dev->dev, "DMA ring slot %u is not initialized\n", buf_index);
+        return -EIO;
+    }
+
+    /* The blocking path cannot share the engine with queued slots. */
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_active >= 0 || dev->q_pending_count > 0 ||
+        dev->buf_state[buf_index] != FPGA_DMA_BUF_IDLE) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return -EBUSY;
+    }
+    dev->sync_active++;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    /* Perform DMA transfer */
+    fpga_dma_sync_for_device(dev, dma_handle, size);
+    mutex_lock(&dev->dma_lock);
+    if (roi)
+        fpga_dma_program_roi(dev, roi);
+    ret = fpga_dma_perform_transfer(dev, size, dma_handle, dma_buf);
+    if (roi)
+        fpga_dma_program_roi(dev, NULL);
+    mutex_unlock(&dev->dma_lock);
+    fpga_dma_stats_account(dev, size, ret);
+    if (!ret)
+        fpga_dma_sync_for_cpu(dev, dma_handle, size);
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    /* Only the last blocking caller out may hand the engine back to the queue. */
+    dev->sync_active--;
+    fpga_dma_queue_kick_locked(dev);
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    if (ret)
+        return ret;
+
+    /* Copy DMA buffer data to userspace */
+    if (transfer->user_buf &&
+        copy_to_user((void __user *)(unsigned long)transfer->user_buf, dma_buf, size))
+        return -EFAULT;
+    transfer->result = 0;
+    return 0;
+}
+
+/**
+ * fpga_dma_qbuf - Queue a ring slot for capture
+ *
+ * With MSI the transfer is chained behind any slot already in flight and the
+ * call returns immediately.  In polling fallback mode the transfer runs
+ * inline, but the slot is still reported through the done queue.  With
+ * FPGA_DMA_BUF_FLAG_TENSOR the paired tensor slot is filled from the same
+ * camera frame before the slot completes.
+ */
+static int fpga_dma_qbuf(struct fpga_dma_dev *dev, struct file *file,
+                         const struct dma_buffer_req *req)
+{
+    bool tensor = (req->flags & FPGA_DMA_BUF_FLAG_TENSOR) != 0;
+    unsigned long flags;
+    size_t size;
+    u32 idx = req->index;
+    int ret = 0;
+
+    fpga_dma_normalize_info_layout(&dev->info);
+    size = req->size > 0 ? req->size : fpga_dma_default_frame_size(&dev->info);
+
+    if (idx >= dev->dma_buf_count) {
+        dev_err(dev->dev, "QBUF: invalid DMA ring index %u (count=%u)\n",
+                idx, dev->dma_buf_count);
+        return -EINVAL;
+    }
+    if (size > dev->dma_buf_size) {
+        dev_err(dev->dev, "QBUF: requested size %zu exceeds buffer size %zu\n",
+                size, dev->dma_buf_size);
+        return -EINVAL;
+    }
+    if (tensor && !dev->tensor_count) {
+        dev_err(dev->dev, "QBUF: no tensor channel (load the driver with dma_tensor=1)\n");
+        return -EINVAL;
+    }
+    /* The hold-bank pairing needs the IRQ-chained pair of frame-mode sessions. */
+    if (tensor && !dev->irq_enabled) {
+        dev_err(dev->dev, "QBUF: tensor transfers need the MSI frame-mode path\n");
+        return -EOPNOTSUPP;
+    }
+    if (!dev->irq_enabled && !dev->use_poll_fallback) {
+        dev_err(dev->dev, "QBUF: neither IRQ nor fallback path is available\n");
+        return -EIO;
+    }
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_owner && dev->q_owner != file)
+        ret = -EBUSY;
+    else if (dev->buf_state[idx] != FPGA_DMA_BUF_IDLE)
+        ret = -EBUSY;
+    if (ret) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return ret;
+    }
+    dev->q_owner = file;
+    dev->buf_bytes[idx] = (u32)size;
+    dev->buf_result[idx] = 0;
+    dev->buf_tensor[idx] = tensor;
+    dev->buf_state[idx] = FPGA_DMA_BUF_QUEUED;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    /* Cache maintenance of a whole frame is too slow for the spinlock. */
+    fpga_dma_sync_for_device(dev, dev->ring->slot[idx].dma_handle, size);
+    if (tensor)
+        fpga_dma_sync_for_device(dev, fpga_dma_tensor_slot(dev, idx)->dma_handle,
+                                 FPGA_TENSOR_FRAME_SIZE);
+
+    /* Ownership cannot change meanwhile: release() never races our own ioctl. */
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->irq_enabled) {
+        dev->q_pending[(dev->q_pending_head + dev->q_pending_count) % FPGA_DMA_MAX_RING_BUFFERS] = idx;
+        dev->q_pending_count++;
+        fpga_dma_queue_kick_locked(dev);
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return 0;
+    }
+    dev->buf_state[idx] = FPGA_DMA_BUF_ACTIVE;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    mutex_lock(&dev->dma_lock);
+    ret = fpga_dma_perform_transfer_polling(dev, size, dev->ring->slot[idx].dma_handle,
+                                            dev->ring->slot[idx].vaddr);
+    mutex_unlock(&dev->dma_lock);
+
+    spin_lock_irqsave(&dev->q_lock, flags);
+    fpga_dma_queue_finish_locked(dev, idx, ret);
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+    wake_up_interruptible(&dev->q_wait);
+    return 0;
+}
+
+static bool fpga_dma_queue_has_done(struct fpga_dma_dev *dev)
+{
+    return READ_ONCE(dev->q_done_count) > 0;
+}
+
+/**
+ * fpga_dma_dqbuf - Dequeue the oldest completed ring slot
+ */
+static int fpga_dma_dqbuf(struct fpga_dma_dev *dev, struct file *file,
+                          struct dma_buffer_req *req)
+{
+    bool nonblock = (file->f_flags & O_NONBLOCK) ||
+                    (req->flags & FPGA_DMA_BUF_FLAG_NONBLOCK);
+    unsigned long flags;
+    long wait_ret;
+    u32 idx;
+
+    for (;;) {
+        spin_lock_irqsave(&dev->q_lock, flags);
+        if (dev->q_owner != file) {
+            spin_unlock_irqrestore(&dev->q_lock, flags);
+            return -EINVAL;
+        }
+        if (dev->q_done_count > 0)
+            break;
+        if (dev->q_active < 0 && dev->q_pending_count == 0) {
+            /* Nothing queued: sleeping would never end. */
+            spin_unlock_irqrestore(&dev->q_lock, flags);
+            return -EINVAL;
+        }
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+
+        if (nonblock)
+            return -EAGAIN;
+        wait_ret = wait_event_interruptible_timeout(dev->q_wait,
+                                                    fpga_dma_queue_has_done(dev),
+                                                    msecs_to_jiffies(dma_timeout_ms));
+        if (wait_ret < 0)
+            return (int)wait_ret;
+        if (wait_ret == 0)
+            return -ETIMEDOUT;
+    }
+
+    idx = dev->q_done[dev->q_done_head];
+    dev->q_done_head = (dev->q_done_head + 1) % FPGA_DMA_MAX_RING_BUFFERS;
+    dev->q_done_count--;
+    dev->buf_state[idx] = FPGA_DMA_BUF_IDLE;
+    req->index = idx;
+    req->size = dev->buf_bytes[idx];
+    req->result = dev->buf_result[idx];
+    req->sequence = dev->buf_sequence[idx];
+    req->dropped = dev->q_dropped;
+    req->timestamp_ns = dev->buf_timestamp_ns[idx];
+    req->flags &= ~FPGA_DMA_BUF_FLAG_TENSOR;
+    if (dev->buf_tensor[idx] && req->result == 0)
+        req->flags |= FPGA_DMA_BUF_FLAG_TENSOR;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    /* The slot is idle (user-owned) now; make landed data visible to the CPU. */
+    if (req->result == 0)
+        fpga_dma_sync_for_cpu(dev, dev->ring->slot[idx].dma_handle, req->size);
+    if (req->flags & FPGA_DMA_BUF_FLAG_TENSOR)
+        fpga_dma_sync_for_cpu(dev, fpga_dma_tensor_slot(dev, idx)->dma_handle,
+                              FPGA_TENSOR_FRAME_SIZE);
+    return 0;
+}
 
-        length_in_dwords = (chunk_size + 3) / 4;
-        cmd_length = length_in_dwords - 1;
+/**
+ * fpga_dma_sync_buffer - Explicit CPU access bracketing for mmap users
+ */
+static int fpga_dma_sync_buffer(struct fpga_dma_dev *dev, const struct dma_buffer_sync *sync)
+{
+    dma_addr_t dma_handle;
+    size_t buf_size;
+    size_t size;
+    void *vaddr;
 
-        if (verbose_chunk) {
-            dev_info(dev->dev, "--- Chunk %d ---\n", chunk_num);
-            dev_info(dev->dev, "  Addr: 0x%llx (lo=0x%x hi=0x%x)\n",
-                     (u64)current_addr,
-                     lower_32_bits(current_addr),
-                     upper_32_bits(current_addr));
-            dev_info(dev->dev, "  Size: %zu bytes (%u DWORDs)\n",
-                     chunk_size, length_in_dwords);
-        }
+    if (!fpga_dma_lookup_slot(dev, sync->index, &vaddr, &dma_handle, &buf_size))
+        return -EINVAL;
+    if (sync->flags != FPGA_DMA_SYNC_START && sync->flags != FPGA_DMA_SYNC_END)
+        return -EINVAL;
+    if ((size_t)sync->offset >= buf_size)
+        return -EINVAL;
+    size = sync->size ? sync->size : buf_size - sync->offset;
+    if (size > buf_size - sync->offset)
+        return -EINVAL;
 
-        buf_offset = (size_t)(current_addr - dma_handle);
+    if (sync->flags == FPGA_DMA_SYNC_START)
+        fpga_dma_sync_for_cpu(dev, dma_handle + sync->offset, size);
+    else
+        fpga_dma_sync_for_device(dev, dma_handle + sync->offset, size);
+    return 0;
+}
 
-        chunk_tail0 = (u32 *)((u8 *)dma_buf + buf_offset + chunk_size - sizeof(u32));
-        WRITE_ONCE(*chunk_tail0, tail_sentinel0);
-        if (chunk_size >= 8) {
-            chunk_tail1 = (u32 *)((u8 *)chunk_tail0 - sizeof(u32));
-            WRITE_ONCE(*chunk_tail1, tail_sentinel1);
-        }
-        dma_wmb();
+/**
+ * fpga_dma_set_streaming - Enable/disable free-running capture for @file
+ *
+ * Streaming needs the MSI path: the handler itself re-arms the next slot.
+ */
+static int fpga_dma_set_streaming(struct fpga_dma_dev *dev, struct file *file, bool on)
+{
+    unsigned long flags;
 
-        /* Keep BAR write sequence fixed: 0x120 -> 0x110 -> 0x100. */
-        fpga_dma_write_reg(dev, BAR1_DMA_H_ADDR, upper_32_bits(current_addr));
-        fpga_dma_write_reg(dev, BAR1_DMA_L_ADDR, lower_32_bits(current_addr));
-        cmd_reg = (cmd_length & DMA_CMD_LEN_MASK) | DMA_CMD_64BIT_ADDR | DMA_CMD_WRITE;
-        fpga_dma_write_reg(dev, BAR1_DMA_CMD_REG, cmd_reg);
-        fpga_dma_flush_posted_writes(dev);
-
-        deadline = jiffies + msecs_to_jiffies(dma_timeout_ms);
-        while ((READ_ONCE(*chunk_tail0) == tail_sentinel0) ||
-               (chunk_tail1 && (READ_ONCE(*chunk_tail1) == tail_sentinel1))) {
-            if (time_after(jiffies, deadline)) {
-                dev_err(dev->dev,
-                        "Chunk %d timeout waiting RAM overwrite (addr=0x%llx size=%zu)\n",
-                        chunk_num, (u64)current_addr, chunk_size);
-                return -ETIMEDOUT;
-            }
-            if (poll_sleep_cur_us <= 0) {
-                cpu_relax();
-                continue;
-            }
+    if (on && !dev->irq_enabled) {
+        dev_err(dev->dev, "STREAMON: free-running capture requires MSI\n");
+        return -EOPNOTSUPP;
+    }
 
-            if (poll_sleep_max_us > 0 && poll_sleep_cur_us > poll_sleep_max_us)
-                poll_sleep_cur_us = poll_sleep_max_us;
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_owner && dev->q_owner != file) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return -EBUSY;
+    }
+    if (on && !dev->q_streaming) {
+        dev->q_owner = file;
+        dev->q_sequence = 0;
+        dev->q_dropped = 0;
+    }
+    dev->q_streaming = on;
+    fpga_dma_queue_kick_locked(dev);
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+    return 0;
+}
 
-            usleep_range(poll_sleep_cur_us, poll_sleep_cur_us + 5);
+static int fpga_dma_set_eventfd(struct fpga_dma_dev *dev, struct file *file, int fd)
+{
+    struct eventfd_ctx *new_ctx = NULL;
+    struct eventfd_ctx *old_ctx;
+    unsigned long flags;
+
+    if (fd >= 0) {
+        new_ctx = eventfd_ctx_fdget(fd);
+        if (IS_ERR(new_ctx))
+            return PTR_ERR(new_ctx);
+    }
 
-            if (poll_backoff_polls > 0 && poll_sleep_max_us > 0 &&
-                poll_sleep_cur_us < poll_sleep_max_us) {
-                poll_count++;
-                if (poll_count >= poll_backoff_polls) {
-                    poll_count = 0;
-                    poll_sleep_cur_us <<= 1;
-                    if (poll_sleep_cur_us > poll_sleep_max_us)
-                        poll_sleep_cur_us = poll_sleep_max_us;
-                }
-            }
-        }
-        dma_rmb();
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_owner && dev->q_owner != file) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        if (new_ctx)
+            eventfd_ctx_put(new_ctx);
+        return -EBUSY;
+    }
+    old_ctx = dev->q_eventfd;
+    dev->q_eventfd = new_ctx;
+    if (new_ctx)
+        dev->q_owner = file;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    if (old_ctx)
+        eventfd_ctx_put(old_ctx);
+    return 0;
+}
 
-        if (dma_chunk_delay_us >= 1000)
-            usleep_range(dma_chunk_delay_us, dma_chunk_delay_us + 100);
-        else if (dma_chunk_delay_us > 0)
-            udelay(dma_chunk_delay_us);
+/**
+ * fpga_dma_queue_reset - Drop every queued/done slot owned by @file
+ *
+ * A slot still in flight finishes normally and returns straight to idle.
+ */
+static void fpga_dma_queue_reset(struct fpga_dma_dev *dev, struct file *file)
+{
+    struct eventfd_ctx *old_ctx;
+    unsigned long flags;
+    u32 i;
 
-        remaining -= chunk_size;
-        current_addr += chunk_size;
-        chunk_num++;
+    spin_lock_irqsave(&dev->q_lock, flags);
+    if (dev->q_owner != file) {
+        spin_unlock_irqrestore(&dev->q_lock, flags);
+        return;
+    }
+    for (i = 0; i < FPGA_DMA_MAX_RING_BUFFERS; i++) {
+        if ((int)i != dev->q_active)
+            dev->buf_state[i] = FPGA_DMA_BUF_IDLE;
     }
+    dev->q_pending_head = 0;
+    dev->q_pending_count = 0;
+    dev->q_done_head = 0;
+    dev->q_done_count = 0;
+    dev->q_owner = NULL;
+    dev->q_streaming = false;
+    old_ctx = dev->q_eventfd;
+    dev->q_eventfd = NULL;
+    spin_unlock_irqrestore(&dev->q_lock, flags);
+
+    if (old_ctx)
+        eventfd_ctx_put(old_ctx);
+}
 
-    if (dma_verbose)
-        dev_info(dev->dev, "=== DMA Transfer Complete (poll fallback) chunks=%d ===\n", chunk_num);
+static struct sg_table *fpga_dma_dmabuf_map(struct dma_buf_attachment *attach,
+                                             enum dma_data_direction dir)
+{
+    struct fpga_dma_dmabuf *priv = attach->dmabuf->priv;
+    struct sg_table *sgt;
+    int ret;
 
-    return ret;
+    sgt = kzalloc(sizeof(*sgt), GFP_KERNEL);
+    if (!sgt)
+        return ERR_PTR(-ENOMEM);
+
+    /* Describe the ring buffer, then map it for the importing device. */
+    if (priv->cached) {
+        /* Noncoherent allocations are physically contiguous pages. */
+        ret = sg_alloc_table(sgt, 1, GFP_KERNEL);
+        if (ret)
+            goto err_free;
+        sg_set_page(sgt->sgl, virt_to_page(priv->vaddr), PAGE_ALIGN(priv->size), 0);
+    } else {
+        ret = dma_get_sgtable(priv->ring->dma_dev, sgt, priv->vaddr, priv->dma_handle,
+                              priv->size);
+        if (ret < 0)
+            goto err_free;
+    }
+    ret = dma_map_sgtable(attach->dev, sgt, dir, 0);
+    if (ret)
+        goto err_free_table;
+    return sgt;
+
+err_free_table:
+    sg_free_table(sgt);
+err_free:
+    kfree(sgt);
+    return ERR_PTR(ret);
 }
 
-static int fpga_dma_perform_transfer_irq(struct fpga_dma_dev *dev,
-                                         size_t size,
-                                         dma_addr_t dma_handle)
+static void fpga_dma_dmabuf_unmap(struct dma_buf_attachment *attach,
+                                  struct sg_table *sgt,
+                                  enum dma_data_direction dir)
 {
-    u32 total_dwords;
-    u32 cmd_reg;
-    unsigned long wait_ret;
+    dma_unmap_sgtable(attach->dev, sgt, dir, 0);
+    sg_free_table(sgt);
+    kfree(sgt);
+}
 
-    if (!size)
-        return -EINVAL;
+static int fpga_dma_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+    struct fpga_dma_dmabuf *priv = dmabuf->priv;
 
-    total_dwords = DIV_ROUND_UP((u32)size, 4U);
-    if (total_dwords == 0 || total_dwords > DMA_CMD_FRAME_DWORDS_MASK) {
-        dev_err(dev->dev, "Invalid frame size for frame-mode DMA: %zu bytes (%u dwords)\n",
-                size, total_dwords);
+    if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > priv->size)
         return -EINVAL;
-    }
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    if (priv->cached)
+        return dma_mmap_pages(priv->ring->dma_dev, vma, vma->vm_end - vma->vm_start,
+                              virt_to_page(priv->vaddr));
+#endif
+    return dma_mmap_coherent(priv->ring->dma_dev, vma, priv->vaddr, priv->dma_handle,
+                             priv->size);
+}
 
-    reinit_completion(&dev->dma_done);
+/* DMA_BUF_IOCTL_SYNC lands here; only the cacheable ring needs maintenance. */
+static int fpga_dma_dmabuf_begin_cpu_access(struct dma_buf *dmabuf, enum dma_data_direction dir)
+{
+    struct fpga_dma_dmabuf *priv = dmabuf->priv;
 
-    /* Fixed write order: BAR1+0x120 -> BAR1+0x110 -> BAR1+0x100. */
-    fpga_dma_write_reg(dev, BAR1_DMA_H_ADDR, upper_32_bits(dma_handle));
-    fpga_dma_write_reg(dev, BAR1_DMA_L_ADDR, lower_32_bits(dma_handle));
-    cmd_reg = DMA_CMD_FRAME_MODE | (total_dwords & DMA_CMD_FRAME_DWORDS_MASK);
-    fpga_dma_write_reg(dev, BAR1_DMA_CMD_REG, cmd_reg);
-    fpga_dma_flush_posted_writes(dev);
+    (void)dir;
+    if (priv->cached)
+        dma_sync_single_for_cpu(priv->ring->dma_dev, priv->dma_handle, priv->size,
+                                DMA_FROM_DEVICE);
+    return 0;
+}
 
-    wait_ret = wait_for_completion_timeout(&dev->dma_done, msecs_to_jiffies(dma_timeout_ms));
-    if (!wait_ret) {
-        dev_err(dev->dev, "Frame-mode DMA timeout (size=%zu bytes, dwords=%u)\n",
-                size, total_dwords);
-        return -ETIMEDOUT;
-    }
+static int fpga_dma_dmabuf_end_cpu_access(struct dma_buf *dmabuf, enum dma_data_direction dir)
+{
+    struct fpga_dma_dmabuf *priv = dmabuf->priv;
 
+    (void)dir;
+    if (priv->cached)
+        dma_sync_single_for_device(priv->ring->dma_dev, priv->dma_handle, priv->size,
+                                   DMA_FROM_DEVICE);
     return 0;
 }
 
+static void fpga_dma_dmabuf_release(struct dma_buf *dmabuf)
+{
+    struct fpga_dma_dmabuf *priv = dmabuf->priv;
+
+    fpga_dma_ring_put(priv->ring);
+    kfree(priv);
+}
+
+static const struct dma_buf_ops fpga_dma_dmabuf_ops = {
+    .map_dma_buf = fpga_dma_dmabuf_map,
+    .unmap_dma_buf = fpga_dma_dmabuf_unmap,
+    .mmap = fpga_dma_dmabuf_mmap,
+    .begin_cpu_access = fpga_dma_dmabuf_begin_cpu_access,
+    .end_cpu_access = fpga_dma_dmabuf_end_cpu_access,
+    .release = fpga_dma_dmabuf_release,
+};
+
 /**
- * fpga_dma_perform_transfer - Perform a DMA read from FPGA
+ * fpga_dma_export_dmabuf - Wrap ring slot @exp->index in a new dma-buf fd
  */
-static int fpga_dma_perform_transfer(struct fpga_dma_dev *dev,
-                                     size_t size,
-                                     dma_addr_t dma_handle,
-                                     void *dma_buf)
+static int fpga_dma_export_dmabuf(struct fpga_dma_dev *dev, struct dma_buffer_export *exp)
 {
-    if (dev->irq_enabled) {
-        int ret = fpga_dma_perform_transfer_irq(dev, size, dma_handle);
+    DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+    struct fpga_dma_dmabuf *priv;
+    struct dma_buf *dmabuf;
+    dma_addr_t dma_handle;
+    size_t size;
+    void *vaddr;
+    int fd;
 
-        if (ret == -ETIMEDOUT && dma_irq_timeout_retry_poll) {
-            dev_warn(dev->dev, "IRQ timeout, retrying DMA transfer with polling path\n");
-            ret = fpga_dma_perform_transfer_polling(dev, size, dma_handle, dma_buf);
-        }
-        return ret;
+    if (!fpga_dma_lookup_slot(dev, exp->index, &vaddr, &dma_handle, &size))
+        return -EINVAL;
+    if (exp->flags & ~(u32)O_CLOEXEC)
+        return -EINVAL;
+
+    priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+    if (!priv)
+        return -ENOMEM;
+    kref_get(&dev->ring->ref);
+    priv->ring = dev->ring;
+    priv->vaddr = vaddr;
+    priv->dma_handle = dma_handle;
+    priv->size = size;
+    priv->index = exp->index;
+    priv->cached = dev->ring->cached;
+
+    exp_info.ops = &fpga_dma_dmabuf_ops;
+    exp_info.size = priv->size;
+    exp_info.flags = O_RDWR;
+    exp_info.priv = priv;
+    dmabuf = dma_buf_export(&exp_info);
+    if (IS_ERR(dmabuf)) {
+        fpga_dma_ring_put(priv->ring);
+        kfree(priv);
+        return PTR_ERR(dmabuf);
     }
-    if (dev->use_poll_fallback)
-        return fpga_dma_perform_transfer_polling(dev, size, dma_handle, dma_buf);
 
-    dev_err(dev->dev, "DMA requested but neither IRQ nor fallback path is available\n");
-    return -EIO;
+    fd = dma_buf_fd(dmabuf, O_RDWR | (exp->flags & O_CLOEXEC));
+    if (fd < 0) {
+        /* Drops the last reference and runs fpga_dma_dmabuf_release(). */
+        dma_buf_put(dmabuf);
+        return fd;
+    }
+
+    exp->fd = fd;
+    exp->size = (u32)priv->size;
+    dev_dbg(dev->dev, "Exported ring slot %u as dma-buf fd %d\n", exp->index, fd);
+    return 0;
 }
 
 /**
@@ -427,6 +1856,7 @@ static int fpga_dma_release(struct inode *inode, struct file *file)
 {
     struct fpga_dma_dev *dev = file->private_data;
 
+    fpga_dma_queue_reset(dev, file);
     dev_dbg(dev->dev, "Device closed\n");
     return 0;
 }
@@ -438,14 +1868,15 @@ static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 {
     struct fpga_dma_dev *dev = file->private_data;
     void __user *argp = (void __user *)arg;
+    u64 start_ns = ktime_get_ns();
     int ret = 0;
 
     switch (cmd) {
     case FPGA_DMA_GET_INFO: {
         struct fpga_info info = dev->info;
 
-        /* Update link status */
-        /* TODO: Read actual PCIe link status from capability registers */
+        /* The link may have retrained since probe. */
+        fpga_dma_read_link_status(dev, &info);
         fpga_dma_normalize_info_layout(&info);
 
         if (copy_to_user(argp, &info, sizeof(info)))
@@ -453,13 +1884,15 @@ static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long ar
         break;
     }
 
+    case FPGA_DMA_GET_TENSOR_INFO:
+        if (copy_to_user(argp, &dev->tensor_info, sizeof(dev->tensor_info)))
+            ret = -EFAULT;
+        break;
+
     case FPGA_DMA_READ_FRAME: {
         struct dma_transfer transfer;
         size_t size;
         size_t default_size;
-        u32 buf_index;
-        dma_addr_t dma_handle;
-        void *dma_buf;
 
         if (copy_from_user(&transfer, argp, sizeof(transfer))) {
             ret = -EFAULT;
@@ -471,46 +1904,41 @@ static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 
         /* Use default frame size if not specified */
         size = transfer.size > 0 ? transfer.size : default_size;
-        buf_index = transfer.offset;
 
-        if (buf_index >= dev->dma_buf_count) {
-            dev_err(dev->dev, "Invalid DMA ring index %u (count=%u)\n",
-                    buf_index, dev->dma_buf_count);
-            ret = -EINVAL;
+        if (transfer.flags & FPGA_DMA_XFER_FLAG_USERPTR) {
+            ret = fpga_dma_read_frame_user(dev, &transfer, size, NULL);
+            if (!ret && copy_to_user(argp, &transfer, sizeof(transfer)))
+                ret = -EFAULT;
             break;
         }
 
-        if (size > dev->dma_buf_size) {
-            dev_err(dev->dev, "Requested size %zu exceeds buffer size %zu\n",
-                    size, dev->dma_buf_size);
-            ret = -EINVAL;
-            break;
-        }
+        ret = fpga_dma_read_frame_ring(dev, &transfer, size, NULL);
+        if (!ret && copy_to_user(argp, &transfer, sizeof(transfer)))
+            ret = -EFAULT;
+        break;
+    }
+
+    case FPGA_DMA_READ_ROI: {
+        struct dma_roi_transfer roi;
+        size_t size;
 
-        dma_handle = dev->dma_handles[buf_index];
-        dma_buf = dev->dma_bufs[buf_index];
-        if (!dma_buf || dma_handle == (dma_addr_t)0) {
-            dev_err(dev->dev, "DMA ring slot %u is not initialized\n", buf_index);
-            ret = -EIO;
+        if (copy_from_user(&roi, argp, sizeof(roi))) {
+            ret = -EFAULT;
             break;
         }
 
-        /* Perform DMA transfer */
-        mutex_lock(&dev->dma_lock);
-        ret = fpga_dma_perform_transfer(dev, size, dma_handle, dma_buf);
-        mutex_unlock(&dev->dma_lock);
+        fpga_dma_normalize_info_layout(&dev->info);
+        ret = fpga_dma_roi_prepare(dev, &roi, &size);
+        if (ret)
+            break;
 
+        if (roi.xfer.flags & FPGA_DMA_XFER_FLAG_USERPTR)
+            ret = fpga_dma_read_frame_user(dev, &roi.xfer, size, &roi);
+        else
+            ret = fpga_dma_read_frame_ring(dev, &roi.xfer, size, &roi);
         if (!ret) {
-            /* Copy DMA buffer data to userspace */
-            if (transfer.user_buf) {
-                if (copy_to_user((void __user *)(unsigned long)transfer.user_buf,
-                                 dma_buf, size)) {
-                    ret = -EFAULT;
-                    break;
-                }
-            }
-            transfer.result = 0;
-            if (copy_to_user(argp, &transfer, sizeof(transfer)))
+            roi.xfer.size = (u32)size;
+            if (copy_to_user(argp, &roi, sizeof(roi)))
                 ret = -EFAULT;
         }
         break;
@@ -518,18 +1946,22 @@ static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long ar
 
     case FPGA_DMA_MAP_BUFFER: {
         struct buffer_map map;
+        dma_addr_t dma_handle;
+        size_t size;
+        void *vaddr;
 
         if (copy_from_user(&map, argp, sizeof(map))) {
             ret = -EFAULT;
             break;
         }
 
-        if (map.index >= dev->dma_buf_count) {
+        if (!fpga_dma_lookup_slot(dev, map.index, &vaddr, &dma_handle, &size)) {
             ret = -EINVAL;
             break;
         }
 
-        map.size = dev->dma_buf_size;
+        /* Tensor slots sit past the ring in the same offset space. */
+        map.size = size;
         map.offset = (u64)map.index * (u64)dev->dma_buf_size;
 
         if (copy_to_user(argp, &map, sizeof(map)))
@@ -537,15 +1969,208 @@ static long fpga_dma_ioctl(struct file *file, unsigned int cmd, unsigned long ar
         break;
     }
 
+    case FPGA_DMA_QBUF: {
+        struct dma_buffer_req req;
+
+        if (copy_from_user(&req, argp, sizeof(req))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = fpga_dma_qbuf(dev, file, &req);
+        break;
+    }
+
+    case FPGA_DMA_DQBUF: {
+        struct dma_buffer_req req;
+
+        if (copy_from_user(&req, argp, sizeof(req))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = fpga_dma_dqbuf(dev, file, &req);
+        if (!ret && copy_to_user(argp, &req, sizeof(req)))
+            ret = -EFAULT;
+        break;
+    }
+
+    case FPGA_DMA_SET_EVENTFD: {
+        __s32 fd;
+
+        if (copy_from_user(&fd, argp, sizeof(fd))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = fpga_dma_set_eventfd(dev, file, fd);
+        break;
+    }
+
+    case FPGA_DMA_STREAMON:
+        ret = fpga_dma_set_streaming(dev, file, true);
+        break;
+
+    case FPGA_DMA_STREAMOFF:
+        ret = fpga_dma_set_streaming(dev, file, false);
+        break;
+
+    case FPGA_DMA_SYNC_BUFFER: {
+        struct dma_buffer_sync sync;
+
+        if (copy_from_user(&sync, argp, sizeof(sync))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = fpga_dma_sync_buffer(dev, &sync);
+        break;
+    }
+
+    case FPGA_DMA_EXPORT_DMABUF: {
+        struct dma_buffer_export exp;
+
+        if (copy_from_user(&exp, argp, sizeof(exp))) {
+            ret = -EFAULT;
+            break;
+        }
+        ret = fpga_dma_export_dmabuf(dev, &exp);
+        if (!ret && copy_to_user(argp, &exp, sizeof(exp)))
+            ret = -EFAULT;
+        break;
+    }
+
     default:
         dev_dbg(dev->dev, "Unknown ioctl cmd=0x%x\n", cmd);
         ret = -ENOTTY;
         break;
     }
 
+    if (cmd == FPGA_DMA_READ_FRAME || cmd == FPGA_DMA_READ_ROI ||
+        cmd == FPGA_DMA_QBUF || cmd == FPGA_DMA_DQBUF)
+        fpga_dma_stats_hist(dev, dev->stats.ioctl_latency_hist, ktime_get_ns() - start_ns);
+
     return ret;
 }
 
+/*
+ * sysfs counters on the class device (/sys/class/fpga_dma/fpga_dma0/),
+ * one value per file; write anything to stats_reset to clear them.
+ */
+#define FPGA_DMA_STAT_ATTR(field)                                               \
+static ssize_t field##_show(struct device *d, struct device_attribute *attr,    \
+                            char *buf)                                          \
+{                                                                               \
+    struct fpga_dma_dev *dev = dev_get_drvdata(d);                              \
+    unsigned long flags;                                                        \
+    u64 val;                                                                    \
+                                                                                \
+    spin_lock_irqsave(&dev->stats_lock, flags);                                 \
+    val = dev->stats.field;                                                     \
+    spin_unlock_irqrestore(&dev->stats_lock, flags);                            \
+    return sysfs_emit(buf, "%llu\n", val);                                      \
+}                                                                               \
+static DEVICE_ATTR_RO(field)
+
+FPGA_DMA_STAT_ATTR(transfers);
+FPGA_DMA_STAT_ATTR(bytes);
+FPGA_DMA_STAT_ATTR(errors);
+FPGA_DMA_STAT_ATTR(timeouts);
+FPGA_DMA_STAT_ATTR(poll_fallbacks);
+
+static ssize_t irq_count_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct fpga_dma_dev *dev = dev_get_drvdata(d);
+
+    return sysfs_emit(buf, "%llu\n", READ_ONCE(dev->irq_count));
+}
+static DEVICE_ATTR_RO(irq_count);
+
+static ssize_t link_width_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct fpga_dma_dev *dev = dev_get_drvdata(d);
+    struct fpga_info info = dev->info;
+
+    fpga_dma_read_link_status(dev, &info);
+    return sysfs_emit(buf, "%u\n", info.link_width);
+}
+static DEVICE_ATTR_RO(link_width);
+
+static ssize_t link_speed_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct fpga_dma_dev *dev = dev_get_drvdata(d);
+    struct fpga_info info = dev->info;
+
+    fpga_dma_read_link_status(dev, &info);
+    return sysfs_emit(buf, "%u\n", info.link_speed);
+}
+static DEVICE_ATTR_RO(link_speed);
+
+static ssize_t stats_reset_store(struct device *d, struct device_attribute *attr,
+                                 const char *buf, size_t count)
+{
+    struct fpga_dma_dev *dev = dev_get_drvdata(d);
+    unsigned long flags;
+
+    spin_lock_irqsave(&dev->stats_lock, flags);
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    spin_unlock_irqrestore(&dev->stats_lock, flags);
+    return count;
+}
+static DEVICE_ATTR_WO(stats_reset);
+
+static struct attribute *fpga_dma_attrs[] = {
+    &dev_attr_transfers.attr,
+    &dev_attr_bytes.attr,
+    &dev_attr_errors.attr,
+    &dev_attr_timeouts.attr,
+    &dev_attr_poll_fallbacks.attr,
+    &dev_attr_irq_count.attr,
+    &dev_attr_link_width.attr,
+    &dev_attr_link_speed.attr,
+    &dev_attr_stats_reset.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(fpga_dma);
+
+/* debugfs histograms (/sys/kernel/debug/fpga_dma0/) */
+static void fpga_dma_hist_show(struct seq_file *s, struct fpga_dma_dev *dev, const u64 *src)
+{
+    u64 hist[FPGA_DMA_HIST_BUCKETS];
+    unsigned long flags;
+    unsigned int i;
+
+    spin_lock_irqsave(&dev->stats_lock, flags);
+    memcpy(hist, src, sizeof(hist));
+    spin_unlock_irqrestore(&dev->stats_lock, flags);
+
+    seq_printf(s, "%12s %12s\n", "us", "count");
+    for (i = 0; i < FPGA_DMA_HIST_BUCKETS; i++) {
+        if (!hist[i])
+            continue;
+        if (i == 0)
+            seq_printf(s, "%12s %12llu\n", "<1", hist[i]);
+        else if (i == FPGA_DMA_HIST_BUCKETS - 1)
+            seq_printf(s, "%11u+ %12llu\n", 1U << (i - 1), hist[i]);
+        else
+            seq_printf(s, "%5u-%-6u %12llu\n", 1U << (i - 1), (1U << i) - 1, hist[i]);
+    }
+}
+
+static int fpga_dma_irq_latency_show(struct seq_file *s, void *unused)
+{
+    struct fpga_dma_dev *dev = s->private;
+
+    fpga_dma_hist_show(s, dev, dev->stats.irq_latency_hist);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fpga_dma_irq_latency);
+
+static int fpga_dma_ioctl_latency_show(struct seq_file *s, void *unused)
+{
+    struct fpga_dma_dev *dev = s->private;
+
+    fpga_dma_hist_show(s, dev, dev->stats.ioctl_latency_hist);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fpga_dma_ioctl_latency);
+
 /**
  * fpga_dma_mmap - Map DMA buffer to userspace
  */
@@ -558,6 +2183,7 @@ static int fpga_dma_mmap(struct file *file, struct vm_area_struct *vma)
     u32 buf_index;
     void *dma_buf;
     dma_addr_t dma_handle;
+    size_t slot_size;
     unsigned long saved_vm_pgoff;
     int ret;
 
@@ -571,41 +2197,53 @@ static int fpga_dma_mmap(struct file *file, struct vm_area_struct *vma)
     }
 
     buf_index = (u32)(mmap_offset_bytes / buf_size);
-    if (buf_index >= dev->dma_buf_count) {
-        dev_err(dev->dev, "mmap ring index %u out of range (count=%u)\n",
-                buf_index, dev->dma_buf_count);
+    if (!fpga_dma_lookup_slot(dev, buf_index, &dma_buf, &dma_handle, &slot_size)) {
+        dev_err(dev->dev, "mmap index %u out of range (ring=%u tensor=%u)\n",
+                buf_index, dev->dma_buf_count, dev->tensor_count);
         return -EINVAL;
     }
 
-    if (size > dev->dma_buf_size) {
+    if (size > slot_size) {
         dev_err(dev->dev, "mmap size %zu exceeds DMA buffer size %zu\n",
-                size, dev->dma_buf_size);
+                size, slot_size);
         return -EINVAL;
     }
 
-    dma_buf = dev->dma_bufs[buf_index];
-    dma_handle = dev->dma_handles[buf_index];
-    if (!dma_buf || dma_handle == (dma_addr_t)0) {
-        dev_err(dev->dev, "mmap ring slot %u is not initialized\n", buf_index);
-        return -EIO;
-    }
-
     dev_dbg(dev->dev, "mmap requested: idx=%u size=%zu offset=0x%llx\n",
             buf_index, size, mmap_offset_bytes);
 
     /* Map coherent DMA memory with the DMA API helper to avoid wrong PFN mapping. */
     saved_vm_pgoff = vma->vm_pgoff;
     vma->vm_pgoff = 0;
-    ret = dma_mmap_coherent(&dev->pdev->dev, vma, dma_buf, dma_handle, size);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    if (dev->ring_cached)
+        ret = dma_mmap_pages(&dev->pdev->dev, vma, size, virt_to_page(dma_buf));
+    else
+#endif
+        ret = dma_mmap_coherent(&dev->pdev->dev, vma, dma_buf, dma_handle, size);
     vma->vm_pgoff = saved_vm_pgoff;
     if (ret) {
-        dev_err(dev->dev, "dma_mmap_coherent failed: %d\n", ret);
+        dev_err(dev->dev, "DMA ring mmap failed: %d\n", ret);
         return ret;
     }
 
     return 0;
 }
 
+/**
+ * fpga_dma_poll - Readable once a queued ring slot can be dequeued
+ */
+static __poll_t fpga_dma_poll(struct file *file, poll_table *wait)
+{
+    struct fpga_dma_dev *dev = file->private_data;
+    __poll_t mask = 0;
+
+    poll_wait(file, &dev->q_wait, wait);
+    if (fpga_dma_queue_has_done(dev))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    return mask;
+}
+
 /**
  * fpga_dma_probe - PCI device probe callback
  */
@@ -632,6 +2270,11 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
     dev->use_poll_fallback = false;
     dev->irq_vector = -1;
     dev->irq_count = 0;
+    spin_lock_init(&dev->stats_lock);
+    spin_lock_init(&dev->q_lock);
+    init_waitqueue_head(&dev->q_wait);
+    INIT_DELAYED_WORK(&dev->q_timeout_work, fpga_dma_queue_timeout_work);
+    dev->q_active = -1;
 
     pci_set_drvdata(pdev, dev);
 
@@ -701,14 +2344,24 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
     /* Allocate enough space for the largest supported frame format. */
     dev->dma_buf_size = PAGE_ALIGN((size_t)FPGA_FRAME_MAX_SIZE);
     dev->dma_buf_count = 0;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+    dev->ring_cached = dma_ring_cached != 0;
+#else
+    if (dma_ring_cached)
+        dev_warn(&pdev->dev, "dma_ring_cached needs kernel 5.10+, using coherent ring\n");
+    dev->ring_cached = false;
+#endif
+    dev->ring = fpga_dma_ring_create(pdev, dev->ring_cached);
+    if (!dev->ring) {
+        ret = -ENOMEM;
+        goto err_iounmap_bar1;
+    }
     for (i = 0; i < (u32)requested_ring_buffers; i++) {
-        dev->dma_bufs[i] = dma_alloc_coherent(&pdev->dev, dev->dma_buf_size,
-                                              &dev->dma_handles[i], GFP_KERNEL);
-        if (!dev->dma_bufs[i]) {
+        if (!fpga_dma_ring_alloc_slot(dev->ring, i, dev->dma_buf_size)) {
             if (i == 0) {
                 dev_err(&pdev->dev, "Cannot allocate DMA ring buffers\n");
                 ret = -ENOMEM;
-                goto err_iounmap_bar1;
+                goto err_free_dma;
             }
             dev_warn(&pdev->dev,
                      "DMA ring allocation stopped at %u/%d buffers\n",
@@ -718,8 +2371,31 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
         dev->dma_buf_count++;
     }
 
-    dev_info(&pdev->dev, "DMA ring allocated: buffers=%u size=%zu bytes each\n",
-             dev->dma_buf_count, dev->dma_buf_size);
+    dev_info(&pdev->dev, "DMA ring allocated: buffers=%u size=%zu bytes each (%s)\n",
+             dev->dma_buf_count, dev->dma_buf_size,
+             dev->ring_cached ? "cacheable" : "coherent");
+
+    /* Tensors pair 1:1 with ring slots; a partial tensor ring is useless. */
+    dev->tensor_buf_size = PAGE_ALIGN((size_t)FPGA_TENSOR_FRAME_SIZE);
+    dev->tensor_count = 0;
+    if (dma_tensor && dma_pixel_format == FPGA_PIXEL_FORMAT_BGR565) {
+        dev_warn(&pdev->dev, "dma_tensor needs BGRX8888 frames, tensor channel disabled\n");
+    } else if (dma_tensor) {
+        for (i = 0; i < dev->dma_buf_count; i++) {
+            if (!fpga_dma_ring_alloc_slot(dev->ring, FPGA_DMA_TENSOR_INDEX_BASE + i,
+                                          dev->tensor_buf_size))
+                break;
+            dev->tensor_count++;
+        }
+        if (dev->tensor_count < dev->dma_buf_count) {
+            dev_warn(&pdev->dev, "Tensor ring allocation stopped at %u/%u, tensor channel disabled\n",
+                     dev->tensor_count, dev->dma_buf_count);
+            fpga_dma_free_tensor_buffers(dev);
+        } else {
+            dev_info(&pdev->dev, "Tensor ring allocated: buffers=%u size=%zu bytes each\n",
+                     dev->tensor_count, dev->tensor_buf_size);
+        }
+    }
 
     ret = pci_alloc_irq_vectors(pdev, 1, 1, PCI_IRQ_MSI);
     if (ret < 0) {
@@ -751,6 +2427,15 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
         }
     }
 
+    /*
+     * The polling engines restart the session (and re-lock a bank) per
+     * command or chunk, so only the IRQ path can pair a tensor with its frame.
+     */
+    if (dev->tensor_count && !dev->irq_enabled) {
+        dev_warn(&pdev->dev, "dma_tensor needs MSI, tensor channel disabled on the polling path\n");
+        fpga_dma_free_tensor_buffers(dev);
+    }
+
     /* Fill device info structure */
     dev->info.vendor_id = FPGA_PCI_VENDOR_ID;
     dev->info.device_id = FPGA_PCI_DEVICE_ID;
@@ -758,12 +2443,24 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
     dev->info.bar1_size = dev->bar1_size;
     dev->info.link_width = 2;  /* PCIe x2 */
     dev->info.link_speed = 2;  /* Gen2 */
+    fpga_dma_read_link_status(dev, &dev->info);
+    dev_info(&pdev->dev, "PCIe link: x%u Gen%u\n", dev->info.link_width, dev->info.link_speed);
     dev->info.frame_width = FPGA_FRAME_WIDTH;
     dev->info.frame_height = FPGA_FRAME_HEIGHT;
     dev->info.pixel_format = (dma_pixel_format == FPGA_PIXEL_FORMAT_BGR565)
         ? FPGA_PIXEL_FORMAT_BGR565
         : FPGA_PIXEL_FORMAT_BGRX8888;
     fpga_dma_normalize_info_layout(&dev->info);
+    if (dev->tensor_count) {
+        dev->tensor_info.count = dev->tensor_count;
+        dev->tensor_info.width = FPGA_TENSOR_SIZE;
+        dev->tensor_info.height = FPGA_TENSOR_SIZE;
+        dev->tensor_info.stride = FPGA_TENSOR_SIZE * FPGA_TENSOR_BPP;
+        dev->tensor_info.format = FPGA_PIXEL_FORMAT_RGB888;
+        dev->tensor_info.pad_x = 0;
+        dev->tensor_info.pad_y = FPGA_TENSOR_PAD_Y;
+        dev->tensor_info.scale_q16 = 65536U / FPGA_TENSOR_DECIM;
+    }
     dev_info(&pdev->dev,
              "Frame layout: %ux%u format=%u bpp=%u stride=%u bytes\n",
              dev->info.frame_width,
@@ -796,15 +2493,22 @@ static int fpga_dma_probe(struct pci_dev *pdev, const struct pci_device_id *id)
     }
 
     /* Create device node in sysfs */
-    dev->dev = device_create(fpga_dma_class, &pdev->dev,
-                             MKDEV(dev->major, 0), dev,
-                             FPGA_DMA_DEV_NAME);
+    dev->dev = device_create_with_groups(fpga_dma_class, &pdev->dev,
+                                         MKDEV(dev->major, 0), dev,
+                                         fpga_dma_groups, FPGA_DMA_DEV_NAME);
     if (IS_ERR(dev->dev)) {
         ret = PTR_ERR(dev->dev);
         dev_err(&pdev->dev, "Cannot create device\n");
         goto err_cdev_del;
     }
 
+    /* debugfs is best effort; failures are not fatal. */
+    dev->debugfs_dir = debugfs_create_dir(FPGA_DMA_DEV_NAME, NULL);
+    debugfs_create_file("irq_latency_hist", 0444, dev->debugfs_dir, dev,
+                        &fpga_dma_irq_latency_fops);
+    debugfs_create_file("ioctl_latency_hist", 0444, dev->debugfs_dir, dev,
+                        &fpga_dma_ioctl_latency_fops);
+
     dev_info(&pdev->dev, "FPGA DMA driver loaded successfully\n");
     dev_info(&pdev->dev, "Device file: /dev/%s\n", FPGA_DMA_DEV_NAME);
     if (dev->use_poll_fallback)
@@ -823,6 +2527,7 @@ err_free_irq:
         dev->irq_enabled = false;
         dev->irq_vector = -1;
     }
+    cancel_delayed_work_sync(&dev->q_timeout_work);
 err_free_dma:
     fpga_dma_free_ring_buffers(dev);
 err_iounmap_bar1:
@@ -848,6 +2553,8 @@ static void fpga_dma_remove(struct pci_dev *pdev)
 
     dev_info(&pdev->dev, "Removing FPGA DMA driver\n");
 
+    debugfs_remove_recursive(dev->debugfs_dir);
+
     /* Remove character device */
     device_destroy(fpga_dma_class, MKDEV(dev->major, 0));
     cdev_del(&dev->cdev);
@@ -859,8 +2566,9 @@ static void fpga_dma_remove(struct pci_dev *pdev)
         dev->irq_enabled = false;
         dev->irq_vector = -1;
     }
+    cancel_delayed_work_sync(&dev->q_timeout_work);
 
-    /* Free DMA ring buffers */
+    /* Free DMA ring buffers, or leave them to the last exported dma-buf */
     fpga_dma_free_ring_buffers(dev);
 
     /* Unmap and release BARs */
@@ -928,6 +2636,11 @@ module_init(fpga_dma_init);
 module_exit(fpga_dma_exit);
 
 MODULE_LICENSE("GPL");
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+MODULE_IMPORT_NS("DMA_BUF");
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 16, 0)
+MODULE_IMPORT_NS(DMA_BUF);
+#endif
 MODULE_AUTHOR(DRIVER_AUTHOR);
 MODULE_DESCRIPTION(DRIVER_DESC);
 MODULE_VERSION("1.0");
@@ -38,11 +38,23 @@
 /* Pixel format reported by fpga_info.pixel_format */
 #define FPGA_PIXEL_FORMAT_BGR565    0U
 #define FPGA_PIXEL_FORMAT_BGRX8888  1U
+#define FPGA_PIXEL_FORMAT_RGB888    2U  /* detector tensor only */
+
+/* Detector tensor: the full frame at 1/2 scale, letterboxed into a square RGB888 frame */
+#define FPGA_TENSOR_SIZE           640U
+#define FPGA_TENSOR_BPP            3U
+#define FPGA_TENSOR_FRAME_SIZE     (FPGA_TENSOR_SIZE * FPGA_TENSOR_SIZE * FPGA_TENSOR_BPP)
+#define FPGA_TENSOR_DECIM          2U
+#define FPGA_TENSOR_PAD_Y          ((FPGA_TENSOR_SIZE - FPGA_FRAME_HEIGHT / FPGA_TENSOR_DECIM) / 2)
 
 /* BAR1 DMA Control Register Offsets (from ips2l_pcie_dma_controller.v) */
 #define BAR1_DMA_CMD_REG     0x100  /* DMA command register */
 #define BAR1_DMA_L_ADDR      0x110  /* Lower 32-bit target address */
 #define BAR1_DMA_H_ADDR      0x120  /* Upper 32-bit target address (64-bit mode) */
+/* Frame read window; must be written before BAR1_DMA_L_ADDR starts the read session */
+#define BAR1_DMA_ROI_POS     0x130  /* [27:16]=y, [11:0]=x */
+#define BAR1_DMA_ROI_SIZE    0x140  /* [27:16]=height, [11:0]=width (source pixels) */
+#define BAR1_DMA_ROI_CTRL    0x150  /* [31]=enable, [30]=tensor, [29]=hold bank, [15:8]=pad, [1:0]=log2 decimation */
 
 /* DMA Command Register Bit Fields */
 #define DMA_CMD_LEN_MASK     0x3FF  /* Bits [9:0] - Transfer length in DWORDs minus 1 */
@@ -52,7 +64,22 @@
 #define DMA_CMD_FRAME_MODE        (1U << 31)
 #define DMA_CMD_FRAME_DWORDS_MASK 0x00FFFFFFU
 
+/* ROI control register bit fields */
+#define DMA_ROI_CTRL_ENABLE       (1U << 31)
+#define DMA_ROI_CTRL_DECIM_MASK   0x3U
+#define DMA_ROI_CTRL_TENSOR       (1U << 30)  /* RGB888 packing + vertical letterbox */
+#define DMA_ROI_CTRL_HOLD_BANK    (1U << 29)  /* re-read the previous session's frame bank */
+#define DMA_ROI_CTRL_PAD_SHIFT    8           /* letterbox fill byte */
+
+/* Window x/width granularity in pixels (DDR beat packing and 1/4 decimation) */
+#define FPGA_DMA_ROI_ALIGN        16U
+
 #define FPGA_DMA_MAX_RING_BUFFERS 8U
+/*
+ * Tensor slot i pairs with ring slot i and is addressed as index
+ * FPGA_DMA_TENSOR_INDEX_BASE + i by MAP_BUFFER, EXPORT_DMABUF and SYNC_BUFFER.
+ */
+#define FPGA_DMA_TENSOR_INDEX_BASE FPGA_DMA_MAX_RING_BUFFERS
 
 /* Maximum DMA transfer size per chunk in DWORDs.
  * cmd_reg[9:0] encodes (length - 1); 0x3FF encodes 1024 DW.
@@ -67,6 +94,38 @@
 #define FPGA_DMA_GET_INFO    _IOR(FPGA_DMA_IOC_MAGIC, 1, struct fpga_info)
 #define FPGA_DMA_READ_FRAME  _IOWR(FPGA_DMA_IOC_MAGIC, 2, struct dma_transfer)
 #define FPGA_DMA_MAP_BUFFER  _IOWR(FPGA_DMA_IOC_MAGIC, 3, struct buffer_map)
+/* Asynchronous capture: queue ring slots, dequeue them once the frame landed. */
+#define FPGA_DMA_QBUF        _IOW(FPGA_DMA_IOC_MAGIC, 4, struct dma_buffer_req)
+#define FPGA_DMA_DQBUF       _IOWR(FPGA_DMA_IOC_MAGIC, 5, struct dma_buffer_req)
+/* Signal an eventfd on every completed queued buffer (-1 detaches). */
+#define FPGA_DMA_SET_EVENTFD _IOW(FPGA_DMA_IOC_MAGIC, 6, __s32)
+/* Free-running capture: the IRQ handler re-arms the ring without userspace. */
+#define FPGA_DMA_STREAMON    _IO(FPGA_DMA_IOC_MAGIC, 7)
+#define FPGA_DMA_STREAMOFF   _IO(FPGA_DMA_IOC_MAGIC, 8)
+/* Export one ring slot as a dma-buf fd for RKNN/RGA/KMS/GStreamer import. */
+#define FPGA_DMA_EXPORT_DMABUF _IOWR(FPGA_DMA_IOC_MAGIC, 9, struct dma_buffer_export)
+/* CPU-access bracketing for the cacheable ring (no-op on coherent memory). */
+#define FPGA_DMA_SYNC_BUFFER _IOW(FPGA_DMA_IOC_MAGIC, 10, struct dma_buffer_sync)
+/*
+ * Blocking transfer of a window of the frame, optionally decimated (BGRX8888
+ * only). The window needs one frame-mode session: -EOPNOTSUPP on the chunked
+ * engine (USERPTR pages that map to several bus ranges or without MSI, or
+ * polling with dma_poll_frame_mode=0).
+ */
+#define FPGA_DMA_READ_ROI    _IOWR(FPGA_DMA_IOC_MAGIC, 11, struct dma_roi_transfer)
+/* Detector tensor channel layout; drivers without one fail with ENOTTY. */
+#define FPGA_DMA_GET_TENSOR_INFO _IOR(FPGA_DMA_IOC_MAGIC, 12, struct fpga_tensor_info)
+
+/* dma_transfer.flags */
+#define FPGA_DMA_XFER_FLAG_USERPTR  (1U << 0)  /* DMA straight into pinned user_buf pages */
+
+/* dma_buffer_req.flags */
+#define FPGA_DMA_BUF_FLAG_NONBLOCK  (1U << 0)  /* DQBUF: return -EAGAIN instead of sleeping */
+#define FPGA_DMA_BUF_FLAG_TENSOR    (1U << 1)  /* QBUF: also fill the paired tensor slot; DQBUF: it landed */
+
+/* dma_buffer_sync.flags */
+#define FPGA_DMA_SYNC_START  (1U << 0)  /* begin CPU access: invalidate CPU caches */
+#define FPGA_DMA_SYNC_END    (1U << 1)  /* end CPU access: hand buffer back to device */
 
 /**
  * struct fpga_info - FPGA device information
@@ -96,11 +155,33 @@ struct fpga_info {
     __u32 pixel_format;
 };
 
+/**
+ * struct fpga_tensor_info - Detector tensor channel layout
+ * @count: Tensor slots, paired 1:1 with ring slots (0=no tensor channel, see dma_tensor)
+ * @width: Tensor width in pixels
+ * @height: Tensor height in pixels
+ * @stride: Tensor bytes per line
+ * @format: Tensor pixel format (FPGA_PIXEL_FORMAT_RGB888)
+ * @pad_x: Letterbox left padding in tensor pixels
+ * @pad_y: Letterbox top padding in tensor lines
+ * @scale_q16: Frame-to-tensor scale, 16.16 fixed point
+ */
+struct fpga_tensor_info {
+    __u32 count;
+    __u32 width;
+    __u32 height;
+    __u32 stride;
+    __u32 format;
+    __u32 pad_x;
+    __u32 pad_y;
+    __u32 scale_q16;
+};
+
 /**
  * struct dma_transfer - DMA transfer parameters
  * @size: Number of bytes to transfer
- * @offset: DMA ring buffer index for frame destination (0-based)
- * @flags: Transfer flags (reserved for future use)
+ * @offset: DMA ring buffer index for frame destination (0-based, unused with USERPTR)
+ * @flags: Transfer flags (FPGA_DMA_XFER_FLAG_*)
  * @result: Result code (0=success, negative=error)
  */
 struct dma_transfer {
@@ -111,9 +192,29 @@ struct dma_transfer {
     __u64 user_buf;   /* Userspace buffer address; driver copies DMA data here */
 };
 
+/**
+ * struct dma_roi_transfer - Windowed/decimated frame transfer
+ * @xfer: Destination as for FPGA_DMA_READ_FRAME; @xfer.size returns bytes landed
+ * @x: Window left edge in pixels (multiple of FPGA_DMA_ROI_ALIGN)
+ * @y: Window top edge in lines
+ * @width: Window width in source pixels (multiple of FPGA_DMA_ROI_ALIGN)
+ * @height: Window height in source lines (multiple of @decim)
+ * @decim: Decimation factor applied to both axes (1, 2 or 4)
+ * @stride: Bytes per output line, lines are packed (returned by driver)
+ */
+struct dma_roi_transfer {
+    struct dma_transfer xfer;
+    __u32 x;
+    __u32 y;
+    __u32 width;
+    __u32 height;
+    __u32 decim;
+    __u32 stride;
+};
+
 /**
  * struct buffer_map - Buffer mapping for mmap
- * @index: DMA ring buffer index (0-based)
+ * @index: DMA ring buffer index (0-based), or FPGA_DMA_TENSOR_INDEX_BASE + i
  * @size: Per-buffer mapping size
  * @offset: mmap offset for this buffer (returned by driver)
  */
@@ -123,4 +224,52 @@ struct buffer_map {
     __u64 offset;
 };
 
+/**
+ * struct dma_buffer_req - Queue/dequeue request for asynchronous capture
+ * @index: DMA ring buffer index (0-based); filled by driver on DQBUF
+ * @size: Bytes to transfer on QBUF (0=default frame size); bytes landed on DQBUF
+ * @flags: FPGA_DMA_BUF_FLAG_* bits
+ * @result: Transfer result on DQBUF (0=success, negative errno)
+ * @sequence: Completion sequence number on DQBUF (gaps mean dropped frames)
+ * @dropped: Frames overwritten by streaming mode since STREAMON, on DQBUF
+ * @timestamp_ns: CLOCK_MONOTONIC completion time in nanoseconds, on DQBUF
+ */
+struct dma_buffer_req {
+    __u32 index;
+    __u32 size;
+    __u32 flags;
+    __s32 result;
+    __u32 sequence;
+    __u32 dropped;
+    __u64 timestamp_ns;
+};
+
+/**
+ * struct dma_buffer_export - Export a DMA ring buffer as a dma-buf
+ * @index: DMA ring buffer index (0-based)
+ * @flags: File flags for the new fd (only O_CLOEXEC is honoured)
+ * @fd: dma-buf file descriptor (returned by driver)
+ * @size: dma-buf size in bytes (returned by driver)
+ */
+struct dma_buffer_export {
+    __u32 index;
+    __u32 flags;
+    __s32 fd;
+    __u32 size;
+};
+
+/**
+ * struct dma_buffer_sync - Cache maintenance request for one ring buffer
+ * @index: DMA ring buffer index (0-based)
+ * @flags: Exactly one of FPGA_DMA_SYNC_START / FPGA_DMA_SYNC_END
+ * @offset: Byte offset of the range inside the buffer
+ * @size: Range length in bytes (0=to end of buffer)
+ */
+struct dma_buffer_sync {
+    __u32 index;
+    __u32 flags;
+    __u32 offset;
+    __u32 size;
+};
+
 #endif /* _PCIE_FPGA_DMA_H */
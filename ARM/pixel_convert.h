@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Pixel format conversion kernels shared by the display applications.
+ *
+ * Every kernel has a scalar reference and, on ARM, a NEON version selected
+ * at runtime. Pixels are packed and rows contiguous; callers pass the total
+ * pixel count.
+ */
+
+#ifndef _PIXEL_CONVERT_H
+#define _PIXEL_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 16-bit source/destination layout flags */
+#define PIXCONV_565_SWAP16   (1U << 0)  /* bytes of each 16-bit pixel are swapped */
+#define PIXCONV_565_RED_LOW  (1U << 1)  /* BGR565: red in bits [4:0], blue in [15:11] */
+
+/**
+ * pixconv_select - Pick the conversion backend
+ * @name: "auto", "scalar" or "neon"
+ *
+ * Returns 0 on success, -1 for an unknown name or a backend this CPU lacks.
+ */
+int pixconv_select(const char *name);
+
+const char *pixconv_backend_name(void);
+
+/* BGRX8888 -> 16-bit 565 in the order given by PIXCONV_565_RED_LOW */
+void pixconv_bgrx_to_565(const uint8_t *src, uint8_t *dst, size_t pixels, unsigned int flags);
+/* Byte-swap every 16-bit pixel */
+void pixconv_swap16(const uint8_t *src, uint8_t *dst, size_t pixels);
+/* BGRX8888 -> RGB888, X byte split out to @a (may be NULL) */
+void pixconv_bgrx_to_rgb_a(const uint8_t *src, uint8_t *rgb, uint8_t *a, size_t pixels);
+/* 16-bit 565 -> RGB888 / BGRX8888 (X=0xFF), bit replication to 8 bits */
+void pixconv_565_to_rgb(const uint8_t *src, uint8_t *rgb, size_t pixels, unsigned int flags);
+void pixconv_565_to_bgrx(const uint8_t *src, uint8_t *bgrx, size_t pixels, unsigned int flags);
+
+/**
+ * pixconv_rgb888_blit_nn - Copy an RGB888 tile into a larger image
+ * @src: Top-left pixel of the source tile
+ * @src_stride: Source line pitch in pixels
+ * @sw: Source tile width
+ * @sh: Source tile height
+ * @dst: Top-left pixel of the destination rectangle
+ * @dst_stride: Destination line pitch in pixels
+ * @dw: Destination width
+ * @dh: Destination height
+ *
+ * Nearest-neighbour scaling, row memcpy when the sizes match. Only the
+ * @dw x @dh rectangle is written. Scalar only.
+ */
+void pixconv_rgb888_blit_nn(const uint8_t *src, int src_stride, int sw, int sh,
+                            uint8_t *dst, int dst_stride, int dw, int dh);
+
+/**
+ * pixconv_selftest - Compare the NEON kernels against the scalar reference
+ *
+ * Covers every kernel and flag combination over ragged lengths and a full
+ * 1280x720 frame. Returns the number of mismatching runs (0 = pass); a CPU
+ * without NEON trivially passes.
+ */
+int pixconv_selftest(void);
+
+#endif /* _PIXEL_CONVERT_H */
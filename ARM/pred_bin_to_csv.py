@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+Convert a binary prediction log (--pred-log-format bin) to the CSV written by
+--pred-log-format csv, so eval_lpr.py can read it.
+
+Binary layout (little endian):
+  header: "LPRB", u32 version, u32 record_size
+  record: u64 frame_id, i64 ts_us, i32 x1, y1, x2, y2, f32 conf,
+          u8 plate_type, u8 plate_color, u16 reserved, 64s text (UTF-8, NUL padded)
+  version 1 logs carry a 40s text instead and are still accepted.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = b"LPRB"
+HEADER = struct.Struct("<4sII")
+RECORDS = {
+    1: struct.Struct("<QqiiiifBBH40s"),
+    2: struct.Struct("<QqiiiifBBH64s"),
+}
+
+# enum plate_type order in fpga_lpr_display.c
+PLATE_TYPES = [
+    "common_blue",
+    "common_green",
+    "yellow",
+    "police",
+    "trailer",
+    "embassy_consulate",
+    "unknown",
+]
+
+CSV_HEADER = ["frame_id", "plate_text_pred", "plate_type_pred", "conf", "x1", "y1", "x2", "y2", "ts_us"]
+
+
+def csv_safe_text(text: str) -> str:
+    return text.replace(",", "_").replace("\n", "_").replace("\r", "_")
+
+
+def convert(src: Path, dst: Path) -> int:
+    data = src.read_bytes()
+    if len(data) < HEADER.size:
+        raise ValueError(f"{src}: truncated header")
+    magic, version, rec_size = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{src}: not a binary prediction log")
+    record = RECORDS.get(version)
+    if record is None or rec_size != record.size:
+        raise ValueError(f"{src}: unsupported version {version} / record size {rec_size}")
+
+    body = len(data) - HEADER.size
+    count = body // record.size
+    if body % record.size:
+        print(f"warning: ignoring {body % record.size} trailing bytes", file=sys.stderr)
+
+    dst.parent.mkdir(parents=True, exist_ok=True)
+    with dst.open("w", newline="", encoding="utf-8") as f:
+        w = csv.writer(f, lineterminator="\n")
+        w.writerow(CSV_HEADER)
+        for i in range(count):
+            frame_id, ts_us, x1, y1, x2, y2, conf, ptype, _color, _rsv, text = record.unpack_from(
+                data, HEADER.size + i * record.size
+            )
+            text_s = text.split(b"\0", 1)[0].decode("utf-8", errors="replace")
+            type_s = PLATE_TYPES[ptype] if ptype < len(PLATE_TYPES) else "unknown"
+            w.writerow([frame_id, csv_safe_text(text_s), type_s, f"{conf:.4f}", x1, y1, x2, y2, ts_us])
+    return count
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--in", dest="src", required=True, help="binary prediction log")
+    parser.add_argument("--out", required=True, help="output prediction CSV")
+    args = parser.parse_args()
+
+    count = convert(Path(args.src), Path(args.out))
+    print(f"converted {count} records -> {args.out}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
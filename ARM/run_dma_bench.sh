@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Sweeps the probe-time driver parameters (ring depth, ring memory type) by
+# reloading pcie_fpga_dma.ko, then runs fpga_dma_test --bench for each setting.
+# Runtime parameters go through --sweep and are applied without a reload.
+
+MODULE="pcie_fpga_dma.ko"
+PIXEL_FORMAT="1"
+RING_BUFFERS="3"
+RING_CACHED="0 1"
+ALLOW_POLL_FALLBACK="0"
+MODES="all"
+COUNT="300"
+CSV="dma_bench.csv"
+LABEL=""
+SWEEP=""
+
+usage() {
+  cat <<EOF
+Usage: $0 [options]
+  --module <path>           Driver module (default: ${MODULE})
+  --pixel-format <0|1>      dma_pixel_format (default: ${PIXEL_FORMAT})
+  --ring-buffers "<n..>"    dma_ring_buffers values (default: "${RING_BUFFERS}")
+  --ring-cached "<0|1..>"   dma_ring_cached values (default: "${RING_CACHED}")
+  --allow-poll "<0|1..>"    dma_allow_poll_fallback values (default: "${ALLOW_POLL_FALLBACK}")
+  --modes <list>            fpga_dma_test --bench modes (default: ${MODES})
+  --count <n>               Frames per mode (default: ${COUNT})
+  --csv <path>              CSV to append to (default: ${CSV})
+  --label <text>            Row label, e.g. bitstream version (default: none)
+  --sweep <p=v1,v2,..>      Runtime parameter sweep passed to fpga_dma_test
+  -h, --help                Show this help
+
+The IRQ/poll path is chosen at probe: polling is only used when MSI setup fails
+and dma_allow_poll_fallback=1. The CSV path column records what each run used.
+EOF
+}
+
+while [[ $# -gt 0 ]]; do
+  case "$1" in
+    --module) MODULE="$2"; shift 2 ;;
+    --pixel-format) PIXEL_FORMAT="$2"; shift 2 ;;
+    --ring-buffers) RING_BUFFERS="$2"; shift 2 ;;
+    --ring-cached) RING_CACHED="$2"; shift 2 ;;
+    --allow-poll) ALLOW_POLL_FALLBACK="$2"; shift 2 ;;
+    --modes) MODES="$2"; shift 2 ;;
+    --count) COUNT="$2"; shift 2 ;;
+    --csv) CSV="$2"; shift 2 ;;
+    --label) LABEL="$2"; shift 2 ;;
+    --sweep) SWEEP="$2"; shift 2 ;;
+    -h|--help) usage; exit 0 ;;
+    *) echo "Unknown option: $1" >&2; usage; exit 1 ;;
+  esac
+done
+
+if [[ ! -x ./fpga_dma_test ]]; then
+  echo "fpga_dma_test not found/executable. Build first: make testapp" >&2
+  exit 2
+fi
+
+if [[ ! -f "${MODULE}" ]]; then
+  echo "Module not found: ${MODULE}" >&2
+  exit 2
+fi
+
+bench_args=(--bench "${MODES}" --count "${COUNT}" --bench-csv "${CSV}")
+if [[ -n "${LABEL}" ]]; then
+  bench_args+=(--bench-label "${LABEL}")
+fi
+if [[ -n "${SWEEP}" ]]; then
+  bench_args+=(--sweep "${SWEEP}")
+fi
+
+for rb in ${RING_BUFFERS}; do
+  for rc in ${RING_CACHED}; do
+    for ap in ${ALLOW_POLL_FALLBACK}; do
+      echo
+      echo "=== dma_ring_buffers=${rb} dma_ring_cached=${rc} dma_allow_poll_fallback=${ap} ==="
+      sudo rmmod pcie_fpga_dma 2>/dev/null || true
+      if ! sudo insmod "${MODULE}" dma_pixel_format="${PIXEL_FORMAT}" \
+          dma_ring_buffers="${rb}" dma_ring_cached="${rc}" dma_allow_poll_fallback="${ap}"; then
+        echo "insmod failed, skipping this setting" >&2
+        continue
+      fi
+      sleep 1
+      sudo ./fpga_dma_test "${bench_args[@]}"
+    done
+  done
+done
+
+echo
+echo "Results: ${CSV}"
@@ -51,10 +51,15 @@ OCR_CROP_DUMP_MAX="20"
 OFFLINE_IMAGE=""
 OFFLINE_ROI=""
 OFFLINE_DETECT_PLATE="1"
+OFFLINE_BATCH=""
+OFFLINE_WORKERS="0"
+REPLAY=""
+REPLAY_SPEED="1"
+REPLAY_LOOP="0"
 
 usage() {
   cat <<EOF
-Usage: $0 [--offline-image <path>] --plate-model <path> --ocr-model <path> --ocr-keys <path> [options]
+Usage: $0 [--offline-image <path> | --offline-batch <dir|list>] --plate-model <path> --ocr-model <path> --ocr-keys <path> [options]
   --device <path>            FPGA device (default: ${DEVICE})
   --drm-card <path>          DRM card (default: ${DRM_CARD})
   --veh-model <path>         Vehicle RKNN model (required for live camera mode)
@@ -67,6 +72,11 @@ Usage: $0 [--offline-image <path>] --plate-model <path> --ocr-model <path> --ocr
   --offline-image <path>     Run one-shot offline on image (jpg/png/ppm), no camera path
   --offline-roi <x1,y1,x2,y2> Optional plate ROI for offline image
   --offline-detect-plate <0|1> Auto plate detect in offline mode (default: ${OFFLINE_DETECT_PLATE})
+  --offline-batch <dir|list> Offline infer a PPM directory or manifest with models loaded once
+  --offline-workers <n>      Batch worker threads (default: ${OFFLINE_WORKERS}=CPU count)
+  --replay <file>            Live pipeline from a fpga_dma_test --record file, no FPGA needed
+  --replay-speed <x>         1=recorded timing, 0=as fast as possible (default: ${REPLAY_SPEED})
+  --replay-loop <0|1>        Restart the recording at its end (default: ${REPLAY_LOOP})
   --connector-id <id>        Optional KMS connector id
   --fps <num>                Target FPS (default: ${FPS})
   --pixel-order <mode>       bgr565|rgb565 (default: ${PIXEL_ORDER})
@@ -122,6 +132,11 @@ while [[ $# -gt 0 ]]; do
     --offline-image) OFFLINE_IMAGE="$2"; shift 2 ;;
     --offline-roi) OFFLINE_ROI="$2"; shift 2 ;;
     --offline-detect-plate) OFFLINE_DETECT_PLATE="$2"; shift 2 ;;
+    --offline-batch) OFFLINE_BATCH="$2"; shift 2 ;;
+    --offline-workers) OFFLINE_WORKERS="$2"; shift 2 ;;
+    --replay) REPLAY="$2"; shift 2 ;;
+    --replay-speed) REPLAY_SPEED="$2"; shift 2 ;;
+    --replay-loop) REPLAY_LOOP="$2"; shift 2 ;;
     --connector-id) CONNECTOR_ID="$2"; shift 2 ;;
     --fps) FPS="$2"; shift 2 ;;
     --pixel-order) PIXEL_ORDER="$2"; shift 2 ;;
@@ -166,7 +181,7 @@ while [[ $# -gt 0 ]]; do
 done
 
 OFFLINE_MODE=0
-if [[ -n "$OFFLINE_IMAGE" ]]; then
+if [[ -n "$OFFLINE_IMAGE" || -n "$OFFLINE_BATCH" ]]; then
   OFFLINE_MODE=1
 fi
 
@@ -201,7 +216,12 @@ if [[ "$OFFLINE_MODE" == "0" ]]; then
     fi
   done
 
-  if [[ ! -c "$DEVICE" ]]; then
+  if [[ -n "$REPLAY" ]]; then
+    if [[ ! -f "$REPLAY" ]]; then
+      echo "Replay file not found: $REPLAY" >&2
+      exit 3
+    fi
+  elif [[ ! -c "$DEVICE" ]]; then
     echo "Device not found: $DEVICE" >&2
     exit 3
   fi
@@ -211,7 +231,12 @@ if [[ "$OFFLINE_MODE" == "0" ]]; then
   fi
 fi
 
-if [[ "$OFFLINE_MODE" == "1" ]]; then
+if [[ "$OFFLINE_MODE" == "1" && -n "$OFFLINE_BATCH" ]]; then
+  if [[ ! -e "$OFFLINE_BATCH" || ! -f "$PLATE_MODEL" || ! -f "$OCR_MODEL" || ! -f "$OCR_KEYS" ]]; then
+    echo "Offline batch/model/keys file not found" >&2
+    exit 3
+  fi
+elif [[ "$OFFLINE_MODE" == "1" ]]; then
   if [[ ! -f "$OFFLINE_IMAGE" || ! -f "$PLATE_MODEL" || ! -f "$OCR_MODEL" || ! -f "$OCR_KEYS" ]]; then
     echo "Offline image/model/keys file not found" >&2
     exit 3
@@ -280,9 +305,16 @@ if [[ "$OFFLINE_MODE" == "0" ]]; then
     --stopline-ratio "$STOPLINE_RATIO"
     --det-resize-mode "$DET_RESIZE_MODE"
     --plate-refine "$PLATE_REFINE")
+  if [[ -n "$REPLAY" ]]; then
+    CMD+=(--replay "$REPLAY" --replay-speed "$REPLAY_SPEED" --replay-loop "$REPLAY_LOOP")
+  fi
 else
+  if [[ -n "$OFFLINE_BATCH" ]]; then
+    CMD+=(--offline-batch "$OFFLINE_BATCH" --offline-workers "$OFFLINE_WORKERS")
+  else
+    CMD+=(--offline-image "$OFFLINE_INPUT")
+  fi
   CMD+=(
-    --offline-image "$OFFLINE_INPUT"
     --offline-detect-plate "$OFFLINE_DETECT_PLATE"
     --sw-preproc "$SW_PREPROC"
     --det-resize-mode "$DET_RESIZE_MODE"
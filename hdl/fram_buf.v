@@ -47,6 +47,14 @@ module fram_buf #(
     output                        vout_de,
     output [127 : 0]              vout_data, // Changed from [PIX_WIDTH-1:0]
     output                        rd_data_ready,
+    // Read window for the vout stream (full frame: 0, 0, H_NUM, V_NUM, 0)
+    input  [11:0]                 rd_roi_x,
+    input  [11:0]                 rd_roi_y,
+    input  [11:0]                 rd_roi_w,
+    input  [11:0]                 rd_roi_h,
+    input  [1:0]                  rd_roi_decim,
+    input                         rd_roi_pack24,   // RGB888 detector tensor packing
+    input                         rd_hold_bank,    // re-read the previous session's bank
     
     output [CTRL_ADDR_WIDTH-1:0]  axi_awaddr     ,
     output [3:0]                  axi_awid       ,
@@ -190,6 +198,13 @@ module fram_buf #(
         
         .init_done       (  ddr_init_ready    ),//input - use DDR3 init directly, not camera-dependent init_done
         .i_wr_frame_idx  (  frame_widx        ),//input  [1:0]                  i_wr_frame_idx,
+        .i_roi_x         (  rd_roi_x          ),//input  [11:0]                 i_roi_x,
+        .i_roi_y         (  rd_roi_y          ),//input  [11:0]                 i_roi_y,
+        .i_roi_w         (  rd_roi_w          ),//input  [11:0]                 i_roi_w,
+        .i_roi_h         (  rd_roi_h          ),//input  [11:0]                 i_roi_h,
+        .i_roi_decim     (  rd_roi_decim      ),//input  [1:0]                  i_roi_decim,
+        .i_roi_pack24    (  rd_roi_pack24     ),//input                         i_roi_pack24,
+        .i_hold_bank     (  rd_hold_bank      ),//input                         i_hold_bank,
       
         .ddr_rreq        (  rd_cmd_en         ),//output                        ddr_rreq,
         .ddr_raddr       (  rd_cmd_addr       ),//output [ADDR_WIDTH- 1'b1 : 0] ddr_raddr,
@@ -79,6 +79,10 @@ module ips2l_pcie_dma #(
     output  wire                        o_cross_4kb_boundary    ,
     output  wire                        o_tx_restart_ext        ,
     output  wire                        o_frame_done_pulse_ext  ,
+    //frame read window registers
+    output  wire    [31:0]              o_roi_pos_ext           ,
+    output  wire    [31:0]              o_roi_size_ext          ,
+    output  wire    [31:0]              o_roi_ctrl_ext          ,
     //external BAR2 read data override (for frame data via MWR)
     output  wire                        o_bar2_rd_clk_en_ext    ,
     output  wire    [ADDR_WIDTH-1:0]    o_bar2_rd_addr_ext      ,
@@ -284,6 +288,9 @@ u_ips2l_pcie_dma_controller
     .o_cross_4kb_boundary       (o_cross_4kb_boundary       ),
     .i_mwr_tx_busy              (mwr_tx_busy                ),
     .o_frame_done_pulse         (frame_done_pulse           ),
+    .o_roi_pos                  (o_roi_pos_ext              ),
+    .o_roi_size                 (o_roi_size_ext             ),
+    .o_roi_ctrl                 (o_roi_ctrl_ext             ),
     //rst tlp cnt
     .i_dma_check_result         (dma_check_result           ),
     .o_tx_restart               (tx_restart                 )
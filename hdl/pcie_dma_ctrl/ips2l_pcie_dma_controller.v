@@ -56,7 +56,11 @@ module ips2l_pcie_dma_controller #(
     input           [63:0]              i_dma_check_result      ,
     output  wire                        o_tx_restart            ,
     output  reg                         o_cross_4kb_boundary    ,
-    output  reg                         o_frame_done_pulse
+    output  reg                         o_frame_done_pulse      ,
+    //frame read window (BAR1 0x130/0x140/0x150)
+    output  reg     [31:0]              o_roi_pos               ,   //[27:16]=y, [11:0]=x
+    output  reg     [31:0]              o_roi_size              ,   //[27:16]=h, [11:0]=w
+    output  reg     [31:0]              o_roi_ctrl                  //[31]=enable, [30]=RGB888 tensor, [29]=hold bank, [15:8]=tensor pad, [1:0]=log2 decimation
 
 );
 //apb register for rc
@@ -275,6 +279,26 @@ begin
         dma_h_addr_cfg_done <= 1'b1;
 end
 
+//frame read window: quasi-static, written before 0x110 starts the read session
+always@(posedge clk or negedge rst_n)
+begin
+    if(!rst_n)
+    begin
+        o_roi_pos  <= 32'd0;
+        o_roi_size <= 32'd0;
+        o_roi_ctrl <= 32'd0;
+    end
+    else if(device_ep && |i_bar1_wr_byte_en && i_bar1_wr_en)
+    begin
+        case(i_bar1_wr_addr[8:0])
+            9'h130: o_roi_pos  <= i_bar1_wr_data[31:0];
+            9'h140: o_roi_size <= i_bar1_wr_data[31:0];
+            9'h150: o_roi_ctrl <= i_bar1_wr_data[31:0];
+            default: ;
+        endcase
+    end
+end
+
 always@(posedge clk or negedge rst_n)
 begin
     if(!rst_n)
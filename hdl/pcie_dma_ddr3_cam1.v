@@ -190,6 +190,9 @@ wire	[11:0]	mwr_rd_addr;
 wire	[127:0]	mwr_rd_data;
 wire			mwr_cmd_start;
 wire			frame_done_pulse;
+wire	[31:0]	roi_pos_reg;
+wire	[31:0]	roi_size_reg;
+wire	[31:0]	roi_ctrl_reg;
 
 wire			cfg_msi_en;
 wire			ven_msi_grant;
@@ -443,6 +446,9 @@ ips2l_pcie_dma #(
     .o_cross_4kb_boundary	(cross_4kb_boundary),	//4k閺夊牆婀遍弲?
     .o_tx_restart_ext		(mwr_cmd_start),
     .o_frame_done_pulse_ext	(frame_done_pulse),
+    .o_roi_pos_ext			(roi_pos_reg),
+    .o_roi_size_ext			(roi_size_reg),
+    .o_roi_ctrl_ext			(roi_ctrl_reg),
 	// External BAR2 read override for MWR frame data
     .o_bar2_rd_clk_en_ext	(mwr_rd_clk_en),
     .o_bar2_rd_addr_ext		(mwr_rd_addr),
@@ -855,11 +861,59 @@ reg                        mwr_rd_clk_en_d;
 wire                       dma_session_start;
 wire                       rd_fsync_pclk_div2;
 wire                       preproc_en = PREPROC_ENABLE_DEFAULT;
-wire [17:0]                frame_words_cfg = FRAME_WORDS_BGRX;
+// Host-programmed read window (BAR1 0x130/0x140/0x150); full frame when disabled.
+wire                       roi_en    = roi_ctrl_reg[31];
+wire [11:0]                roi_x     = roi_en ? roi_pos_reg[11:0]   : 12'd0;
+wire [11:0]                roi_y     = roi_en ? roi_pos_reg[27:16]  : 12'd0;
+wire [11:0]                roi_w     = roi_en ? roi_size_reg[11:0]  : 12'd1280;
+wire [11:0]                roi_h     = roi_en ? roi_size_reg[27:16] : 12'd720;
+wire [1:0]                 roi_decim = ~roi_en ? 2'd0 :
+                                       (roi_ctrl_reg[1:0] == 2'd3) ? 2'd2 : roi_ctrl_reg[1:0];
+// Detector tensor (ROI_CTRL[30]): the window is packed to RGB888 by rd_buf and
+// letterboxed vertically to TENSOR_SIZE lines; the pad lines ([15:8] fill byte)
+// come from this mux, not from DDR. The decimated window must be TENSOR_SIZE
+// pixels wide. [29] re-reads the previous session's bank, so a tensor read
+// right after a display read shows the same camera frame.
+localparam [11:0]          TENSOR_SIZE       = 12'd640;
+localparam [17:0]          TENSOR_LINE_WORDS = (640 * 24) / 128;
+localparam [17:0]          TENSOR_WORDS      = TENSOR_LINE_WORDS * 640;
+wire                       tensor_en       = roi_en & roi_ctrl_reg[30];
+wire                       hold_bank       = roi_en & roi_ctrl_reg[29];
+wire [7:0]                 tensor_pad_byte = roi_ctrl_reg[15:8];
+wire [11:0]                tensor_img_lines = roi_h >> roi_decim;
+reg  [17:0]                tensor_img_start;
+reg  [17:0]                tensor_img_end;
+reg  [17:0]                roi_frame_words;
+wire [17:0]                frame_words_cfg = tensor_en ? TENSOR_WORDS :
+                                             roi_en    ? roi_frame_words : FRAME_WORDS_BGRX;
+
+always @(posedge pclk_div2 or negedge pclk_div2_core_rst_n) begin
+    if (!pclk_div2_core_rst_n)
+        roi_frame_words <= FRAME_WORDS_BGRX;
+    else
+        roi_frame_words <= ((roi_w >> roi_decim) >> 2) * (roi_h >> roi_decim);
+end
+
+always @(posedge pclk_div2 or negedge pclk_div2_core_rst_n) begin
+    if (!pclk_div2_core_rst_n) begin
+        tensor_img_start <= 18'd0;
+        tensor_img_end   <= TENSOR_WORDS;
+    end else if (tensor_img_lines >= TENSOR_SIZE) begin
+        tensor_img_start <= 18'd0;
+        tensor_img_end   <= TENSOR_WORDS;
+    end else begin
+        tensor_img_start <= ((TENSOR_SIZE - tensor_img_lines) >> 1) * TENSOR_LINE_WORDS;
+        tensor_img_end   <= (((TENSOR_SIZE - tensor_img_lines) >> 1) + tensor_img_lines) * TENSOR_LINE_WORDS;
+    end
+end
 // Count chunk first beat as a valid step to prevent boundary phase slip.
 wire                       bar2_addr_step = mwr_rd_clk_en &&
                                             ((mwr_rd_addr != mwr_rd_addr_d) || (~mwr_rd_clk_en_d));
-wire                       frame_rd_fetch_en = bar2_addr_step;
+// Pad words do not consume line buffer data.
+wire                       tensor_pad_now = tensor_en && dma_session_active &&
+                                            ((dma_rd_word_count < tensor_img_start) ||
+                                             (dma_rd_word_count >= tensor_img_end));
+wire                       frame_rd_fetch_en = bar2_addr_step & ~tensor_pad_now;
 wire [11:0]                post_ddr_x_pix = {1'b0, post_ddr_word_x, 2'b00};
 wire [15:0]                post_ddr_color_base = color_bar_bgr565(post_ddr_x_pix);
 wire [15:0]                post_ddr_color_data = post_ddr_color_base;
@@ -1091,8 +1145,9 @@ end
 
 wire [127:0] post_ddr_pattern_data_bgrx = {4{bgr565_to_bgrx32(post_ddr_color_data, preproc_en ? 8'h80 : 8'h00)}};
 wire [127:0] post_ddr_pattern_data = post_ddr_pattern_data_bgrx;
-wire [127:0] frame_dma_data = frame_rd_data;
-wire        frame_stream_ready = ~dma_session_active | ~mwr_first_beat_seen | frame_rd_data_ready;
+wire [127:0] frame_dma_data = tensor_pad_now ? {16{tensor_pad_byte}} : frame_rd_data;
+wire        frame_stream_ready = ~dma_session_active | ~mwr_first_beat_seen | frame_rd_data_ready |
+                                 tensor_pad_now;
 
 assign axis_slave2_tready_fc = axis_slave2_tready_raw & frame_stream_ready;
 
@@ -1201,6 +1256,13 @@ fram_buf #(
     .vout_de            (),
     .vout_data          (frame_rd_data),
     .rd_data_ready      (frame_rd_data_ready),
+    .rd_roi_x           (roi_x),
+    .rd_roi_y           (roi_y),
+    .rd_roi_w           (roi_w),
+    .rd_roi_h           (roi_h),
+    .rd_roi_decim       (roi_decim),
+    .rd_roi_pack24      (tensor_en),
+    .rd_hold_bank       (hold_bank),
     
     // AXI Write channel
     .axi_awaddr         (axi_awaddr),
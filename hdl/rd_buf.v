@@ -10,6 +10,10 @@
 // Target Devices: 
 // Tool Versions: 
 // Description: Modified for PCIe 128-bit Zero Copy
+//              Reads an (x, y, w, h) window of the locked frame bank with optional
+//              1/2 or 1/4 decimation; defaults to the full H_NUM x V_NUM frame.
+//              Optionally repacks BGRX to RGB888 (4 words -> 3) for the detector
+//              tensor, and can re-read the bank locked by the previous session.
 // 
 // Dependencies: 
 // 
@@ -42,6 +46,15 @@ module rd_buf #(
     
     input                         init_done,
     input      [1:0]              i_wr_frame_idx,
+    // Read window, sampled at rd_fsync. x and w must be multiples of 16 pixels.
+    input      [11:0]             i_roi_x,
+    input      [11:0]             i_roi_y,
+    input      [11:0]             i_roi_w,
+    input      [11:0]             i_roi_h,
+    input      [1:0]              i_roi_decim,   // log2 factor: 0=1:1, 1=1/2, 2=1/4
+    // Also sampled at rd_fsync. pack24 needs an output width that is a multiple of 16 pixels.
+    input                         i_roi_pack24,  // emit packed R,G,B bytes instead of BGRX
+    input                         i_hold_bank,   // keep the frame bank of the previous session
     
     output                        ddr_rreq,
     output [ADDR_WIDTH- 1'b1 : 0] ddr_raddr,
@@ -64,6 +77,10 @@ module rd_buf #(
     localparam [9:0] READY_HI_WATER = 10'd64;
     localparam [9:0] READY_LO_WATER = 10'd32;
     localparam [ADDR_WIDTH-1:0] FRAME_ADDR_STRIDE = ({{(ADDR_WIDTH-1){1'b0}},1'b1} << LINE_ADDR_WIDTH);
+    localparam PIX_PER_BEAT   = DDR_DATA_WIDTH / PIX_WIDTH;
+    localparam PIX_ADDR_UNITS = PIX_WIDTH / DQ_WIDTH;
+    // Horizontal decimation picks 32-bit pixels out of 128-bit beats.
+    localparam DECIM_SUPPORTED = (PIX_WIDTH == 32) && (DDR_DATA_WIDTH == RAM_WIDTH);
     
     //===========================================================================
     reg       rd_fsync_1d;
@@ -111,6 +128,15 @@ module rd_buf #(
     wire     set_pending;
     wire     req_accept;
 
+    reg  [11:0]                  roi_lines;
+    reg  [LEN_WIDTH-1:0]         roi_line_beats;
+    reg  [LINE_ADDR_WIDTH-1:0]   roi_base;
+    reg  [LINE_ADDR_WIDTH-1:0]   roi_line_step;
+    reg  [1:0]                   roi_decim;
+    reg                          roi_pack24;
+    wire [1:0]                   roi_decim_in = !DECIM_SUPPORTED     ? 2'd0 :
+                                                (i_roi_decim == 2'd3) ? 2'd2 : i_roi_decim;
+
     // Use wrap-bit pointers to avoid ambiguous modulo subtraction in 1024-depth ring.
     assign fill_level_ext = {wr_addr_wrap, wr_addr} - {rd_addr_wrap_ddr_2d, rd_addr_ddr_2d};
     assign rd_overtook_wr = fill_level_ext[10];
@@ -140,8 +166,8 @@ module rd_buf #(
     assign ddr_rdone_rise = ddr_rdone & ~ddr_rdone_d;
 
     assign prefetch_enable_rise = prefetch_enable & ~prefetch_enable_d;
-    assign can_issue_now = init_done && prefetch_enable && (wr_line < V_NUM);
-    assign can_issue_after_done = init_done && prefetch_enable && (wr_line + 12'd1 < V_NUM);
+    assign can_issue_now = init_done && prefetch_enable && (wr_line < roi_lines);
+    assign can_issue_after_done = init_done && prefetch_enable && (wr_line + 12'd1 < roi_lines);
     assign set_pending = (wr_rst && init_done) ||
                          (ddr_rdone_rise && can_issue_after_done) ||
                          (prefetch_enable_rise && can_issue_now && ~req_busy);
@@ -219,9 +245,9 @@ module rd_buf #(
             data_ready_ddr <= 1'b0;
         else if(fill_level >= READY_HI_WATER)
             data_ready_ddr <= 1'b1;
-        else if(fill_level <= READY_LO_WATER && wr_line < V_NUM)
+        else if(fill_level <= READY_LO_WATER && wr_line < roi_lines)
             data_ready_ddr <= 1'b0;
-        else if(wr_line >= V_NUM && fill_level == 10'd0)
+        else if(wr_line >= roi_lines && fill_level == 10'd0)
             data_ready_ddr <= 1'b0;
         else
             data_ready_ddr <= data_ready_ddr;
@@ -236,6 +262,30 @@ module rd_buf #(
     end 
     
     assign wr_rst = ~wr_fsync_3d && wr_fsync_2d;
+
+    // The host writes the window before the DMA command, so the inputs are
+    // stable by the time the session start crosses into this domain.
+    always @(posedge ddr_clk)
+    begin
+        if(~ddr_rstn)
+        begin
+            roi_lines      <= V_NUM;
+            roi_line_beats <= RD_LINE_NUM;
+            roi_base       <= {LINE_ADDR_WIDTH{1'b0}};
+            roi_line_step  <= DDR_ADDR_OFFSET;
+            roi_decim      <= 2'd0;
+            roi_pack24     <= 1'b0;
+        end
+        else if(wr_rst)
+        begin
+            roi_lines      <= i_roi_h >> roi_decim_in;
+            roi_line_beats <= i_roi_w / PIX_PER_BEAT;
+            roi_base       <= i_roi_y * DDR_ADDR_OFFSET + i_roi_x * PIX_ADDR_UNITS;
+            roi_line_step  <= DDR_ADDR_OFFSET << roi_decim_in;
+            roi_decim      <= roi_decim_in;
+            roi_pack24     <= DECIM_SUPPORTED && i_roi_pack24;
+        end
+    end
     
     //==========================================================================
     reg [1:0] locked_frame_idx;
@@ -245,9 +295,10 @@ module rd_buf #(
     begin 
         if(~ddr_rstn)
             locked_frame_idx <= 2'd0;
-        else if(wr_rst)
+        else if(wr_rst && !i_hold_bank)
         begin
             // 3-bank mode: read the previously completed frame bank.
+            // A held session (tensor after display) reuses the bank already locked.
             case (i_wr_frame_idx)
                 2'd0: locked_frame_idx <= 2'd2;
                 2'd1: locked_frame_idx <= 2'd0;
@@ -268,23 +319,101 @@ module rd_buf #(
         if(wr_rst)
             wr_cnt <= 10'd0;
         else if(ddr_rdone_rise)
-            wr_cnt <= wr_cnt + DDR_ADDR_OFFSET;
+            wr_cnt <= wr_cnt + roi_line_step;
         else
             wr_cnt <= wr_cnt;
     end 
     
     assign ddr_rreq = wr_trig;
-    assign ddr_raddr = locked_frame_base + wr_cnt + ADDR_OFFSET;
-    assign ddr_rd_len = RD_LINE_NUM;
+    assign ddr_raddr = locked_frame_base + roi_base + wr_cnt + ADDR_OFFSET;
+    assign ddr_rd_len = roi_line_beats;
     
     wire [127:0]          rd_data; // Changed to 128-bit
+
+    //===========================================================================
+    // Horizontal decimation: keep every 2nd/4th pixel and pack 2/4 DDR beats
+    // into one RAM word. Lines are a multiple of 4 beats, so the phase
+    // realigns at every line start.
+    reg  [1:0]   dec_phase;
+    reg  [95:0]  dec_word;
+    wire         dec_last = (roi_decim == 2'd0) ||
+                            ((roi_decim == 2'd1) && dec_phase[0]) ||
+                            (dec_phase == 2'd3);
+    wire         dec_wr_en = ddr_rdata_en && dec_last;
+    wire [127:0] dec_wr_data = (roi_decim == 2'd0) ? ddr_rdata :
+                               (roi_decim == 2'd1) ? {ddr_rdata[95:64], ddr_rdata[31:0], dec_word[63:0]} :
+                                                     {ddr_rdata[31:0], dec_word[95:0]};
+
+    always @(posedge ddr_clk)
+    begin
+        if(wr_rst || (~ddr_rstn))
+        begin
+            dec_phase <= 2'd0;
+            dec_word  <= 96'd0;
+        end
+        else if(ddr_rdata_en)
+        begin
+            dec_phase <= dec_last ? 2'd0 : dec_phase + 2'd1;
+            if(roi_decim == 2'd1)
+                dec_word[63:0] <= {ddr_rdata[95:64], ddr_rdata[31:0]};
+            else
+            begin
+                case(dec_phase)
+                    2'd0:    dec_word[31:0]  <= ddr_rdata[31:0];
+                    2'd1:    dec_word[63:32] <= ddr_rdata[31:0];
+                    default: dec_word[95:64] <= ddr_rdata[31:0];
+                endcase
+            end
+        end
+    end
+
+    //===========================================================================
+    // RGB888 packing: drop X and reorder each pixel to R,G,B in memory, then
+    // pack 4 decimated words (16 pixels, 48 bytes) into 3 RAM words. Output
+    // lines are a multiple of 16 pixels, so the phase realigns per line too.
+    function [23:0] bgrx_to_rgb24;
+        input [31:0] px;
+    begin
+        bgrx_to_rgb24 = {px[7:0], px[15:8], px[23:16]};
+    end
+    endfunction
+
+    reg  [1:0]   pk_phase;
+    reg  [95:0]  pk_hold;
+    wire [95:0]  pk_rgb = {bgrx_to_rgb24(dec_wr_data[127:96]), bgrx_to_rgb24(dec_wr_data[95:64]),
+                           bgrx_to_rgb24(dec_wr_data[63:32]),  bgrx_to_rgb24(dec_wr_data[31:0])};
+    wire         pk_wr_en = dec_wr_en && (pk_phase != 2'd0);
+    wire [127:0] pk_wr_data = (pk_phase == 2'd1) ? {pk_rgb[31:0], pk_hold[95:0]} :
+                              (pk_phase == 2'd2) ? {pk_rgb[63:0], pk_hold[63:0]} :
+                                                   {pk_rgb[95:0], pk_hold[31:0]};
+    wire         ram_wr_en = roi_pack24 ? pk_wr_en : dec_wr_en;
+    wire [127:0] ram_wr_data = roi_pack24 ? pk_wr_data : dec_wr_data;
+
+    always @(posedge ddr_clk)
+    begin
+        if(wr_rst || (~ddr_rstn))
+        begin
+            pk_phase <= 2'd0;
+            pk_hold  <= 96'd0;
+        end
+        else if(dec_wr_en && roi_pack24)
+        begin
+            pk_phase <= pk_phase + 2'd1;
+            case(pk_phase)
+                2'd0:    pk_hold[95:0] <= pk_rgb;
+                2'd1:    pk_hold[63:0] <= pk_rgb[95:32];
+                2'd2:    pk_hold[31:0] <= pk_rgb[95:64];
+                default: pk_hold       <= pk_hold;
+            endcase
+        end
+    end
     
     //===========================================================================
     always @(posedge ddr_clk)
     begin
         if(wr_rst)
             wr_addr <= (SIM == 1'b1) ? 10'd360 : 10'd0;
-        else if(ddr_rdata_en)
+        else if(ram_wr_en)
             wr_addr <= wr_addr + 10'd1;
         else
             wr_addr <= wr_addr;
@@ -294,17 +423,17 @@ module rd_buf #(
     begin
         if(wr_rst || (~ddr_rstn))
             wr_addr_wrap <= 1'b0;
-        else if(ddr_rdata_en && (wr_addr == 10'h3ff))
+        else if(ram_wr_en && (wr_addr == 10'h3ff))
             wr_addr_wrap <= ~wr_addr_wrap;
         else
             wr_addr_wrap <= wr_addr_wrap;
     end
 
     rd_fram_buf rd_fram_buf (
-        .a_wr_data   (  ddr_rdata       ),// input [127:0]            
+        .a_wr_data   (  ram_wr_data     ),// input [127:0]            
         .a_addr      (  wr_addr         ),// input [9:0]              
         .a_rd_data   (                  ),
-        .a_wr_en     (  ddr_rdata_en    ),// input                    
+        .a_wr_en     (  ram_wr_en       ),// input                    
         .a_clk       (  ddr_clk         ),// input                    
         .a_rst       (  ~ddr_rstn       ),// input                    
         .b_addr      (  rd_addr         ),// input [9:0]             
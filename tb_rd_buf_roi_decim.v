@@ -0,0 +1,326 @@
+`timescale 1ns / 1ps
+
+// Behavioral stand-in for the 1024x128 dual-port read line buffer IP.
+module rd_fram_buf (
+    input  wire [127:0] a_wr_data,
+    input  wire [9:0]   a_addr,
+    output reg  [127:0] a_rd_data,
+    input  wire         a_wr_en,
+    input  wire         a_clk,
+    input  wire         a_rst,
+    input  wire [9:0]   b_addr,
+    input  wire [127:0] b_wr_data,
+    output reg  [127:0] b_rd_data,
+    input  wire         b_wr_en,
+    input  wire         b_clk,
+    input  wire         b_rst
+);
+
+reg [127:0] mem [0:1023];
+
+always @(posedge a_clk) begin
+    if (a_wr_en)
+        mem[a_addr] <= a_wr_data;
+    a_rd_data <= mem[a_addr];
+end
+
+always @(posedge b_clk)
+    b_rd_data <= mem[b_addr];
+
+endmodule
+
+module tb_rd_buf_roi_decim;
+
+localparam H_NUM           = 1280;
+localparam V_NUM           = 720;
+localparam DQ_WIDTH        = 16;
+localparam ADDR_WIDTH      = 28;
+localparam LINE_ADDR_WIDTH = 22;
+localparam LINE_UNITS      = H_NUM * 32 / DQ_WIDTH;
+// i_wr_frame_idx = 0 locks bank 2 for reading.
+localparam [ADDR_WIDTH-1:0] BANK_BASE = 28'd2 << LINE_ADDR_WIDTH;
+localparam MAX_WORDS       = 1024;
+
+reg         ddr_clk;
+reg         vout_clk;
+reg         ddr_rstn;
+reg         rd_fsync;
+reg  [11:0] roi_x;
+reg  [11:0] roi_y;
+reg  [11:0] roi_w;
+reg  [11:0] roi_h;
+reg  [1:0]  roi_decim;
+reg         roi_pack24;
+reg         hold_bank;
+reg  [1:0]  wr_frame_idx;
+
+wire                  ddr_rreq;
+wire [ADDR_WIDTH-1:0] ddr_raddr;
+wire [31:0]           ddr_rd_len;
+reg                   ddr_rrdy;
+reg                   ddr_rdone;
+reg  [127:0]          ddr_rdata;
+reg                   ddr_rdata_en;
+
+reg  [ADDR_WIDTH-1:0] beat_addr;
+reg  [31:0]           beats_left;
+reg  [2:0]            done_delay;
+
+reg  [127:0] expected [0:MAX_WORDS-1];
+reg  [7:0]   rgb_bytes [0:MAX_WORDS*16-1];
+integer      expected_count;
+integer      seen_count;
+integer      mismatch_count;
+integer      case_idx;
+
+rd_buf #(
+    .ADDR_WIDTH      (ADDR_WIDTH),
+    .ADDR_OFFSET     (32'h0000_0000),
+    .H_NUM           (H_NUM),
+    .V_NUM           (V_NUM),
+    .DQ_WIDTH        (DQ_WIDTH),
+    .LEN_WIDTH       (32),
+    .PIX_WIDTH       (32),
+    .LINE_ADDR_WIDTH (LINE_ADDR_WIDTH),
+    .FRAME_CNT_WIDTH (ADDR_WIDTH - LINE_ADDR_WIDTH)
+) dut (
+    .ddr_clk        (ddr_clk),
+    .ddr_rstn       (ddr_rstn),
+    .vout_clk       (vout_clk),
+    .rd_fsync       (rd_fsync),
+    .rd_en          (1'b0),
+    .vout_de        (),
+    .vout_data      (),
+    .o_data_ready   (),
+    .init_done      (1'b1),
+    .i_wr_frame_idx (wr_frame_idx),
+    .i_roi_x        (roi_x),
+    .i_roi_y        (roi_y),
+    .i_roi_w        (roi_w),
+    .i_roi_h        (roi_h),
+    .i_roi_decim    (roi_decim),
+    .i_roi_pack24   (roi_pack24),
+    .i_hold_bank    (hold_bank),
+    .ddr_rreq       (ddr_rreq),
+    .ddr_raddr      (ddr_raddr),
+    .ddr_rd_len     (ddr_rd_len),
+    .ddr_rrdy       (ddr_rrdy),
+    .ddr_rdone      (ddr_rdone),
+    .ddr_rdata      (ddr_rdata),
+    .ddr_rdata_en   (ddr_rdata_en)
+);
+
+initial ddr_clk = 1'b0;
+always #5 ddr_clk = ~ddr_clk;
+
+initial vout_clk = 1'b0;
+always #4 vout_clk = ~vout_clk;
+
+// Every source pixel encodes its own coordinates.
+function [31:0] pix_value;
+    input integer line;
+    input integer px;
+begin
+    pix_value = {4'hA, line[11:0], px[15:0]};
+end
+endfunction
+
+function [127:0] ddr_beat;
+    input [ADDR_WIDTH-1:0] addr;
+    integer off;
+    integer line;
+    integer px;
+begin
+    off = addr - BANK_BASE;
+    line = off / LINE_UNITS;
+    px = (off % LINE_UNITS) / 2;
+    ddr_beat = {pix_value(line, px + 3), pix_value(line, px + 2),
+                pix_value(line, px + 1), pix_value(line, px)};
+end
+endfunction
+
+// DDR read responder: accept one line request, stream it, pulse rdone a few
+// cycles after the last beat like the real controller.
+always @(posedge ddr_clk) begin
+    if (!ddr_rstn) begin
+        ddr_rrdy <= 1'b1;
+        ddr_rdone <= 1'b0;
+        ddr_rdata_en <= 1'b0;
+        ddr_rdata <= 128'd0;
+        beats_left <= 32'd0;
+        done_delay <= 3'd0;
+    end else begin
+        ddr_rdone <= 1'b0;
+        ddr_rdata_en <= 1'b0;
+        if (ddr_rreq) begin
+            ddr_rrdy <= 1'b0;
+            beat_addr <= ddr_raddr;
+            beats_left <= ddr_rd_len;
+        end else if (beats_left != 32'd0) begin
+            ddr_rdata_en <= 1'b1;
+            ddr_rdata <= ddr_beat(beat_addr);
+            beat_addr <= beat_addr + 28'd8;
+            beats_left <= beats_left - 32'd1;
+            if (beats_left == 32'd1)
+                done_delay <= 3'd4;
+        end else if (done_delay != 3'd0) begin
+            done_delay <= done_delay - 3'd1;
+            if (done_delay == 3'd1) begin
+                ddr_rdone <= 1'b1;
+                ddr_rrdy <= 1'b1;
+            end
+        end
+    end
+end
+
+// Snoop the line buffer write port.
+always @(posedge ddr_clk) begin
+    if (ddr_rstn && dut.ram_wr_en) begin
+        if (seen_count < expected_count) begin
+            if (dut.ram_wr_data !== expected[seen_count]) begin
+                mismatch_count = mismatch_count + 1;
+                if (mismatch_count <= 8)
+                    $display("MISMATCH case=%0d word=%0d ref=%h out=%h",
+                             case_idx, seen_count, expected[seen_count], dut.ram_wr_data);
+            end
+        end
+        seen_count = seen_count + 1;
+    end
+end
+
+task build_expected;
+    input integer x;
+    input integer y;
+    input integer w;
+    input integer h;
+    input integer decim;
+    input integer pack24;
+    input integer limit;
+    integer ol;
+    integer ow;
+    integer out_w;
+    integer out_h;
+    integer line;
+    integer px;
+    integer nbytes;
+    integer b;
+    reg [31:0] v;
+begin
+    out_w = w / decim;
+    out_h = h / decim;
+    expected_count = 0;
+    nbytes = 0;
+    for (ol = 0; ol < out_h; ol = ol + 1) begin
+        line = y + ol * decim;
+        for (ow = 0; ow < out_w; ow = ow + 4) begin
+            px = x + ow * decim;
+            if (pack24 == 0 && expected_count < limit) begin
+                expected[expected_count] = {pix_value(line, px + 3 * decim), pix_value(line, px + 2 * decim),
+                                            pix_value(line, px + decim), pix_value(line, px)};
+                expected_count = expected_count + 1;
+            end
+            // RGB888 tensor bytes: R, G, B per pixel, X dropped.
+            for (b = 0; pack24 != 0 && b < 4 && nbytes < limit * 16; b = b + 1) begin
+                v = pix_value(line, px + b * decim);
+                rgb_bytes[nbytes]     = v[23:16];
+                rgb_bytes[nbytes + 1] = v[15:8];
+                rgb_bytes[nbytes + 2] = v[7:0];
+                nbytes = nbytes + 3;
+            end
+        end
+    end
+    for (b = 0; b + 16 <= nbytes; b = b + 16) begin
+        for (ow = 0; ow < 16; ow = ow + 1)
+            expected[expected_count][ow * 8 +: 8] = rgb_bytes[b + ow];
+        expected_count = expected_count + 1;
+    end
+end
+endtask
+
+task run_case;
+    input integer x;
+    input integer y;
+    input integer w;
+    input integer h;
+    input integer decim_log2;
+    input integer pack24;
+    input integer limit;
+    integer timeout;
+begin
+    case_idx = case_idx + 1;
+    roi_x = x;
+    roi_y = y;
+    roi_w = w;
+    roi_h = h;
+    roi_decim = decim_log2;
+    roi_pack24 = pack24;
+    build_expected(x, y, w, h, 1 << decim_log2, pack24, limit);
+    seen_count = 0;
+
+    @(posedge vout_clk);
+    rd_fsync = 1'b1;
+    repeat (8) @(posedge vout_clk);
+    rd_fsync = 1'b0;
+
+    timeout = 0;
+    while (seen_count < expected_count && timeout < 100000) begin
+        @(posedge ddr_clk);
+        timeout = timeout + 1;
+    end
+    // Nothing beyond the window may land.
+    repeat (2000) @(posedge ddr_clk);
+
+    if (seen_count != expected_count) begin
+        $display("ERROR: case=%0d wrote %0d words, expected %0d", case_idx, seen_count, expected_count);
+        $fatal;
+    end
+    if (mismatch_count != 0) begin
+        $display("ERROR: case=%0d found %0d word mismatches", case_idx, mismatch_count);
+        $fatal;
+    end
+end
+endtask
+
+initial begin
+    ddr_rstn = 1'b0;
+    rd_fsync = 1'b0;
+    roi_x = 12'd0;
+    roi_y = 12'd0;
+    roi_w = H_NUM;
+    roi_h = V_NUM;
+    roi_decim = 2'd0;
+    roi_pack24 = 1'b0;
+    hold_bank = 1'b0;
+    wr_frame_idx = 2'd0;
+    expected_count = 0;
+    seen_count = 0;
+    mismatch_count = 0;
+    case_idx = 0;
+
+    repeat (10) @(posedge ddr_clk);
+    ddr_rstn = 1'b1;
+    repeat (10) @(posedge ddr_clk);
+
+    // Window without decimation.
+    run_case(32, 5, 64, 8, 0, 0, MAX_WORDS);
+    // Half resolution: every 2nd pixel of every 2nd line.
+    run_case(16, 2, 128, 16, 1, 0, MAX_WORDS);
+    // Quarter resolution.
+    run_case(0, 4, 256, 16, 2, 0, MAX_WORDS);
+    // Full frame: nobody drains the buffer, so prefetch stops after two lines.
+    run_case(0, 0, H_NUM, V_NUM, 0, 0, 640);
+    // RGB888 packing, 16 output pixels per 3 words, with and without decimation.
+    run_case(0, 3, 64, 4, 0, 1, MAX_WORDS);
+    run_case(32, 0, 256, 8, 1, 1, MAX_WORDS);
+    // Tensor session after display: the writer moved on, the bank must not.
+    wr_frame_idx = 2'd1;
+    hold_bank = 1'b1;
+    run_case(0, 0, H_NUM, 8, 1, 1, MAX_WORDS);
+    hold_bank = 1'b0;
+    wr_frame_idx = 2'd0;
+
+    $display("PASS: rd_buf window, decimation and RGB888 packing match the reference pixel layout.");
+    $finish;
+end
+
+endmodule